@@ -1,9 +1,14 @@
 
 
+// The profile, render stats and load timings are built as JSON in wasm, so they're only
+//   read a few times a second rather than every frame
+const PROFILE_POLL_INTERVAL = 250;
+
 module.exports = class GameCanvas {
     constructor (clientState, canvas) {
         this.canvas = canvas;
         this.clientState = clientState;
+        this.lastProfilePoll = 0;
 
         document.addEventListener('pointerlockchange', () => {
             this.clientState.isPaused = document.pointerLockElement !== this.canvas;
@@ -67,5 +72,18 @@ module.exports = class GameCanvas {
 
         const postDraw = Date.now();
         this.clientState.performance.drawTime.pushValue(postDraw - preDraw);
+
+        if (postDraw - this.lastProfilePoll < PROFILE_POLL_INTERVAL) return;
+        this.lastProfilePoll = postDraw;
+
+        this.clientState.renderProfile = this.clientState.GetRenderProfile();
+        this.clientState.performance.gpuTime.pushValue(this.clientState.renderProfile.gpuTotalMs);
+        this.clientState.renderStats = this.clientState.GetRenderStats();
+
+        // Poll until the map's bundle lands, then the numbers are final
+        const loadTimings = this.clientState.loadTimings;
+        if (!loadTimings || loadTimings.mapReadyMs < 0) {
+            this.clientState.loadTimings = this.clientState.GetLoadTimings();
+        }
     }
 }
\ No newline at end of file
@@ -289,6 +289,30 @@ module.exports = class UICanvas {
         this.DrawGraph("Tick Interval", this.clientState.performance.tickInterval, 300 + (graphWidth * i++), 20);
         this.DrawGraph("Replication Count", this.clientState.performance.replicateObjectCount, 300 + (graphWidth * i++), 20);
         this.DrawGraph("Draw Time", this.clientState.performance.drawTime, 300 + (graphWidth * i++), 20);
+        this.DrawGraph("GPU Time", this.clientState.performance.gpuTime, 300 + (graphWidth * i++), 20);
+
+        const timings = this.clientState.loadTimings;
+        if (timings) {
+            const mapReady = timings.mapFailed ? "failed"
+                : timings.mapReadyMs >= 0 ? `${timings.mapReadyMs.toFixed(0)}ms` : "loading";
+            this.context.fillText(`First frame ${timings.firstFrameMs.toFixed(0)}ms, map assets ${mapReady}`, 20, 100);
+        }
+
+        const stats = this.clientState.renderStats;
+        if (stats) {
+            this.context.fillText(`Drawn ${stats.objectsDrawn}/${stats.objectsTested} objects, ${stats.drawCalls} draw calls `
+                + `(${stats.instancedDrawCalls} instanced), ${stats.shadowDrawCalls} shadow`, 20, 120);
+        }
+        if (this.clientState.tracing) {
+            this.context.fillText("Tracing, F8 saves the trace", 20, 140);
+        }
+
+        const profile = this.clientState.renderProfile;
+        if (profile && profile.gpuTimerSupported) {
+            profile.passes.forEach((pass, index) => {
+                this.context.fillText(`${pass.name} ${pass.gpuMs.toFixed(2)}ms`, 20, 160 + index * 20);
+            });
+        }
 
 
         Object.keys(this.clientState.animations).forEach(k => {
@@ -58,8 +58,13 @@ module.exports = class ClientState {
             tickTime: new PerfTracker(100),
             tickInterval: new PerfTracker(100),
             replicateObjectCount: new PerfTracker(100),
-            drawTime: new PerfTracker(100)
+            drawTime: new PerfTracker(100),
+            gpuTime: new PerfTracker(100)
         };
+        this.renderProfile = undefined;
+        this.renderStats = undefined;
+        this.loadTimings = undefined;
+        this.tracing = false;
 
         this.SetupSocketHandler();
 
@@ -130,6 +135,9 @@ module.exports = class ClientState {
                 const heapString = this.ToHeapString(this.wasm, ev.data);
                 this.wasm._HandleReplicate(heapString);
                 this.wasm._free(heapString);
+                if (this.wasm._TakeRelationshipResyncRequest()) {
+                    this.SendData(JSON.stringify({ event: "resync" }));
+                }
                 const endTime = Date.now();
                 this.performance.handleReplicateTime.pushValue(endTime - startTime);
             }
@@ -294,6 +302,14 @@ module.exports = class ClientState {
                     this.game.canvas.requestPointerLock();
                 }
             }
+            // F8 starts tracing, pressing it again saves the trace
+            if (e.keyCode === 119 && !e.repeat) {
+                this.tracing = !this.tracing;
+                this.SetTracing(this.tracing);
+                if (!this.tracing) {
+                    this.DownloadTrace();
+                }
+            }
         });
 
         window.addEventListener('keyup', e => {
@@ -367,6 +383,59 @@ module.exports = class ClientState {
         return serializedObject;
     }
 
+    // Culling and draw call counters from the last frame
+    GetRenderStats() {
+        const serializedString = this.wasm._GetRenderStats();
+        const jsonString = this.wasm.UTF8ToString(serializedString);
+        const stats = JSON.parse(jsonString);
+        this.wasm._free(serializedString);
+        return stats;
+    }
+
+    // Voice pool counters from the last audio tick
+    GetAudioStats() {
+        const serializedString = this.wasm._GetAudioStats();
+        const jsonString = this.wasm.UTF8ToString(serializedString);
+        const stats = JSON.parse(jsonString);
+        this.wasm._free(serializedString);
+        return stats;
+    }
+
+    // Per pass GPU and CPU timings, GPU times lag a few frames behind
+    GetRenderProfile() {
+        const serializedString = this.wasm._GetRenderProfile();
+        const jsonString = this.wasm.UTF8ToString(serializedString);
+        const profile = JSON.parse(jsonString);
+        this.wasm._free(serializedString);
+        return profile;
+    }
+
+    // Time to first frame and to the map's bundle, ms since navigation
+    GetLoadTimings() {
+        const serializedString = this.wasm._GetLoadTimings();
+        const jsonString = this.wasm.UTF8ToString(serializedString);
+        const timings = JSON.parse(jsonString);
+        this.wasm._free(serializedString);
+        return timings;
+    }
+
+    // Spans are recorded while tracing is on, the trace holds the last few
+    //   thousand and opens in Perfetto (ui.perfetto.dev)
+    SetTracing(enabled) {
+        this.wasm._SetTracing(enabled);
+    }
+
+    DownloadTrace() {
+        const serializedString = this.wasm._GetTrace();
+        const jsonString = this.wasm.UTF8ToString(serializedString);
+        this.wasm._free(serializedString);
+        const link = document.createElement('a');
+        link.href = URL.createObjectURL(new Blob([jsonString], { type: 'application/json' }));
+        link.download = 'trace.json';
+        link.click();
+        URL.revokeObjectURL(link.href);
+    }
+
     ApplyPlayerSettings(settings) {
         const input = {
             "event": "playerSettings",
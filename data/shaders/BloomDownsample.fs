@@ -0,0 +1,38 @@
+uniform sampler2D u_texture;
+// Size of the level being sampled
+uniform vec2 u_textureSize;
+
+in vec2 FragmentTexCoords;
+
+out vec4 OutputColor;
+
+// 13 tap downsample (Jimenez, Next Generation Post Processing in Call of Duty:
+//   Advanced Warfare), five overlapping 2x2 boxes weighted towards the center
+void main() {
+    vec2 uv = FragmentTexCoords;
+    vec2 texel = 1.0 / u_textureSize;
+    float x = texel.x;
+    float y = texel.y;
+
+    vec4 a = texture(u_texture, uv + vec2(-2.0 * x,  2.0 * y));
+    vec4 b = texture(u_texture, uv + vec2( 0.0,      2.0 * y));
+    vec4 c = texture(u_texture, uv + vec2( 2.0 * x,  2.0 * y));
+
+    vec4 d = texture(u_texture, uv + vec2(-2.0 * x,  0.0));
+    vec4 e = texture(u_texture, uv);
+    vec4 f = texture(u_texture, uv + vec2( 2.0 * x,  0.0));
+
+    vec4 g = texture(u_texture, uv + vec2(-2.0 * x, -2.0 * y));
+    vec4 h = texture(u_texture, uv + vec2( 0.0,     -2.0 * y));
+    vec4 i = texture(u_texture, uv + vec2( 2.0 * x, -2.0 * y));
+
+    vec4 j = texture(u_texture, uv + vec2(-x,  y));
+    vec4 k = texture(u_texture, uv + vec2( x,  y));
+    vec4 l = texture(u_texture, uv + vec2(-x, -y));
+    vec4 m = texture(u_texture, uv + vec2( x, -y));
+
+    OutputColor = e * 0.125
+        + (a + c + g + i) * 0.03125
+        + (b + d + f + h) * 0.0625
+        + (j + k + l + m) * 0.125;
+}
@@ -1,6 +1,5 @@
 uniform sampler2D u_texture;
 uniform vec2 u_textureSize;
-uniform vec2 u_direction;
 
 uniform float u_threshold;
 
@@ -8,14 +7,21 @@ in vec2 FragmentTexCoords;
 
 out vec4 OutputColor;
 
-void main() {
-    OutputColor = vec4(0.0, 0.0, 0.0, 0.0);
-    vec4 tex = texture(u_texture, FragmentTexCoords);
+vec4 HighPass(vec2 uv) {
+    vec4 tex = texture(u_texture, uv);
     float max_brightness = length(tex.rgb);
     if (isnan(max_brightness) || (max_brightness < u_threshold)) {
-        return;
+        return vec4(0.0, 0.0, 0.0, 0.0);
     }
+    return tex;
+}
 
-    OutputColor = vec4(u_threshold, u_threshold, u_threshold, 1.0);
-    OutputColor = tex;
-}
\ No newline at end of file
+void main() {
+    // Drawn at half resolution, average the 2x2 input texels under this one
+    vec2 texel = 0.5 / u_textureSize;
+    OutputColor = 0.25 * (
+        HighPass(FragmentTexCoords + vec2(-texel.x, -texel.y)) +
+        HighPass(FragmentTexCoords + vec2( texel.x, -texel.y)) +
+        HighPass(FragmentTexCoords + vec2(-texel.x,  texel.y)) +
+        HighPass(FragmentTexCoords + vec2( texel.x,  texel.y)));
+}
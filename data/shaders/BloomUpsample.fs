@@ -0,0 +1,31 @@
+uniform sampler2D u_texture;
+// Size of the (smaller) level being sampled
+uniform vec2 u_textureSize;
+// Tent radius in texels of the sampled level
+uniform float u_filterRadius;
+
+in vec2 FragmentTexCoords;
+
+out vec4 OutputColor;
+
+// 3x3 tent filter, added onto the level above with additive blending
+void main() {
+    vec2 uv = FragmentTexCoords;
+    vec2 offset = u_filterRadius / u_textureSize;
+    float x = offset.x;
+    float y = offset.y;
+
+    vec4 a = texture(u_texture, uv + vec2(-x,  y));
+    vec4 b = texture(u_texture, uv + vec2( 0.0, y));
+    vec4 c = texture(u_texture, uv + vec2( x,  y));
+
+    vec4 d = texture(u_texture, uv + vec2(-x, 0.0));
+    vec4 e = texture(u_texture, uv);
+    vec4 f = texture(u_texture, uv + vec2( x, 0.0));
+
+    vec4 g = texture(u_texture, uv + vec2(-x, -y));
+    vec4 h = texture(u_texture, uv + vec2( 0.0, -y));
+    vec4 i = texture(u_texture, uv + vec2( x, -y));
+
+    OutputColor = (e * 4.0 + (b + d + f + h) * 2.0 + (a + c + g + i)) / 16.0;
+}
@@ -0,0 +1,92 @@
+uniform vec2 u_textureSize;
+
+uniform float u_lumaThreshold;
+uniform float u_mulReduce;
+uniform float u_minReduce;
+uniform float u_maxSpan;
+
+in vec2 FragmentTexCoords;
+
+out vec4 OutputColor;
+
+// Fetches the color to antialias
+#require SampleColor
+
+void main() {
+    // Passthrough for now
+    // OutputColor = SampleColor(FragmentTexCoords);
+    vec4 base = SampleColor(FragmentTexCoords);
+    vec3 rgbM = base.rgb;
+    float alpha = base.a;
+
+	// Sampling neighbour texels. Offsets are adapted to OpenGL texture coordinates.
+	vec2 texel = 1.0 / u_textureSize;
+	vec3 rgbNW = SampleColor(FragmentTexCoords + vec2(-1.0, 1.0) * texel).rgb;
+    vec3 rgbNE = SampleColor(FragmentTexCoords + vec2(1.0, 1.0) * texel).rgb;
+    vec3 rgbSW = SampleColor(FragmentTexCoords + vec2(-1.0, -1.0) * texel).rgb;
+    vec3 rgbSE = SampleColor(FragmentTexCoords + vec2(1.0, -1.0) * texel).rgb;
+
+	// see http://en.wikipedia.org/wiki/Grayscale
+	const vec3 toLuma = vec3(0.299, 0.587, 0.114);
+
+	// Convert from RGB to luma.
+	float lumaNW = dot(rgbNW, toLuma);
+	float lumaNE = dot(rgbNE, toLuma);
+	float lumaSW = dot(rgbSW, toLuma);
+	float lumaSE = dot(rgbSE, toLuma);
+	float lumaM = dot(rgbM, toLuma);
+
+	// Gather minimum and maximum luma.
+	float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+	float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+	// // If contrast is lower than a maximum threshold ...
+	// if (lumaMax - lumaMin <= lumaMax * u_lumaThreshold)
+	// {
+	// 	// ... do no AA and return.
+	// 	OutputColor = vec4(rgbM, alpha);
+	// 	return;
+	// }
+
+	// Sampling is done along the gradient.
+	vec2 samplingDirection;
+	samplingDirection.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    samplingDirection.y =  ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    // Sampling step distance depends on the luma: The brighter the sampled texels, the smaller the final sampling step direction.
+    // This results, that brighter areas are less blurred/more sharper than dark areas.
+    float samplingDirectionReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * u_mulReduce, u_minReduce);
+
+	// Factor for norming the sampling direction plus adding the brightness influence.
+	float minSamplingDirectionFactor = 1.0 / (min(abs(samplingDirection.x), abs(samplingDirection.y)) + samplingDirectionReduce);
+
+    // Calculate final sampling direction vector by reducing, clamping to a range and finally adapting to the texture size.
+    samplingDirection = clamp(samplingDirection * minSamplingDirectionFactor, vec2(-u_maxSpan), vec2(u_maxSpan)) * (1.0 / u_textureSize);
+
+	// Inner samples on the tab.
+	vec3 rgbSampleNeg = SampleColor(FragmentTexCoords + samplingDirection * (1.0/3.0 - 0.5)).rgb;
+	vec3 rgbSamplePos = SampleColor(FragmentTexCoords + samplingDirection * (2.0/3.0 - 0.5)).rgb;
+
+	vec3 rgbTwoTab = (rgbSamplePos + rgbSampleNeg) * 0.5;
+
+	// Outer samples on the tab.
+	vec3 rgbSampleNegOuter = SampleColor(FragmentTexCoords + samplingDirection * (0.0/3.0 - 0.5)).rgb;
+	vec3 rgbSamplePosOuter = SampleColor(FragmentTexCoords + samplingDirection * (3.0/3.0 - 0.5)).rgb;
+
+	vec3 rgbFourTab = (rgbSamplePosOuter + rgbSampleNegOuter) * 0.25 + rgbTwoTab * 0.5;
+
+	// Calculate luma for checking against the minimum and maximum value.
+	float lumaFourTab = dot(rgbFourTab, toLuma);
+
+	// Are outer samples of the tab beyond the edge ...
+	if (lumaFourTab < lumaMin || lumaFourTab > lumaMax)
+	{
+		// ... yes, so use only two samples.
+		OutputColor = vec4(rgbTwoTab, alpha);
+	}
+	else
+	{
+		// ... no, so use four samples.
+		OutputColor = vec4(rgbFourTab, alpha);
+	}
+}
\ No newline at end of file
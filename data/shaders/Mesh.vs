@@ -4,12 +4,22 @@ uniform float u_Outline;
 uniform mat4 u_Projection;
 uniform mat4 u_View;
 uniform mat4 u_Model;
+uniform bool u_Instanced;
+uniform bool u_Skinned;
+
+// Matches MaxBones in skeleton.h
+layout (std140) uniform Bones {
+  mat4 u_Bones[32];
+};
 
 layout (location = 0) in vec3 v_position;
 layout (location = 1) in vec3 v_normal;
 layout (location = 2) in vec2 v_texCoords;
 layout (location = 3) in vec3 v_tangent;
 layout (location = 4) in vec3 v_smoothedNormal;
+layout (location = 5) in mat4 v_InstanceModel;
+layout (location = 9) in vec4 v_boneIndices;
+layout (location = 10) in vec4 v_boneWeights;
 
 out vec3 FragmentNormal;
 out vec3 FragmentPos;
@@ -20,16 +30,23 @@ flat out float FragmentOutline;
 
 void main() {
   // gl_Position = vec4(v_position, 1.0);
+  mat4 model = u_Instanced ? v_InstanceModel : u_Model;
+  if (u_Skinned) {
+    model = model * (u_Bones[int(v_boneIndices.x)] * v_boneWeights.x +
+                     u_Bones[int(v_boneIndices.y)] * v_boneWeights.y +
+                     u_Bones[int(v_boneIndices.z)] * v_boneWeights.z +
+                     u_Bones[int(v_boneIndices.w)] * v_boneWeights.w);
+  }
 
   FragmentTexCoords = v_texCoords;
-  FragmentNormal = vec3(transpose(inverse(u_Model)) * vec4(normalize(v_normal), 1.0));
+  FragmentNormal = vec3(transpose(inverse(model)) * vec4(normalize(v_normal), 1.0));
 
-  vec3 tangent = vec3(transpose(inverse(u_Model)) * vec4(normalize(v_tangent), 1.0));
+  vec3 tangent = vec3(transpose(inverse(model)) * vec4(normalize(v_tangent), 1.0));
   vec3 bitangent = cross(FragmentNormal, tangent);
 
   FragmentTBN = mat3(tangent, bitangent, FragmentNormal);
 
-	FragmentPos = vec3(u_Model * vec4(v_position, 1.0));
+	FragmentPos = vec3(model * vec4(v_position, 1.0));
 
   FragmentOutline = u_Outline;
 
@@ -37,7 +54,7 @@ void main() {
   if (u_Outline > 0.0) {
     position += normalize(v_smoothedNormal) * u_Outline;
   }
-  gl_Position = u_Projection * u_View * u_Model * vec4(position, 1.0);
+  gl_Position = u_Projection * u_View * model * vec4(position, 1.0);
   // gl_Position gets converted, this wont
-  FragmentPosClipSpace = vec3(u_View * u_Model * vec4(position, 1.0));
+  FragmentPosClipSpace = vec3(u_View * model * vec4(position, 1.0));
 }
\ No newline at end of file
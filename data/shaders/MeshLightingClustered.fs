@@ -0,0 +1,131 @@
+out vec4 OutputColor;
+
+uniform sampler2D gbuf_position;
+uniform sampler2D gbuf_normal;
+uniform sampler2D gbuf_diffuse;
+uniform sampler2D gbuf_specular;
+
+// One row per light, layout is written by LightClusters::Build
+//   0: position, shape (0 point, 1 rectangle)    1: color * strength
+//   2-5: inverse transform    6-9: transform    10-13: inverse volume transform
+uniform sampler2D u_LightData;
+// (offset, count) into u_LightIndices, x is the tile and y the depth slice
+uniform highp usampler2D u_ClusterData;
+uniform highp usampler2D u_LightIndices;
+
+uniform ivec3 u_ClusterCount;
+uniform float u_ClusterNear;
+uniform float u_ClusterScale;
+uniform int u_IndexTextureWidth;
+
+uniform vec2 u_ViewportSize;
+
+uniform mat4 u_View;
+uniform vec3 u_ViewerPos;
+
+mat4 FetchMatrix(int light, int texel) {
+    return mat4(
+        texelFetch(u_LightData, ivec2(texel, light), 0),
+        texelFetch(u_LightData, ivec2(texel + 1, light), 0),
+        texelFetch(u_LightData, ivec2(texel + 2, light), 0),
+        texelFetch(u_LightData, ivec2(texel + 3, light), 0));
+}
+
+void main()
+{
+    vec2 FragmentTexCoords = gl_FragCoord.xy / u_ViewportSize;
+    vec4 texPos = texture(gbuf_position, FragmentTexCoords);
+    if (texPos.a < 0.5) {
+        OutputColor = vec4(0, 0, 0, 0);
+        return;
+    }
+    vec3 MappedFragmentPos = texPos.rgb;
+    vec4 normalAndFlag = texture(gbuf_normal, FragmentTexCoords);
+    vec3 MappedFragmentNormal = normalAndFlag.rgb;
+    float RenderFlag = normalAndFlag.a;
+
+    vec4 fullDiffuse = texture(gbuf_diffuse, FragmentTexCoords);
+    vec3 Diffuse = fullDiffuse.rgb;
+    float alpha = fullDiffuse.a;
+    vec4 fullSpecular = texture(gbuf_specular, FragmentTexCoords);
+    vec3 Specular = fullSpecular.rgb;
+    float SpecularFactor = fullSpecular.a;
+
+    // Find the cluster this fragment falls in
+    float depth = -(u_View * vec4(MappedFragmentPos, 1.0)).z;
+    int slice = int(log(max(depth, u_ClusterNear) / u_ClusterNear) * u_ClusterScale);
+    slice = clamp(slice, 0, u_ClusterCount.z - 1);
+    ivec2 tile = clamp(ivec2(FragmentTexCoords * vec2(u_ClusterCount.xy)),
+        ivec2(0, 0), u_ClusterCount.xy - 1);
+    uvec2 cluster = texelFetch(u_ClusterData, ivec2(tile.x + tile.y * u_ClusterCount.x, slice), 0).rg;
+
+    if (RenderFlag < 0.9f) {
+        // Unlit surfaces are kept at full color. The per light passes add it
+        //   for every light volume drawn over the pixel at any depth, this
+        //   only approximates that by counting the lights listed in the
+        //   fragment's cluster. Lights covering the tile in other depth
+        //   slices are missed, so unlit surfaces can come out darker here
+        OutputColor = cluster.y > 0u ? vec4(Diffuse * float(cluster.y), alpha)
+            : vec4(0.0, 0.0, 0.0, 0.0);
+        return;
+    }
+
+    vec3 viewDirection = normalize(u_ViewerPos - MappedFragmentPos);
+    vec3 color = vec3(0.0);
+    bool lit = false;
+
+    for (uint i = 0u; i < cluster.y; i++) {
+        int index = int(cluster.x + i);
+        int light = int(texelFetch(u_LightIndices,
+            ivec2(index % u_IndexTextureWidth, index / u_IndexTextureWidth), 0).r);
+
+        vec4 header = texelFetch(u_LightData, ivec2(0, light), 0);
+        vec3 lightPosition = header.xyz;
+        vec3 lightColor = texelFetch(u_LightData, ivec2(1, light), 0).rgb;
+        mat4 inverseTransform = FetchMatrix(light, 2);
+
+        vec3 closestPoint;
+        if (header.w > 0.5) {
+            // Rectangle, the emitter is a quad transformed by transform
+            vec3 volumePoint = vec3(FetchMatrix(light, 10) * vec4(MappedFragmentPos, 1.0));
+            vec3 s = step(vec3(-0.5, -0.5, -0.5), volumePoint) - step(vec3(0.5, 0.5, 0.5), volumePoint);
+            if (s.x * s.y * s.z <= 0.0) continue;
+
+            vec3 transformedPoint = vec3(inverseTransform * vec4(MappedFragmentPos, 1.0));
+            vec3 clamped = clamp(transformedPoint,
+                vec3(-0.5, -0.5, 0), vec3(0.5, 0.5, 0));
+            closestPoint = vec3(FetchMatrix(light, 6) * vec4(clamped, 1.0));
+        }
+        else {
+            vec3 transformedPoint = vec3(inverseTransform * vec4(MappedFragmentPos, 1.0));
+            if (length(transformedPoint) >= 0.5) continue;
+            closestPoint = lightPosition;
+        }
+
+        lit = true;
+
+        vec3 lightDirection = normalize(lightPosition - MappedFragmentPos);
+        float lightAngle = max(dot(MappedFragmentNormal, lightDirection), 0.0);
+        vec3 diffuseAccum = lightAngle * lightColor;
+        vec3 specularAccum = vec3(0.0);
+        if (lightAngle > 0.0) {
+            // Halfway vector.
+            vec3 h = normalize(viewDirection + lightAngle);
+            float n_dot_h = max(dot(MappedFragmentNormal, h), 0.0);
+            if (!(n_dot_h == 0.0 && SpecularFactor <= 0.0)) {
+                specularAccum = pow(n_dot_h, SpecularFactor) * lightColor;
+            }
+        }
+
+        float r = distance(MappedFragmentPos, closestPoint);
+        vec3 contribution = Diffuse * diffuseAccum + Specular * specularAccum;
+        if (abs(r) < 0.001) {
+            color += contribution;
+        }
+        else {
+            color += contribution / (r * r);
+        }
+    }
+
+    OutputColor = lit ? vec4(color, alpha) : vec4(0.0, 0.0, 0.0, 0.0);
+}
@@ -2,9 +2,26 @@
 uniform mat4 u_Projection;
 uniform mat4 u_View;
 uniform mat4 u_Model;
+uniform bool u_Instanced;
+uniform bool u_Skinned;
+
+// Matches MaxBones in skeleton.h
+layout (std140) uniform Bones {
+    mat4 u_Bones[32];
+};
 
 layout (location = 0) in vec3 v_position;
+layout (location = 5) in mat4 v_InstanceModel;
+layout (location = 9) in vec4 v_boneIndices;
+layout (location = 10) in vec4 v_boneWeights;
 
 void main() {
-    gl_Position = u_Projection * u_View * u_Model * vec4(v_position, 1.0);
+    mat4 model = u_Instanced ? v_InstanceModel : u_Model;
+    if (u_Skinned) {
+        model = model * (u_Bones[int(v_boneIndices.x)] * v_boneWeights.x +
+                         u_Bones[int(v_boneIndices.y)] * v_boneWeights.y +
+                         u_Bones[int(v_boneIndices.z)] * v_boneWeights.z +
+                         u_Bones[int(v_boneIndices.w)] * v_boneWeights.w);
+    }
+    gl_Position = u_Projection * u_View * model * vec4(v_position, 1.0);
 }
\ No newline at end of file
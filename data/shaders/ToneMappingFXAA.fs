@@ -0,0 +1,13 @@
+#define SampleColor
+    uniform sampler2D u_texture;
+    uniform float u_exposure;
+
+    // Tone maps every tap the same way as ToneMapping.fs, so the tone mapped
+    //   image never has to be written out
+    vec4 SampleColor(vec2 uv) {
+        vec4 tex = texture(u_texture, uv);
+        return vec4(vec3(1.0) - exp(-tex.rgb * u_exposure), tex.a);
+    }
+#end
+
+#include shaders/FXAAFilter.fs
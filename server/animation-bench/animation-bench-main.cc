@@ -0,0 +1,99 @@
+#include "skeletal-animation-loader.h"
+#include "logging.h"
+#include "timer.h"
+
+#include <string>
+
+// Ticks and poses a crowd of characters the way the client does for every
+//   player it draws, and reports the cost per character
+
+// The shipped BVH only holds its rest pose, so a swaying clip is made up to
+//   give the sampling and blending real rotations to work on
+static SkeletalAnimationClip MakeSwayClip(const Skeleton& skeleton) {
+    SkeletalAnimationClip clip;
+    clip.name = "Sway";
+    clip.frameCount = 60;
+    clip.frameTime = 1.0f / 30.0f;
+    clip.loop = true;
+    clip.translationFrames = 1;
+    clip.rotationFrames = clip.frameCount;
+
+    size_t padded = skeleton.GetPaddedBoneCount();
+    for (auto& component : clip.translations) {
+        component.assign(padded, 0.0f);
+    }
+    for (size_t bone = 0; bone < skeleton.GetBoneCount(); bone++) {
+        clip.translations[0][bone] = skeleton.bindTranslations[bone].x;
+        clip.translations[1][bone] = skeleton.bindTranslations[bone].y;
+        clip.translations[2][bone] = skeleton.bindTranslations[bone].z;
+    }
+
+    for (auto& component : clip.rotations) {
+        component.assign(clip.frameCount * padded, 0.0f);
+    }
+    for (size_t frame = 0; frame < clip.frameCount; frame++) {
+        float phase = frame * glm::two_pi<float>() / clip.frameCount;
+        for (size_t bone = 0; bone < padded; bone++) {
+            Quaternion rotation = glm::angleAxis(0.4f * std::sin(phase + bone),
+                glm::normalize(Vector3(1, bone % 3, 1)));
+            if (bone >= skeleton.GetBoneCount()) rotation = Quaternion();
+            for (int c = 0; c < 4; c++) {
+                clip.rotations[c][frame * padded + bone] = rotation[c];
+            }
+        }
+    }
+    return clip;
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "../data/animations/Player.json";
+    size_t characters = argc > 2 ? std::stoul(argv[2]) : 1000;
+    size_t frames = argc > 3 ? std::stoul(argv[3]) : 600;
+    // Client frame time
+    const Time deltaTime = 16;
+
+    SkeletalAnimationGroup group;
+    std::vector<std::string> models;
+    LoadSkeletalAnimationGroup(path, group, models);
+    group.clips.push_back(MakeSwayClip(group.skeleton));
+    group.transitions.push_back(SkeletalAnimationTransition{ group.clips.size() - 1, 0 });
+
+    std::vector<SkeletalAnimationState> states(characters);
+    std::vector<SkeletonPose> poses(characters);
+    SkeletonPose scratch;
+    for (size_t i = 0; i < characters; i++) {
+        states[i].group = &group;
+        states[i].clip = i % group.clips.size();
+        states[i].clipTime = i * 0.01f;
+    }
+
+    // Everyone switches clip every half second, spread over the frames, with
+    //   a 200ms crossfade so about 40% of the crowd is blending at any time
+    Time start = Timer::NowMicro();
+    size_t fading = 0;
+    for (size_t frame = 0; frame < frames; frame++) {
+        for (size_t i = 0; i < characters; i++) {
+            SkeletalAnimationState& state = states[i];
+            if ((frame + i) % 30 == 0) {
+                state.Play((state.clip + 1) % group.clips.size(), 200);
+            }
+            state.TickState(deltaTime);
+            state.Evaluate(poses[i], scratch);
+            fading += state.fadeDuration > 0;
+        }
+    }
+    Time elapsed = Timer::NowMicro() - start;
+
+    // Keeps the poses from being optimized away
+    float checksum = 0;
+    for (auto& pose : poses) {
+        checksum += pose.skinningMatrices.back()[3][1];
+    }
+
+    double perCharacter = (double) elapsed / (characters * frames);
+    LOG_INFO(group.skeleton.GetBoneCount() << " bones, " << characters << " characters, "
+        << frames << " frames, " << (100.0 * fading / (characters * frames)) << "% blending");
+    LOG_INFO(perCharacter << "us per character per frame, "
+        << (perCharacter * characters / 1000.0) << "ms per frame (checksum " << checksum << ")");
+    return 0;
+}
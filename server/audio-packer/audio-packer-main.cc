@@ -0,0 +1,304 @@
+#include "audio-decoder.h"
+#include "logging.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+// Packs every WAV under a directory into IMA ADPCM at a quarter of the size,
+//   which the client decodes on load or streams, see AudioDecoder. With
+//   --bench it instead compares loading the clips fully against streaming them
+
+namespace fs = std::filesystem;
+
+// Bytes per channel in a block, with 4 header bytes that leaves 1017 frames
+static const uint32_t BlockBytesPerChannel = 512;
+
+static const int IndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int StepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+struct AdpcmChannel {
+    int predictor = 0;
+    int stepIndex = 0;
+};
+
+// Mirrors the decoder's reconstruction so the predictor never drifts
+static uint8_t EncodeSample(AdpcmChannel& channel, int sample) {
+    int step = StepTable[channel.stepIndex];
+    int diff = sample - channel.predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    int delta = step >> 3;
+    if (diff >= step) { nibble |= 4; diff -= step; delta += step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 2; diff -= step; delta += step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 1; delta += step; }
+
+    channel.predictor += (nibble & 8) ? -delta : delta;
+    channel.predictor = std::clamp(channel.predictor, -32768, 32767);
+    channel.stepIndex = std::clamp(channel.stepIndex + IndexTable[nibble], 0, 88);
+    return nibble;
+}
+
+static void Write16(std::ostream& stream, uint16_t value) {
+    char bytes[2] = { (char) (value & 0xff), (char) (value >> 8) };
+    stream.write(bytes, 2);
+}
+
+static void Write32(std::ostream& stream, uint32_t value) {
+    Write16(stream, value & 0xffff);
+    Write16(stream, value >> 16);
+}
+
+// Frames in each block, the first of a channel's frames is stored whole in
+//   its header and the rest as two nibbles a byte
+static uint32_t FramesPerBlock(uint32_t channels) {
+    uint32_t blockAlign = BlockBytesPerChannel * channels;
+    return (blockAlign - 4 * channels) * 8 / (4 * channels) + 1;
+}
+
+static std::vector<uint8_t> EncodeAdpcm(const std::vector<int16_t>& samples, uint32_t channels) {
+    uint32_t framesPerBlock = FramesPerBlock(channels);
+    size_t frames = samples.size() / channels;
+    std::vector<uint8_t> data;
+    AdpcmChannel state[2];
+    // The last block is cut short, dr_wav ignores the fact chunk for IMA
+    //   ADPCM and counts frames from the data, so at most 7 silent frames
+    //   are left on the end
+    auto sampleAt = [&](size_t frame, uint32_t channel) -> int {
+        return frame < frames ? samples[frame * channels + channel] : 0;
+    };
+
+    for (size_t start = 0; start < frames; start += framesPerBlock) {
+        for (uint32_t c = 0; c < channels; c++) {
+            state[c].predictor = sampleAt(start, c);
+            int16_t predictor = (int16_t) state[c].predictor;
+            data.push_back(predictor & 0xff);
+            data.push_back((predictor >> 8) & 0xff);
+            data.push_back((uint8_t) state[c].stepIndex);
+            data.push_back(0);
+        }
+        // Channels take turns every 8 frames, 4 bytes at a time
+        size_t end = std::min(start + framesPerBlock, frames);
+        for (size_t group = start + 1; group < end; group += 8) {
+            for (uint32_t c = 0; c < channels; c++) {
+                for (size_t frame = group; frame < group + 8; frame += 2) {
+                    uint8_t low = EncodeSample(state[c], sampleAt(frame, c));
+                    uint8_t high = EncodeSample(state[c], sampleAt(frame + 1, c));
+                    data.push_back(low | (high << 4));
+                }
+            }
+        }
+    }
+    return data;
+}
+
+static void WriteAdpcm(const fs::path& path, const std::vector<int16_t>& samples,
+        uint32_t channels, uint32_t sampleRate) {
+    std::vector<uint8_t> data = EncodeAdpcm(samples, channels);
+    uint32_t blockAlign = BlockBytesPerChannel * channels;
+    uint32_t framesPerBlock = FramesPerBlock(channels);
+    uint32_t frames = samples.size() / channels;
+
+    std::ofstream stream(path, std::ios::binary);
+    stream.write("RIFF", 4);
+    Write32(stream, 4 + (8 + 20) + (8 + 4) + (8 + data.size()));
+    stream.write("WAVE", 4);
+
+    stream.write("fmt ", 4);
+    Write32(stream, 20);
+    Write16(stream, 0x11);
+    Write16(stream, channels);
+    Write32(stream, sampleRate);
+    Write32(stream, (uint64_t) sampleRate * blockAlign / framesPerBlock);
+    Write16(stream, blockAlign);
+    Write16(stream, 4);
+    Write16(stream, 2);
+    Write16(stream, framesPerBlock);
+
+    stream.write("fact", 4);
+    Write32(stream, 4);
+    Write32(stream, frames);
+
+    stream.write("data", 4);
+    Write32(stream, data.size());
+    stream.write((const char*) data.data(), data.size());
+}
+
+static void WritePcm(const fs::path& path, const std::vector<int16_t>& samples,
+        uint32_t channels, uint32_t sampleRate) {
+    uint32_t bytes = samples.size() * sizeof(int16_t);
+    std::ofstream stream(path, std::ios::binary);
+    stream.write("RIFF", 4);
+    Write32(stream, 4 + (8 + 16) + (8 + bytes));
+    stream.write("WAVE", 4);
+
+    stream.write("fmt ", 4);
+    Write32(stream, 16);
+    Write16(stream, 1);
+    Write16(stream, channels);
+    Write32(stream, sampleRate);
+    Write32(stream, sampleRate * channels * sizeof(int16_t));
+    Write16(stream, channels * sizeof(int16_t));
+    Write16(stream, 16);
+
+    stream.write("data", 4);
+    Write32(stream, bytes);
+    for (int16_t sample : samples) {
+        Write16(stream, (uint16_t) sample);
+    }
+}
+
+static bool IsSourceAudio(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".wav";
+}
+
+static void PackAudio(const fs::path& source, const fs::path& output) {
+    AudioDecoder decoder;
+    if (!decoder.Open(source.string())) {
+        throw std::runtime_error("Could not load audio");
+    }
+    std::vector<int16_t> samples = decoder.ReadAll();
+
+    fs::create_directories(output.parent_path());
+    WriteAdpcm(output, samples, decoder.GetChannels(), decoder.GetSampleRate());
+    LOG_INFO("Packed " << source << " " << decoder.GetDuration() << "s, "
+        << fs::file_size(source) / 1024 << "KB -> " << fs::file_size(output) / 1024 << "KB");
+}
+
+static std::vector<fs::path> FindAudio(const fs::path& dir) {
+    std::vector<fs::path> sources;
+    for (auto& entry : fs::recursive_directory_iterator(dir)) {
+        if (entry.is_regular_file() && IsSourceAudio(entry.path())) {
+            sources.push_back(entry.path());
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+    return sources;
+}
+
+// Each load is timed this many times, the median is reported so the first
+//   read of the file doesn't decide the result
+static const size_t BenchRuns = 7;
+
+template <class F>
+static Time MedianMicros(F run) {
+    std::vector<Time> times;
+    for (size_t i = 0; i < BenchRuns; i++) {
+        Time start = Timer::NowMicro();
+        run();
+        times.push_back(Timer::NowMicro() - start);
+    }
+    std::nth_element(times.begin(), times.begin() + BenchRuns / 2, times.end());
+    return times[BenchRuns / 2];
+}
+
+// What a clip costs to get ready to play: decoding all of it up front, the
+//   way short clips load, against opening it and decoding the chunks a
+//   stream queues before it starts
+static void BenchAudio(const fs::path& path) {
+    AudioDecoder decoder;
+    size_t fullBytes = 0;
+    Time fullTime = MedianMicros([&]() {
+        if (!decoder.Open(path.string())) {
+            throw std::runtime_error("Could not load audio");
+        }
+        fullBytes = decoder.ReadAll().size() * sizeof(int16_t);
+    });
+
+    std::vector<int16_t> chunk;
+    Time streamTime = MedianMicros([&]() {
+        decoder.Open(path.string());
+        chunk.resize(StreamChunkFrames * decoder.GetChannels());
+        for (size_t i = 0; i < StreamChunkCount; i++) {
+            decoder.Read(chunk.data(), StreamChunkFrames);
+        }
+    });
+    size_t streamBytes = chunk.size() * sizeof(int16_t) * StreamChunkCount;
+
+    LOG_INFO(path.filename() << " " << decoder.GetDuration() << "s, " << fs::file_size(path) / 1024
+        << "KB file: full decode " << fullTime << "us " << fullBytes / 1024 << "KB, stream start "
+        << streamTime << "us " << streamBytes / 1024 << "KB (median of " << BenchRuns << ")");
+}
+
+static int Bench(const fs::path& dir) {
+    // The shipped sounds are all short, a made up three minute stereo track
+    //   stands in for music
+    const uint32_t sampleRate = 44100, channels = 2, seconds = 180;
+    std::vector<int16_t> track(sampleRate * seconds * channels);
+    for (size_t frame = 0; frame < track.size() / channels; frame++) {
+        float t = (float) frame / sampleRate;
+        float tone = std::sin(t * 220.0f * 6.2831853f) * 0.5f + std::sin(t * 331.0f * 6.2831853f) * 0.25f;
+        track[frame * 2] = (int16_t) (tone * 12000.0f);
+        track[frame * 2 + 1] = (int16_t) (tone * std::cos(t) * 12000.0f);
+    }
+    fs::path trackDir = fs::temp_directory_path() / "audio-bench";
+    fs::create_directories(trackDir);
+    WritePcm(trackDir / "track-pcm.wav", track, channels, sampleRate);
+    WriteAdpcm(trackDir / "track-adpcm.wav", track, channels, sampleRate);
+
+    std::vector<fs::path> sources = FindAudio(dir);
+    sources.push_back(trackDir / "track-pcm.wav");
+    sources.push_back(trackDir / "track-adpcm.wav");
+
+    size_t pcmBytes = 0, adpcmBytes = 0;
+    for (auto& source : sources) {
+        BenchAudio(source);
+        if (source.parent_path() == trackDir) continue;
+
+        AudioDecoder decoder;
+        decoder.Open(source.string());
+        std::vector<int16_t> samples = decoder.ReadAll();
+        pcmBytes += samples.size() * sizeof(int16_t);
+        adpcmBytes += EncodeAdpcm(samples, decoder.GetChannels()).size();
+    }
+    LOG_INFO("Sounds as 16 bit PCM " << pcmBytes / 1024 << "KB, as IMA ADPCM " << adpcmBytes / 1024 << "KB");
+    fs::remove_all(trackDir);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::string(argv[1]) == "--bench") {
+        return Bench(argv[2]);
+    }
+    if (argc != 3) {
+        LOG_ERROR("usage: " << argv[0] << " <sound_dir> <output_dir> | --bench <sound_dir>");
+        return 1;
+    }
+
+    fs::path sourceDir = argv[1], outputDir = argv[2];
+    std::vector<fs::path> sources = FindAudio(sourceDir);
+    size_t packed = 0;
+    for (auto& source : sources) {
+        fs::path output = outputDir / fs::relative(source, sourceDir);
+        if (fs::exists(output) && fs::last_write_time(output) >= fs::last_write_time(source)) {
+            continue;
+        }
+        PackAudio(source, output);
+        packed++;
+    }
+    LOG_INFO("Packed " << packed << " of " << sources.size() << " sounds");
+    return 0;
+}
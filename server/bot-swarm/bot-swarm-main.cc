@@ -0,0 +1,286 @@
+#include "bot.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <sys/epoll.h>
+#include <thread>
+#include <unistd.h>
+
+// Plays a swarm of headless bots against a game_server on this machine,
+//   growing the swarm in stages and reporting how the server holds up at
+//   each size
+
+static const char* Characters[] = { "Marine", "Archer", "Bombmaker", "Hookman" };
+
+struct SwarmSettings {
+    uint16_t port = 8080;
+    std::vector<size_t> stages { 25, 50, 100, 200 };
+    // Measured after the stage's bots had a few seconds to join
+    Time warmupSeconds = 3;
+    Time stageSeconds = 20;
+    size_t threads = 4;
+    int serverPid = 0;
+    bool deflate = true;
+};
+
+// Runs a share of the bots on its own thread
+struct Worker {
+    size_t index = 0;
+    std::thread thread;
+    std::vector<std::unique_ptr<Bot>> bots;
+    std::atomic<size_t> wanted { 0 };
+    std::atomic<size_t> open { 0 };
+    std::mutex statsMutex;
+    BotStats stats;
+};
+
+static std::atomic<bool> running { true };
+
+static void RunWorker(Worker& worker, const SwarmSettings& settings) {
+    int epoll = epoll_create1(0);
+    epoll_event events[256];
+
+    while (running) {
+        while (worker.bots.size() < worker.wanted) {
+            size_t index = worker.bots.size() * settings.threads + worker.index;
+            auto bot = std::make_unique<Bot>(index == 0, Characters[index % 4], index + 1);
+            if (!bot->Connect(settings.port, settings.deflate)) {
+                LOG_ERROR("Bot " << index << " could not connect");
+                running = false;
+                break;
+            }
+            epoll_event event {};
+            event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+            event.data.ptr = bot.get();
+            epoll_ctl(epoll, EPOLL_CTL_ADD, bot->GetSocket().GetFd(), &event);
+            worker.bots.push_back(std::move(bot));
+        }
+
+        // Woken often enough to keep every bot's 16ms tick on time
+        int count = epoll_wait(epoll, events, 256, 2);
+        std::scoped_lock lock(worker.statsMutex);
+        for (int i = 0; i < count; i++) {
+            Bot* bot = static_cast<Bot*>(events[i].data.ptr);
+            WebSocketClient& socket = bot->GetSocket();
+            if (events[i].events & EPOLLOUT) {
+                socket.OnWritable();
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                socket.OnReadable([bot, &worker](std::string_view message) {
+                    bot->OnMessage(message, worker.stats);
+                });
+            }
+        }
+
+        Time now = Timer::NowMicro();
+        size_t open = 0;
+        for (auto& bot : worker.bots) {
+            bot->Tick(now, worker.stats);
+            open += bot->GetSocket().IsOpen();
+        }
+        worker.open = open;
+    }
+    worker.bots.clear();
+    close(epoll);
+}
+
+// utime + stime in seconds, -1 if the process can't be read
+static double ReadProcessCpu(int pid) {
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat;
+    if (!pid || !std::getline(file, stat)) return -1;
+    // The name in brackets can hold spaces, fields count from after it
+    std::istringstream fields(stat.substr(stat.rfind(')') + 2));
+    std::string field;
+    uint64_t utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && fields >> field; i++) {
+        if (i == 14) utime = std::stoull(field);
+        if (i == 15) stime = std::stoull(field);
+    }
+    return (double) (utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static int FindServerPid() {
+    DIR* proc = opendir("/proc");
+    if (!proc) return 0;
+    int found = 0;
+    while (dirent* entry = readdir(proc)) {
+        int pid = atoi(entry->d_name);
+        if (!pid) continue;
+        std::ifstream file("/proc/" + std::string(entry->d_name) + "/comm");
+        std::string name;
+        // Also matches game_server_prod, cut short to 15 characters
+        if (std::getline(file, name) && name.rfind("game_server", 0) == 0) {
+            found = pid;
+            break;
+        }
+    }
+    closedir(proc);
+    return found;
+}
+
+static float Percentile(std::vector<float>& values, float percentile) {
+    if (values.empty()) return 0;
+    size_t index = std::min(values.size() - 1, (size_t) (percentile * (values.size() - 1) + 0.5f));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static float Mean(const std::vector<float>& values) {
+    if (values.empty()) return 0;
+    double sum = 0;
+    for (float value : values) sum += value;
+    return sum / values.size();
+}
+
+static BotStats DrainStats(std::vector<std::unique_ptr<Worker>>& workers) {
+    BotStats total;
+    for (auto& worker : workers) {
+        std::scoped_lock lock(worker->statsMutex);
+        total.Merge(worker->stats);
+        worker->stats = BotStats{};
+    }
+    return total;
+}
+
+// False when the stage measured nothing, a swarm the server dropped would
+//   otherwise report zeros that look like an idle server
+static bool Report(size_t clients, size_t open, BotStats& stats, double seconds, double serverCpu) {
+    if (!open || !stats.replications) {
+        LOG_ERROR(clients << " clients (" << open << " connected): no replication received, nothing measured");
+        return false;
+    }
+    double perClient = open * seconds;
+    std::vector<float>& latencies = stats.latencies;
+    std::vector<float>& intervals = stats.replicationIntervals;
+    LOG_INFO(clients << " clients (" << open << " connected)");
+    LOG_INFO("    server tick rate " << Mean(stats.tickRates) << "/s (min "
+        << (stats.tickRates.empty() ? 0 : *std::min_element(stats.tickRates.begin(), stats.tickRates.end()))
+        << "/s, expected " << 1000.0f / BotTickInterval << "/s)");
+    LOG_INFO("    replication interval p50 " << Percentile(intervals, 0.5f) << "ms p99 "
+        << Percentile(intervals, 0.99f) << "ms max " << Percentile(intervals, 1.0f) << "ms");
+    LOG_INFO("    input to replication p50 " << Percentile(latencies, 0.5f) << "ms p90 "
+        << Percentile(latencies, 0.9f) << "ms p99 " << Percentile(latencies, 0.99f) << "ms max "
+        << Percentile(latencies, 1.0f) << "ms (" << latencies.size() << " samples)");
+    LOG_INFO("    ping p50 " << Percentile(stats.pings, 0.5f) << "ms p99 " << Percentile(stats.pings, 0.99f) << "ms");
+    LOG_INFO("    per client: down " << stats.bytesReceived / perClient / 1024 << "KB/s ("
+        << stats.messageBytes / perClient / 1024 << "KB/s inflated), up "
+        << stats.bytesSent / perClient / 1024 << "KB/s, " << stats.inputs / perClient << " inputs/s, "
+        << stats.replications / perClient << " replications/s of "
+        << (stats.replications ? stats.replicatedObjects / stats.replications : 0) << " objects");
+    if (serverCpu >= 0) {
+        LOG_INFO("    server CPU " << serverCpu * 100 << "% of a core");
+    }
+    return true;
+}
+
+static std::vector<size_t> ParseStages(const std::string& list) {
+    std::vector<size_t> stages;
+    std::istringstream stream(list);
+    std::string stage;
+    while (std::getline(stream, stage, ',')) {
+        stages.push_back(std::stoul(stage));
+    }
+    return stages;
+}
+
+static void Usage(char* arg0) {
+    std::cout << "usage: " << arg0 << " [options]" << std::endl;
+    std::cout << "    options: " << std::endl;
+    std::cout << "        --port N            : game_server port on localhost (8080)" << std::endl;
+    std::cout << "        --clients A,B,...   : bots in each stage (25,50,100,200)" << std::endl;
+    std::cout << "        --stage-seconds N   : measured time per stage (20)" << std::endl;
+    std::cout << "        --threads N         : bot threads (4)" << std::endl;
+    std::cout << "        --server-pid N      : server to sample CPU of, found by name otherwise" << std::endl;
+    std::cout << "        --no-deflate        : don't offer permessage-deflate" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    SwarmSettings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string arg { argv[i] };
+        bool hasValue = i + 1 < argc;
+        if (arg == "--port" && hasValue) {
+            settings.port = std::stoi(argv[++i]);
+        }
+        else if (arg == "--clients" && hasValue) {
+            settings.stages = ParseStages(argv[++i]);
+        }
+        else if (arg == "--stage-seconds" && hasValue) {
+            settings.stageSeconds = std::stoul(argv[++i]);
+        }
+        else if (arg == "--threads" && hasValue) {
+            settings.threads = std::max(1ul, std::stoul(argv[++i]));
+        }
+        else if (arg == "--server-pid" && hasValue) {
+            settings.serverPid = std::stoi(argv[++i]);
+        }
+        else if (arg == "--no-deflate") {
+            settings.deflate = false;
+        }
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!settings.serverPid) {
+        settings.serverPid = FindServerPid();
+    }
+    if (!settings.serverPid) {
+        LOG_WARN("No game_server process found, server CPU won't be reported");
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t i = 0; i < settings.threads; i++) {
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->index = i;
+    }
+    for (auto& worker : workers) {
+        worker->thread = std::thread(RunWorker, std::ref(*worker), std::cref(settings));
+    }
+
+    bool measured = true;
+    for (size_t clients : settings.stages) {
+        if (!running) break;
+        for (auto& worker : workers) {
+            worker->wanted = clients / settings.threads + (worker->index < clients % settings.threads);
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(settings.warmupSeconds));
+        DrainStats(workers);
+
+        double cpuStart = ReadProcessCpu(settings.serverPid);
+        Time start = Timer::NowMicro();
+        std::this_thread::sleep_for(std::chrono::seconds(settings.stageSeconds));
+        double seconds = (Timer::NowMicro() - start) / 1e6;
+        double cpuEnd = ReadProcessCpu(settings.serverPid);
+        if (settings.serverPid && cpuEnd < 0) {
+            LOG_ERROR("game_server " << settings.serverPid << " exited during the stage");
+        }
+
+        BotStats stats = DrainStats(workers);
+        size_t open = 0;
+        for (auto& worker : workers) {
+            open += worker->open;
+        }
+        bool sampled = cpuStart >= 0 && cpuEnd >= 0;
+        if (!Report(clients, open, stats, seconds, sampled ? (cpuEnd - cpuStart) / seconds : -1)) {
+            // Larger stages wouldn't get any further
+            measured = false;
+            break;
+        }
+    }
+
+    running = false;
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+    return measured ? 0 : 1;
+}
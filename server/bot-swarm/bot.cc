@@ -0,0 +1,211 @@
+#include "bot.h"
+#include "logging.h"
+
+// Key codes the browser sends, see KEY_MAP in player.cc
+static const int MovementKeys[] = { 87, 65, 83, 68 };
+static const int SpaceKey = 32;
+static const int LeftMouseButton = 1;
+
+void BotStats::Merge(const BotStats& other) {
+    latencies.insert(latencies.end(), other.latencies.begin(), other.latencies.end());
+    pings.insert(pings.end(), other.pings.begin(), other.pings.end());
+    replicationIntervals.insert(replicationIntervals.end(),
+        other.replicationIntervals.begin(), other.replicationIntervals.end());
+    tickRates.insert(tickRates.end(), other.tickRates.begin(), other.tickRates.end());
+    bytesReceived += other.bytesReceived;
+    messageBytes += other.messageBytes;
+    bytesSent += other.bytesSent;
+    inputs += other.inputs;
+    replications += other.replications;
+    replicatedObjects += other.replicatedObjects;
+    animations += other.animations;
+}
+
+Bot::Bot(bool observer, const std::string& character, unsigned int seed)
+    : observer(observer), character(character), random(seed) {
+}
+
+bool Bot::Connect(uint16_t port, bool deflate) {
+    // Only ever localhost, this is a load generator
+    return socket.Connect("127.0.0.1", port, "/connect", deflate);
+}
+
+Time Bot::Between(Time low, Time high) {
+    return std::uniform_int_distribution<Time>(low, high)(random);
+}
+
+void Bot::SendInput(const std::string& event, const std::string& fields, BotStats& stats, Time now) {
+    // Stamped for the next client tick, like SendInputPacket
+    Time inputTime = clientTime + BotTickInterval;
+    socket.Send("{\"event\":\"" + event + "\"," + fields + ",\"time\":" + std::to_string(inputTime) + "}");
+    if (pendingInputs.empty() || pendingInputs.back().first != inputTime) {
+        pendingInputs.emplace_back(inputTime, now);
+    }
+    stats.inputs++;
+}
+
+static std::string KeyFields(int key) {
+    return "\"key\":" + std::to_string(key) + ",\"ctrl\":false,\"shift\":false,\"alt\":false";
+}
+
+void Bot::GenerateInput(Time now, BotStats& stats) {
+    Time nowMs = now / 1000;
+
+    // Strafing and running about, sometimes standing still
+    if (nowMs >= nextMovementChange) {
+        if (movementKey) {
+            SendInput("ku", KeyFields(movementKey), stats, now);
+        }
+        size_t choice = Between(0, 4);
+        movementKey = choice < 4 ? MovementKeys[choice] : 0;
+        if (movementKey) {
+            SendInput("kd", KeyFields(movementKey), stats, now);
+        }
+        nextMovementChange = nowMs + Between(300, 1500);
+    }
+
+    if (jumpRelease && nowMs >= jumpRelease) {
+        SendInput("ku", KeyFields(SpaceKey), stats, now);
+        jumpRelease = 0;
+    }
+    else if (!jumpRelease && Between(0, 300) == 0) {
+        SendInput("kd", KeyFields(SpaceKey), stats, now);
+        jumpRelease = nowMs + Between(50, 150);
+    }
+
+    if (nowMs >= nextFireChange) {
+        firing = !firing;
+        SendInput(firing ? "md" : "mu", "\"button\":" + std::to_string(LeftMouseButton), stats, now);
+        nextFireChange = nowMs + (firing ? Between(100, 600) : Between(500, 3000));
+    }
+
+    // The client sends the mouse movement of each frame it moved in
+    if (Between(0, 9) < 7) {
+        int x = (int) Between(0, 40) - 20;
+        int y = (int) Between(0, 10) - 5;
+        SendInput("mm", "\"x\":" + std::to_string(x) + ",\"y\":" + std::to_string(y) +
+            ",\"rx\":640,\"ry\":360", stats, now);
+    }
+}
+
+void Bot::CollectBytes(BotStats& stats) {
+    stats.bytesReceived += socket.bytesReceived - reportedReceived;
+    stats.messageBytes += socket.messageBytes - reportedMessages;
+    stats.bytesSent += socket.bytesSent - reportedSent;
+    reportedReceived = socket.bytesReceived;
+    reportedMessages = socket.messageBytes;
+    reportedSent = socket.bytesSent;
+}
+
+void Bot::Tick(Time now, BotStats& stats) {
+    if (!socket.IsOpen()) {
+        CollectBytes(stats);
+        return;
+    }
+
+    Time nowMs = now / 1000;
+    if (nextTick == 0) {
+        // Joins the way the page does: settings, character, ready
+        socket.Send("{\"event\":\"globalSettings\"}");
+        socket.Send("{\"event\":\"setchar\",\"char\":\"" + character + "\"}");
+        socket.Send("{\"event\":\"rdy\",\"time\":" + std::to_string(clientTime) + "}");
+        nextTick = nowMs;
+        // Spread the swarm's heartbeats out
+        nextHeartbeat = nowMs + Between(0, BotHeartbeatInterval);
+    }
+    if (nowMs >= nextHeartbeat) {
+        socket.Send("{\"event\":\"hb\",\"time\":" + std::to_string(nowMs) + "}");
+        nextHeartbeat += BotHeartbeatInterval;
+    }
+
+    // Catches up on ticks a slow poll missed, like the client's interval does
+    while (nowMs >= nextTick) {
+        nextTick += BotTickInterval;
+        clientTime += BotTickInterval;
+        if (hasLocalPlayer && !observer) {
+            GenerateInput(now, stats);
+        }
+    }
+    if (socket.WantsWrite()) {
+        socket.OnWritable();
+    }
+    CollectBytes(stats);
+}
+
+void Bot::OnReplication(const rapidjson::Document& packet, Time now, BotStats& stats) {
+    stats.replications++;
+    if (lastReplication) {
+        stats.replicationIntervals.push_back((now - lastReplication) / 1000.0f);
+    }
+
+    Time processed = packet["time"].GetUint64();
+    uint64_t ticks = packet["ticks"].GetUint64();
+    // Nothing has reset the count since the last packet, so it moved on
+    //   once per server tick
+    if (observer && lastReplication && processed == lastReplicationTime && ticks > lastReplicationTicks) {
+        stats.tickRates.push_back((ticks - lastReplicationTicks) * 1e6f / (now - lastReplication));
+    }
+    lastReplication = now;
+    lastReplicationTime = processed;
+    lastReplicationTicks = ticks;
+
+    if (processed > lastProcessedInput) {
+        while (!pendingInputs.empty() && pendingInputs.front().first < processed) {
+            pendingInputs.pop_front();
+        }
+        if (!pendingInputs.empty() && pendingInputs.front().first == processed) {
+            stats.latencies.push_back((now - pendingInputs.front().second) / 1000.0f);
+            pendingInputs.pop_front();
+        }
+        lastProcessedInput = processed;
+    }
+
+    bool hasPlayerIn = false;
+    if (packet.HasMember("objs")) {
+        for (auto& object : packet["objs"].GetArray()) {
+            stats.replicatedObjects++;
+            if (object.HasMember("id") && object["id"].GetUint() == localPlayerId) {
+                hasPlayerIn = true;
+            }
+        }
+    }
+
+    // The same correction the client makes, so inputs keep landing on
+    //   ticks the server hasn't run yet
+    if (!hasPlayerIn) return;
+    Time serverCurrentTickTime = processed + ticks * BotTickInterval;
+    if (clientTime > serverCurrentTickTime + 1000) {
+        clientTime = serverCurrentTickTime;
+    }
+    else if (clientTime < serverCurrentTickTime) {
+        clientTime = ((serverCurrentTickTime + lastPing) / BotTickInterval) * BotTickInterval;
+    }
+}
+
+void Bot::OnMessage(std::string_view message, BotStats& stats) {
+    Time now = Timer::NowMicro();
+    rapidjson::Document packet;
+    packet.Parse(message.data(), message.size());
+    if (packet.HasParseError() || !packet.IsObject()) {
+        LOG_WARN("Could not parse packet: " << message.substr(0, 80));
+        return;
+    }
+
+    if (packet.HasMember("playerLocalObjectId")) {
+        localPlayerId = packet["playerLocalObjectId"].GetUint();
+        hasLocalPlayer = true;
+        return;
+    }
+    if (!packet.HasMember("event")) return;
+    std::string_view event { packet["event"].GetString(), packet["event"].GetStringLength() };
+    if (event == "r") {
+        OnReplication(packet, now, stats);
+    }
+    else if (event == "a") {
+        stats.animations++;
+    }
+    else if (event == "hb") {
+        lastPing = now / 1000 - packet["time"].GetUint64();
+        stats.pings.push_back(lastPing);
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "websocket-client.h"
+#include "timer.h"
+#include "json/rapidjson/document.h"
+
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+// The server's tick, a bot's game clock runs at the same rate as the
+//   browser client's (TickInterval in game.cc)
+static const Time BotTickInterval = 16;
+// Heartbeats for ping, as often as client-state.js sends them
+static const Time BotHeartbeatInterval = 1000;
+
+// Measurements the bots of a worker add to, drained by the reporter
+struct BotStats {
+    // From sending an input to the first replication that says the server
+    //   processed it, in ms
+    std::vector<float> latencies;
+    // Heartbeat round trips in ms
+    std::vector<float> pings;
+    // Between replication packets arriving at a bot, in ms
+    std::vector<float> replicationIntervals;
+    // Server ticks per second, only measured by the observer bot
+    std::vector<float> tickRates;
+
+    uint64_t bytesReceived = 0;
+    // After inflating
+    uint64_t messageBytes = 0;
+    uint64_t bytesSent = 0;
+    uint64_t inputs = 0;
+    uint64_t replications = 0;
+    uint64_t replicatedObjects = 0;
+    uint64_t animations = 0;
+
+    void Merge(const BotStats& other);
+};
+
+// One fake player, joins like the browser client and sends it input
+//   streams at its rates: a new mouse movement most frames, movement keys
+//   every second or so, the odd jump and bursts of fire
+class Bot {
+    WebSocketClient socket;
+    // The observer joins but never sends input, so the ticks field of its
+    //   replications counts every server tick
+    bool observer;
+    std::string character;
+    std::mt19937 random;
+
+    bool hasLocalPlayer = false;
+    uint32_t localPlayerId = 0;
+    // Game clock, kept in step with the server like client_main.cc does
+    Time clientTime = 0;
+    Time nextTick = 0;
+    Time nextHeartbeat = 0;
+    Time lastPing = 0;
+
+    int movementKey = 0;
+    Time nextMovementChange = 0;
+    Time jumpRelease = 0;
+    bool firing = false;
+    Time nextFireChange = 0;
+
+    // Input time and when it was sent in us, oldest first
+    std::deque<std::pair<Time, Time>> pendingInputs;
+    Time lastProcessedInput = 0;
+    Time lastReplication = 0;
+    Time lastReplicationTime = 0;
+    uint64_t lastReplicationTicks = 0;
+
+    uint64_t reportedReceived = 0;
+    uint64_t reportedMessages = 0;
+    uint64_t reportedSent = 0;
+
+    Time Between(Time low, Time high);
+    void CollectBytes(BotStats& stats);
+    void SendInput(const std::string& event, const std::string& fields, BotStats& stats, Time now);
+    void GenerateInput(Time now, BotStats& stats);
+    void OnReplication(const rapidjson::Document& packet, Time now, BotStats& stats);
+
+public:
+    Bot(bool observer, const std::string& character, unsigned int seed);
+
+    bool Connect(uint16_t port, bool deflate);
+    WebSocketClient& GetSocket() { return socket; }
+
+    void OnMessage(std::string_view message, BotStats& stats);
+    // Call as often as possible, now in us
+    void Tick(Time now, BotStats& stats);
+};
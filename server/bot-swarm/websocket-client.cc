@@ -0,0 +1,290 @@
+#include "websocket-client.h"
+#include "logging.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Compressed messages end in an empty stored block the sender strips off
+static const char DeflateTail[4] = { 0x00, 0x00, (char) 0xff, (char) 0xff };
+
+static std::string Base64(const uint8_t* data, size_t size) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t group = data[i] << 16;
+        if (i + 1 < size) group |= data[i + 1] << 8;
+        if (i + 2 < size) group |= data[i + 2];
+        result += alphabet[(group >> 18) & 63];
+        result += alphabet[(group >> 12) & 63];
+        result += i + 1 < size ? alphabet[(group >> 6) & 63] : '=';
+        result += i + 2 < size ? alphabet[group & 63] : '=';
+    }
+    return result;
+}
+
+static std::mt19937& Random() {
+    thread_local std::mt19937 random { std::random_device{}() };
+    return random;
+}
+
+WebSocketClient::~WebSocketClient() {
+    Close();
+}
+
+bool WebSocketClient::Connect(const std::string& host, uint16_t port, const std::string& newPath, bool newDeflate) {
+    Close();
+    path = newPath;
+    deflate = newDeflate;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOG_ERROR("Could not create socket: " << strerror(errno));
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    // Inputs are small and latency is what's being measured
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &address.sin_addr);
+    if (connect(fd, (sockaddr*) &address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+        LOG_ERROR("Could not connect to " << host << ":" << port << ": " << strerror(errno));
+        Close();
+        return false;
+    }
+    state = State::Connecting;
+    return true;
+}
+
+void WebSocketClient::Close() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (inflaterReady) {
+        inflateEnd(&inflater);
+        inflaterReady = false;
+    }
+    state = State::Closed;
+    in.clear();
+    out.clear();
+    message.clear();
+}
+
+void WebSocketClient::OnWritable() {
+    if (state == State::Connecting) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error) {
+            LOG_ERROR("Could not connect: " << strerror(error));
+            Close();
+            return;
+        }
+        uint8_t key[16];
+        for (uint8_t& byte : key) {
+            byte = Random()() & 0xff;
+        }
+        out = "GET " + path + " HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: " + Base64(key, sizeof(key)) + "\r\n"
+            "Sec-WebSocket-Version: 13\r\n";
+        if (deflate) {
+            // What browsers offer
+            out += "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n";
+        }
+        out += "\r\n";
+        state = State::Handshaking;
+    }
+
+    while (!out.empty()) {
+        ssize_t sent = send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            LOG_ERROR("Send failed: " << strerror(errno));
+            Close();
+            return;
+        }
+        bytesSent += sent;
+        out.erase(0, sent);
+    }
+}
+
+bool WebSocketClient::ReadHandshake() {
+    size_t end = in.find("\r\n\r\n");
+    if (end == std::string::npos) return false;
+    std::string response = in.substr(0, end);
+    in.erase(0, end + 4);
+
+    if (response.compare(0, 12, "HTTP/1.1 101") != 0) {
+        LOG_ERROR("Websocket upgrade refused: " << response.substr(0, response.find("\r\n")));
+        Close();
+        return false;
+    }
+    // The server may turn the offer down, frames say if they are compressed
+    if (response.find("permessage-deflate") != std::string::npos) {
+        memset(&inflater, 0, sizeof(inflater));
+        inflateInit2(&inflater, -15);
+        inflaterReady = true;
+    }
+    state = State::Open;
+    return true;
+}
+
+bool WebSocketClient::Inflate(const std::string& compressed, std::string& output) {
+    if (!inflaterReady) {
+        LOG_ERROR("Compressed frame without permessage-deflate");
+        return false;
+    }
+    std::string input = compressed + std::string(DeflateTail, sizeof(DeflateTail));
+    inflater.next_in = (Bytef*) input.data();
+    inflater.avail_in = input.size();
+    output.clear();
+    char chunk[16 * 1024];
+    do {
+        inflater.next_out = (Bytef*) chunk;
+        inflater.avail_out = sizeof(chunk);
+        int result = inflate(&inflater, Z_SYNC_FLUSH);
+        if (result != Z_OK && result != Z_BUF_ERROR) {
+            LOG_ERROR("Could not inflate message: " << result);
+            return false;
+        }
+        output.append(chunk, sizeof(chunk) - inflater.avail_out);
+        // No progress left to make
+        if (result == Z_BUF_ERROR) break;
+    } while (inflater.avail_in > 0 || inflater.avail_out == 0);
+    return true;
+}
+
+bool WebSocketClient::ReadFrame(const std::function<void(std::string_view)>& onMessage) {
+    if (in.size() < 2) return false;
+    const uint8_t* bytes = (const uint8_t*) in.data();
+    bool fin = bytes[0] & 0x80;
+    bool compressed = bytes[0] & 0x40;
+    uint8_t opcode = bytes[0] & 0x0f;
+    uint64_t length = bytes[1] & 0x7f;
+    size_t header = 2;
+    if (length == 126) {
+        if (in.size() < 4) return false;
+        length = (bytes[2] << 8) | bytes[3];
+        header = 4;
+    }
+    else if (length == 127) {
+        if (in.size() < 10) return false;
+        length = 0;
+        for (int i = 0; i < 8; i++) {
+            length = (length << 8) | bytes[2 + i];
+        }
+        header = 10;
+    }
+    // Servers never mask
+    if (in.size() < header + length) return false;
+    std::string payload = in.substr(header, length);
+    in.erase(0, header + length);
+
+    switch (opcode) {
+    case 0x0:
+    case 0x1:
+    case 0x2:
+        if (opcode != 0x0) {
+            message.clear();
+            messageCompressed = compressed;
+        }
+        message += payload;
+        if (fin) {
+            if (messageCompressed) {
+                std::string inflated;
+                if (!Inflate(message, inflated)) {
+                    Close();
+                    return false;
+                }
+                message.swap(inflated);
+            }
+            messageBytes += message.size();
+            onMessage(message);
+            message.clear();
+        }
+        break;
+    case 0x8:
+        SendFrame(0x8, payload.substr(0, 2));
+        OnWritable();
+        Close();
+        return false;
+    case 0x9:
+        SendFrame(0xA, payload);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+void WebSocketClient::OnReadable(const std::function<void(std::string_view)>& onMessage) {
+    char buffer[64 * 1024];
+    while (fd >= 0) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            LOG_ERROR("Receive failed: " << strerror(errno));
+            Close();
+            return;
+        }
+        if (received == 0) {
+            LOG_WARN("Server closed the connection");
+            Close();
+            return;
+        }
+        bytesReceived += received;
+        in.append(buffer, received);
+    }
+
+    if (state == State::Handshaking && !ReadHandshake()) return;
+    while (state == State::Open && ReadFrame(onMessage)) {}
+}
+
+void WebSocketClient::SendFrame(uint8_t opcode, std::string_view payload) {
+    std::string frame;
+    frame += (char) (0x80 | opcode);
+    // Clients always mask
+    if (payload.size() < 126) {
+        frame += (char) (0x80 | payload.size());
+    }
+    else if (payload.size() < 65536) {
+        frame += (char) (0x80 | 126);
+        frame += (char) (payload.size() >> 8);
+        frame += (char) (payload.size() & 0xff);
+    }
+    else {
+        frame += (char) (0x80 | 127);
+        for (int i = 7; i >= 0; i--) {
+            frame += (char) ((uint64_t) payload.size() >> (i * 8));
+        }
+    }
+    uint32_t mask = Random()();
+    char maskBytes[4];
+    memcpy(maskBytes, &mask, 4);
+    frame.append(maskBytes, 4);
+    size_t start = frame.size();
+    frame += payload;
+    for (size_t i = 0; i < payload.size(); i++) {
+        frame[start + i] ^= maskBytes[i % 4];
+    }
+    out += frame;
+}
+
+void WebSocketClient::Send(std::string_view text) {
+    if (state != State::Open) return;
+    SendFrame(0x1, text);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+// Just enough of a websocket client (RFC 6455 plus permessage-deflate) for
+//   the bot swarm to talk to the game server like a browser does. Non
+//   blocking, driven by whoever polls GetFd()
+class WebSocketClient {
+public:
+    enum class State { Connecting, Handshaking, Open, Closed };
+
+private:
+    int fd = -1;
+    State state = State::Closed;
+    std::string path;
+    bool deflate = false;
+    z_stream inflater;
+    bool inflaterReady = false;
+
+    std::string in;
+    std::string out;
+    // Fragments of a message still being received
+    std::string message;
+    bool messageCompressed = false;
+
+    void SendFrame(uint8_t opcode, std::string_view payload);
+    bool ReadHandshake();
+    // False if the frame at the front of in isn't complete yet
+    bool ReadFrame(const std::function<void(std::string_view)>& onMessage);
+    bool Inflate(const std::string& compressed, std::string& output);
+
+public:
+    // Wire bytes, before inflating
+    uint64_t bytesReceived = 0;
+    uint64_t bytesSent = 0;
+    // Message bytes after inflating
+    uint64_t messageBytes = 0;
+
+    WebSocketClient() {}
+    ~WebSocketClient();
+    WebSocketClient(const WebSocketClient&) = delete;
+    WebSocketClient& operator=(const WebSocketClient&) = delete;
+
+    // Starts connecting, true if the connection is under way
+    bool Connect(const std::string& host, uint16_t port, const std::string& path, bool deflate);
+    void Close();
+
+    int GetFd() const { return fd; }
+    State GetState() const { return state; }
+    bool IsOpen() const { return state == State::Open; }
+
+    // Call when the socket is readable, every complete text message is
+    //   handed to onMessage
+    void OnReadable(const std::function<void(std::string_view)>& onMessage);
+    // Call when the socket is writable, finishes connecting and sends
+    //   anything queued
+    void OnWritable();
+    bool WantsWrite() const { return state == State::Connecting || !out.empty(); }
+
+    // Queued as a text frame, sent on the next OnWritable
+    void Send(std::string_view text);
+};
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+# Splits the packed textures into a core set and one bundle per map.
+#
+# A texture goes into a map's bundle when the only thing referencing it is a
+#   StaticModelNode of that map. Textures shared by several maps, used by
+#   models the code loads by name or named in the code directly stay in the
+#   core set, which is copied to <core-dir> for the preloaded emscripten
+#   package. Textures nothing references go in an "extra" bundle that the
+#   client only fetches once it asks for one of them.
+#
+# Bundles are a plain concatenation of files named <map>.<content hash>.bundle
+#   so they can be cached forever, manifest.json maps each map to its bundle
+#   and is the only file that has to be revalidated.
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import shutil
+import sys
+
+def standardize_path(path):
+    # Matches StandardizePath in asset-manager.cc
+    if path.startswith('..\\\\'):
+        path = path[4:]
+    return path.replace('\\\\', '/')
+
+def packed_path(texture):
+    return os.path.splitext(texture)[0] + '.ctex'
+
+def model_textures(data_dir, model):
+    textures = set()
+    obj_path = os.path.join(data_dir, 'models', model)
+    if not os.path.exists(obj_path):
+        return textures
+    with open(obj_path, errors='ignore') as obj:
+        libs = [line.split(None, 1)[1].strip() for line in obj if line.startswith('mtllib ')]
+    for lib in libs:
+        mtl_path = os.path.join(data_dir, 'models', lib)
+        if not os.path.exists(mtl_path):
+            continue
+        with open(mtl_path, errors='ignore') as mtl:
+            for line in mtl:
+                parts = line.strip().split(None, 1)
+                if len(parts) == 2 and (parts[0].startswith('map_') or parts[0] == 'refl'):
+                    textures.add(standardize_path(parts[1]))
+    return textures
+
+def map_references(map_path):
+    with open(map_path) as f:
+        scene = json.load(f)
+    models = set()
+    def walk(node):
+        if isinstance(node, dict):
+            if node.get('type') == 'StaticModelNode' and 'model' in node:
+                models.add(node['model'])
+            for value in node.values():
+                walk(value)
+        elif isinstance(node, list):
+            for value in node:
+                walk(value)
+    walk(scene)
+    textures = set()
+    skydome = scene.get('properties', {}).get('skydomeTexture')
+    if skydome:
+        textures.add(skydome)
+    return models, textures
+
+def code_references(source_dirs):
+    # Models and textures the game loads by name can show up on any map
+    models = set()
+    textures = set()
+    model_pattern = re.compile(r'"([A-Za-z0-9_\-]+\.obj)"')
+    texture_pattern = re.compile(r'"(textures/[^"]+\.(?:png|jpg|jpeg))"')
+    for source_dir in source_dirs:
+        for root, _, files in os.walk(source_dir):
+            for name in files:
+                if os.path.splitext(name)[1] in ('.h', '.cc', '.w'):
+                    with open(os.path.join(root, name), errors='ignore') as f:
+                        source = f.read()
+                    models.update(model_pattern.findall(source))
+                    textures.update(texture_pattern.findall(source))
+    return models, textures
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--data', default='../data')
+    parser.add_argument('--out', required=True, help='bundle and manifest output directory')
+    parser.add_argument('--core-dir', required=True, help='core textures are copied here')
+    args = parser.parse_args()
+
+    texture_dir = os.path.join(args.data, 'textures')
+    packed = set()
+    for root, _, files in os.walk(texture_dir):
+        for name in files:
+            if name.endswith('.ctex'):
+                packed.add(os.path.relpath(os.path.join(root, name), args.data).replace(os.sep, '/'))
+    if not packed:
+        sys.exit('No packed textures in ' + texture_dir + ', run make textures first')
+
+    pinned, pinned_textures = code_references(['src', os.path.join(args.data, 'scripts')])
+
+    # Every packed texture -> the maps that need it, None for anything global
+    users = {}
+    for texture in pinned_textures:
+        users.setdefault(packed_path(texture), set()).add(None)
+    for model in pinned:
+        for texture in model_textures(args.data, model):
+            users.setdefault(packed_path(texture), set()).add(None)
+    map_dir = os.path.join(args.data, 'maps')
+    maps = sorted(name for name in os.listdir(map_dir) if name.endswith('.json'))
+    for map_name in maps:
+        models, textures = map_references(os.path.join(map_dir, map_name))
+        for model in models:
+            owner = None if model in pinned else map_name
+            for texture in model_textures(args.data, model):
+                users.setdefault(packed_path(texture), set()).add(owner)
+        for texture in textures:
+            users.setdefault(packed_path(texture), set()).add(map_name)
+
+    bundles = { map_name: [] for map_name in maps }
+    bundles['extra'] = []
+    core = []
+    for texture in sorted(packed):
+        owners = users.get(texture)
+        if owners is None:
+            bundles['extra'].append(texture)
+        elif len(owners) == 1 and None not in owners:
+            bundles[next(iter(owners))].append(texture)
+        else:
+            core.append(texture)
+
+    os.makedirs(args.out, exist_ok=True)
+    for name in os.listdir(args.out):
+        if name.endswith('.bundle'):
+            os.remove(os.path.join(args.out, name))
+
+    manifest = { 'maps': {}, 'bundles': {} }
+    for map_name, textures in bundles.items():
+        if not textures:
+            continue
+        blob = bytearray()
+        files = []
+        for texture in textures:
+            with open(os.path.join(args.data, texture), 'rb') as f:
+                data = f.read()
+            files.append({ 'path': texture, 'offset': len(blob), 'size': len(data) })
+            blob += data
+        bundle_name = os.path.splitext(map_name)[0]
+        file_name = bundle_name + '.' + hashlib.sha1(blob).hexdigest()[:12] + '.bundle'
+        with open(os.path.join(args.out, file_name), 'wb') as f:
+            f.write(blob)
+        if map_name != 'extra':
+            manifest['maps']['maps/' + map_name] = bundle_name
+        manifest['bundles'][bundle_name] = { 'file': file_name, 'size': len(blob), 'files': files }
+        print('Bundle %s: %d textures, %.1f MB' % (file_name, len(files), len(blob) / 1e6))
+
+    # Only fetched when one of their textures is missing
+    manifest['onDemand'] = [name for name in ('extra',) if name in manifest['bundles']]
+
+    with open(os.path.join(args.out, 'manifest.json'), 'w') as f:
+        json.dump(manifest, f, indent=2)
+
+    shutil.rmtree(args.core_dir, ignore_errors=True)
+    core_bytes = 0
+    for texture in core:
+        dest = os.path.join(args.core_dir, os.path.relpath(texture, 'textures'))
+        os.makedirs(os.path.dirname(dest), exist_ok=True)
+        shutil.copyfile(os.path.join(args.data, texture), dest)
+        core_bytes += os.path.getsize(dest)
+    print('Core: %d textures, %.1f MB' % (len(core), core_bytes / 1e6))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,79 @@
+#include "audio_stream.h"
+
+AudioStream::~AudioStream() {
+    Stop();
+    if (buffers[0]) {
+        alDeleteBuffers(StreamChunkCount, buffers);
+    }
+}
+
+bool AudioStream::FillBuffer(ALuint buffer) {
+    if (decoded) return false;
+    uint64_t frames = decoder.Read(chunk.data(), StreamChunkFrames);
+    if (frames < StreamChunkFrames) {
+        decoded = true;
+        decoder.Close();
+    }
+    if (frames == 0) return false;
+    alBufferData(buffer, format, chunk.data(), frames * (chunk.size() / StreamChunkFrames) * sizeof(int16_t),
+        sampleRate);
+    return true;
+}
+
+bool AudioStream::Start(ALuint newSource, const Audio& audio) {
+    Stop();
+    if (!decoder.Open(audio.path)) {
+        return false;
+    }
+    if (!buffers[0]) {
+        alGenBuffers(StreamChunkCount, buffers);
+    }
+    source = newSource;
+    format = audio.GetFormat();
+    sampleRate = decoder.GetSampleRate();
+    chunk.resize(StreamChunkFrames * decoder.GetChannels());
+    decoded = false;
+
+    for (ALuint buffer : buffers) {
+        if (!FillBuffer(buffer)) break;
+        alSourceQueueBuffers(source, 1, &buffer);
+    }
+    return true;
+}
+
+bool AudioStream::Refill() {
+    if (!source) return false;
+    ALint processed = 0;
+    alGetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
+    for (; processed > 0; processed--) {
+        ALuint buffer;
+        alSourceUnqueueBuffers(source, 1, &buffer);
+        if (FillBuffer(buffer)) {
+            alSourceQueueBuffers(source, 1, &buffer);
+        }
+    }
+
+    ALint queued = 0;
+    alGetSourcei(source, AL_BUFFERS_QUEUED, &queued);
+    if (queued == 0) {
+        source = 0;
+        return false;
+    }
+    // A long frame can drain the queue before it is refilled
+    ALint state;
+    alGetSourcei(source, AL_SOURCE_STATE, &state);
+    if (state != AL_PLAYING) {
+        alSourcePlay(source);
+    }
+    return true;
+}
+
+void AudioStream::Stop() {
+    if (source) {
+        alSourceStop(source);
+        // Unqueues every buffer of a stopped source
+        alSourcei(source, AL_BUFFER, 0);
+        source = 0;
+    }
+    decoder.Close();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "logging.h"
+#include "audio.h"
+#include "audio-decoder.h"
+
+#include <vector>
+
+// Plays a streamed clip on a source through a ring of StreamChunkCount
+//   buffers, each refilled with the next chunk once the source is done with it
+class AudioStream {
+    AudioDecoder decoder;
+    ALuint buffers[StreamChunkCount] = {};
+    std::vector<int16_t> chunk;
+    ALenum format = 0;
+    unsigned int sampleRate = 0;
+    ALuint source = 0;
+    // Everything has been decoded, the queue just has to drain
+    bool decoded = false;
+
+    // False when there was nothing left to put in it
+    bool FillBuffer(ALuint buffer);
+
+public:
+    AudioStream() {}
+    ~AudioStream();
+    AudioStream(const AudioStream&) = delete;
+    AudioStream& operator=(const AudioStream&) = delete;
+
+    // Queues the first chunks of audio on a stopped source with no buffers,
+    //   the caller plays it
+    bool Start(ALuint source, const Audio& audio);
+    // Call every frame while playing, false once the whole clip has played
+    bool Refill();
+    // Stops the source and takes the buffers back off it
+    void Stop();
+};
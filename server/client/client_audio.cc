@@ -18,52 +18,47 @@ void ClientAudio::SetupContext() {
         LOG_ERROR("Could not make audio context current");
         throw "Could not make audio context current";
     }
+    voices.Initialize();
 }
 
 void ClientAudio::Tick() {
-    if (PlayerObject* p = game.GetLocalPlayer()) {
+    Vector3 listener;
+    PlayerObject* p = game.GetLocalPlayer();
+    if (p) {
         Vector3 player = p->GetPosition();
+        listener = player;
         Vector3 look = p->GetLookDirection();
         alListener3f(AL_POSITION, player.x, player.y, player.z);
         ALfloat listenerOri[]= { look.x, look.y, look.z, 0.0, 1.0, 0.0 };
         alListenerfv(AL_ORIENTATION, listenerOri);
     }
 
-    // Start all audios that were queued up
+    // Queue everything requested this frame, the voice manager decides what
+    //   actually plays
     for (auto& request : game.audioRequests) {
-        if (!request.audio) continue;
-        AudioPlayback* playback = new AudioPlayback;
-        playback->boundObject = request.boundObject;
-        playback->state = AL_PLAYING;
-        playback->position = request.location;
-        alGenSources(1, &playback->source);
-        alSourcef(playback->source, AL_PITCH, 1);
-        alSourcef(playback->source, AL_GAIN, request.volume);
-        alSource3f(playback->source, AL_VELOCITY, 0, 0, 0);
-        alSourcei(playback->source, AL_LOOPING, AL_FALSE);
-        alSourcei(playback->source, AL_BUFFER, request.audio->audioBuffer);
-        alSourcePlay(playback->source);
-        sources.insert(playback);
+        VoiceRequest voice;
+        voice.audio = request.audio;
+        voice.gain = request.volume;
+        voice.position = request.location;
+        voice.boundObject = request.boundObject;
+        voice.priority = request.priority;
+        if (Object* bound = game.GetObject<Object>(request.boundObject)) {
+            voice.position = bound->clientPosition;
+            // The local player's own sounds get a one step priority boost,
+            //   not a reserved voice. Others' sounds of the same priority
+            //   can't steal them however loud, ones a step higher still can
+            if (bound == p) voice.priority++;
+        }
+        voices.Play(voice);
     }
     game.audioRequests.clear();
 
-
-    for (auto it = sources.begin(); it != sources.end();) {
-        AudioPlayback* source = *it;
-        if (Object* bound = game.GetObject<Object>(source->boundObject)) {
-            // LOG_DEBUG("Updating position " << bound->GetClass());
-            source->position = bound->clientPosition;
-        }
-        alSource3f(source->source, AL_POSITION, source->position.x, source->position.y, source->position.z);
-        alGetSourcei(source->source, AL_SOURCE_STATE, &source->state);
-        // Remove all sources that ended
-        if (source->state != AL_PLAYING) {
-            alDeleteSources(1, &source->source);
-            delete source;
-            it = sources.erase(it);
-        }
-        else {
-            it++;
+    // Sounds whose object is gone stay where it was last
+    for (Voice& voice : voices.GetVoices()) {
+        if (!voice.active || voice.request.boundObject == VoiceRequest::NoObject) continue;
+        if (Object* bound = game.GetObject<Object>(voice.request.boundObject)) {
+            voice.request.position = bound->clientPosition;
         }
     }
+    voices.Update(Timer::Now(), listener);
 }
\ No newline at end of file
@@ -3,22 +3,16 @@
 #include "game.h"
 #include "audio.h"
 #include "object.h"
-
-#include <unordered_set>
-
-struct AudioPlayback {
-    ALuint source;
-    ALint state;
-    Vector3 position;
-    ObjectID boundObject;
-};
+#include "voice_manager.h"
 
 class ClientAudio {
     Game& game;
-    std::unordered_set<AudioPlayback*> sources;
+    VoiceManager voices;
 public:
     ClientAudio(Game& game) : game(game) {}
 
     void SetupContext();
     void Tick();
+
+    const VoiceStats& GetStats() const { return voices.GetStats(); }
 };
\ No newline at end of file
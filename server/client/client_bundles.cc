@@ -0,0 +1,159 @@
+#include "client_bundles.h"
+#include "compressed-texture.h"
+#include "logging.h"
+
+#include <emscripten.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+void ClientBundles::RequestMap(const std::string& path) {
+    mapPath = path;
+    mapBundle.clear();
+
+    emscripten_fetch_attr_t attr;
+    emscripten_fetch_attr_init(&attr);
+    strcpy(attr.requestMethod, "GET");
+    attr.attributes = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY;
+    attr.userData = this;
+    attr.onsuccess = OnManifest;
+    attr.onerror = OnError;
+    // The only file without a hash in its name
+    static const char* headers[] = { "Cache-Control", "no-cache", nullptr };
+    attr.requestHeaders = headers;
+    emscripten_fetch(&attr, (baseUrl + "manifest.json").c_str());
+}
+
+void ClientBundles::OnManifest(emscripten_fetch_t* fetch) {
+    ClientBundles* self = static_cast<ClientBundles*>(fetch->userData);
+    self->manifest.Parse(fetch->data, fetch->numBytes);
+    emscripten_fetch_close(fetch);
+    if (self->manifest.HasParseError() || !self->manifest.IsObject()) {
+        LOG_ERROR("Could not parse bundle manifest");
+        self->MapFailed();
+        return;
+    }
+    self->hasManifest = true;
+
+    auto& maps = self->manifest["maps"];
+    if (maps.HasMember(self->mapPath.c_str())) {
+        self->mapBundle = maps[self->mapPath.c_str()].GetString();
+        self->queue.push_back(self->mapBundle);
+    }
+    else {
+        // Everything the map needs is in the core package
+        self->mapReadyMs = emscripten_get_now();
+    }
+    if (self->manifest.HasMember("onDemand")) {
+        for (auto& name : self->manifest["onDemand"].GetArray()) {
+            for (auto& file : self->manifest["bundles"][name.GetString()]["files"].GetArray()) {
+                self->onDemandFiles[RESOURCE_PATH(std::string(file["path"].GetString()))] = name.GetString();
+            }
+        }
+    }
+    self->FetchNext();
+}
+
+void ClientBundles::MapFailed() {
+    mapFailed = true;
+    mapReadyMs = emscripten_get_now();
+    LOG_ERROR("Map assets failed at " << mapReadyMs << "ms, drawing placeholders");
+}
+
+void ClientBundles::FetchNext() {
+    if (fetching || queue.empty()) return;
+    auto& bundles = manifest["bundles"];
+    if (!bundles.HasMember(queue.front().c_str())) {
+        LOG_ERROR("Bundle " << queue.front() << " is not in the manifest");
+        if (queue.front() == mapBundle) MapFailed();
+        queue.pop_front();
+        FetchNext();
+        return;
+    }
+    std::string file = bundles[queue.front().c_str()]["file"].GetString();
+
+    emscripten_fetch_attr_t attr;
+    emscripten_fetch_attr_init(&attr);
+    strcpy(attr.requestMethod, "GET");
+    // Served from IndexedDB when this exact hash was fetched before
+    attr.attributes = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY | EMSCRIPTEN_FETCH_PERSIST_FILE;
+    attr.userData = this;
+    attr.onsuccess = OnBundle;
+    attr.onerror = OnError;
+    fetching = true;
+    emscripten_fetch(&attr, (baseUrl + file).c_str());
+}
+
+void ClientBundles::OnBundle(emscripten_fetch_t* fetch) {
+    ClientBundles* self = static_cast<ClientBundles*>(fetch->userData);
+    std::string name = self->queue.front();
+    self->queue.pop_front();
+    self->fetching = false;
+
+    self->downloadedBytes += fetch->numBytes;
+    self->Unpack(name, fetch->data, fetch->numBytes);
+    emscripten_fetch_close(fetch);
+
+    size_t loaded = self->game.GetAssetManager().LoadPendingTextures();
+    self->checkedPending = -1;
+    LOG_INFO("Bundle " << name << " ready, replaced " << loaded << " placeholder textures");
+    if (name == self->mapBundle) {
+        self->mapReadyMs = emscripten_get_now();
+        LOG_INFO("Map assets ready at " << self->mapReadyMs << "ms");
+    }
+    self->FetchNext();
+}
+
+void ClientBundles::OnError(emscripten_fetch_t* fetch) {
+    ClientBundles* self = static_cast<ClientBundles*>(fetch->userData);
+    LOG_ERROR("Could not fetch " << fetch->url << ", status " << fetch->status);
+    emscripten_fetch_close(fetch);
+    if (!self->hasManifest) {
+        self->MapFailed();
+        return;
+    }
+
+    if (self->queue.front() == self->mapBundle) self->MapFailed();
+    self->queue.pop_front();
+    self->fetching = false;
+    self->FetchNext();
+}
+
+void ClientBundles::Unpack(const std::string& name, const char* data, size_t size) {
+    for (auto& file : manifest["bundles"][name.c_str()]["files"].GetArray()) {
+        std::string path = RESOURCE_PATH(std::string(file["path"].GetString()));
+        size_t offset = file["offset"].GetUint64();
+        size_t length = file["size"].GetUint64();
+        if (offset + length > size) {
+            LOG_ERROR("Bundle " << name << " is truncated at " << path);
+            return;
+        }
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+        std::ofstream stream(path, std::ios::binary);
+        stream.write(data + offset, length);
+    }
+}
+
+void ClientBundles::FetchMissing() {
+    auto& pending = game.GetAssetManager().pendingTextures;
+    if (onDemandFiles.empty() || pending.size() == checkedPending) return;
+    checkedPending = pending.size();
+
+    for (auto& [path, texture] : pending) {
+        auto file = onDemandFiles.find(CompressedTexturePath(path));
+        if (file == onDemandFiles.end() || onDemandQueued.count(file->second)) continue;
+        LOG_INFO("Fetching bundle " << file->second << " for " << path);
+        onDemandQueued.insert(file->second);
+        queue.push_back(file->second);
+    }
+    FetchNext();
+}
+
+void ClientBundles::OnFrame() {
+    if (firstFrameMs < 0) {
+        firstFrameMs = emscripten_get_now();
+        LOG_INFO("Time to first frame " << firstFrameMs << "ms");
+    }
+    FetchMissing();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "game.h"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <emscripten/fetch.h>
+
+// Downloads the asset bundles written by bundle_assets.py. The core package
+//   is enough to start the game, a map's textures arrive afterwards and
+//   replace the placeholders the asset manager drew in the meantime.
+//   Bundles of textures no map uses are only fetched once one of them is
+//   asked for. Bundle file names carry a content hash, so they are cached in IndexedDB
+//   and only manifest.json is revalidated on every load.
+class ClientBundles {
+    Game& game;
+    std::string baseUrl = "bundles/";
+
+    JSONDocument manifest;
+    bool hasManifest = false;
+    std::string mapPath;
+    std::string mapBundle;
+    std::deque<std::string> queue;
+    bool fetching = false;
+
+    // Packed file -> on demand bundle holding it, each is queued at most once
+    std::unordered_map<std::string, std::string> onDemandFiles;
+    std::unordered_set<std::string> onDemandQueued;
+    // Pending textures are only looked up again when their count changes
+    size_t checkedPending = 0;
+
+    // Milliseconds since navigation, -1 until it happens
+    double firstFrameMs = -1;
+    double mapReadyMs = -1;
+    // The map's bundle or the manifest couldn't be fetched, its textures
+    //   stay placeholders
+    bool mapFailed = false;
+    size_t downloadedBytes = 0;
+
+    static void OnManifest(emscripten_fetch_t* fetch);
+    static void OnBundle(emscripten_fetch_t* fetch);
+    static void OnError(emscripten_fetch_t* fetch);
+
+    void FetchNext();
+    void MapFailed();
+    // Queues the on demand bundles of textures that are still placeholders
+    void FetchMissing();
+    // Writes every file of a bundle into the virtual file system
+    void Unpack(const std::string& name, const char* data, size_t size);
+
+public:
+    ClientBundles(Game& game) : game(game) {}
+
+    // Fetches the manifest, then the map's bundle
+    void RequestMap(const std::string& path);
+    void OnFrame();
+
+    // Also once the map's textures failed to arrive
+    bool IsMapReady() const { return mapReadyMs >= 0; }
+    bool IsMapFailed() const { return mapFailed; }
+    double GetFirstFrameMs() const { return firstFrameMs; }
+    double GetMapReadyMs() const { return mapReadyMs; }
+    size_t GetDownloadedBytes() const { return downloadedBytes; }
+    size_t GetPendingTextureCount() { return game.GetAssetManager().pendingTextures.size(); }
+};
@@ -6,6 +6,7 @@
 #include "shader.h"
 #include "bvh.h"
 #include "global.h"
+#include "trace.h"
 
 #include <vector>
 #include <fstream>
@@ -43,6 +44,10 @@ void ClientGL::SetupContext() {
     emscripten_webgl_make_context_current(glContext);
 
     emscripten_webgl_enable_extension(glContext, "EXT_color_buffer_float");
+    GPUTimer::supported = emscripten_webgl_enable_extension(glContext, "EXT_disjoint_timer_query_webgl2");
+    TextureStreamer::compressionSupported =
+        emscripten_webgl_enable_extension(glContext, "WEBGL_compressed_texture_s3tc");
+    LOG_INFO("S3TC textures " << (TextureStreamer::compressionSupported ? "supported" : "unsupported"));
 
     glGetIntegerv(GL_MAX_SAMPLES, &glLimits.MAX_SAMPLES);
     LOG_INFO("GL_MAX_SAMPLES = " << glLimits.MAX_SAMPLES);
@@ -91,7 +96,7 @@ void ClientGL::DrawDebug(Object* obj) {
         //         if (GlobalSettings.Client_DrawBVH) {
         //             // Draw all the BVHs
         //             std::queue<std::pair<BVHTree<BVHTriangle>*, int>> nodes;
-        //             nodes.emplace(collider->bvhTree, 0);
+        //             nodes.emplace(collider->mesh->bvhTree, 0);
         //             while (!nodes.empty()) {
         //                 auto pair = nodes.front();
         //                 BVHTree<BVHTriangle>* front = pair.first;
@@ -152,23 +157,139 @@ void MultiplyAll(A* dest, const A* src, size_t count, const B& multiplyBy) {
     }
 }
 
-void ClientGL::AddMeshToLayer(Object* obj, Mesh* mesh, DrawLayer* layer, const Vector3& centerPt) {
-    if (mesh->material->IsTransparent()) {
+void ClientGL::AddMeshToLayer(Object* obj, Mesh* mesh, DrawLayer* layer,
+        const Matrix4& transform, const Vector3& centerPt) {
+    Material* overrideMaterial = obj->GetMaterialOverride();
+    Material* material = overrideMaterial ? overrideMaterial : mesh->material;
+    const SkeletonPose* pose = mesh->skin.empty() ? nullptr : obj->GetPose();
+    if (material->IsTransparent()) {
         DrawParams& params = layer->PushTransparent(
             glm::distance2(centerPt, cameraPosition));
         params.id = obj->GetId();
         params.mesh = mesh;
-        params.transform = obj->GetTransform();
+        params.overrideMaterial = overrideMaterial;
+        params.transform = transform;
         params.castShadows = !obj->IsTagged(Tag::NO_CAST_SHADOWS);
         params.hasOutline = obj->IsTagged(Tag::DRAW_OUTLINE);
+        params.bounds = obj->GetRenderBounds(transform);
+        params.hasBounds = true;
+        params.isStatic = obj->IsStatic();
+        if (pose) {
+            params.bones = pose->skinningMatrices.data();
+            params.boneCount = pose->boneCount;
+        }
     }
     else {
-        DrawParams& params = layer->PushOpaque(mesh->material);
+        DrawParams& params = layer->PushOpaque(
+            glm::distance2(centerPt, cameraPosition));
         params.id = obj->GetId();
         params.mesh = mesh;
-        params.transform = obj->GetTransform();
+        params.overrideMaterial = overrideMaterial;
+        params.transform = transform;
         params.castShadows = !obj->IsTagged(Tag::NO_CAST_SHADOWS);
         params.hasOutline = obj->IsTagged(Tag::DRAW_OUTLINE);
+        params.bounds = obj->GetRenderBounds(transform);
+        params.hasBounds = true;
+        params.isStatic = obj->IsStatic();
+        if (pose) {
+            params.bones = pose->skinningMatrices.data();
+            params.boneCount = pose->boneCount;
+        }
+    }
+}
+
+void ClientGL::AddObjectToLayers(Object* obj, const Matrix4& transform, bool isVisible) {
+    Model* model = obj->GetModel();
+    bool isForeground = obj->IsTagged(Tag::DRAW_FOREGROUND);
+    // Culled objects can still cast shadows into view
+    DrawLayer& layerToDraw = !isVisible ?
+        behindPlayerLayer : (isForeground ? foregroundLayer : backgroundLayer);
+    if (isVisible) {
+        cullingStats.objectsDrawn++;
+    }
+    else {
+        cullingStats.objectsCulled++;
+    }
+
+    const AABB& broad = obj->GetRenderBounds(transform);
+    Vector3 delta = ClosestPointOnAABB(broad, cameraPosition) - cameraPosition;
+    float distanceXZ = glm::sqrt(delta.x * delta.x + delta.z * delta.z);
+    bool isWithinMinimapRange = distanceXZ < 30.f;
+    for (auto& mesh : model->meshes) {
+        Vector3 centerPt = Vector3(transform * Vector4(mesh->center, 1));
+        AddMeshToLayer(obj, mesh, &layerToDraw, transform, centerPt);
+
+        if (isWithinMinimapRange) {
+            AddMeshToLayer(obj, mesh, &minimapLayer, transform, centerPt);
+        }
+    }
+}
+
+static size_t StaticCullSignature(ObjectID id) {
+    return (size_t) id * 2654435761u + 1;
+}
+
+void ClientGL::RebuildStaticCullTree() {
+    delete staticCullTree;
+    staticCullTree = nullptr;
+    staticCullTreeSignature = 0;
+    staticCullTreePoses = 0;
+
+    std::vector<BVHCullObject*> nodes;
+    for (auto& gameObjectPair : game.GetGameObjects()) {
+        Object* obj = gameObjectPair.second;
+        if (!obj->IsStatic() || !obj->GetModel()) continue;
+        nodes.push_back(new BVHCullObject(obj->GetId(),
+            obj->GetRenderBounds(obj->GetTransform()), obj->clientPoseVersion));
+        staticCullTreeSignature += StaticCullSignature(obj->GetId());
+        staticCullTreePoses += obj->clientPoseVersion;
+    }
+    if (!nodes.empty()) {
+        staticCullTree = BVHTree<BVHCullObject>::Create(nodes, 0, 0);
+    }
+}
+
+void ClientGL::RefitStaticCullTree(BVHTree<BVHCullObject>* node) {
+    bool first = true;
+    for (auto& child : node->children) {
+        RefitStaticCullTree(child);
+        node->collider = first ? child->collider : AABB::FromTwo(node->collider, child->collider);
+        first = false;
+    }
+    for (auto& leaf : node->tris) {
+        Object* obj = game.GetObject(leaf->id);
+        if (obj && obj->clientPoseVersion != leaf->poseVersion) {
+            staticCullTreePoses += obj->clientPoseVersion - (size_t) leaf->poseVersion;
+            leaf->bounds = obj->GetRenderBounds(obj->GetTransform());
+            leaf->poseVersion = obj->clientPoseVersion;
+        }
+        node->collider = first ? leaf->bounds : AABB::FromTwo(node->collider, leaf->bounds);
+        first = false;
+    }
+}
+
+void ClientGL::CullStaticTree(BVHTree<BVHCullObject>* node, const Frustum& frustum, CullState state) {
+    cullingStats.staticNodesVisited++;
+    if (state == CullState::Partial) {
+        if (!frustum.Intersects(node->collider)) {
+            state = CullState::Outside;
+        }
+        else if (frustum.Contains(node->collider)) {
+            state = CullState::Inside;
+        }
+    }
+    for (auto& child : node->children) {
+        CullStaticTree(child, frustum, state);
+    }
+    for (auto& leaf : node->tris) {
+        Object* obj = game.GetObject(leaf->id);
+        if (!obj) continue;
+        bool isVisible = state == CullState::Inside;
+        if (state == CullState::Partial) {
+            cullingStats.objectsTested++;
+            isVisible = frustum.Intersects(leaf->bounds);
+        }
+        AddObjectToLayers(obj, obj->GetTransform(), isVisible);
     }
 }
 
@@ -188,36 +309,66 @@ void ClientGL::SetupDrawingLayers() {
         }
     }
 
+    viewMat = glm::lookAt(cameraPosition,
+        cameraPosition + cameraRotation, Vector::Up);
+
+    float FOV = glm::radians(55.0f);
+    float viewNear = 0.2f;
+    float viewFar = 300.f;
+    float aspectRatio = (float) windowWidth / (float) windowHeight;
+    projMat = glm::perspective(FOV, aspectRatio, viewNear, viewFar);
+
     foregroundLayer.Clear();
     backgroundLayer.Clear();
     behindPlayerLayer.Clear();
+    behindPlayerLayer.shadowOnly = true;
     minimapLayer.Clear();
 
+    cullingStats = CullingStats{};
+    Frustum frustum(projMat * viewMat);
+
+    // Moving objects are culled in one batch, static ones go through the BVH
+    dynamicObjects.clear();
+    dynamicCullingList.Clear();
+    size_t staticSignature = 0;
+    size_t staticPoses = 0;
     for (auto& gameObjectPair : game.GetGameObjects()) {
         Object* obj = gameObjectPair.second;
         if (PlayerObject* localPlayer = game.GetLocalPlayer()) {
             // Don't draw the local player
             if (obj == localPlayer) continue;
         }
-        Matrix4 transform = obj->GetTransform();
-        bool isForeground = obj->IsTagged(Tag::DRAW_FOREGROUND);
-        DrawLayer& layerToDraw = !obj->IsVisibleInFrustrum(cameraPosition, cameraRotation) ?
-            behindPlayerLayer : (isForeground ? foregroundLayer : backgroundLayer);
-
-        AABB broad = obj->GetCollider().GetBroadAABB();
-        Vector3 delta = ClosestPointOnAABB(broad, cameraPosition) - cameraPosition;
-        float distanceXZ = glm::sqrt(delta.x * delta.x + delta.z * delta.z);
-        bool isWithinMinimapRange = distanceXZ < 30.f;
-        if (Model* model = obj->GetModel()) {
-            for (auto& mesh : model->meshes) {
-                Vector3 centerPt = Vector3(transform * Vector4(mesh->center, 1));
-                AddMeshToLayer(obj, mesh, &layerToDraw, centerPt);
-
-                if (isWithinMinimapRange) {
-                    AddMeshToLayer(obj, mesh, &minimapLayer, centerPt);
-                }
-            }
+        if (!obj->GetModel()) continue;
+        if (obj->IsStatic()) {
+            staticSignature += StaticCullSignature(obj->GetId());
+            staticPoses += obj->clientPoseVersion;
+            continue;
         }
+        Matrix4 transform = obj->GetTransform();
+        dynamicObjects.emplace_back(obj, transform);
+        dynamicCullingList.Add(obj->GetRenderBounds(transform));
+    }
+
+    dynamicCullingList.Cull(frustum);
+    cullingStats.objectsTested += dynamicObjects.size();
+    for (size_t i = 0; i < dynamicObjects.size(); i++) {
+        AddObjectToLayers(dynamicObjects[i].first, dynamicObjects[i].second,
+            dynamicCullingList.visible[i]);
+    }
+
+    // The tree is rebuilt when the set of static objects changes, and only
+    //   refit when one of them moves, like an arrow still settling or a
+    //   dropped weapon
+    if (staticSignature != staticCullTreeSignature) {
+        RebuildStaticCullTree();
+        staticCasterVersion++;
+    }
+    else if (staticPoses != staticCullTreePoses && staticCullTree) {
+        RefitStaticCullTree(staticCullTree);
+        staticCasterVersion++;
+    }
+    if (staticCullTree) {
+        CullStaticTree(staticCullTree, frustum, CullState::Partial);
     }
 }
 
@@ -270,25 +421,19 @@ void ClientGL::RenderMinimap() {
 }
 
 void ClientGL::Draw(int width, int height) {
+    TRACE_SCOPE("ClientGL::Draw");
     if (!worldRenderer.IsInitialized()) return;
     if (!minimapRenderer.IsInitialized()) return;
     // LOG_DEBUG("Draw " << width << " " << height);
     windowWidth = width;
     windowHeight = height;
 
+    game.GetAssetManager().textureStreamer.Update();
+
     defaultFrameBuffer.SetSize(width, height);
 
     SetupDrawingLayers();
 
-    viewMat = glm::lookAt(cameraPosition,
-        cameraPosition + cameraRotation, Vector::Up);
-
-    float FOV = glm::radians(55.0f);
-    float viewNear = 0.2f;
-    float viewFar = 300.f;
-    float aspectRatio = (float) width / (float) height;
-    projMat = glm::perspective(FOV, aspectRatio, viewNear, viewFar);
-
     RenderFrameParameters params;
     params.width = width;
     params.height = height;
@@ -305,6 +450,7 @@ void ClientGL::Draw(int width, int height) {
     params.enableAntialiasing = true;
     params.lights = game.lightNodes;
     params.skydomeTexture = skydomeTexture;
+    params.staticCasterVersion = staticCasterVersion;
 
     defaultFrameBuffer.Bind();
     glClearColor(0, 0, 0, 1);
@@ -314,7 +460,7 @@ void ClientGL::Draw(int width, int height) {
     for (auto& objPair : game.GetGameObjects()) {
         DrawDebug(objPair.second);
     }
-    worldRenderer.Draw({ &backgroundLayer, &foregroundLayer });
+    worldRenderer.Draw({ &backgroundLayer, &foregroundLayer, &behindPlayerLayer });
     worldRenderer.EndFrame();
 
     // Finally render everything to the main buffer
@@ -17,6 +17,29 @@
 
 const unsigned int MINIMAP_WIDTH = 512, MINIMAP_HEIGHT = 512;
 
+// Static objects never move, so they're culled through a BVH over their bounds
+struct BVHCullObject : public BVHNode {
+    ObjectID id;
+    AABB bounds;
+    // Client pose version the bounds were taken at
+    uint32_t poseVersion;
+    BVHCullObject(ObjectID id, const AABB& bounds, uint32_t poseVersion) :
+        id(id), bounds(bounds), poseVersion(poseVersion) {
+        center = (bounds.ptMin + bounds.ptMax) * 0.5f;
+    }
+    virtual AABB ComputeAABB() override {
+        return bounds;
+    }
+};
+
+// Counted per frame for the main view
+struct CullingStats {
+    size_t objectsTested = 0;
+    size_t objectsCulled = 0;
+    size_t objectsDrawn = 0;
+    size_t staticNodesVisited = 0;
+};
+
 struct DrawLayerOptions {
     bool drawBehind = true;
     bool drawBackground = true;
@@ -65,11 +88,31 @@ class ClientGL {
     Matrix4 viewMat;
     Matrix4 projMat;
 
+    // Culling
+    CullingStats cullingStats;
+    CullingList dynamicCullingList;
+    std::vector<std::pair<Object*, Matrix4>> dynamicObjects;
+    BVHTree<BVHCullObject>* staticCullTree = nullptr;
+    // Sum of hashed ids in the tree, to notice when the static set changes
+    size_t staticCullTreeSignature = 0;
+    // Sum of their pose versions, which only grow, to notice one moving
+    size_t staticCullTreePoses = 0;
+    // Bumped whenever the tree is rebuilt or refit, so the renderer knows
+    //   when to redraw its cached static shadows
+    size_t staticCasterVersion = 1;
+    // Whether a BVH node still needs testing or is known to be in/out
+    enum class CullState { Partial, Inside, Outside };
+
     // Draw Steps
     void SetupDrawingLayers();
     void RenderMinimap();
     void AddMeshToLayer(Object* obj, Mesh* mesh, DrawLayer* layer,
-        const Vector3& centerPt);
+        const Matrix4& transform, const Vector3& centerPt);
+    void AddObjectToLayers(Object* obj, const Matrix4& transform, bool isVisible);
+    void RebuildStaticCullTree();
+    // Retakes the bounds of leaves that moved and grows the nodes around them
+    void RefitStaticCullTree(BVHTree<BVHCullObject>* node);
+    void CullStaticTree(BVHTree<BVHCullObject>* node, const Frustum& frustum, CullState state);
 
 public:
 
@@ -100,4 +143,6 @@ public:
     void SetGLCullFace(GLenum setting);
     Vector2 WorldToScreenCoordinates(Vector3 worldCoord);
 
+    const CullingStats& GetCullingStats() const { return cullingStats; }
+
 };
\ No newline at end of file
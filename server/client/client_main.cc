@@ -10,9 +10,11 @@
 #include "object.h"
 #include "json/json.hpp"
 #include "perf.h"
+#include "trace.h"
 
 #include "client_gl.h"
 #include "client_audio.h"
+#include "client_bundles.h"
 #include "global.h"
 
 #include "objects.h"
@@ -33,6 +35,9 @@ extern "C" {
     EMSCRIPTEN_KEEPALIVE
     ClientAudio clientAudio(game);
 
+    EMSCRIPTEN_KEEPALIVE
+    ClientBundles clientBundles(game);
+
     EMSCRIPTEN_KEEPALIVE
     std::deque<JSONDocument> inputEvents;
 
@@ -202,6 +207,8 @@ extern "C" {
         object.Parse(settings);
         GlobalSettings.ProcessReplication(object["globalSettings"]);
         game.LoadMap(GlobalSettings.MapPath);
+        // Textures outside the core package show placeholders until this lands
+        clientBundles.RequestMap(GlobalSettings.MapPath);
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -211,6 +218,13 @@ extern "C" {
         arr[1] = result.y;
     }
 
+    // Asked after each replication, true when the server should send the
+    //   full relationship list again
+    EMSCRIPTEN_KEEPALIVE
+    bool TakeRelationshipResyncRequest() {
+        return game.GetRelationshipManager().TakeResyncRequest();
+    }
+
     EMSCRIPTEN_KEEPALIVE
     void HandleReplicate(const char* input) {
         // LOG_DEBUG("Handle Replicate");
@@ -370,7 +384,180 @@ extern "C" {
 
     EMSCRIPTEN_KEEPALIVE
     void Draw(int width, int height) {
+        TRACE_SCOPE("Draw");
         clientGl.Draw(width, height);
+        clientBundles.OnFrame();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* GetRenderStats() {
+        const CullingStats& culling = clientGl.GetCullingStats();
+        const RenderStats& render = clientGl.worldRenderer.GetRenderStats();
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer writer(buffer);
+
+        writer.StartObject();
+        writer.Key("objectsTested");
+        writer.Uint64(culling.objectsTested);
+        writer.Key("objectsCulled");
+        writer.Uint64(culling.objectsCulled);
+        writer.Key("objectsDrawn");
+        writer.Uint64(culling.objectsDrawn);
+        writer.Key("staticNodesVisited");
+        writer.Uint64(culling.staticNodesVisited);
+        writer.Key("drawCalls");
+        writer.Uint64(render.drawCalls);
+        writer.Key("instancedDrawCalls");
+        writer.Uint64(render.instancedDrawCalls);
+        writer.Key("instances");
+        writer.Uint64(render.instances);
+        writer.Key("shadowDrawCalls");
+        writer.Uint64(render.shadowDrawCalls);
+        writer.Key("shadowCastersCulled");
+        writer.Uint64(render.shadowCastersCulled);
+        writer.Key("clusteredLights");
+        writer.Uint64(render.clusteredLights);
+        writer.Key("lightPasses");
+        writer.Uint64(render.lightPasses);
+        writer.Key("clusterLightIndices");
+        writer.Uint64(render.clusterLightIndices);
+        writer.Key("shadowMs");
+        writer.Double(render.shadowMs);
+        writer.Key("shadowCacheUpdates");
+        writer.Uint64(render.shadowCacheUpdates);
+        writer.Key("shadowCascadesCached");
+        writer.Uint64(render.shadowCascadesCached);
+        writer.Key("shadowCascadesSkipped");
+        writer.Uint64(render.shadowCascadesSkipped);
+        writer.Key("bloomHighPassMs");
+        writer.Double(render.bloomHighPassMs);
+        writer.Key("bloomDownsampleMs");
+        writer.Double(render.bloomDownsampleMs);
+        writer.Key("bloomUpsampleMs");
+        writer.Double(render.bloomUpsampleMs);
+        writer.Key("postProcessPasses");
+        writer.Uint64(render.postProcessPasses);
+        writer.Key("postProcessTargets");
+        writer.Uint64(render.postProcessTargets);
+        writer.Key("postProcessMegabytes");
+        writer.Double(render.postProcessMegabytes);
+        writer.EndObject();
+
+        size_t length = buffer.GetSize() + 1;
+        char* writable = new char[length];
+        std::copy_n(buffer.GetString(), length, writable);
+        writable[length - 1] = 0;
+        return writable;
+    }
+
+    // Voice pool counters from the last frame
+    EMSCRIPTEN_KEEPALIVE
+    const char* GetAudioStats() {
+        const VoiceStats& stats = clientAudio.GetStats();
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer writer(buffer);
+
+        writer.StartObject();
+        writer.Key("requested");
+        writer.Uint64(stats.requested);
+        writer.Key("coalesced");
+        writer.Uint64(stats.coalesced);
+        writer.Key("culled");
+        writer.Uint64(stats.culled);
+        writer.Key("started");
+        writer.Uint64(stats.started);
+        writer.Key("stolen");
+        writer.Uint64(stats.stolen);
+        writer.Key("dropped");
+        writer.Uint64(stats.dropped);
+        writer.Key("active");
+        writer.Uint64(stats.active);
+        writer.Key("streaming");
+        writer.Uint64(stats.streaming);
+        writer.EndObject();
+
+        size_t length = buffer.GetSize() + 1;
+        char* writable = new char[length];
+        std::copy_n(buffer.GetString(), length, writable);
+        writable[length - 1] = 0;
+        return writable;
+    }
+
+    // Per pass GPU and CPU time of the world renderer
+    EMSCRIPTEN_KEEPALIVE
+    const char* GetRenderProfile() {
+        const GPUProfiler& profiler = clientGl.worldRenderer.GetProfiler();
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer writer(buffer);
+
+        writer.StartObject();
+        writer.Key("gpuTimerSupported");
+        writer.Bool(GPUTimer::supported);
+        writer.Key("gpuTotalMs");
+        writer.Double(profiler.GetGPUTotal());
+        writer.Key("cpuTotalMs");
+        writer.Double(profiler.GetCPUTotal());
+        writer.Key("passes");
+        writer.StartArray();
+        for (auto& pass : profiler.GetPasses()) {
+            if (!pass->active) continue;
+            writer.StartObject();
+            writer.Key("name");
+            writer.String(pass->name.c_str());
+            writer.Key("gpuMs");
+            writer.Double(pass->timer.GetMilliseconds());
+            writer.Key("cpuMs");
+            writer.Double(pass->cpuMilliseconds);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+
+        size_t length = buffer.GetSize() + 1;
+        char* writable = new char[length];
+        std::copy_n(buffer.GetString(), length, writable);
+        writable[length - 1] = 0;
+        return writable;
+    }
+
+    // Startup benchmark, times are milliseconds since navigation
+    EMSCRIPTEN_KEEPALIVE
+    const char* GetLoadTimings() {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer writer(buffer);
+
+        writer.StartObject();
+        writer.Key("firstFrameMs");
+        writer.Double(clientBundles.GetFirstFrameMs());
+        writer.Key("mapReadyMs");
+        writer.Double(clientBundles.GetMapReadyMs());
+        writer.Key("mapFailed");
+        writer.Bool(clientBundles.IsMapFailed());
+        writer.Key("bundleBytes");
+        writer.Uint64(clientBundles.GetDownloadedBytes());
+        writer.Key("pendingTextures");
+        writer.Uint64(clientBundles.GetPendingTextureCount());
+        writer.EndObject();
+
+        size_t length = buffer.GetSize() + 1;
+        char* writable = new char[length];
+        std::copy_n(buffer.GetString(), length, writable);
+        writable[length - 1] = 0;
+        return writable;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void SetTracing(bool enabled) {
+        Trace::SetEnabled(enabled);
+    }
+
+    // Chrome trace JSON of the spans recorded so far
+    EMSCRIPTEN_KEEPALIVE
+    const char* GetTrace() {
+        std::string trace = Trace::ToChromeJSON(Trace::TakeSnapshot());
+        char* writable = new char[trace.size() + 1];
+        std::copy_n(trace.c_str(), trace.size() + 1, writable);
+        return writable;
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -0,0 +1,166 @@
+#include "voice_manager.h"
+
+#include <algorithm>
+
+VoiceManager::~VoiceManager() {
+    for (Voice& voice : voices) {
+        voice.stream.reset();
+        alDeleteSources(1, &voice.source);
+    }
+}
+
+void VoiceManager::Initialize(size_t voiceCount) {
+    voices.resize(voiceCount);
+    for (Voice& voice : voices) {
+        alGenSources(1, &voice.source);
+        alSourcef(voice.source, AL_PITCH, 1);
+        alSource3f(voice.source, AL_VELOCITY, 0, 0, 0);
+        alSourcei(voice.source, AL_LOOPING, AL_FALSE);
+        alSourcef(voice.source, AL_REFERENCE_DISTANCE, referenceDistance);
+        alSourcef(voice.source, AL_ROLLOFF_FACTOR, rolloffFactor);
+    }
+}
+
+void VoiceManager::Play(const VoiceRequest& request) {
+    if (!request.audio) return;
+    requests.push_back(request);
+}
+
+float VoiceManager::GetAudibleGain(const VoiceRequest& request) const {
+    float distance = std::max(glm::distance(request.position, listener), referenceDistance);
+    return request.gain * referenceDistance /
+        (referenceDistance + rolloffFactor * (distance - referenceDistance));
+}
+
+// Priority first, then how loud it is where the listener is
+static bool MoreImportant(int priorityA, float gainA, int priorityB, float gainB) {
+    if (priorityA != priorityB) return priorityA > priorityB;
+    return gainA > gainB;
+}
+
+void VoiceManager::Start(Voice& voice, const VoiceRequest& request, Time now) {
+    // Also covers a source our clock thinks has ended a little early. Without
+    //   its buffer the source can take a static clip or queue a stream
+    alSourceStop(voice.source);
+    alSourcei(voice.source, AL_BUFFER, 0);
+    if (voice.stream) {
+        voice.stream->Stop();
+    }
+    Audio* audio = request.audio;
+    if (audio->streamed) {
+        if (!voice.stream) {
+            voice.stream = std::make_unique<AudioStream>();
+        }
+        if (!voice.stream->Start(voice.source, *audio)) {
+            LOG_ERROR("Could not stream " << audio->path);
+            voice.active = false;
+            return;
+        }
+    }
+    else {
+        alSourcei(voice.source, AL_BUFFER, audio->audioBuffer);
+    }
+    alSourcef(voice.source, AL_GAIN, request.gain);
+    alSource3f(voice.source, AL_POSITION, request.position.x, request.position.y, request.position.z);
+    alSourcePlay(voice.source);
+
+    voice.active = true;
+    voice.request = request;
+    voice.endTime = now + (audio->sampleRate ? audio->frames * 1000 / audio->sampleRate : 0);
+    stats.started++;
+}
+
+void VoiceManager::Update(Time now, const Vector3& listenerPosition) {
+    listener = listenerPosition;
+    stats = VoiceStats{};
+    stats.requested = requests.size();
+
+    for (Voice& voice : voices) {
+        if (!voice.active) continue;
+        if (voice.request.audio->streamed) {
+            voice.active = voice.stream->Refill();
+        }
+        else if (now >= voice.endTime) {
+            voice.active = false;
+        }
+    }
+
+    // A burst of the same sound in one place is heard as one, the loudest
+    for (size_t i = 0; i < requests.size(); i++) {
+        VoiceRequest& kept = requests[i];
+        for (size_t j = i + 1; j < requests.size();) {
+            VoiceRequest& other = requests[j];
+            bool sameSound = other.audio == kept.audio && other.boundObject == kept.boundObject &&
+                glm::distance2(other.position, kept.position) <= coalesceDistance * coalesceDistance;
+            if (!sameSound) {
+                j++;
+                continue;
+            }
+            kept.gain = std::max(kept.gain, other.gain);
+            kept.priority = std::max(kept.priority, other.priority);
+            other = requests.back();
+            requests.pop_back();
+            stats.coalesced++;
+        }
+    }
+
+    // Most important first so stealing never takes a voice from a request
+    //   started this frame
+    std::vector<std::pair<float, VoiceRequest*>> audible;
+    audible.reserve(requests.size());
+    for (VoiceRequest& request : requests) {
+        float gain = GetAudibleGain(request);
+        if (gain < minAudibleGain) {
+            stats.culled++;
+            continue;
+        }
+        audible.emplace_back(gain, &request);
+    }
+    std::sort(audible.begin(), audible.end(), [](const auto& a, const auto& b) {
+        return MoreImportant(a.second->priority, a.first, b.second->priority, b.first);
+    });
+
+    for (size_t i = 0; i < audible.size(); i++) {
+        auto& [gain, request] = audible[i];
+        Voice* target = nullptr;
+        int targetPriority = 0;
+        float targetGain = 0;
+        for (Voice& voice : voices) {
+            if (!voice.active) {
+                target = &voice;
+                break;
+            }
+            int priority = voice.request.priority;
+            float voiceGain = GetAudibleGain(voice.request);
+            if (MoreImportant(request->priority, gain, priority, voiceGain) &&
+                (!target || MoreImportant(targetPriority, targetGain, priority, voiceGain))) {
+                target = &voice;
+                targetPriority = priority;
+                targetGain = voiceGain;
+            }
+        }
+        // Every voice already outranks this request, and so every request
+        //   after it
+        if (!target) {
+            stats.dropped += audible.size() - i;
+            break;
+        }
+        if (target->active) {
+            stats.stolen++;
+        }
+        Start(*target, *request, now);
+    }
+    requests.clear();
+
+    for (Voice& voice : voices) {
+        if (!voice.active) continue;
+        stats.active++;
+        const VoiceRequest& request = voice.request;
+        if (request.audio->streamed) {
+            stats.streaming++;
+        }
+        if (request.boundObject != VoiceRequest::NoObject) {
+            alSource3f(voice.source, AL_POSITION, request.position.x, request.position.y, request.position.z);
+        }
+    }
+}
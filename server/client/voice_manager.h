@@ -0,0 +1,94 @@
+#pragma once
+
+#include "logging.h"
+#include "audio.h"
+#include "timer.h"
+#include "vector.h"
+#include "audio_stream.h"
+
+#include <memory>
+#include <vector>
+
+// A sound to start on the next Update
+struct VoiceRequest {
+    Audio* audio = nullptr;
+    float gain = 1.0f;
+    Vector3 position;
+    // Object the sound follows while it plays, NoObject if it stays put
+    uint32_t boundObject = NoObject;
+    // A higher priority always gets a voice over a lower one, audibility
+    //   decides between equal priorities
+    int priority = 0;
+
+    static const uint32_t NoObject = (uint32_t) -1;
+};
+
+// One preallocated OpenAL source
+struct Voice {
+    ALuint source = 0;
+    bool active = false;
+    VoiceRequest request;
+    // When the sound runs out, sources aren't polled for their state
+    Time endTime = 0;
+    // Made the first time the voice plays a streamed clip, which ends when
+    //   the stream does instead
+    std::unique_ptr<AudioStream> stream;
+};
+
+// Counted per Update
+struct VoiceStats {
+    size_t requested = 0;
+    // Merged into a request for the same sound in the same place
+    size_t coalesced = 0;
+    // Too quiet at the listener to be worth a voice
+    size_t culled = 0;
+    size_t started = 0;
+    // Started by stopping a less important voice
+    size_t stolen = 0;
+    // Every voice was busy with something more important
+    size_t dropped = 0;
+    size_t active = 0;
+    // Active voices playing a streamed clip
+    size_t streaming = 0;
+};
+
+// Plays sounds on a fixed pool of sources instead of a source per sound.
+//   Requests are coalesced and culled by their gain at the listener before
+//   they compete for a voice, the least important playing voice is stolen
+//   when the pool is full.
+class VoiceManager {
+    std::vector<Voice> voices;
+    std::vector<VoiceRequest> requests;
+    VoiceStats stats;
+    Vector3 listener;
+
+    void Start(Voice& voice, const VoiceRequest& request, Time now);
+
+public:
+    static const size_t DefaultVoiceCount = 32;
+
+    // Attenuation of the sources, inverse distance clamped (the OpenAL
+    //   default model), used to judge audibility the same way
+    float referenceDistance = 2.0f;
+    float rolloffFactor = 1.0f;
+    // Sounds quieter than this at the listener are dropped before playing
+    float minAudibleGain = 0.01f;
+    // Same sound requests closer than this in one frame play once
+    float coalesceDistance = 1.0f;
+
+    ~VoiceManager();
+
+    // Needs a current OpenAL context
+    void Initialize(size_t voiceCount = DefaultVoiceCount);
+
+    void Play(const VoiceRequest& request);
+    // Starts the requests since the last Update, refills streams and moves
+    //   bound voices to their request's position, call once per frame
+    void Update(Time now, const Vector3& listenerPosition);
+
+    // Gain left after distance attenuation
+    float GetAudibleGain(const VoiceRequest& request) const;
+
+    std::vector<Voice>& GetVoices() { return voices; }
+    const VoiceStats& GetStats() const { return stats; }
+};
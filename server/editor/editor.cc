@@ -18,6 +18,10 @@ Editor::Editor(GLFWwindow* window, const std::string& path) :
     renderer.Initialize();
 }
 
+Editor::~Editor() {
+    UpdateBenchmarkLights(0);
+}
+
 void Editor::DrawGridMesh() {
     // Grid from -100 to 100
     const int size = 100;
@@ -38,6 +42,67 @@ void Editor::DrawGridMesh() {
     }
 }
 
+void Editor::UpdateBenchmarkLights(size_t count) {
+    if (benchmarkLights.size() == count) return;
+
+    for (auto& light : benchmarkLights) delete light;
+    for (auto& node : benchmarkLightNodes) delete node;
+    benchmarkLights.clear();
+    benchmarkLightNodes.clear();
+
+    // Grid of overlapping point lights on the ground plane around the origin
+    const float spacing = 4.0f;
+    const float radius = 6.0f;
+    size_t side = (size_t) std::ceil(std::sqrt((float) count));
+    for (size_t i = 0; i < count; i++) {
+        LightNode* node = new LightNode;
+        node->shape = LightShape::Point;
+        node->strength = 4.0f;
+        node->color = Vector3(
+            0.5f + 0.5f * std::sin(i * 1.3f),
+            0.5f + 0.5f * std::sin(i * 2.1f + 2.0f),
+            0.5f + 0.5f * std::sin(i * 3.7f + 4.0f));
+        benchmarkLightNodes.push_back(node);
+
+        Vector3 position(
+            ((float) (i % side) - side * 0.5f) * spacing,
+            1.0f,
+            ((float) (i / side) - side * 0.5f) * spacing);
+        TransformedLight* light = new TransformedLight;
+        light->node = node;
+        light->transform = glm::translate(position) * glm::scale(Vector3(radius * 2));
+        light->transformedPosition = position;
+        light->transformedDirection = Vector::Forward;
+        benchmarkLights.push_back(light);
+    }
+}
+
+void Editor::PushBenchmarkDraws(size_t count) {
+    std::vector<Mesh*> meshes;
+    for (auto& model : GetScene().assetManager.models) {
+        meshes.insert(meshes.end(), model->meshes.begin(), model->meshes.end());
+    }
+    if (meshes.empty()) return;
+
+    // Grid on the ground plane around the origin, cycling through every mesh
+    //   so the sort sees a realistic spread of materials
+    const float spacing = 3.0f;
+    size_t side = (size_t) std::ceil(std::sqrt((float) count));
+    for (size_t i = 0; i < count; i++) {
+        Mesh* mesh = meshes[i % meshes.size()];
+        Vector3 position(
+            ((float) (i % side) - side * 0.5f) * spacing,
+            0.0f,
+            ((float) (i / side) - side * 0.5f) * spacing);
+        float depth = glm::distance2(position, viewPos);
+        DrawParams& params = mesh->material->IsTransparent() ?
+            layer.PushTransparent(depth) : layer.PushOpaque(depth);
+        params.mesh = mesh;
+        params.transform = glm::translate(position);
+        params.castShadows = false;
+    }
+}
+
 void Editor::DrawScene(int width, int height) {
     // Render Scene
     // ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
@@ -105,7 +170,7 @@ void Editor::DrawScene(int width, int height) {
 
     size_t lightNodeCount = 0;
 
-    DrawLayer layer;
+    layer.Clear();
     for (auto& transformed : nodes) {
         Node* node = transformed.node;
         if (StaticModelNode* model_node = dynamic_cast<StaticModelNode*>(node)) {
@@ -120,10 +185,12 @@ void Editor::DrawScene(int width, int height) {
                     params.hasOutline = model_node == GetSelectedNode();
                 }
                 else {
-                    DrawParams& params = layer.PushOpaque(mesh->material);
+                    DrawParams& params = layer.PushOpaque(
+                        glm::distance2(centerPt, viewPos));
                     params.mesh = mesh;
                     params.transform = transformed.transform;
                     params.castShadows = true;
+                    params.isStatic = true;
                     params.hasOutline = model_node == GetSelectedNode();
                 }
             }
@@ -163,7 +230,7 @@ void Editor::DrawScene(int width, int height) {
                         transform = obj->GetTransform();
                     }
                     for (auto& mesh : model->meshes) {
-                        DrawParams& params = layer.PushOpaque(mesh->material);
+                        DrawParams& params = layer.PushOpaque();
                         params.mesh = mesh;
                         params.transform = transform;
                         params.castShadows = false;
@@ -189,6 +256,11 @@ void Editor::DrawScene(int width, int height) {
 
     parameters.lights = lights;
 
+    PushBenchmarkDraws(render_settings_window.benchmarkDrawCount);
+    UpdateBenchmarkLights(render_settings_window.benchmarkLightCount);
+    parameters.lights.insert(parameters.lights.end(),
+        benchmarkLights.begin(), benchmarkLights.end());
+
     renderer.NewFrame(&parameters);
     renderer.Draw({ &layer });
     renderer.EndFrame();
@@ -247,6 +319,9 @@ void Editor::DrawUI(int width, int height) {
             ImGui::MenuItem(
                 "Render Settings", NULL,
                 &render_settings_window.isVisible, true);
+            ImGui::MenuItem(
+                "Render Profiler", NULL,
+                &render_profiler_window.isVisible, true);
 
             ImGui::EndMenu();
         }
@@ -257,9 +332,11 @@ void Editor::DrawUI(int width, int height) {
     scene_data_window.Draw(*this);
     scene_graph_window.Draw(*this);
     render_settings_window.Draw(*this);
+    render_profiler_window.Draw(*this);
 }
 
 void Editor::Draw(int width, int height) {
+    game.GetAssetManager().textureStreamer.Update();
     DrawScene(width, height);
     DrawUI(width, height);
 }
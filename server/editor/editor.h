@@ -15,6 +15,7 @@
 #include "scene_data_window.h"
 #include "scene_graph_window.h"
 #include "render_settings_window.h"
+#include "render_profiler_window.h"
 #include "game.h"
 
 // Primary Editor Class
@@ -43,6 +44,18 @@ struct Editor {
 
     std::vector<TransformedLight*> lights;
 
+    // Synthetic point lights for measuring how lighting scales with light count
+    std::vector<LightNode*> benchmarkLightNodes;
+    std::vector<TransformedLight*> benchmarkLights;
+    void UpdateBenchmarkLights(size_t count);
+
+    // Synthetic draws for measuring how sorting and submission scale with
+    //   draw count
+    void PushBenchmarkDraws(size_t count);
+
+    // Reused every frame to keep its storage
+    DrawLayer layer;
+
     void DrawGridMesh();
 
     Quaternion GetRotationQuat(Vector2 dir) {
@@ -61,8 +74,10 @@ struct Editor {
     SceneDataWindow scene_data_window;
     SceneGraphWindow scene_graph_window;
     RenderSettingsWindow render_settings_window;
+    RenderProfilerWindow render_profiler_window;
 
     Editor(GLFWwindow* window, const std::string& path);
+    ~Editor();
 
     void Draw(int width, int height);
 
@@ -73,6 +73,7 @@ int main(int argc, char* argv[]) {
         fprintf(stderr, "Failed to initialize OpenGL loader!\n");
         return 1;
     }
+    TextureStreamer::compressionSupported = glfwExtensionSupported("GL_EXT_texture_compression_s3tc");
 
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback(MessageCallback, 0);
@@ -0,0 +1,47 @@
+#include "render_profiler_window.h"
+#include "editor.h"
+
+void RenderProfilerWindow::Draw(Editor& editor) {
+    if (!isVisible) return;
+    ImGui::Begin("Render Profiler", &isVisible, ImGuiWindowFlags_NoCollapse);
+
+    GPUProfiler& profiler = editor.renderer.GetProfiler();
+    ImGui::Checkbox("Enable Profiler", &profiler.enabled);
+    if (!GPUTimer::supported) {
+        ImGui::Text("Timer queries unsupported, GPU times unavailable");
+    }
+    ImGui::Separator();
+
+    if (ImGui::BeginTable("Passes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        ImGui::TableSetupColumn("Pass");
+        ImGui::TableSetupColumn("GPU ms");
+        ImGui::TableSetupColumn("CPU ms");
+        ImGui::TableHeadersRow();
+        for (auto& pass : profiler.GetPasses()) {
+            if (!pass->active) continue;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", pass->name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", pass->timer.GetMilliseconds());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", pass->cpuMilliseconds);
+        }
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("Total");
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", profiler.GetGPUTotal());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", profiler.GetCPUTotal());
+        ImGui::EndTable();
+    }
+
+    ImGui::Separator();
+    TextureStreamer& streamer = editor.GetScene().assetManager.textureStreamer;
+    ImGui::Text("Packed Textures: %.1f MB resident, %zu streaming%s",
+        streamer.GetResidentBytes() / (1024.0 * 1024.0), streamer.GetPendingCount(),
+        TextureStreamer::compressionSupported ? "" : " (S3TC unsupported, decoded)");
+
+    ImGui::End();
+}
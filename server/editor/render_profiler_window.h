@@ -0,0 +1,11 @@
+#pragma once
+
+class Editor;
+
+// Per pass GPU and CPU timings from the renderer's profiler
+class RenderProfilerWindow {
+public:
+    bool isVisible = true;
+
+    void Draw(Editor& editor);
+};
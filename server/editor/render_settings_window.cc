@@ -16,9 +16,12 @@ void RenderSettingsWindow::Draw(Editor& editor) {
     ImGui::Separator();
     ImGui::Checkbox("Enable Lighting", &parameters.enableLighting);
     ImGui::Checkbox("Enable Shadows", &parameters.enableShadows);
+    ImGui::Checkbox("Cache Static Shadows", &parameters.enableShadowCaching);
+    ImGui::SliderInt("Far Cascade Update Interval", &parameters.farCascadeUpdateInterval, 1, 8);
     ImGui::Separator();
     ImGui::Checkbox("Enable Bloom", &parameters.enableBloom);
     ImGui::DragFloat("Bloom Threshold", &parameters.bloomThreshold, 0.01f, 0.0f, 10.0f);
+    ImGui::SliderInt("Bloom Levels", &parameters.bloomLevels, 1, 8);
     ImGui::Separator();
     ImGui::Checkbox("Enable Tone Mapping", &parameters.enableToneMapping);
     ImGui::DragFloat("Tone Mapping Exposure", &parameters.exposure, 0.01f, 0.01f, 10.0f);
@@ -29,6 +32,25 @@ void RenderSettingsWindow::Draw(Editor& editor) {
     ImGui::DragFloat("Min Reduce Reciprocal", &parameters.fxaaMinReduceReciprocal, 1.0f, 0.0f, 512.0f);
     ImGui::DragFloat("Max Span", &parameters.fxaaMaxSpan, 0.0f, 0.0f, 100.0f);
     ImGui::Separator();
+    ImGui::Checkbox("Enable Instancing", &parameters.enableInstancing);
+    const RenderStats& stats = editor.renderer.GetRenderStats();
+    ImGui::Text("Draw Calls: %zu (Shadow: %zu)", stats.drawCalls, stats.shadowDrawCalls);
+    ImGui::Text("Instanced Draw Calls: %zu (%zu instances)", stats.instancedDrawCalls, stats.instances);
+    ImGui::SliderInt("Benchmark Draws", &benchmarkDrawCount, 0, 100000);
+    ImGui::Text("Sort CPU: %.3f ms, Submit CPU: %.3f ms", stats.sortMs, stats.submitMs);
+    ImGui::Separator();
+    ImGui::Checkbox("Enable Clustered Lighting", &parameters.enableClusteredLighting);
+    ImGui::SliderInt("Benchmark Lights", &benchmarkLightCount, 0, LightClusters::MaxLights);
+    ImGui::Text("Clustered Lights: %zu (%zu indices)", stats.clusteredLights, stats.clusterLightIndices);
+    ImGui::Text("Light Passes: %zu", stats.lightPasses);
+    ImGui::Text("Frame Time: %.2f ms", 1000.0f / ImGui::GetIO().Framerate);
+    ImGui::Text("Shadow GPU: %.3f ms, %zu cached, %zu redrawn, %zu skipped cascades",
+        stats.shadowMs, stats.shadowCascadesCached, stats.shadowCacheUpdates, stats.shadowCascadesSkipped);
+    ImGui::Text("Bloom GPU: %.3f ms high pass, %.3f ms down, %.3f ms up",
+        stats.bloomHighPassMs, stats.bloomDownsampleMs, stats.bloomUpsampleMs);
+    ImGui::Text("Post Processing: %zu passes, %zu targets, %.1f MB",
+        stats.postProcessPasses, stats.postProcessTargets, stats.postProcessMegabytes);
+    ImGui::Separator();
     GBuffer& worldGBuffer = editor.renderer.GetGBuffer();
     GBuffer& transparencyGBuffer = editor.renderer.GetTransparencyGBuffer();
     ImVec2 uv_min = ImVec2(0.0f, 1.0f);                 // Top-left
@@ -76,8 +98,21 @@ void RenderSettingsWindow::Draw(Editor& editor) {
         ImGui::TreePop();
     }
     if (ImGui::TreeNode("Bloom")) {
-        RenderBuffer& bloomBuffer = editor.renderer.GetBloomShader()->bloomBuffer;
-        ImGui::Image((ImTextureID)bloomBuffer.textureColor, size, uv_min, uv_max, tint_col, border_col);
+        BloomShader* bloomShader = editor.renderer.GetBloomShader();
+        GLuint bloomTexture = bloomShader->GetBloomTexture();
+        ImGui::Image((ImTextureID)bloomTexture, size, uv_min, uv_max, tint_col, border_col);
+        if (ImGui::Button("Compare With Gaussian Blur")) {
+            bloomShader->RequestComparison();
+        }
+        const BloomComparison& comparison = bloomShader->GetComparison();
+        if (comparison.valid) {
+            ImGui::Text("%dx%d, energy %.1f against %.1f (%.3f)",
+                comparison.width, comparison.height,
+                comparison.pyramidEnergy, comparison.referenceEnergy,
+                comparison.referenceEnergy > 0 ? comparison.pyramidEnergy / comparison.referenceEnergy : 0.0);
+            ImGui::Text("Difference: %.4f mean, %.4f max",
+                comparison.meanDifference, comparison.maxDifference);
+        }
         ImGui::TreePop();
     }
 
@@ -105,8 +140,8 @@ void RenderSettingsWindow::Draw(Editor& editor) {
 
     }
     if (ImGui::TreeNode("Final")) {
-        RenderBuffer& final = editor.renderer.GetOutputBuffer();
-        ImGui::Image((ImTextureID)final.textureColor, size, uv_min, uv_max, tint_col, border_col);
+        GLuint final = editor.renderer.GetRenderedTexture();
+        ImGui::Image((ImTextureID)final, size, uv_min, uv_max, tint_col, border_col);
         ImGui::TreePop();
     }
     ImGui::End();
@@ -10,6 +10,10 @@ public:
     RenderSettingsWindow();
     bool isVisible = true;
     bool lockShadowMapToViewport = true;
+    // Extra point lights spawned by the editor, see Editor::UpdateBenchmarkLights
+    int benchmarkLightCount = 0;
+    // Extra draws pushed by the editor, see Editor::PushBenchmarkDraws
+    int benchmarkDrawCount = 0;
 
     RenderFrameParameters parameters;
 
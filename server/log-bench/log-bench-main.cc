@@ -0,0 +1,124 @@
+#include "logging.h"
+#include "timer.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures how many messages a second the logger takes from several threads,
+//   and what logging costs a tick that spawns objects, against writing and
+//   flushing every line on the calling thread the way LOG_* used to
+
+static std::ofstream* synchronousOutput = nullptr;
+
+// The old LOG_DEBUG, formatted straight into the stream and flushed by
+//   std::endl
+#define SYNCHRONOUS_DEBUG(...) *synchronousOutput << "[00:00:00] \033[36m[DEBUG]\033[0m " << __VA_ARGS__ << std::endl
+
+// Something for a tick to do besides logging, the same every run
+static float Work(size_t amount) {
+    float sum = 0;
+    for (size_t i = 0; i < amount; i++) {
+        sum += std::sqrt((float) i);
+    }
+    return sum;
+}
+
+static void Throughput(size_t threads, size_t messages) {
+    Log::Flush();
+    uint64_t droppedBefore = Log::GetDroppedCount();
+    Time start = Timer::NowMicro();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([t, messages]() {
+            for (size_t i = 0; i < messages; i++) {
+                LOG_INFO("Thread " << t << " message " << i << " at " << Vector3(i, t, 0.5f));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    Time queued = Timer::NowMicro() - start;
+    Log::Flush();
+    Time written = Timer::NowMicro() - start;
+
+    size_t total = threads * messages;
+    uint64_t dropped = Log::GetDroppedCount() - droppedBefore;
+    std::cout << threads << " threads, " << total << " messages: " << (total * 1e6 / queued)
+        << " queued/s, " << ((total - dropped) * 1e6 / written) << " written/s, " << dropped << " dropped" << std::endl;
+}
+
+static void ReportTicks(const std::string& name, std::vector<Time> ticks) {
+    std::sort(ticks.begin(), ticks.end());
+    double mean = 0;
+    for (Time tick : ticks) mean += tick;
+    mean /= ticks.size();
+    std::cout << std::left << std::setw(22) << name << " mean " << std::setw(8) << mean
+        << " p50 " << std::setw(6) << ticks[ticks.size() / 2]
+        << " p99 " << std::setw(6) << ticks[ticks.size() * 99 / 100]
+        << " max " << ticks.back() << " us" << std::endl;
+}
+
+// A tick that spawns and destroys objects, each logging a line like
+//   FlushNewObjects and DestroyObject do
+static std::vector<Time> Ticks(size_t ticks, size_t spawnsPerTick, std::function<void(size_t, void*)> log) {
+    std::vector<Time> times;
+    float sink = 0;
+    for (size_t tick = 0; tick < ticks; tick++) {
+        Time start = Timer::NowMicro();
+        for (size_t i = 0; i < spawnsPerTick; i++) {
+            sink += Work(200);
+            log(tick * spawnsPerTick + i, &sink);
+        }
+        times.push_back(Timer::NowMicro() - start);
+    }
+    Log::Flush();
+    if (sink < 0) std::cout << sink << std::endl;
+    return times;
+}
+
+int main(int argc, char** argv) {
+    size_t messages = argc > 1 ? std::stoul(argv[1]) : 200000;
+    size_t threads = argc > 2 ? std::stoul(argv[2]) : 4;
+    std::string path = argc > 3 ? argv[3] : "log-bench.log";
+    const size_t ticks = 2000;
+    const size_t spawnsPerTick = 50;
+
+    FILE* output = std::fopen(path.c_str(), "w");
+    if (!output) {
+        LOG_ERROR("Could not open " << path);
+        return 1;
+    }
+    std::ofstream synchronous(path, std::ios::app);
+    synchronousOutput = &synchronous;
+    Log::SetOutput(output);
+
+    Throughput(1, messages);
+    Throughput(threads, messages / threads);
+
+    std::cout << ticks << " ticks spawning " << spawnsPerTick << " objects each:" << std::endl;
+    ReportTicks("no logging", Ticks(ticks, spawnsPerTick, [](size_t, void*) {}));
+    ReportTicks("synchronous", Ticks(ticks, spawnsPerTick, [](size_t id, void* object) {
+        SYNCHRONOUS_DEBUG("Flush New Object (" << object << ") " << id);
+    }));
+    ReportTicks("queued", Ticks(ticks, spawnsPerTick, [](size_t id, void* object) {
+        LOG_DEBUG("Flush New Object (" << object << ") " << id);
+    }));
+    ReportTicks("queued, rate limited", Ticks(ticks, spawnsPerTick, [](size_t id, void* object) {
+        LOG_LIMITED(Debug, 20, "Flush New Object (" << object << ") " << id);
+    }));
+    Log::SetLevel(LogLevel::Info);
+    ReportTicks("filtered by level", Ticks(ticks, spawnsPerTick, [](size_t id, void* object) {
+        LOG_DEBUG("Flush New Object (" << object << ") " << id);
+    }));
+
+    Log::SetOutput(stdout);
+    std::fclose(output);
+    return 0;
+}
@@ -1,40 +1,185 @@
 #include "bloom.h"
+#include "logging.h"
 
-GLuint BloomShader::BloomTexture(GLuint texture, float threshold, int width, int height) {
-    // width /= 2;
-    // height /= 2;
-    glDisable(GL_DEPTH_TEST);
-    bloomBuffer.SetSize(width, height);
+#include <algorithm>
+#include <cmath>
 
-    blurShader.Use();
-    blurShader.SetTextureSize(width, height);
+void BloomShader::SetupLevels(int width, int height, int levelCount) {
+    // Levels stop before a side gets under 2 texels, compared against what
+    //   was asked for a small target would be rebuilt every frame
+    int buildable = 0;
+    for (int w = width / 2, h = height / 2; buildable < levelCount && w >= 2 && h >= 2; w /= 2, h /= 2) {
+        buildable++;
+    }
+    if (width == levelsWidth && height == levelsHeight &&
+        (int) levels.size() == buildable) {
+        return;
+    }
+    levelsWidth = width;
+    levelsHeight = height;
+
+    for (auto& level : levels) {
+        glDeleteFramebuffers(1, &level.fbo);
+        glDeleteTextures(1, &level.texture);
+    }
+    levels.clear();
+
+    int levelWidth = width / 2;
+    int levelHeight = height / 2;
+    for (int i = 0; i < buildable; i++) {
+        Level level;
+        SetupLevel(level, levelWidth, levelHeight);
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            LOG_ERROR("Could not setup bloom level " << i << "! Status: " << status);
+        }
+
+        levels.push_back(level);
+        levelWidth /= 2;
+        levelHeight /= 2;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void BloomShader::SetupLevel(Level& level, int width, int height) {
+    level.width = width;
+    level.height = height;
+
+    // Linear filtering does part of the work of the down and up sample taps
+    glGenTextures(1, &level.texture);
+    glBindTexture(GL_TEXTURE_2D, level.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &level.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, level.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, level.texture, 0);
+}
+
+std::vector<float> BloomShader::ReadLevel(const Level& level) {
+    std::vector<float> texels(level.width * level.height * 4);
+    glBindFramebuffer(GL_FRAMEBUFFER, level.fbo);
+    glReadPixels(0, 0, level.width, level.height, GL_RGBA, GL_FLOAT, texels.data());
+    return texels;
+}
 
-    bloomBuffer.Bind();
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+bool BloomShader::HighPass(GLuint texture, float threshold, int width, int height, int levelCount) {
+    SetupLevels(width, height, levelCount);
+    bytesMoved = 0;
+    if (levels.empty()) return false;
 
+    // Bright parts into the first level, 2x2 average of the full resolution input
+    glDisable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, levels[0].fbo);
+    glViewport(0, 0, levels[0].width, levels[0].height);
     highPassFilter.Use();
     highPassFilter.SetTextureSize(width, height);
     glUniform1f(uniformThreshold, threshold);
     highPassFilter.DrawQuad(texture, highPassFilter.standardRemapMatrix);
+    bytesMoved += LevelBytes(0);
+    return true;
+}
 
-    texture = bloomBuffer.SwapBuffers();
+void BloomShader::Downsample() {
+    if (levels.empty()) return;
+    // Progressive 13 tap downsample
+    glDisable(GL_BLEND);
+    downsampleShader.Use();
+    for (size_t i = 1; i < levels.size(); i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, levels[i].fbo);
+        glViewport(0, 0, levels[i].width, levels[i].height);
+        downsampleShader.SetTextureSize(levels[i - 1].width, levels[i - 1].height);
+        downsampleShader.DrawQuad(levels[i - 1].texture, downsampleShader.standardRemapMatrix);
+        bytesMoved += LevelBytes(i - 1) + LevelBytes(i);
+    }
+}
+
+void BloomShader::Upsample() {
+    if (levels.empty()) return;
+    // Tent filter each level up and add it onto the one above
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    upsampleShader.Use();
+    glUniform1f(uniformFilterRadius, 1.0f);
+    for (size_t i = levels.size() - 1; i > 0; i--) {
+        glBindFramebuffer(GL_FRAMEBUFFER, levels[i - 1].fbo);
+        glViewport(0, 0, levels[i - 1].width, levels[i - 1].height);
+        upsampleShader.SetTextureSize(levels[i].width, levels[i].height);
+        upsampleShader.DrawQuad(levels[i].texture, upsampleShader.standardRemapMatrix);
+        bytesMoved += LevelBytes(i) + LevelBytes(i - 1) * 2;
+    }
+    glDisable(GL_BLEND);
+}
+
+void BloomShader::Compare(GLuint texture, float threshold, int width, int height) {
+    comparisonRequested = false;
+    comparison = BloomComparison();
+    if (levels.empty()) return;
+
+    if (!referenceBlur) {
+        referenceBlur = new QuadShaderProgram("shaders/GaussianBlur.fs");
+        referenceBlur->Use();
+        uniformDirection = referenceBlur->GetUniformLocation("u_direction");
+    }
+    const Level& output = levels[0];
+    if (reference[0].width != output.width || reference[0].height != output.height) {
+        for (Level& level : reference) {
+            glDeleteFramebuffers(1, &level.fbo);
+            glDeleteTextures(1, &level.texture);
+            SetupLevel(level, output.width, output.height);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
 
-    blurShader.Use();
-    glUniform2f(uniformDirection, 0.0f, 1.0f);
-    for (size_t i = 0; i < 50; i++) {
-        bloomBuffer.Bind();
-        blurShader.DrawQuad(texture, blurShader.standardRemapMatrix);
+    // Same high pass as the pyramid starts from, the old one ran at full
+    //   resolution but the 2x2 average keeps what passes the same
+    glDisable(GL_BLEND);
+    glViewport(0, 0, output.width, output.height);
+    glBindFramebuffer(GL_FRAMEBUFFER, reference[0].fbo);
+    highPassFilter.Use();
+    highPassFilter.SetTextureSize(width, height);
+    glUniform1f(uniformThreshold, threshold);
+    highPassFilter.DrawQuad(texture, highPassFilter.standardRemapMatrix);
 
-        texture = bloomBuffer.SwapBuffers();
+    // The old 50 vertical then 50 horizontal passes. Offsets are in full
+    //   resolution texels so the blur covers the same part of the screen
+    referenceBlur->Use();
+    referenceBlur->SetTextureSize(width, height);
+    int current = 0;
+    for (int pass = 0; pass < 100; pass++) {
+        if (pass == 0) glUniform2f(uniformDirection, 0.0f, 1.0f);
+        if (pass == 50) glUniform2f(uniformDirection, 1.0f, 0.0f);
+        glBindFramebuffer(GL_FRAMEBUFFER, reference[1 - current].fbo);
+        referenceBlur->DrawQuad(reference[current].texture, referenceBlur->standardRemapMatrix);
+        current = 1 - current;
     }
-    glUniform2f(uniformDirection, 1.0f, 0.0f);
-    for (size_t i = 0; i < 50; i++) {
-        bloomBuffer.Bind();
-        blurShader.DrawQuad(texture, blurShader.standardRemapMatrix);
 
-        texture = bloomBuffer.SwapBuffers();
+    // The old bloom was added at full strength, the pyramid at its scale
+    std::vector<float> expected = ReadLevel(reference[current]);
+    std::vector<float> actual = ReadLevel(output);
+    float scale = GetOutputScale();
+    double totalDifference = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        // Alpha isn't composited
+        if (i % 4 == 3) continue;
+        double pyramid = actual[i] * scale;
+        double difference = std::abs(pyramid - expected[i]);
+        comparison.referenceEnergy += expected[i];
+        comparison.pyramidEnergy += pyramid;
+        totalDifference += difference;
+        comparison.maxDifference = std::max(comparison.maxDifference, difference);
     }
-    glEnable(GL_DEPTH_TEST);
-    return texture;
-}
\ No newline at end of file
+    comparison.meanDifference = totalDifference / (output.width * output.height * 3);
+    comparison.width = output.width;
+    comparison.height = output.height;
+    comparison.valid = true;
+
+    LOG_INFO("Bloom comparison at " << output.width << "x" << output.height
+        << ": energy " << comparison.pyramidEnergy << " against " << comparison.referenceEnergy
+        << ", mean difference " << comparison.meanDifference
+        << ", max difference " << comparison.maxDifference);
+}
@@ -4,26 +4,98 @@
 #include "buffers.h"
 #include "shader.h"
 
-class BloomShader {
+#include <vector>
 
-    QuadShaderProgram blurShader;
+// The pyramid measured against the 100 pass Gaussian blur it replaced, on
+//   the same frame. Both are read back at half resolution as composited
+struct BloomComparison {
+    bool valid = false;
+    int width = 0;
+    int height = 0;
+    // Summed RGB of each output. The 1 / levels output scale is meant to
+    //   keep the ratio near 1, the blur shape is what differs
+    double referenceEnergy = 0;
+    double pyramidEnergy = 0;
+    // Per channel absolute difference between the two
+    double meanDifference = 0;
+    double maxDifference = 0;
+};
 
-    QuadShaderProgram highPassFilter;
+class BloomShader {
 
-    GLuint uniformDirection;
+    QuadShaderProgram highPassFilter;
+    QuadShaderProgram downsampleShader;
+    QuadShaderProgram upsampleShader;
 
     GLuint uniformThreshold;
-public:
-    RenderBuffer bloomBuffer;
+    GLuint uniformFilterRadius;
+
+    // Level 0 is half the input resolution, each level after is half the last
+    struct Level {
+        GLuint fbo = 0;
+        GLuint texture = 0;
+        int width = 0;
+        int height = 0;
+    };
+    std::vector<Level> levels;
+    int levelsWidth = 0;
+    int levelsHeight = 0;
 
-    BloomShader() : blurShader("shaders/GaussianBlur.fs"),
-            highPassFilter("shaders/BloomHighPass.fs") {
-        blurShader.Use();
-        uniformDirection = blurShader.GetUniformLocation("u_direction");
+    // Every level is RGBA16F
+    static constexpr size_t TexelBytes = 8;
+    size_t bytesMoved = 0;
 
+    // The old blur, only created once a comparison is asked for
+    QuadShaderProgram* referenceBlur = nullptr;
+    GLuint uniformDirection;
+    Level reference[2];
+    bool comparisonRequested = false;
+    BloomComparison comparison;
+
+    void SetupLevels(int width, int height, int levelCount);
+    static void SetupLevel(Level& level, int width, int height);
+    static std::vector<float> ReadLevel(const Level& level);
+    size_t LevelBytes(size_t i) const {
+        return levels[i].width * levels[i].height * TexelBytes;
+    }
+
+public:
+    BloomShader() : highPassFilter("shaders/BloomHighPass.fs"),
+            downsampleShader("shaders/BloomDownsample.fs"),
+            upsampleShader("shaders/BloomUpsample.fs") {
         highPassFilter.Use();
         uniformThreshold = highPassFilter.GetUniformLocation("u_threshold");
+
+        upsampleShader.Use();
+        uniformFilterRadius = upsampleShader.GetUniformLocation("u_filterRadius");
+    }
+
+    // The three stages run in order and leave a half resolution texture of
+    //   the blurred bright parts of texture in GetBloomTexture(). Every level
+    //   adds its own blur on top, scale by GetOutputScale().
+    //   HighPass returns false if the input is too small to bloom
+    bool HighPass(GLuint texture, float threshold, int width, int height, int levelCount);
+    void Downsample();
+    void Upsample();
+
+    // Reads floating point framebuffers back, desktop GL only. Runs on the
+    //   next frame after Upsample, with the same input as the pyramid
+    void RequestComparison() { comparisonRequested = true; }
+    bool IsComparisonRequested() const { return comparisonRequested; }
+    void Compare(GLuint texture, float threshold, int width, int height);
+    const BloomComparison& GetComparison() const { return comparison; }
+
+    // Keeps the summed levels at the brightness of a single blur
+    float GetOutputScale() const {
+        return levels.empty() ? 1.0f : 1.0f / levels.size();
     }
 
-    GLuint BloomTexture(GLuint texture, float threshold, int width, int height);
+    GLuint GetBloomTexture() const {
+        return levels.empty() ? 0 : levels[0].texture;
+    }
+
+    // Estimated color traffic of the last bloom within its own levels, in bytes
+    size_t GetBytesMoved() const {
+        return bytesMoved;
+    }
 };
@@ -1,134 +1,19 @@
 #include "buffers.h"
 #include "logging.h"
 
-void RenderBuffer::SetSize(int newWidth, int newHeight) {
-    if (newWidth == width && newHeight == height) {
+void GBuffer::SetSize(int newWidth, int newHeight, GLuint sharedDepth) {
+    if (newWidth == width && newHeight == height &&
+        (sharedDepth ? sharedDepth == g_depth : ownsDepth)) {
         return;
     }
 
     width = newWidth;
     height = newHeight;
 
-    if (fbo) {
-        glDeleteFramebuffers(1, &fbo);
-        fbo = 0;
-    }
-
-    if (textureColor) {
-        glDeleteTextures(1, &textureColor);
-        textureColor = 0;
-    }
-
-    if (textureDepth) {
-        glDeleteTextures(1, &textureDepth);
-        textureDepth = 0;
-    }
-
-    if (internalTexture) {
-        glDeleteTextures(1, &internalTexture);
-        internalTexture = 0;
-    }
-
-    if (internalDepth) {
-        glDeleteTextures(1, &internalDepth);
-        internalDepth = 0;
-    }
-
-    if (internalFBO) {
-        glDeleteFramebuffers(1, &internalFBO);
-        internalFBO = 0;
-    }
-
-    glGenTextures(1, &textureColor);
-    glBindTexture(GL_TEXTURE_2D, textureColor);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F,
-                width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glGenTextures(1, &textureDepth);
-    glBindTexture(GL_TEXTURE_2D, textureDepth);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
-            width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColor, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textureDepth, 0);
-
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-
-    if (status != GL_FRAMEBUFFER_COMPLETE) {
-        LOG_ERROR("Could not setup render buffer! Status: " << status);
-    }
-
-    glGenTextures(1, &internalTexture);
-    glBindTexture(GL_TEXTURE_2D, internalTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F,
-                width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glGenTextures(1, &internalDepth);
-    glBindTexture(GL_TEXTURE_2D, internalDepth);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
-            width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glGenFramebuffers(1, &internalFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, internalFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, internalTexture, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, internalDepth, 0);
-
-    status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (status != GL_FRAMEBUFFER_COMPLETE) {
-        LOG_ERROR("Could not setup internal frame buffer! Status: " << status);
-    }
-
-}
-
-GLuint RenderBuffer::SwapBuffers() {
-    std::swap(textureColor, internalTexture);
-    std::swap(textureDepth, internalDepth);
-    std::swap(fbo, internalFBO);
-    return internalTexture;
-}
-
-GLuint RenderBuffer::BlitTexture() {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, internalFBO);
-    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
-        GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
-        GL_NEAREST);
-    return internalTexture;
-}
-
-void GBuffer::SetSize(int newWidth, int newHeight) {
-    if (newWidth == width && newHeight == height) {
-        return;
-    }
-
-    width = newWidth;
-    height = newHeight;
-
-    if (g_depth) {
+    if (g_depth && ownsDepth) {
         glDeleteTextures(1, &g_depth);
-        g_depth = 0;
     }
+    g_depth = 0;
 
     if (g_position) {
         glDeleteTextures(1, &g_position);
@@ -192,14 +77,20 @@ void GBuffer::SetSize(int newWidth, int newHeight) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 
-    glGenTextures(1, &g_depth);
-    glBindTexture(GL_TEXTURE_2D, g_depth);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
-                width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    ownsDepth = sharedDepth == 0;
+    if (ownsDepth) {
+        glGenTextures(1, &g_depth);
+        glBindTexture(GL_TEXTURE_2D, g_depth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
+                    width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    else {
+        g_depth = sharedDepth;
+    }
 
     // glGenRenderbuffers(1, &g_depth);
     // glBindRenderbuffer(GL_RENDERBUFFER, g_depth);
@@ -226,4 +117,73 @@ void GBuffer::SetSize(int newWidth, int newHeight) {
     if (status != GL_FRAMEBUFFER_COMPLETE) {
         LOG_ERROR("Could not setup gbuffer! Status: " << status);
     }
-}
\ No newline at end of file
+}
+void InstanceBuffer::Upload(const std::vector<Matrix4>& transforms) {
+    if (transforms.empty()) return;
+    if (!vbo) {
+        glGenBuffers(1, &vbo);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    size_t count = transforms.size();
+    if (count > capacity) {
+        // Room for a few frames before wrapping
+        capacity = std::max(count * 4, capacity * 2);
+        head = capacity;
+    }
+    if (head + count > capacity) {
+        // Orphan the old storage so we don't stall on draws still using it
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Matrix4), nullptr, GL_STREAM_DRAW);
+        head = 0;
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, head * sizeof(Matrix4), count * sizeof(Matrix4), transforms.data());
+    base = head;
+    head += count;
+}
+
+void InstanceBuffer::Bind(size_t offset) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    for (GLuint i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(AttributeLocation + i);
+        glVertexAttribPointer(AttributeLocation + i, 4, GL_FLOAT, false, sizeof(Matrix4),
+            (const void*)((base + offset) * sizeof(Matrix4) + i * sizeof(Vector4)));
+        glVertexAttribDivisor(AttributeLocation + i, 1);
+    }
+}
+
+void InstanceBuffer::Unbind() {
+    for (GLuint i = 0; i < 4; i++) {
+        glDisableVertexAttribArray(AttributeLocation + i);
+    }
+}
+
+size_t BoneBuffer::GetPaletteStride() {
+    if (!paletteStride) {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        size_t alignedMatrices = std::max<size_t>(1, alignment / sizeof(Matrix4));
+        paletteStride = (MaxBones + alignedMatrices - 1) / alignedMatrices * alignedMatrices;
+    }
+    return paletteStride;
+}
+
+void BoneBuffer::Upload(const std::vector<Matrix4>& palettes) {
+    if (!ubo) {
+        glGenBuffers(1, &ubo);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    if (palettes.empty()) {
+        // Nothing is skinned, but the block still needs backing
+        std::vector<Matrix4> identity(GetPaletteStride());
+        glBufferData(GL_UNIFORM_BUFFER, identity.size() * sizeof(Matrix4), identity.data(), GL_STREAM_DRAW);
+    }
+    else {
+        // Respecified every frame, the driver orphans the old storage
+        glBufferData(GL_UNIFORM_BUFFER, palettes.size() * sizeof(Matrix4), palettes.data(), GL_STREAM_DRAW);
+    }
+    Bind(0);
+}
+
+void BoneBuffer::Bind(size_t palette) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, BindingPoint, ubo,
+        palette * GetPaletteStride() * sizeof(Matrix4), MaxBones * sizeof(Matrix4));
+}
@@ -1,41 +1,17 @@
 #pragma once
 
 #include "opengl.h"
+#include "vector.h"
+#include "skeleton.h"
 
-class RenderBuffer {
-    // Internally we use another FBO to blit over when we want a texture
-    GLuint internalFBO = 0;
-    GLuint internalTexture = 0;
-
-public:
-
-    GLuint internalDepth = 0;
-
-    GLuint fbo = 0;
-    GLuint textureColor = 0;
-    GLuint textureDepth = 0;
-
-    int width = 0;
-    int height = 0;
-
-    RenderBuffer() {}
-    void SetSize(int width, int height);
-
-    void Bind() {
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-        glViewport(0, 0, width, height);
-    }
-
-    // warning: will override current fbo
-    GLuint BlitTexture();
-
-    GLuint SwapBuffers();
-};
+#include <vector>
 
 struct GBuffer {
     GLuint fbo = 0;
 
     GLuint g_depth = 0;
+    // False when g_depth belongs to another buffer
+    bool ownsDepth = true;
 
     GLuint g_position = 0;
     GLuint g_normal = 0;
@@ -45,7 +21,9 @@ struct GBuffer {
     int width = 0;
     int height = 0;
 
-    void SetSize(int width, int height);
+    // Pass sharedDepth to depth test against (and write into) another
+    //   buffer's depth instead of copying it over
+    void SetSize(int width, int height, GLuint sharedDepth = 0);
 
     void Bind() {
         glBindFramebuffer(GL_FRAMEBUFFER, fbo);
@@ -61,6 +39,45 @@ struct DefaultFrameBuffer : public GBuffer {
     }
 };
 
+// Streams per-instance model matrices for instanced draws, the matrix is
+//   bound to attribute locations 5-8 of whichever mesh VAO is bound.
+//   Uploads are appended to a ring and the storage is only orphaned when it
+//   wraps, so several uploads share one allocation.
+struct InstanceBuffer {
+    static const GLuint AttributeLocation = 5;
+
+    GLuint vbo = 0;
+    size_t capacity = 0;
+    // Start of the last upload and where the next one goes, in matrices
+    size_t base = 0;
+    size_t head = 0;
+
+    void Upload(const std::vector<Matrix4>& transforms);
+
+    // Points the instance attributes of the bound VAO at the given instance
+    //   of the last upload
+    void Bind(size_t offset);
+    void Unbind();
+};
+
+// Bone palettes of the skinned draws in a frame, read by the shaders'
+//   Bones uniform block. Every palette is uploaded at once and a draw binds
+//   its own range, WebGL checks the block is backed on every draw so a range
+//   is always left bound.
+struct BoneBuffer {
+    static const GLuint BindingPoint = 0;
+
+    GLuint ubo = 0;
+    // Matrices between palettes, at least MaxBones and a multiple of the
+    //   uniform buffer offset alignment
+    size_t paletteStride = 0;
+
+    size_t GetPaletteStride();
+    // Palettes laid out paletteStride apart, binds the first
+    void Upload(const std::vector<Matrix4>& palettes);
+    void Bind(size_t palette);
+};
+
 struct GLLimits {
     GLint MAX_SAMPLES = 0;
 };
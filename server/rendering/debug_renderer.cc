@@ -1,27 +1,12 @@
 #include "debug_renderer.h"
 
+#include <algorithm>
+
 
 void SetupMesh(Mesh& mesh, const std::vector<float>& verts, const std::vector<unsigned int>& indices) {
-    glGenVertexArrays(1, &mesh.renderInfo.vao);
-    glBindVertexArray(mesh.renderInfo.vao);
-
-    glGenBuffers(1, &mesh.renderInfo.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.renderInfo.vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-        verts.size() * sizeof(float),
-        verts.data(), GL_STATIC_DRAW
-    );
-
-    glVertexAttribPointer(0,
-        3, GL_FLOAT, false, 3 * sizeof(float), (const void*)0);
-    glEnableVertexAttribArray(0);
-
-    glGenBuffers(1, &mesh.renderInfo.ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.renderInfo.ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-        indices.size() * sizeof(unsigned int),
-        indices.data(), GL_STATIC_DRAW);
-    mesh.renderInfo.iboCount = indices.size();
+    mesh.renderInfo.buffer = &MeshBuffer::Get(VertexFormat::Position);
+    mesh.renderInfo.allocation = mesh.renderInfo.buffer->Allocate(
+        verts.data(), verts.size() / 3, indices.data(), indices.size());
 }
 
 
@@ -48,15 +33,6 @@ void DebugRenderer::Initialize() {
     };
     SetupMesh(debugCube, cubeVerts, cubeIndices);
 
-    // Setup Line
-    std::vector<float> lineVerts = {
-        0, 0, 0, 0, 0, -1
-    };
-    std::vector<unsigned int> lineIndices = {
-        0, 1
-    };
-    SetupMesh(debugLine, lineVerts, lineIndices);
-
     std::vector<float> circleVerts;
     std::vector<unsigned int> circleIndices;
     const int numCircleVerts = 256;
@@ -121,21 +97,34 @@ void DebugRenderer::NewFrame(const Matrix4& view, const Matrix4& proj) {
     debugShaderProgram->PreDraw(Vector3{}, view, proj);
 }
 
+void DebugRenderer::DrawLineVertices() {
+    MeshBuffer& buffer = MeshBuffer::Get(VertexFormat::Position);
+    size_t chunk = buffer.GetStreamCapacity();
+    for (size_t offset = 0; offset < lineVertices.size(); offset += chunk) {
+        size_t count = std::min(chunk, lineVertices.size() - offset);
+        size_t first = buffer.Stream(&lineVertices[offset], count);
+        debugShaderProgram->DrawStreamedLines(first, count);
+    }
+    lineVertices.clear();
+}
+
 void DebugRenderer::Render(Vector3 cameraPos) {
     debugShaderProgram->Use();
-    for (const LineParams& line : lines) {
+    for (size_t i = 0; i < lines.size(); i++) {
+        const LineParams& line = lines[i];
+        lineVertices.push_back(line.start);
+        lineVertices.push_back(line.end);
+        bool runEnds = i + 1 == lines.size() || lines[i + 1].color != line.color ||
+            lines[i + 1].depthTest != line.depthTest;
+        if (!runEnds) continue;
+
         if (line.depthTest) {
             glEnable(GL_DEPTH_TEST);
         } else {
             glDisable(GL_DEPTH_TEST);
         }
         debugShaderProgram->SetColor(line.color);
-        float length = glm::distance(line.start, line.end);
-
-        Matrix4 model = glm::translate(line.start) *
-            glm::transpose(glm::toMat4(DirectionToQuaternion(line.end - line.start))) *
-            glm::scale(Vector3(length));
-        debugShaderProgram->Draw(model, &debugLine);
+        DrawLineVertices();
     }
     for (const CubeParams& cube : cubes) {
         if (cube.depthTest) {
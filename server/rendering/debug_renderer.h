@@ -31,13 +31,17 @@ class DebugRenderer {
     DebugShaderProgram* debugShaderProgram;
 
     Mesh debugCube;
-    Mesh debugLine;
     Mesh debugSphere;
 
     std::vector<LineParams> lines;
     std::vector<CubeParams> cubes;
     std::vector<SphereParams> spheres;
 
+    // Ends of a run of lines with the same color and depth test, streamed
+    //   and drawn in one call
+    std::vector<Vector3> lineVertices;
+    void DrawLineVertices();
+
 public:
     DebugRenderer();
 
@@ -50,6 +54,10 @@ public:
     void DrawLine(const Vector3& start, const Vector3& end, const Vector3& color, bool depthTest = true);
     void DrawCube(const Matrix4& model, const Vector3& color, bool depthTest = true);
 
+    bool IsEmpty() const {
+        return lines.empty() && cubes.empty() && spheres.empty();
+    }
+
     void NewFrame(const Matrix4& view, const Matrix4& proj);
     void Render(Vector3 cameraPos);
 };
\ No newline at end of file
@@ -1,4 +1,74 @@
 #include "deferred_renderer.h"
+#include "trace.h"
+
+#include <cstring>
+
+// Maps a float to an unsigned int with the same ordering
+static uint32_t SortableFloatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// LSD radix sort on the key, a byte at a time. Bytes that are the same for
+//   every command (usually the top ones) are skipped.
+static void RadixSortCommands(std::vector<DrawCommand>& commands,
+        std::vector<DrawCommand>& scratch) {
+    size_t count = commands.size();
+    if (count < 2) return;
+    scratch.resize(count);
+
+    size_t histograms[8][256] = {};
+    for (const auto& command : commands) {
+        for (int b = 0; b < 8; b++) {
+            histograms[b][(command.key >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    DrawCommand* src = commands.data();
+    DrawCommand* dst = scratch.data();
+    for (int b = 0; b < 8; b++) {
+        size_t* histogram = histograms[b];
+        if (histogram[(src[0].key >> (b * 8)) & 0xFF] == count) continue;
+
+        size_t offset = 0;
+        for (int i = 0; i < 256; i++) {
+            size_t bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dst[histogram[(src[i].key >> (b * 8)) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != commands.data()) {
+        commands.swap(scratch);
+    }
+}
+
+void DrawLayer::Sort() {
+    const uint64_t mask20 = (1ull << 20) - 1;
+    opaqueCount = 0;
+    for (auto& command : commands) {
+        const DrawParams& params = draws[command.index];
+        uint32_t depthBits = SortableFloatBits(command.depth);
+        if (command.key >> 63) {
+            // Furthest first
+            command.key = (1ull << 63) | ((uint64_t) ~depthBits << 31);
+        }
+        else {
+            Material* material = params.overrideMaterial ?
+                params.overrideMaterial : params.mesh->material;
+            command.key =
+                ((uint64_t) (params.mesh->sortId & mask20) << 43) |
+                ((uint64_t) (material->sortId & mask20) << 23) |
+                (depthBits >> 9);
+            opaqueCount++;
+        }
+    }
+    RadixSortCommands(commands, sortScratch);
+}
 
 DeferredRenderer::DeferredRenderer(AssetManager& assetManager) :
     assetManager(assetManager) {
@@ -12,21 +82,25 @@ void DeferredRenderer::Initialize() {
     pointLightShader = new DeferredShadingLightingShaderProgram("shaders/MeshLightingPointLight.fs");
     rectangleLightShader = new DeferredShadingLightingShaderProgram("shaders/MeshLightingRectangleLight.fs");
     directionalLightShader = new DeferredShadingLightingShaderProgram("shaders/MeshLightingDirectionalLight.fs");
+    clusteredLightShader = new ClusteredLightingShaderProgram;
+    lightClusters.Initialize();
 
     shadowMapShader = new ShadowMapShaderProgram;
     bloomShader = new BloomShader;
     toneMappingShader = new QuadShaderProgram("shaders/ToneMapping.fs");
     fxaaShader = new QuadShaderProgram("shaders/FXAA.fs");
+    toneMappedFXAAShader = new QuadShaderProgram("shaders/ToneMappingFXAA.fs");
     skydomeShader = new QuadShaderProgram("shaders/Skydome.fs");
 
     toneMappingShader->Use();
     uniformToneMappingExposure = toneMappingShader->GetUniformLocation("u_exposure");
 
     fxaaShader->Use();
-    uniformFXAALumaThreshold = fxaaShader->GetUniformLocation("u_lumaThreshold");
-    uniformFXAAMulReduceReciprocal = fxaaShader->GetUniformLocation("u_mulReduce");
-    uniformFXAAMinReduceReciprocal = fxaaShader->GetUniformLocation("u_minReduce");
-    uniformFXAAMaxSpan = fxaaShader->GetUniformLocation("u_maxSpan");
+    fxaaUniforms = GetFXAAUniforms(*fxaaShader);
+
+    toneMappedFXAAShader->Use();
+    toneMappedFXAAUniforms = GetFXAAUniforms(*toneMappedFXAAShader);
+    uniformToneMappedFXAAExposure = toneMappedFXAAShader->GetUniformLocation("u_exposure");
 
     skydomeShader->Use();
     uniformSkydomeDirection = skydomeShader->GetUniformLocation("u_cameraDirection");
@@ -79,18 +153,29 @@ void DeferredRenderer::NewFrame(RenderFrameParameters* params) {
     directionalLightShader->PreDraw(shadowViewPos, renderFrameParameters->shadowView, proj);
     directionalLightShader->SetViewportSize(params->width, params->height);
 
+    clusteredLightShader->Use();
+    clusteredLightShader->PreDraw(shadowViewPos, renderFrameParameters->shadowView, proj);
+    clusteredLightShader->SetViewportSize(params->width, params->height);
+
     gBuffer.SetSize(params->width, params->height);
-    transparencyGBuffer.SetSize(params->width, params->height);
-    outputBuffer.SetSize(params->width, params->height);
+    transparencyGBuffer.SetSize(params->width, params->height, gBuffer.g_depth);
 
     renderFrameParameters->view = view;
     renderFrameParameters->proj = proj;
 
+    stats = RenderStats{};
+    profiler.BeginFrame();
+
     GetDebugRenderer().NewFrame(view, proj);
 }
 
 void DeferredRenderer::EndFrame() {
-    // No-op for now
+    profiler.EndFrame();
+    targetPool.EndFrame();
+    stats.shadowMs = profiler.GetGPUMilliseconds("Shadow Maps");
+    stats.bloomHighPassMs = profiler.GetGPUMilliseconds("Bloom High Pass");
+    stats.bloomDownsampleMs = profiler.GetGPUMilliseconds("Bloom Downsample");
+    stats.bloomUpsampleMs = profiler.GetGPUMilliseconds("Bloom Upsample");
 }
 
 void DeferredRenderer::DrawObject(const DrawParams& params) {
@@ -109,19 +194,59 @@ void DeferredRenderer::DrawObject(const DrawParams& params) {
             // Render Front only
             glCullFace(GL_FRONT);
             geometryShader->SetDrawOutline(0.05, Vector3(1));
-            geometryShader->Draw(params.transform, params.mesh);
+            DrawGeometryMesh(params);
+            stats.drawCalls++;
         }
         glCullFace(GL_BACK);
     }
     geometryShader->SetOverrideMaterial(params.overrideMaterial);
     geometryShader->SetDrawOutline(0, Vector3());
-    geometryShader->Draw(params.transform, params.mesh);
+    DrawGeometryMesh(params);
+    stats.drawCalls++;
     #ifdef BUILD_EDITOR
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     #endif
     glEnable(GL_CULL_FACE);
 }
 
+void DeferredRenderer::UploadBonePalettes(std::initializer_list<DrawLayer*> layers) {
+    bonePalettes.clear();
+    paletteIndices.clear();
+    size_t stride = boneBuffer.GetPaletteStride();
+    for (auto& layer : layers) {
+        for (auto& params : layer->draws) {
+            // Meshes of one object share its palette
+            if (!params.bones || paletteIndices.count(params.bones)) continue;
+            size_t palette = bonePalettes.size() / stride;
+            paletteIndices[params.bones] = palette;
+            bonePalettes.insert(bonePalettes.end(), params.bones,
+                params.bones + std::min(params.boneCount, MaxBones));
+            bonePalettes.resize((palette + 1) * stride);
+        }
+    }
+    boneBuffer.Upload(bonePalettes);
+}
+
+void DeferredRenderer::DrawGeometryMesh(const DrawParams& params) {
+    auto palette = params.bones ? paletteIndices.find(params.bones) : paletteIndices.end();
+    if (palette != paletteIndices.end()) {
+        geometryShader->DrawSkinned(params.transform, params.mesh, boneBuffer, palette->second);
+    }
+    else {
+        geometryShader->Draw(params.transform, params.mesh);
+    }
+}
+
+void DeferredRenderer::DrawShadowMesh(const DrawParams& params) {
+    auto palette = params.bones ? paletteIndices.find(params.bones) : paletteIndices.end();
+    if (palette != paletteIndices.end()) {
+        shadowMapShader->DrawSkinned(params.transform, params.mesh, boneBuffer, palette->second);
+    }
+    else {
+        shadowMapShader->Draw(params.transform, params.mesh);
+    }
+}
+
 
 Vector4 viewFrustrumPoints[] = {
     Vector4(-1, -1, -1, 1),
@@ -141,20 +266,216 @@ void MultiplyAll(A* dest, const A* src, size_t count, const B& multiplyBy) {
     }
 }
 
-void DeferredRenderer::DrawShadowObjects(std::initializer_list<DrawLayer*> layers) {
-    glDisable(GL_CULL_FACE);
+void DeferredRenderer::AppendInstanceBatches(const std::vector<const DrawParams*>& params,
+        std::vector<InstanceBatch>& batches) {
+    // Mesh is the top of the opaque key, so equal meshes are already
+    //   adjacent even when some override their material
+    for (size_t i = 0; i < params.size();) {
+        InstanceBatch& batch = batches.emplace_back();
+        batch.mesh = params[i]->mesh;
+        batch.offset = instanceTransforms.size();
+        for (; i < params.size() && params[i]->mesh == batch.mesh; i++) {
+            instanceTransforms.push_back(params[i]->transform);
+        }
+        batch.count = instanceTransforms.size() - batch.offset;
+    }
+}
+
+static bool IsShadowCaster(const DrawParams& param, ShadowCasters casters) {
+    if (!param.castShadows) return false;
+    switch (casters) {
+        case ShadowCasters::Static: return param.isStatic;
+        case ShadowCasters::Dynamic: return !param.isStatic;
+        default: return true;
+    }
+}
+
+void DeferredRenderer::PrepareShadowBatches(std::initializer_list<DrawLayer*> layers,
+        const Frustum& frustum, ShadowCasters casters) {
+    instanceTransforms.clear();
+    shadowBatches.clear();
+    skinnedShadowCasters.clear();
+    batchScratch.clear();
     for (auto& layer : layers) {
-        for (auto& pair : layer->opaque) {
-            for (auto& param : pair.second) {
-                if (!param.castShadows) continue;
-                shadowMapShader->Draw(param.transform, param.mesh);
+        batchScratch.clear();
+        for (size_t i = 0; i < layer->opaqueCount; i++) {
+            const DrawParams& param = layer->GetOpaque(i);
+            if (!IsShadowCaster(param, casters)) continue;
+            if (param.hasBounds && !frustum.Intersects(param.bounds)) {
+                stats.shadowCastersCulled++;
+                continue;
+            }
+            if (param.bones) {
+                skinnedShadowCasters.push_back(&param);
+                continue;
+            }
+            batchScratch.push_back(&param);
+        }
+        AppendInstanceBatches(batchScratch, shadowBatches);
+    }
+    shadowInstances.Upload(instanceTransforms);
+}
+
+void DeferredRenderer::DrawShadowObjects(std::initializer_list<DrawLayer*> layers,
+        const Frustum& frustum, ShadowCasters casters) {
+    glDisable(GL_CULL_FACE);
+    if (renderFrameParameters->enableInstancing) {
+        PrepareShadowBatches(layers, frustum, casters);
+        for (auto& batch : shadowBatches) {
+            shadowMapShader->DrawInstanced(batch.mesh, shadowInstances, batch.offset, batch.count);
+            stats.drawCalls++;
+            stats.shadowDrawCalls++;
+            stats.instancedDrawCalls++;
+            stats.instances += batch.count;
+        }
+        for (const DrawParams* param : skinnedShadowCasters) {
+            DrawShadowMesh(*param);
+            stats.drawCalls++;
+            stats.shadowDrawCalls++;
+        }
+    }
+    else {
+        for (auto& layer : layers) {
+            for (size_t i = 0; i < layer->opaqueCount; i++) {
+                const DrawParams& param = layer->GetOpaque(i);
+                if (!IsShadowCaster(param, casters)) continue;
+                if (param.hasBounds && !frustum.Intersects(param.bounds)) {
+                    stats.shadowCastersCulled++;
+                    continue;
+                }
+                DrawShadowMesh(param);
+                stats.drawCalls++;
+                stats.shadowDrawCalls++;
             }
         }
     }
     glEnable(GL_CULL_FACE);
 }
 
+// Ortho projection around the bounding sphere of a cascade's corners. The
+//   sphere keeps its size as the camera turns and its center is snapped to
+//   whole shadow map texels, so the cascade only ever moves in texel steps
+//   and static shadows don't shimmer.
+static Matrix4 FitStableCascade(const Vector4* corners, const Matrix4& lightView,
+        int shadowMapSize, float maxBoundary) {
+    Vector3 center(0);
+    for (size_t i = 0; i < 8; i++) {
+        center += Vector3(corners[i]);
+    }
+    center /= 8.0f;
+
+    float radius = 0;
+    for (size_t i = 0; i < 8; i++) {
+        radius = glm::max(radius, glm::distance(center, Vector3(corners[i])));
+    }
+    // Round up so float noise can't change the texel size between frames
+    radius = glm::ceil(radius * 16.0f) / 16.0f;
+
+    Vector3 lightCenter = Vector3(lightView * Vector4(center, 1));
+    float texelSize = 2.0f * radius / shadowMapSize;
+    lightCenter.x = glm::floor(lightCenter.x / texelSize) * texelSize;
+    lightCenter.y = glm::floor(lightCenter.y / texelSize) * texelSize;
+
+    // IMPORTANT NOTE OUR Z-AXES HAVE TO BE REVERSED BECAUSE FOR SOME
+    // REASON I DECIDED TO USE A +Z AS FORWARD POST TRANFORM SO ... YEAH
+    // Also our near plane has to be 0.01 otherwise things that occlude
+    // might get cut out and you get wrong shadows. The far plane is fixed
+    // so the depth values of cached casters stay valid.
+    return glm::ortho(
+        lightCenter.x - radius,
+        lightCenter.x + radius,
+        lightCenter.y - radius,
+        lightCenter.y + radius,
+        0.01f,
+        maxBoundary);
+}
+
+// Changes whenever a static caster is added, removed, moved, turned or scaled,
+//   for callers without a staticCasterVersion
+static size_t StaticShadowSignature(std::initializer_list<DrawLayer*> layers) {
+    size_t signature = 0;
+    for (auto& layer : layers) {
+        for (size_t i = 0; i < layer->opaqueCount; i++) {
+            const DrawParams& param = layer->GetOpaque(i);
+            if (!param.castShadows || !param.isStatic) continue;
+            size_t hash = std::hash<Mesh*>()(param.mesh);
+            for (int column = 0; column < 4; column++) {
+                for (int row = 0; row < 4; row++) {
+                    hash = hash * 31 + std::hash<float>()(param.transform[column][row]);
+                }
+            }
+            signature += hash * 2654435761u + 1;
+        }
+    }
+    return signature;
+}
+
+void DeferredRenderer::DrawShadowCascade(TransformedLight* transformed,
+        std::initializer_list<DrawLayer*> layers, size_t cascade,
+        const Matrix4& lightView, const Matrix4& lightProjection, size_t staticSignature) {
+    LightNode* light = dynamic_cast<LightNode*>(transformed->node);
+    int size = light->shadowMapSize;
+    // Near, mid and far are packed into the 2x2 atlas
+    int x = cascade == 1 ? size : 0;
+    int y = cascade == 2 ? size : 0;
+    Matrix4 lightViewProj = lightProjection * lightView;
+    Frustum frustum(lightViewProj);
+
+    shadowMapShader->PreDraw(Vector3(), lightView, lightProjection);
+
+    if (!renderFrameParameters->enableShadowCaching) {
+        glBindFramebuffer(GL_FRAMEBUFFER, transformed->shadowFrameBuffer);
+        glViewport(x, y, size, size);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(x, y, size, size);
+        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
+        transformed->isCascadeCached[cascade] = false;
+        DrawShadowObjects(layers, frustum, ShadowCasters::All);
+        return;
+    }
+
+    // Static casters only get redrawn when the cascade snaps to a new texel,
+    //   the light moves or the set of static casters changes
+    if (!transformed->isCascadeCached[cascade] ||
+        transformed->cachedCascadeViewProj[cascade] != lightViewProj ||
+        transformed->cachedStaticSignature[cascade] != staticSignature) {
+        glBindFramebuffer(GL_FRAMEBUFFER, transformed->shadowCacheFrameBuffer);
+        glViewport(x, y, size, size);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(x, y, size, size);
+        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
+        DrawShadowObjects(layers, frustum, ShadowCasters::Static);
+
+        transformed->isCascadeCached[cascade] = true;
+        transformed->cachedCascadeViewProj[cascade] = lightViewProj;
+        transformed->cachedStaticSignature[cascade] = staticSignature;
+        stats.shadowCacheUpdates++;
+    }
+    else {
+        stats.shadowCascadesCached++;
+    }
+
+    // Copy the cached cascade over, then dynamic casters depth test against it
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, transformed->shadowCacheFrameBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, transformed->shadowFrameBuffer);
+    glBlitFramebuffer(x, y, x + size, y + size, x, y, x + size, y + size,
+        GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, transformed->shadowFrameBuffer);
+    glViewport(x, y, size, size);
+    DrawShadowObjects(layers, frustum, ShadowCasters::Dynamic);
+}
+
 void DeferredRenderer::DrawShadowMaps(std::initializer_list<DrawLayer*> layers) {
+    ScopedGPUPass pass(profiler, "Shadow Maps");
+    size_t staticSignature = 0;
+    if (renderFrameParameters->enableShadowCaching) {
+        staticSignature = renderFrameParameters->staticCasterVersion ?
+            renderFrameParameters->staticCasterVersion : StaticShadowSignature(layers);
+    }
+
     for (auto& transformed : renderFrameParameters->lights) {
         LightNode* light = dynamic_cast<LightNode*>(transformed->node);
         if (light->shadowMapSize == 0) continue;
@@ -203,105 +524,40 @@ void DeferredRenderer::DrawShadowMaps(std::initializer_list<DrawLayer*> layers)
             0.5, 0.5, 0.5, 1.0
         );
 
-        Vector3 boxToLight[8];
-
-        // Draw to our temporary buffer
-        glBindFramebuffer(GL_FRAMEBUFFER, transformed->shadowFrameBuffer);
-        // glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1, 1, 1, 1);
-        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
         glEnable(GL_CULL_FACE);
         glCullFace(GL_FRONT);
         glEnable(GL_DEPTH_TEST);
+        glClearColor(1, 1, 1, 1);
 
-        // shaderPrograms[0]->Use();
-        // shaderPrograms[0]->PreDraw(game, light.position, lightView, lightProjection);
-
-        // Draw Near Field
-        glViewport(0, 0, light->shadowMapSize, light->shadowMapSize);
-        for (size_t i = 0; i < 8; i++) {
-            boxToLight[i] = Vector3(lightView * viewFrustrumPointsNear[i]);
-        }
-
-        // IMPORTANT NOTE OUR Z-AXES HAVE TO BE REVERSED BECAUSE FOR SOME
-        // REASON I DECIDED TO USE A +Z AS FORWARD POST TRANFORM SO ... YEAH
-        // Also our near plane has to be 0.01 otherwise things that occlude
-        // might get cut out and you get wrong shadows.
-        AABB boxExtents { boxToLight, 8 };
-        Matrix4 lightProjection = glm::ortho(
-            boxExtents.ptMin.x,
-            boxExtents.ptMax.x,
-            boxExtents.ptMin.y,
-            boxExtents.ptMax.y,
-            0.01f,
-            glm::min(-boxExtents.ptMin.z, 400.f));
-        // LOG_DEBUG(boxExtents.ptMin.z << " " <<  boxExtents.ptMax.z);
-        if (renderFrameParameters->debugSettings.drawShadowMapDebug) {
-            Matrix4 transform =
-                glm::inverse(lightView) *
-                glm::translate((boxExtents.ptMin + boxExtents.ptMax) / 2.f) *
-                glm::scale(boxExtents.ptMax - boxExtents.ptMin);
-            GetDebugRenderer().DrawCube(transform, Vector4(0, 1, 1, 1));
-        }
-        transformed->depthBiasMVPNear = biasMatrix * lightProjection * lightView;
-        shadowMapShader->PreDraw(Vector3(), lightView, lightProjection);
-
-        DrawShadowObjects(layers);
-
-        // Update stuff to middle side
-        for (size_t i = 0; i < 8; i++) {
-            boxToLight[i] = Vector3(lightView * viewFrustrumPointsMid[i]);
-        }
-
-        boxExtents = AABB(boxToLight, 8);
-        lightProjection = glm::ortho(
-            boxExtents.ptMin.x,
-            boxExtents.ptMax.x,
-            boxExtents.ptMin.y,
-            boxExtents.ptMax.y,
-            0.01f,
-            glm::min(-boxExtents.ptMin.z, 400.f));
-        if (renderFrameParameters->debugSettings.drawShadowMapDebug) {
-            Matrix4 transform =
-                glm::inverse(lightView) *
-                glm::translate((boxExtents.ptMin + boxExtents.ptMax) / 2.f) *
-                glm::scale(boxExtents.ptMax - boxExtents.ptMin);
-            GetDebugRenderer().DrawCube(transform, Vector4(1, 0, 1, 1));
-        }
-        transformed->depthBiasMVPMid = biasMatrix * lightProjection * lightView;
-        shadowMapShader->PreDraw(Vector3(), lightView, lightProjection);
-
-        glViewport(light->shadowMapSize, 0, light->shadowMapSize, light->shadowMapSize);
-
-        DrawShadowObjects(layers);
+        const Vector4* cascadeCorners[3] = {
+            viewFrustrumPointsNear, viewFrustrumPointsMid, viewFrustrumPointsFar };
+        Matrix4* depthBiasMVP[3] = {
+            &transformed->depthBiasMVPNear, &transformed->depthBiasMVPMid, &transformed->depthBiasMVPFar };
+        Vector4 debugColors[3] = { Vector4(0, 1, 1, 1), Vector4(1, 0, 1, 1), Vector4(1, 1, 0, 1) };
+
+        int farInterval = glm::max(renderFrameParameters->farCascadeUpdateInterval, 1);
+        bool updateFar = transformed->shadowFrame % farInterval == 0;
+        transformed->shadowFrame++;
+
+        for (size_t cascade = 0; cascade < 3; cascade++) {
+            // The far cascade keeps last update's contents and matrix
+            if (cascade == 2 && !updateFar) {
+                stats.shadowCascadesSkipped++;
+                continue;
+            }
 
-        // Update stuff to far side
-        for (size_t i = 0; i < 8; i++) {
-            boxToLight[i] = Vector3(lightView * viewFrustrumPointsFar[i]);
-        }
+            Matrix4 lightProjection = FitStableCascade(cascadeCorners[cascade],
+                lightView, light->shadowMapSize, light->maxBoundary);
+            Matrix4 lightViewProj = lightProjection * lightView;
+            if (renderFrameParameters->debugSettings.drawShadowMapDebug) {
+                Vector4 box[8];
+                MultiplyAll(box, viewFrustrumPoints, 8, glm::inverse(lightViewProj));
+                GetDebugRenderer().DrawCube(box, debugColors[cascade]);
+            }
+            *depthBiasMVP[cascade] = biasMatrix * lightViewProj;
 
-        boxExtents = AABB(boxToLight, 8);
-        lightProjection = glm::ortho(
-            boxExtents.ptMin.x,
-            boxExtents.ptMax.x,
-            boxExtents.ptMin.y,
-            boxExtents.ptMax.y,
-            0.01f,
-            glm::min(-boxExtents.ptMin.z, 400.f));
-        if (renderFrameParameters->debugSettings.drawShadowMapDebug) {
-            Matrix4 transform =
-                glm::inverse(lightView) *
-                glm::translate((boxExtents.ptMin + boxExtents.ptMax) / 2.f) *
-                glm::scale(boxExtents.ptMax - boxExtents.ptMin);
-            GetDebugRenderer().DrawCube(transform, Vector4(1, 1, 0, 1));
+            DrawShadowCascade(transformed, layers, cascade, lightView, lightProjection, staticSignature);
         }
-
-        transformed->depthBiasMVPFar = biasMatrix * lightProjection * lightView;
-        shadowMapShader->PreDraw(Vector3(), lightView, lightProjection);
-
-        glViewport(0, light->shadowMapSize, light->shadowMapSize, light->shadowMapSize);
-
-        DrawShadowObjects(layers);
     }
 }
 
@@ -323,11 +579,19 @@ void DeferredRenderer::Draw(std::initializer_list<DrawLayer*> layers) {
         }
     }
 
+    uint64_t sortStart = Trace::Now();
+    for (auto& layer : layers) {
+        layer->Sort();
+    }
+    stats.sortMs = (Trace::Now() - sortStart) / 1e6;
+    UploadBonePalettes(layers);
+
     // Create Shadow Maps
     if (renderFrameParameters->enableShadows) {
         DrawShadowMaps(layers);
     }
 
+    profiler.Begin("Geometry");
     gBuffer.Bind();
     glViewport(0, 0, gBuffer.width, gBuffer.height);
     glClearColor(0, 0, 0, 0);
@@ -337,26 +601,219 @@ void DeferredRenderer::Draw(std::initializer_list<DrawLayer*> layers) {
     glCullFace(GL_BACK);
 
     // Opaque Geometry Pass
+    uint64_t submitStart = Trace::Now();
     geometryShader->Use();
-    for (auto& layer : layers) {
-        for (auto& pair : layer->opaque) {
-            for (auto& param : pair.second) {
-                DrawObject(param);
+    if (renderFrameParameters->enableInstancing) {
+        // Outlines, wireframes, overrides and skinned meshes need per draw
+        //   state, the rest are batched per mesh with the mesh's material
+        instanceTransforms.clear();
+        geometryBatches.clear();
+        for (auto& layer : layers) {
+            if (layer->shadowOnly) continue;
+            batchScratch.clear();
+            for (size_t i = 0; i < layer->opaqueCount; i++) {
+                const DrawParams& param = layer->GetOpaque(i);
+                if (param.hasOutline || param.isWireframe || param.overrideMaterial || param.bones) {
+                    DrawObject(param);
+                }
+                else {
+                    batchScratch.push_back(&param);
+                }
+            }
+            AppendInstanceBatches(batchScratch, geometryBatches);
+        }
+        geometryInstances.Upload(instanceTransforms);
+
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+        geometryShader->SetOverrideMaterial(nullptr);
+        geometryShader->SetDrawOutline(0, Vector3());
+        for (auto& batch : geometryBatches) {
+            geometryShader->DrawInstanced(batch.mesh, geometryInstances, batch.offset, batch.count);
+            stats.drawCalls++;
+            stats.instancedDrawCalls++;
+            stats.instances += batch.count;
+        }
+    }
+    else {
+        for (auto& layer : layers) {
+            if (layer->shadowOnly) continue;
+            for (size_t i = 0; i < layer->opaqueCount; i++) {
+                DrawObject(layer->GetOpaque(i));
             }
         }
     }
 
-    // Lighting Pass
-    outputBuffer.Bind();
-    glClearColor(0, 0, 0, 0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Transparent geometry only needs the opaque depth, which its buffer
+    //   shares with the gBuffer. Composited after lighting
+    {
+        profiler.Begin("Transparency");
+        transparencyGBuffer.Bind();
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        geometryShader->Use();
+        for (auto& layer : layers) {
+            if (layer->shadowOnly) continue;
+            for (size_t i = layer->opaqueCount; i < layer->commands.size(); i++) {
+                DrawObject(layer->draws[layer->commands[i].index]);
+            }
+        }
+    }
+    stats.submitMs = (Trace::Now() - submitStart) / 1e6;
+
+    // Everything from here on is full screen, targets come from the pool and
+    //   passes read the last pass's target directly instead of a copy
+    int width = renderFrameParameters->width;
+    int height = renderFrameParameters->height;
+    GLuint depth = gBuffer.g_depth;
+    RenderGraph& graph = postProcessGraph;
+    graph.Reset();
+
+    RenderGraph::Resource position = graph.Import("Position", gBuffer.g_position, width, height, GL_RGBA16F);
+    RenderGraph::Resource normal = graph.Import("Normal", gBuffer.g_normal, width, height, GL_RGBA16F);
+    RenderGraph::Resource diffuse = graph.Import("Diffuse", gBuffer.g_diffuse, width, height, GL_RGBA8);
+    RenderGraph::Resource specular = graph.Import("Specular", gBuffer.g_specular, width, height, GL_RGBA8);
+    RenderGraph::Resource transparent = graph.Import("Transparent",
+        transparencyGBuffer.g_diffuse, width, height, GL_RGBA8);
+
+    RenderGraph::Resource lit = graph.Create("Lit", width, height, GL_RGBA16F, depth);
+    graph.AddPass("Lighting", { position, normal, diffuse, specular }, lit, false,
+        [this](RenderGraph& graph) {
+            DrawLighting();
+        });
+
+    graph.AddPass("Transparency Composite", { transparent }, lit, true,
+        [this](RenderGraph& graph) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            quadShader->Use();
+            quadShader->DrawQuad(transparencyGBuffer.g_diffuse, quadShader->standardRemapMatrix);
+        });
+
+    if (renderFrameParameters->enableBloom) {
+        // The pyramid belongs to the bloom shader, so these write no graph target
+        graph.AddPass("Bloom High Pass", { lit }, RenderGraph::None, false,
+            [this, lit](RenderGraph& graph) {
+                bloomShader->HighPass(graph.GetTexture(lit),
+                    renderFrameParameters->bloomThreshold,
+                    renderFrameParameters->width,
+                    renderFrameParameters->height,
+                    renderFrameParameters->bloomLevels);
+            });
+        graph.AddPass("Bloom Downsample", {}, RenderGraph::None, false,
+            [this](RenderGraph& graph) {
+                bloomShader->Downsample();
+            });
+        graph.AddPass("Bloom Upsample", {}, RenderGraph::None, false,
+            [this](RenderGraph& graph) {
+                bloomShader->Upsample();
+            });
+        if (bloomShader->IsComparisonRequested()) {
+            graph.AddPass("Bloom Comparison", { lit }, RenderGraph::None, false,
+                [this, lit](RenderGraph& graph) {
+                    bloomShader->Compare(graph.GetTexture(lit),
+                        renderFrameParameters->bloomThreshold,
+                        renderFrameParameters->width,
+                        renderFrameParameters->height);
+                });
+        }
+
+        // Additive Bloom on top, upscaled from half resolution
+        graph.AddPass("Bloom Composite", {}, lit, true,
+            [this](RenderGraph& graph) {
+                GLuint bloomTexture = bloomShader->GetBloomTexture();
+                if (!bloomTexture) return;
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE);
+                quadShader->Use();
+                quadShader->DrawQuad(bloomTexture, quadShader->standardRemapMatrix,
+                    bloomShader->GetOutputScale());
+            });
+    }
+
+    RenderGraph::Resource current = lit;
+    bool drawDebug = !GetDebugRenderer().IsEmpty();
+    // Nothing to draw in between, antialias the tone mapped taps in one pass
+    if (renderFrameParameters->enableToneMapping &&
+        renderFrameParameters->enableAntialiasing && !drawDebug) {
+        RenderGraph::Resource output = graph.Create("Output", width, height, GL_RGBA8, depth);
+        graph.AddPass("Tone Mapping + FXAA", { current }, output, false,
+            [this, current](RenderGraph& graph) {
+                glDisable(GL_BLEND);
+                toneMappedFXAAShader->Use();
+                glUniform1f(uniformToneMappedFXAAExposure, renderFrameParameters->exposure);
+                DrawFXAA(*toneMappedFXAAShader, toneMappedFXAAUniforms, graph.GetTexture(current));
+            });
+        current = output;
+    }
+    else {
+        if (renderFrameParameters->enableToneMapping) {
+            RenderGraph::Resource mapped = graph.Create("Tone Mapped", width, height, GL_RGBA8, depth);
+            graph.AddPass("Tone Mapping", { current }, mapped, false,
+                [this, current](RenderGraph& graph) {
+                    glDisable(GL_BLEND);
+                    toneMappingShader->Use();
+                    glUniform1f(uniformToneMappingExposure, renderFrameParameters->exposure);
+                    toneMappingShader->DrawQuad(graph.GetTexture(current), toneMappingShader->standardRemapMatrix);
+                });
+            current = mapped;
+        }
+
+        // Render Debug Artifacts Before Antialiasing, depth tests against the gBuffer
+        if (drawDebug) {
+            graph.AddPass("Debug", {}, current, true,
+                [this](RenderGraph& graph) {
+                    glDisable(GL_BLEND);
+                    GetDebugRenderer().Render(renderFrameParameters->viewPos);
+                });
+        }
+
+        if (renderFrameParameters->enableAntialiasing) {
+            GLenum format = renderFrameParameters->enableToneMapping ? GL_RGBA8 : GL_RGBA16F;
+            RenderGraph::Resource output = graph.Create("Output", width, height, format, depth);
+            graph.AddPass("FXAA", { current }, output, false,
+                [this, current](RenderGraph& graph) {
+                    glDisable(GL_BLEND);
+                    fxaaShader->Use();
+                    DrawFXAA(*fxaaShader, fxaaUniforms, graph.GetTexture(current));
+                });
+            current = output;
+        }
+    }
+
+    graph.SetOutput(current);
+    graph.Run(profiler);
+
+    stats.postProcessPasses = graph.GetPassCount();
+    stats.postProcessTargets = targetPool.GetTargetCount();
+    size_t bytes = graph.GetBytes();
+    if (renderFrameParameters->enableBloom) {
+        bytes += bloomShader->GetBytesMoved();
+    }
+    stats.postProcessMegabytes = bytes / (1024.0 * 1024.0);
+
+    glBlendFunc(GL_ONE, GL_ZERO);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    // renderFrameParameters = nullptr;
+}
+
+DeferredRenderer::FXAAUniforms DeferredRenderer::GetFXAAUniforms(QuadShaderProgram& shader) {
+    FXAAUniforms uniforms;
+    uniforms.lumaThreshold = shader.GetUniformLocation("u_lumaThreshold");
+    uniforms.mulReduceReciprocal = shader.GetUniformLocation("u_mulReduce");
+    uniforms.minReduceReciprocal = shader.GetUniformLocation("u_minReduce");
+    uniforms.maxSpan = shader.GetUniformLocation("u_maxSpan");
+    return uniforms;
+}
 
-    // Copy Depth from GBuffer Over
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.fbo);
-    glBlitFramebuffer(0, 0, gBuffer.width, gBuffer.height,
-        0, 0, outputBuffer.width, outputBuffer.height,
-        GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-    outputBuffer.Bind();
+void DeferredRenderer::DrawLighting() {
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
 
     glEnable(GL_CULL_FACE);
     glEnable(GL_BLEND);
@@ -398,8 +855,27 @@ void DeferredRenderer::Draw(std::initializer_list<DrawLayer*> layers) {
         glActiveTexture(GL_TEXTURE3);
         glBindTexture(GL_TEXTURE_2D, gBuffer.g_specular);
 
-        for (auto& transformed : renderFrameParameters->lights) {
+        unclusteredLights.clear();
+        if (renderFrameParameters->enableClusteredLighting) {
+            // Same view the lighting shaders use, so clusters line up
+            lightClusters.Build(renderFrameParameters->lights,
+                renderFrameParameters->shadowView, renderFrameParameters->proj,
+                renderFrameParameters->viewNear, renderFrameParameters->viewFar,
+                renderFrameParameters->enableShadows, unclusteredLights);
+            stats.clusteredLights = lightClusters.GetLightCount();
+            stats.clusterLightIndices = lightClusters.GetIndexCount();
+            if (stats.clusteredLights > 0) {
+                clusteredLightShader->Use();
+                clusteredLightShader->RenderLighting(lightClusters);
+            }
+        }
+        else {
+            unclusteredLights = renderFrameParameters->lights;
+        }
+
+        for (auto& transformed : unclusteredLights) {
             LightNode* light = dynamic_cast<LightNode*>(transformed->node);
+            stats.lightPasses++;
             if (light->shape == LightShape::Point) {
                 pointLightShader->Use();
                 pointLightShader->RenderLighting(*transformed, assetManager);
@@ -425,99 +901,13 @@ void DeferredRenderer::Draw(std::initializer_list<DrawLayer*> layers) {
     }
 
     glDepthMask(GL_TRUE);
-    glEnable(GL_DEPTH_TEST);
-
-    // Draw Transparent Objects, Clear Color, keep depth
-    {
-        transparencyGBuffer.Bind();
-        glClearColor(0, 0, 0, 0);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.fbo);
-        glBlitFramebuffer(0, 0, gBuffer.width, gBuffer.height,
-            0, 0, transparencyGBuffer.width, transparencyGBuffer.height,
-            GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-        transparencyGBuffer.Bind();
-
-
-        geometryShader->Use();
-        for (auto& layer : layers) {
-            for (auto it = layer->transparent.rbegin(); it != layer->transparent.rend(); ++it) {
-                // LOG_DEBUG(it->second.mesh->name);
-                for (auto& param : it->second) {
-                    DrawObject(param);
-                }
-            }
-        }
-
-        outputBuffer.Bind();
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        GLuint diffuseTexture = transparencyGBuffer.g_diffuse;
-        quadShader->Use();
-        quadShader->DrawQuad(diffuseTexture, quadShader->standardRemapMatrix);
-
-    }
-
-    glBlendFunc(GL_ONE, GL_ZERO);
-
-    GLuint texture = outputBuffer.BlitTexture();
-    if (renderFrameParameters->enableBloom) {
-        texture = bloomShader->BloomTexture(
-            texture,
-            renderFrameParameters->bloomThreshold,
-            renderFrameParameters->width,
-            renderFrameParameters->height);
-
-        outputBuffer.Bind();
-
-        // Additive Bloom on top
-        glBlendFunc(GL_ONE, GL_ONE);
-        glDisable(GL_DEPTH_TEST);
-        quadShader->Use();
-        quadShader->DrawQuad(texture, quadShader->standardRemapMatrix);
-        texture = outputBuffer.BlitTexture();
-    }
-
-    if (renderFrameParameters->enableToneMapping) {
-        outputBuffer.Bind();
-        glBlendFunc(GL_ONE, GL_ZERO);
-        glDisable(GL_DEPTH_TEST);
-        toneMappingShader->Use();
-        glUniform1f(uniformToneMappingExposure, renderFrameParameters->exposure);
-        toneMappingShader->DrawQuad(texture, toneMappingShader->standardRemapMatrix);
-        texture = outputBuffer.BlitTexture();
-    }
-
-    // Render Debug Artifacts Before Antialiasing
-    {
-        outputBuffer.Bind();
-
-        // Copy depth into output
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.fbo);
-        glBlitFramebuffer(0, 0, gBuffer.width, gBuffer.height,
-            0, 0, outputBuffer.width, outputBuffer.height,
-            GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-
-        GetDebugRenderer().Render(renderFrameParameters->viewPos);
-        texture = outputBuffer.BlitTexture();
-    }
-
-    if (renderFrameParameters->enableAntialiasing) {
-        outputBuffer.Bind();
-        glBlendFunc(GL_ONE, GL_ZERO);
-        glDisable(GL_DEPTH_TEST);
-        fxaaShader->Use();
-        fxaaShader->SetTextureSize(outputBuffer.width, outputBuffer.height);
-        glUniform1f(uniformFXAALumaThreshold, renderFrameParameters->fxaaLumaThreshold);
-        glUniform1f(uniformFXAAMulReduceReciprocal, renderFrameParameters->fxaaMulReduceReciprocal);
-        glUniform1f(uniformFXAAMinReduceReciprocal, renderFrameParameters->fxaaMinReduceReciprocal);
-        glUniform1f(uniformFXAAMaxSpan, renderFrameParameters->fxaaMaxSpan);
-        fxaaShader->DrawQuad(texture, toneMappingShader->standardRemapMatrix);
-    }
-
-    // texture = outputBuffer.BlitTexture();
+}
 
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
-    // renderFrameParameters = nullptr;
+void DeferredRenderer::DrawFXAA(QuadShaderProgram& shader, const FXAAUniforms& uniforms, GLuint texture) {
+    shader.SetTextureSize(renderFrameParameters->width, renderFrameParameters->height);
+    glUniform1f(uniforms.lumaThreshold, renderFrameParameters->fxaaLumaThreshold);
+    glUniform1f(uniforms.mulReduceReciprocal, renderFrameParameters->fxaaMulReduceReciprocal);
+    glUniform1f(uniforms.minReduceReciprocal, renderFrameParameters->fxaaMinReduceReciprocal);
+    glUniform1f(uniforms.maxSpan, renderFrameParameters->fxaaMaxSpan);
+    shader.DrawQuad(texture, shader.standardRemapMatrix);
 }
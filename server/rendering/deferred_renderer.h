@@ -7,6 +7,10 @@
 #include "scene.h"
 #include "bloom.h"
 #include "debug_renderer.h"
+#include "frustum.h"
+#include "light_clusters.h"
+#include "gpu_profiler.h"
+#include "render_graph.h"
 
 // Everything must be loaded in, don't depend on game instance
 
@@ -18,29 +22,66 @@ struct DrawParams {
     bool hasOutline = false;
     bool isWireframe = false;
     Material* overrideMaterial = nullptr;
+    // World space bounds, used to cull shadow casters per cascade
+    AABB bounds;
+    bool hasBounds = false;
+    // Never moves, its shadow can be cached between frames
+    bool isStatic = false;
+    // Skinning matrices of a skinned mesh, have to live until the frame is
+    //   drawn. Skinned draws aren't instanced
+    const Matrix4* bones = nullptr;
+    size_t boneCount = 0;
+};
+
+// Which casters a shadow pass draws
+enum class ShadowCasters { All, Static, Dynamic };
+
+// Index into DrawLayer::draws ordered by a packed key
+//   opaque:      0 | mesh (20) | material (20) | depth front to back (23)
+//   transparent: 1 | depth back to front (32) | unused (31)
+//   Mesh is above material so every draw of a mesh is adjacent whatever
+//   material it overrides with, instancing batches by mesh. Meshes get
+//   their ids as they load, so the meshes of one model, which usually
+//   share materials, still sort next to each other.
+struct DrawCommand {
+    uint64_t key;
+    uint32_t index;
+    float depth;
 };
 
 struct DrawLayer {
-    // std::map<float, std::vector<DrawParams>> opaque;
-    std::map<Material*, std::vector<DrawParams>> opaque;
-    std::map<float, std::vector<DrawParams>> transparent;
+    // Storage is kept between frames, Clear() doesn't free anything
+    std::vector<DrawParams> draws;
+    std::vector<DrawCommand> commands;
+    std::vector<DrawCommand> sortScratch;
+
+    // After Sort(), commands[0, opaqueCount) are opaque and the rest transparent
+    size_t opaqueCount = 0;
+
+    // Only contributes shadow casters, skipped by the geometry passes
+    bool shadowOnly = false;
 
     void Clear() {
-        opaque.clear();
-        transparent.clear();
+        draws.clear();
+        commands.clear();
+        opaqueCount = 0;
     }
 
-    DrawParams& PushOpaque(Material* material) {
-        auto& list = opaque[material];
-        list.reserve(500);
-        return list.emplace_back();
+    // Depth is the distance (or squared distance) from the viewer
+    DrawParams& PushOpaque(float depth = 0.0f) {
+        commands.push_back(DrawCommand{ 0, (uint32_t) draws.size(), depth });
+        return draws.emplace_back();
     }
 
     DrawParams& PushTransparent(float depth) {
-        auto& list = transparent[depth];
-        list.reserve(500);
-        return list.emplace_back();
+        commands.push_back(DrawCommand{ 1ull << 63, (uint32_t) draws.size(), depth });
+        return draws.emplace_back();
     }
+
+    // Builds the keys from the pushed params and radix sorts the commands
+    void Sort();
+
+    const DrawParams& GetOpaque(size_t i) const { return draws[commands[i].index]; }
 };
 
 struct RenderFrameParameters {
@@ -72,16 +113,32 @@ struct RenderFrameParameters {
 
     bool enableLighting = false;
 
+    // Resolve unshadowed point and rectangle lights in one clustered pass
+    bool enableClusteredLighting = true;
+
     bool enableShadows = false;
+    // Keep static casters in a per cascade cache, only dynamic ones are redrawn
+    bool enableShadowCaching = true;
+    // Changes whenever a static caster is added, removed or moved, the cache
+    //   is redrawn when it does. Zero if the caller doesn't keep track, the
+    //   static casters are then hashed every frame
+    size_t staticCasterVersion = 0;
+    // Redraw the far cascade every N shadow updates
+    int farCascadeUpdateInterval = 1;
 
     bool enableBloom = false;
     float bloomThreshold = 1.0f;
+    // Downsample levels in the bloom pyramid, each one doubles the blur radius
+    int bloomLevels = 6;
 
     bool enableToneMapping = false;
     float exposure = 1.0f;
 
     bool enableAntialiasing = false;
 
+    // Batch opaque meshes into instanced draws
+    bool enableInstancing = true;
+
     float fxaaLumaThreshold = 0.5f;
     float fxaaMulReduceReciprocal = 1.0f / 8.0f;
     float fxaaMinReduceReciprocal = 1.0f / 128.0f;
@@ -98,6 +155,50 @@ struct RenderFrameParameters {
     } debugSettings;
 };
 
+// Counted per frame, reset in NewFrame
+struct RenderStats {
+    // Every draw call issued for meshes, includes instanced and shadow calls
+    size_t drawCalls = 0;
+    size_t instancedDrawCalls = 0;
+    // Meshes drawn through instanced calls
+    size_t instances = 0;
+    size_t shadowDrawCalls = 0;
+    // CPU time sorting the layers and issuing the opaque and transparent
+    //   geometry, measured in Draw
+    double sortMs = 0;
+    double submitMs = 0;
+    // Shadow casters outside of a cascade's light frustum, summed over cascades
+    size_t shadowCastersCulled = 0;
+    // Cascades whose static casters were redrawn or reused from the cache
+    size_t shadowCacheUpdates = 0;
+    size_t shadowCascadesCached = 0;
+    // Far cascades left as they were because of farCascadeUpdateInterval
+    size_t shadowCascadesSkipped = 0;
+    // GPU time of the shadow pass, filled from the profiler in EndFrame
+    double shadowMs = 0;
+    // Lights resolved by the clustered pass and lights drawn with their own pass
+    size_t clusteredLights = 0;
+    size_t lightPasses = 0;
+    size_t clusterLightIndices = 0;
+    // GPU time of the bloom passes, from the profiler like shadowMs
+    double bloomHighPassMs = 0;
+    double bloomDownsampleMs = 0;
+    double bloomUpsampleMs = 0;
+    // Full screen passes after the geometry, the pooled targets they used and
+    //   their estimated color traffic
+    size_t postProcessPasses = 0;
+    size_t postProcessTargets = 0;
+    double postProcessMegabytes = 0;
+};
+
+// A run of opaque draws sharing a mesh, transforms are contiguous in the
+//   instance buffer starting at offset
+struct InstanceBatch {
+    Mesh* mesh;
+    size_t offset;
+    size_t count;
+};
+
 class DeferredRenderer {
     bool isInitialized = false;
     AssetManager& assetManager;
@@ -110,7 +211,10 @@ class DeferredRenderer {
     GBuffer gBuffer;
     GBuffer transparencyGBuffer;
 
-    RenderBuffer outputBuffer;
+    // Lighting onwards reads and writes pooled targets, the gBuffer depth is
+    //   attached to them rather than copied
+    RenderTargetPool targetPool;
+    RenderGraph postProcessGraph { targetPool };
 
     RenderFrameParameters* renderFrameParameters = nullptr;
 
@@ -119,6 +223,11 @@ class DeferredRenderer {
     DeferredShadingLightingShaderProgram* rectangleLightShader;
     DeferredShadingLightingShaderProgram* directionalLightShader;
 
+    ClusteredLightingShaderProgram* clusteredLightShader;
+    LightClusters lightClusters;
+    // Lights the clustered pass doesn't handle, drawn one pass each
+    std::vector<TransformedLight*> unclusteredLights;
+
     QuadShaderProgram* skydomeShader;
     ShadowMapShaderProgram* shadowMapShader;
 
@@ -128,22 +237,70 @@ class DeferredRenderer {
     QuadShaderProgram* toneMappingShader;
     GLint uniformToneMappingExposure;
 
+    struct FXAAUniforms {
+        GLint lumaThreshold;
+        GLint mulReduceReciprocal;
+        GLint minReduceReciprocal;
+        GLint maxSpan;
+    };
+
     QuadShaderProgram* fxaaShader;
-    GLint uniformFXAALumaThreshold;
-    GLint uniformFXAAMulReduceReciprocal;
-    GLint uniformFXAAMinReduceReciprocal;
-    GLint uniformFXAAMaxSpan;
+    FXAAUniforms fxaaUniforms;
+    // Tone mapping and FXAA in one pass, used when nothing draws in between
+    QuadShaderProgram* toneMappedFXAAShader;
+    FXAAUniforms toneMappedFXAAUniforms;
+    GLint uniformToneMappedFXAAExposure;
     GLint uniformSkydomeDirection;
     GLint uniformSkydomeFOV;
     GLint uniformSkydomeWidth;
     GLint uniformSkydomeHeight;
 
+    RenderStats stats;
+
+    // Instancing, scratch space is kept between frames to avoid allocations
+    InstanceBuffer geometryInstances;
+    InstanceBuffer shadowInstances;
+    std::vector<Matrix4> instanceTransforms;
+    std::vector<const DrawParams*> batchScratch;
+    std::vector<InstanceBatch> geometryBatches;
+    std::vector<InstanceBatch> shadowBatches;
+    std::vector<const DrawParams*> skinnedShadowCasters;
+
+    // Every palette of the frame goes up in one upload after sorting
+    BoneBuffer boneBuffer;
+    std::vector<Matrix4> bonePalettes;
+    std::unordered_map<const Matrix4*, size_t> paletteIndices;
+    void UploadBonePalettes(std::initializer_list<DrawLayer*> layers);
+    // Skinned or not, by whether the params have bones
+    void DrawGeometryMesh(const DrawParams& params);
+    void DrawShadowMesh(const DrawParams& params);
+
+    // Appends a batch per run of the same mesh to batches. Doesn't sort,
+    //   params have to arrive in sort key order, which puts equal meshes
+    //   together
+    void AppendInstanceBatches(const std::vector<const DrawParams*>& params,
+        std::vector<InstanceBatch>& batches);
+    void PrepareShadowBatches(std::initializer_list<DrawLayer*> layers, const Frustum& frustum,
+        ShadowCasters casters);
+    void DrawShadowCascade(TransformedLight* transformed, std::initializer_list<DrawLayer*> layers,
+        size_t cascade, const Matrix4& lightView, const Matrix4& lightProjection,
+        size_t staticSignature);
+
+    GPUProfiler profiler;
+
+    static FXAAUniforms GetFXAAUniforms(QuadShaderProgram& shader);
+    // Ambient, skydome and every light into the bound target
+    void DrawLighting();
+    // Shader must be in use, its exposure (if any) already set
+    void DrawFXAA(QuadShaderProgram& shader, const FXAAUniforms& uniforms, GLuint texture);
+
 public:
 
     DeferredRenderer(AssetManager& assetManager);
 
     void Initialize();
-    void DrawShadowObjects(std::initializer_list<DrawLayer*> layers);
+    void DrawShadowObjects(std::initializer_list<DrawLayer*> layers, const Frustum& frustum,
+        ShadowCasters casters = ShadowCasters::All);
     void DrawObject(const DrawParams& params);
 
     void NewFrame(RenderFrameParameters* params);
@@ -154,7 +311,8 @@ public:
 
     QuadShaderProgram& GetQuadShader() { return *quadShader; }
 
-    GLuint GetRenderedTexture() { return outputBuffer.BlitTexture(); }
+    // Valid until the next Draw
+    GLuint GetRenderedTexture() { return postProcessGraph.GetOutputTexture(); }
 
     bool IsInitialized() {
         return isInitialized;
@@ -172,11 +330,15 @@ public:
         return bloomShader;
     }
 
-    RenderBuffer& GetOutputBuffer() {
-        return outputBuffer;
-    }
-
     DebugRenderer& GetDebugRenderer() {
         return debugRenderer;
     }
+
+    const RenderStats& GetRenderStats() const {
+        return stats;
+    }
+
+    GPUProfiler& GetProfiler() {
+        return profiler;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "gpu_profiler.h"
+#include "timer.h"
+#include "trace.h"
+
+#include <algorithm>
+
+GPUProfiler::Pass* GPUProfiler::FindPass(const char* name) {
+    if (nextIndex < passes.size() && passes[nextIndex]->name == name) {
+        return passes[nextIndex++].get();
+    }
+
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (passes[i]->name == name) {
+            nextIndex = i + 1;
+            return passes[i].get();
+        }
+    }
+
+    // First time this pass ran, keep it after the pass before it
+    auto pass = std::make_unique<Pass>();
+    pass->name = name;
+    Pass* result = pass.get();
+    size_t index = std::min(nextIndex, passes.size());
+    passes.insert(passes.begin() + index, std::move(pass));
+    nextIndex = index + 1;
+    return result;
+}
+
+void GPUProfiler::BeginFrame() {
+    End();
+    nextIndex = 0;
+#ifdef BUILD_CLIENT
+    bool disjoint = GPUTimer::TakeDisjoint();
+#else
+    bool disjoint = false;
+#endif
+    for (auto& pass : passes) {
+        pass->active = false;
+        pass->cpuMilliseconds = 0;
+        if (disjoint) {
+            pass->timer.Discard();
+        }
+    }
+}
+
+void GPUProfiler::EndFrame() {
+    End();
+}
+
+void GPUProfiler::Begin(const char* name) {
+    End();
+    if (!enabled) return;
+
+    current = FindPass(name);
+    current->active = true;
+    current->timer.Begin();
+    currentStart = Trace::Now();
+}
+
+void GPUProfiler::End() {
+    if (!current) return;
+    current->timer.End();
+    uint64_t end = Trace::Now();
+    current->cpuMilliseconds += (end - currentStart) / 1e6;
+    // Passes live as long as the profiler, their names can be traced as is
+    if (Trace::IsEnabled()) {
+        Trace::Record(current->name.c_str(), currentStart, end);
+    }
+    current = nullptr;
+}
+
+double GPUProfiler::GetGPUMilliseconds(const char* name) const {
+    for (auto& pass : passes) {
+        if (pass->active && pass->name == name) {
+            return pass->timer.GetMilliseconds();
+        }
+    }
+    return 0;
+}
+
+double GPUProfiler::GetGPUTotal() const {
+    double total = 0;
+    for (auto& pass : passes) {
+        if (pass->active) total += pass->timer.GetMilliseconds();
+    }
+    return total;
+}
+
+double GPUProfiler::GetCPUTotal() const {
+    double total = 0;
+    for (auto& pass : passes) {
+        if (pass->active) total += pass->cpuMilliseconds;
+    }
+    return total;
+}
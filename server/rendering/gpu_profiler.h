@@ -0,0 +1,65 @@
+#pragma once
+
+#include "gpu_timer.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Named per pass GPU and CPU timings for a frame. Passes are flat, beginning
+//   a pass ends the one before it, since timer queries can't nest.
+//   GPU times are a few frames old, see GPUTimer. Names should be unique
+//   within a frame.
+class GPUProfiler {
+public:
+    struct Pass {
+        std::string name;
+        GPUTimer timer;
+        // Time spent on the CPU issuing the pass
+        double cpuMilliseconds = 0;
+        // Whether the pass ran during the last frame
+        bool active = false;
+    };
+
+private:
+    std::vector<std::unique_ptr<Pass>> passes;
+    // Passes usually run in the same order every frame, so the next one is
+    //   checked before searching
+    size_t nextIndex = 0;
+    Pass* current = nullptr;
+    // Nanoseconds, Trace::Now
+    uint64_t currentStart = 0;
+
+    Pass* FindPass(const char* name);
+
+public:
+    bool enabled = true;
+
+    void BeginFrame();
+    void EndFrame();
+
+    void Begin(const char* name);
+    void End();
+
+    const std::vector<std::unique_ptr<Pass>>& GetPasses() const {
+        return passes;
+    }
+
+    // Zero if the pass didn't run last frame
+    double GetGPUMilliseconds(const char* name) const;
+    double GetGPUTotal() const;
+    double GetCPUTotal() const;
+};
+
+// Times a block as one pass of the profiler
+class ScopedGPUPass {
+    GPUProfiler& profiler;
+public:
+    ScopedGPUPass(GPUProfiler& profiler, const char* name) : profiler(profiler) {
+        profiler.Begin(name);
+    }
+    ~ScopedGPUPass() {
+        profiler.End();
+    }
+};
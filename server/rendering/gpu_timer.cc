@@ -0,0 +1,60 @@
+#include "gpu_timer.h"
+
+GPUTimer::~GPUTimer() {
+    if (queries[0]) {
+        glDeleteQueries(QueryCount, queries);
+    }
+}
+
+void GPUTimer::Collect() {
+    for (int i = 0; i < QueryCount; i++) {
+        int index = (next + i) % QueryCount;
+        if (!pending[index]) continue;
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        GLuint nanoseconds = 0;
+        glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT, &nanoseconds);
+        lastMilliseconds = nanoseconds / 1000000.0;
+        pending[index] = false;
+    }
+}
+
+void GPUTimer::Begin() {
+    if (!supported) return;
+    if (!queries[0]) {
+        glGenQueries(QueryCount, queries);
+    }
+
+    Collect();
+    // Every query is still in flight, skip this measurement
+    if (pending[next]) return;
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    running = true;
+}
+
+void GPUTimer::Discard() {
+    for (bool& query : pending) {
+        query = false;
+    }
+}
+
+#ifdef BUILD_CLIENT
+bool GPUTimer::TakeDisjoint() {
+    if (!supported) return false;
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    return disjoint;
+}
+#endif
+
+void GPUTimer::End() {
+    if (!running) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[next] = true;
+    next = (next + 1) % QueryCount;
+    running = false;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "opengl.h"
+
+// GL_TIME_ELAPSED_EXT from EXT_disjoint_timer_query_webgl2 has the same value
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+// Measures GPU time between Begin and End with timer queries. Results come
+//   back a few frames late, queries are kept in a ring so reading never stalls.
+//   Only one timer can be running at a time.
+class GPUTimer {
+    static constexpr int QueryCount = 4;
+    GLuint queries[QueryCount] = {};
+    bool pending[QueryCount] = {};
+    int next = 0;
+    bool running = false;
+
+    double lastMilliseconds = 0;
+
+    // Reads back every finished query, oldest first
+    void Collect();
+
+public:
+    // Desktop GL always has timer queries, WebGL needs the extension
+    #ifdef BUILD_EDITOR
+        inline static bool supported = true;
+    #else
+        inline static bool supported = false;
+    #endif
+
+    GPUTimer() {}
+    GPUTimer(const GPUTimer&) = delete;
+    GPUTimer& operator=(const GPUTimer&) = delete;
+    ~GPUTimer();
+
+    void Begin();
+    void End();
+    // Forgets the queries in flight, their results can't be trusted
+    void Discard();
+
+#ifdef BUILD_CLIENT
+    // Whether anything, like a clock change, made the queries since the last
+    //   call unreliable. Resets on reading, so once per frame for every timer
+    static bool TakeDisjoint();
+#endif
+
+    // Most recent completed measurement
+    double GetMilliseconds() const { return lastMilliseconds; }
+};
@@ -0,0 +1,234 @@
+#include "light_clusters.h"
+
+#include <cmath>
+
+static AABB UnitVolume(Vector3(-0.5f), Vector3(0.5f));
+
+static GLuint CreateDataTexture(GLenum internalFormat, GLenum format, GLenum type,
+        int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    // Only read with texelFetch, float and integer textures can't be filtered
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+static void WriteMatrix(float* out, const Matrix4& matrix) {
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            out[column * 4 + row] = matrix[column][row];
+        }
+    }
+}
+
+void LightClusters::Initialize() {
+    int indexRows = (ClusterCount * MaxLightsPerCluster + IndexTextureWidth - 1) / IndexTextureWidth;
+
+    lightTexture = CreateDataTexture(GL_RGBA32F, GL_RGBA, GL_FLOAT, LightTexels, MaxLights);
+    clusterTexture = CreateDataTexture(GL_RG32UI, GL_RG_INTEGER, GL_UNSIGNED_INT,
+        TilesX * TilesY, Slices);
+    indexTexture = CreateDataTexture(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+        IndexTextureWidth, indexRows);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    lightData.reserve(MaxLights * LightTexels * 4);
+    clusterLights.resize(ClusterCount * MaxLightsPerCluster);
+    clusterCounts.resize(ClusterCount);
+    clusterData.resize(ClusterCount * 2);
+}
+
+void LightClusters::BuildClusterBounds(const Matrix4& proj, float viewNear, float viewFar) {
+    if (!clusterBounds.empty() && proj == boundsProj &&
+        viewNear == boundsNear && viewFar == boundsFar) {
+        return;
+    }
+    boundsProj = proj;
+    boundsNear = viewNear;
+    boundsFar = viewFar;
+
+    clusterNear = viewNear;
+    sliceScale = Slices / std::log(viewFar / viewNear);
+
+    // Tile corners on the near and far planes in view space, a point at some
+    //   depth is found by walking from the near to the far corner
+    Matrix4 inverseProj = glm::inverse(proj);
+    auto unproject = [&](float x, float y, float z) {
+        Vector4 point = inverseProj * Vector4(x, y, z, 1);
+        return Vector3(point) / point.w;
+    };
+
+    clusterBounds.resize(ClusterCount);
+    for (int slice = 0; slice < Slices; slice++) {
+        float sliceNear = viewNear * std::pow(viewFar / viewNear, (float) slice / Slices);
+        float sliceFar = viewNear * std::pow(viewFar / viewNear, (float) (slice + 1) / Slices);
+        for (int y = 0; y < TilesY; y++) {
+            for (int x = 0; x < TilesX; x++) {
+                Vector3 corners[8];
+                int c = 0;
+                for (int cy = 0; cy < 2; cy++) {
+                    for (int cx = 0; cx < 2; cx++) {
+                        float ndcX = -1.0f + 2.0f * (float) (x + cx) / TilesX;
+                        float ndcY = -1.0f + 2.0f * (float) (y + cy) / TilesY;
+                        Vector3 nearPoint = unproject(ndcX, ndcY, -1);
+                        Vector3 farPoint = unproject(ndcX, ndcY, 1);
+                        // View space looks down -z
+                        for (float depth : { sliceNear, sliceFar }) {
+                            float t = (-depth - nearPoint.z) / (farPoint.z - nearPoint.z);
+                            corners[c++] = glm::mix(nearPoint, farPoint, t);
+                        }
+                    }
+                }
+                clusterBounds[(slice * TilesY + y) * TilesX + x] = AABB(corners, 8);
+            }
+        }
+    }
+}
+
+void LightClusters::Build(const std::vector<TransformedLight*>& lights,
+        const Matrix4& view, const Matrix4& proj,
+        float viewNear, float viewFar, bool enableShadows,
+        std::vector<TransformedLight*>& unclustered) {
+    BuildClusterBounds(proj, viewNear, viewFar);
+
+    lightData.clear();
+    std::fill(clusterCounts.begin(), clusterCounts.end(), 0);
+    lightCount = 0;
+    overflowCount = 0;
+
+    float logDepthRange = std::log(viewFar / viewNear);
+    for (auto& transformed : lights) {
+        LightNode* light = dynamic_cast<LightNode*>(transformed->node);
+        bool clusterable =
+            (light->shape == LightShape::Point || light->shape == LightShape::Rectangle) &&
+            !(enableShadows && light->shadowMapSize > 0) &&
+            lightCount < MaxLights;
+        if (!clusterable) {
+            unclustered.push_back(transformed);
+            continue;
+        }
+
+        // Same volumes the per light passes rasterize
+        Matrix4 volumeTransform = light->shape == LightShape::Point ?
+            transformed->transform : light->GetRectangleVolumeTransform(transformed->transform);
+        AABB bounds = UnitVolume.Transformed(view * volumeTransform);
+
+        float minDepth = -bounds.ptMax.z;
+        float maxDepth = -bounds.ptMin.z;
+        if (maxDepth < viewNear || minDepth > viewFar) continue;
+
+        int firstSlice = minDepth <= viewNear ? 0 :
+            (int) (std::log(minDepth / viewNear) / logDepthRange * Slices);
+        int lastSlice = maxDepth >= viewFar ? Slices - 1 :
+            (int) (std::log(maxDepth / viewNear) / logDepthRange * Slices);
+        firstSlice = glm::clamp(firstSlice, 0, Slices - 1);
+        lastSlice = glm::clamp(lastSlice, 0, Slices - 1);
+
+        auto overlaps = [&](int cluster) {
+            const AABB& box = clusterBounds[cluster];
+            return !(bounds.ptMin.x > box.ptMax.x || bounds.ptMax.x < box.ptMin.x ||
+                bounds.ptMin.y > box.ptMax.y || bounds.ptMax.y < box.ptMin.y ||
+                bounds.ptMin.z > box.ptMax.z || bounds.ptMax.z < box.ptMin.z);
+        };
+        // Only binned if every cluster it touches has room, a light left
+        //   out of some of them would go missing there
+        bool touches = false;
+        bool fits = true;
+        for (int slice = firstSlice; slice <= lastSlice; slice++) {
+            for (int tile = 0; tile < TilesX * TilesY; tile++) {
+                int cluster = slice * TilesX * TilesY + tile;
+                if (!overlaps(cluster)) continue;
+                touches = true;
+                if (clusterCounts[cluster] == MaxLightsPerCluster) {
+                    fits = false;
+                }
+            }
+        }
+        if (!touches) continue;
+        if (!fits) {
+            overflowCount++;
+            unclustered.push_back(transformed);
+            continue;
+        }
+
+        uint16_t lightIndex = (uint16_t) lightCount;
+        for (int slice = firstSlice; slice <= lastSlice; slice++) {
+            for (int tile = 0; tile < TilesX * TilesY; tile++) {
+                int cluster = slice * TilesX * TilesY + tile;
+                if (!overlaps(cluster)) continue;
+                clusterLights[cluster * MaxLightsPerCluster + clusterCounts[cluster]++] = lightIndex;
+            }
+        }
+
+        // Row layout, matches MeshLightingClustered.fs
+        //   0: position, shape    1: color * strength
+        //   2-5: inverse transform    6-9: transform
+        //   10-13: inverse volume transform
+        size_t start = lightData.size();
+        lightData.resize(start + LightTexels * 4);
+        float* row = &lightData[start];
+        row[0] = transformed->transformedPosition.x;
+        row[1] = transformed->transformedPosition.y;
+        row[2] = transformed->transformedPosition.z;
+        row[3] = light->shape == LightShape::Rectangle ? 1.0f : 0.0f;
+        row[4] = light->color.r * light->strength;
+        row[5] = light->color.g * light->strength;
+        row[6] = light->color.b * light->strength;
+        row[7] = 0.0f;
+        WriteMatrix(row + 8, glm::inverse(transformed->transform));
+        WriteMatrix(row + 24, transformed->transform);
+        WriteMatrix(row + 40, glm::inverse(volumeTransform));
+        lightCount++;
+    }
+
+    // Compact the fixed size per cluster lists into one index list
+    indices.clear();
+    for (int cluster = 0; cluster < ClusterCount; cluster++) {
+        uint32_t count = clusterCounts[cluster];
+        clusterData[cluster * 2] = (uint32_t) indices.size();
+        clusterData[cluster * 2 + 1] = count;
+        const uint16_t* list = &clusterLights[cluster * MaxLightsPerCluster];
+        indices.insert(indices.end(), list, list + count);
+    }
+
+    indexCount = indices.size();
+
+    if (lightCount > 0) {
+        glBindTexture(GL_TEXTURE_2D, lightTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LightTexels, lightCount,
+            GL_RGBA, GL_FLOAT, lightData.data());
+    }
+
+    glBindTexture(GL_TEXTURE_2D, clusterTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TilesX * TilesY, Slices,
+        GL_RG_INTEGER, GL_UNSIGNED_INT, clusterData.data());
+
+    if (indexCount > 0) {
+        size_t rows = (indexCount + IndexTextureWidth - 1) / IndexTextureWidth;
+        indices.resize(rows * IndexTextureWidth, 0);
+        glBindTexture(GL_TEXTURE_2D, indexTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, IndexTextureWidth, rows,
+            GL_RED_INTEGER, GL_UNSIGNED_INT, indices.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void LightClusters::BindTextures(GLenum firstUnit) {
+    glActiveTexture(firstUnit);
+    glBindTexture(GL_TEXTURE_2D, lightTexture);
+    glActiveTexture(firstUnit + 1);
+    glBindTexture(GL_TEXTURE_2D, clusterTexture);
+    glActiveTexture(firstUnit + 2);
+    glBindTexture(GL_TEXTURE_2D, indexTexture);
+}
+
+void LightClusters::UnbindTextures(GLenum firstUnit) {
+    for (GLenum i = 0; i < 3; i++) {
+        glActiveTexture(firstUnit + i);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
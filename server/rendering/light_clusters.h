@@ -0,0 +1,75 @@
+#pragma once
+
+#include "opengl.h"
+#include "vector.h"
+#include "aabb.h"
+#include "scene.h"
+
+#include <vector>
+
+// Froxel grid over the view frustum (screen tiles x exponential depth slices).
+//   Point and rectangle lights are binned on the CPU each frame and the
+//   per cluster light lists are uploaded as textures, so every unshadowed
+//   light is resolved in one full screen pass instead of a pass per light.
+class LightClusters {
+public:
+    static constexpr int TilesX = 16;
+    static constexpr int TilesY = 9;
+    static constexpr int Slices = 24;
+    static constexpr int ClusterCount = TilesX * TilesY * Slices;
+
+    static constexpr int MaxLights = 1024;
+    static constexpr int MaxLightsPerCluster = 64;
+    // RGBA32F texels per light row in the light texture
+    static constexpr int LightTexels = 14;
+    static constexpr int IndexTextureWidth = 1024;
+
+private:
+    GLuint lightTexture = 0;
+    GLuint clusterTexture = 0;
+    GLuint indexTexture = 0;
+
+    // View space bounds per cluster, rebuilt when the projection changes
+    std::vector<AABB> clusterBounds;
+    Matrix4 boundsProj;
+    float boundsNear = 0;
+    float boundsFar = 0;
+
+    // Scratch space is kept between frames to avoid allocations
+    std::vector<float> lightData;
+    std::vector<uint16_t> clusterLights;
+    std::vector<uint32_t> clusterCounts;
+    std::vector<uint32_t> clusterData;
+    std::vector<uint32_t> indices;
+
+    size_t lightCount = 0;
+    size_t indexCount = 0;
+    size_t overflowCount = 0;
+
+    void BuildClusterBounds(const Matrix4& proj, float viewNear, float viewFar);
+
+public:
+    // Depth of the first slice boundary and Slices / log(far / near),
+    //   the slice for a view depth is log(depth / near) * sliceScale
+    float clusterNear = 0;
+    float sliceScale = 0;
+
+    void Initialize();
+
+    // Bins every point and rectangle light without a shadow map, the rest
+    //   (directional, shadowed, over MaxLights) are appended to unclustered
+    void Build(const std::vector<TransformedLight*>& lights,
+        const Matrix4& view, const Matrix4& proj,
+        float viewNear, float viewFar, bool enableShadows,
+        std::vector<TransformedLight*>& unclustered);
+
+    // Binds the light, cluster and index textures to firstUnit onwards
+    void BindTextures(GLenum firstUnit);
+    void UnbindTextures(GLenum firstUnit);
+
+    size_t GetLightCount() const { return lightCount; }
+    size_t GetIndexCount() const { return indexCount; }
+    // Lights sent back to the per light passes because a cluster they
+    //   touch was full
+    size_t GetOverflowCount() const { return overflowCount; }
+};
@@ -0,0 +1,214 @@
+#include "mesh_buffer.h"
+#include "mesh.h"
+#include "logging.h"
+
+#include <algorithm>
+
+bool MeshBuffer::RangeAllocator::Allocate(size_t count, size_t& offset) {
+    if (count == 0) {
+        offset = 0;
+        return true;
+    }
+    for (size_t i = 0; i < freeRanges.size(); i++) {
+        Range& range = freeRanges[i];
+        if (range.count < count) continue;
+
+        offset = range.offset;
+        range.offset += count;
+        range.count -= count;
+        if (range.count == 0) {
+            freeRanges.erase(freeRanges.begin() + i);
+        }
+        return true;
+    }
+    return false;
+}
+
+void MeshBuffer::RangeAllocator::Free(size_t offset, size_t count) {
+    if (count == 0) return;
+    auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset,
+        [](const Range& range, size_t value) { return range.offset < value; });
+    it = freeRanges.insert(it, Range { offset, count });
+
+    // Merge with the neighbours so large meshes can reuse the space
+    auto next = it + 1;
+    if (next != freeRanges.end() && it->offset + it->count == next->offset) {
+        it->count += next->count;
+        freeRanges.erase(next);
+    }
+    if (it != freeRanges.begin()) {
+        auto previous = it - 1;
+        if (previous->offset + previous->count == it->offset) {
+            previous->count += it->count;
+            freeRanges.erase(it);
+        }
+    }
+}
+
+void MeshBuffer::RangeAllocator::Grow(size_t newCapacity) {
+    size_t oldCapacity = capacity;
+    capacity = newCapacity;
+    Free(oldCapacity, newCapacity - oldCapacity);
+}
+
+MeshBuffer::MeshBuffer(VertexFormat format, size_t vertexSize,
+        size_t initialVertices, size_t initialIndices, size_t streamVertices) :
+        format(format), vertexSize(vertexSize), streamCapacity(streamVertices) {
+    glGenVertexArrays(1, &vao);
+
+    // Room for the streaming ring on top of the meshes
+    vbo = CreateBuffer(GL_ARRAY_BUFFER, (initialVertices + streamVertices) * vertexSize);
+    vertexRanges.Grow(initialVertices + streamVertices);
+
+    ibo = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, initialIndices * sizeof(unsigned int));
+    indexRanges.Grow(initialIndices);
+
+    SetupVertexArray();
+
+    // Taken from the front before any mesh, the ring never moves or grows
+    vertexRanges.Allocate(streamCapacity, streamFirst);
+}
+
+MeshBuffer& MeshBuffer::Get(VertexFormat format) {
+    // Created on first use, there has to be a context by then
+    static MeshBuffer standard(VertexFormat::Standard, sizeof(Vertex), 1 << 16, 1 << 18);
+    // Debug lines are streamed, two vertices each
+    static MeshBuffer position(VertexFormat::Position, 3 * sizeof(float), 1 << 10, 1 << 12, 1 << 14);
+    static MeshBuffer skinned(VertexFormat::Skinned, sizeof(SkinnedVertex), 1 << 12, 1 << 14);
+    switch (format) {
+        case VertexFormat::Position: return position;
+        case VertexFormat::Skinned: return skinned;
+        default: return standard;
+    }
+}
+
+void MeshBuffer::SetupVertexArray() {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    if (format == VertexFormat::Standard || format == VertexFormat::Skinned) {
+        // A SkinnedVertex starts with a Vertex, only the stride differs
+        glVertexAttribPointer(0,
+            3, GL_FLOAT, false, vertexSize, (const void*)offsetof(Vertex, position));
+        glEnableVertexAttribArray(0);
+
+        glVertexAttribPointer(1,
+            3, GL_FLOAT, false, vertexSize, (const void*)offsetof(Vertex, normal));
+        glEnableVertexAttribArray(1);
+
+        glVertexAttribPointer(2,
+            2, GL_FLOAT, false, vertexSize, (const void*)offsetof(Vertex, texCoords));
+        glEnableVertexAttribArray(2);
+
+        glVertexAttribPointer(3,
+            3, GL_FLOAT, false, vertexSize, (const void*)offsetof(Vertex, tangent));
+        glEnableVertexAttribArray(3);
+
+        glVertexAttribPointer(4,
+            3, GL_FLOAT, false, vertexSize, (const void*)offsetof(Vertex, smoothedNormal));
+        glEnableVertexAttribArray(4);
+    }
+    if (format == VertexFormat::Skinned) {
+        // Float attributes rather than integer ones, WebGL rejects draws of
+        //   rigid meshes with the same shader if an unused attribute is an
+        //   integer type
+        glVertexAttribPointer(9,
+            4, GL_UNSIGNED_BYTE, false, vertexSize, (const void*)offsetof(SkinnedVertex, skin.bones));
+        glEnableVertexAttribArray(9);
+
+        glVertexAttribPointer(10,
+            4, GL_UNSIGNED_BYTE, true, vertexSize, (const void*)offsetof(SkinnedVertex, skin.weights));
+        glEnableVertexAttribArray(10);
+    }
+    if (format == VertexFormat::Position) {
+        glVertexAttribPointer(0,
+            3, GL_FLOAT, false, 3 * sizeof(float), (const void*)0);
+        glEnableVertexAttribArray(0);
+    }
+
+    // Element buffer binding is part of the VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBindVertexArray(0);
+}
+
+GLuint MeshBuffer::CreateBuffer(GLenum target, size_t bytes) {
+    // WebGL2 types a buffer by its first binding and never lets an element
+    //   buffer be used as anything else, so the first binding has to be the
+    //   real target. The element binding is VAO state, bind ours for it.
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindVertexArray(vao);
+    glBindBuffer(target, buffer);
+    glBufferData(target, bytes, nullptr, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    return buffer;
+}
+
+GLuint MeshBuffer::GrowBuffer(GLenum target, GLuint buffer, size_t oldBytes, size_t newBytes) {
+    GLuint grown = CreateBuffer(target, newBytes);
+    // Copy targets accept buffers of either type once they are typed
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+    glDeleteBuffers(1, &buffer);
+    return grown;
+}
+
+MeshAllocation MeshBuffer::Allocate(const void* vertices, size_t vertexCount,
+        const unsigned int* indices, size_t indexCount) {
+    MeshAllocation allocation;
+    allocation.vertexCount = vertexCount;
+    allocation.indexCount = indexCount;
+
+    bool grew = false;
+    while (!vertexRanges.Allocate(vertexCount, allocation.firstVertex)) {
+        size_t capacity = std::max(vertexRanges.capacity * 2, vertexRanges.capacity + vertexCount);
+        vbo = GrowBuffer(GL_ARRAY_BUFFER, vbo, vertexRanges.capacity * vertexSize,
+            capacity * vertexSize);
+        vertexRanges.Grow(capacity);
+        grew = true;
+    }
+    while (!indexRanges.Allocate(indexCount, allocation.firstIndex)) {
+        size_t capacity = std::max(indexRanges.capacity * 2, indexRanges.capacity + indexCount);
+        ibo = GrowBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo,
+            indexRanges.capacity * sizeof(unsigned int), capacity * sizeof(unsigned int));
+        indexRanges.Grow(capacity);
+        grew = true;
+    }
+    if (grew) {
+        LOG_INFO("Mesh buffer grown to " << vertexRanges.capacity << " vertices, "
+            << indexRanges.capacity << " indices");
+        SetupVertexArray();
+    }
+
+    indexScratch.resize(indexCount);
+    for (size_t i = 0; i < indexCount; i++) {
+        indexScratch[i] = indices[i] + allocation.firstVertex;
+    }
+
+    // Upload through the copy targets so no VAO's element binding changes
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.firstVertex * vertexSize,
+        vertexCount * vertexSize, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.firstIndex * sizeof(unsigned int),
+        indexCount * sizeof(unsigned int), indexScratch.data());
+    return allocation;
+}
+
+void MeshBuffer::Free(const MeshAllocation& allocation) {
+    vertexRanges.Free(allocation.firstVertex, allocation.vertexCount);
+    indexRanges.Free(allocation.firstIndex, allocation.indexCount);
+}
+
+size_t MeshBuffer::Stream(const void* vertices, size_t vertexCount) {
+    if (streamHead + vertexCount > streamCapacity) {
+        streamHead = 0;
+    }
+    size_t first = streamFirst + streamHead;
+    streamHead += vertexCount;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, first * vertexSize, vertexCount * vertexSize, vertices);
+    return first;
+}
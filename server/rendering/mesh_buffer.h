@@ -0,0 +1,95 @@
+#pragma once
+
+#include "opengl.h"
+
+#include <cstddef>
+#include <vector>
+
+// Attribute layouts meshes are stored in, each has its own MeshBuffer
+enum class VertexFormat {
+    // Vertex from mesh.h
+    Standard = 0,
+    // Packed float3 positions, used by the debug renderer
+    Position,
+    // SkinnedVertex from mesh.h, bones at location 9 and weights at 10
+    Skinned,
+    Count
+};
+
+// A mesh's range of a MeshBuffer, the indices already include firstVertex
+struct MeshAllocation {
+    size_t firstVertex = 0;
+    size_t vertexCount = 0;
+    size_t firstIndex = 0;
+    size_t indexCount = 0;
+};
+
+// Vertex and index storage shared by every mesh of one format. Meshes are
+//   ranges of the same two buffers drawn through one VAO, so drawing a
+//   different mesh only changes the index offset. WebGL2 has no base vertex
+//   draws, the base vertex is added to the indices on upload instead.
+//   A format can also reserve a ring of vertices for geometry rebuilt every
+//   frame, drawn unindexed through the same VAO.
+class MeshBuffer {
+    // First fit free list over a buffer, in elements
+    struct RangeAllocator {
+        struct Range {
+            size_t offset;
+            size_t count;
+        };
+        std::vector<Range> freeRanges;
+        size_t capacity = 0;
+
+        bool Allocate(size_t count, size_t& offset);
+        void Free(size_t offset, size_t count);
+        void Grow(size_t newCapacity);
+    };
+
+    VertexFormat format;
+    size_t vertexSize;
+
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ibo = 0;
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+
+    std::vector<unsigned int> indexScratch;
+
+    // Streaming ring, a range of the vertex buffer taken at construction.
+    //   Written front to back and restarted when a write doesn't fit, so a
+    //   write rarely lands on vertices the last frames are still drawing
+    size_t streamFirst = 0;
+    size_t streamCapacity = 0;
+    size_t streamHead = 0;
+
+    MeshBuffer(VertexFormat format, size_t vertexSize,
+        size_t initialVertices, size_t initialIndices, size_t streamVertices = 0);
+
+    // Points the VAO at vbo and ibo, needed again whenever either grows
+    void SetupVertexArray();
+    // Creates a buffer bound to target first, so WebGL2 types it correctly
+    GLuint CreateBuffer(GLenum target, size_t bytes);
+    // Copies the old contents into a larger buffer and returns it
+    GLuint GrowBuffer(GLenum target, GLuint buffer, size_t oldBytes, size_t newBytes);
+
+public:
+    MeshBuffer(const MeshBuffer&) = delete;
+    MeshBuffer& operator=(const MeshBuffer&) = delete;
+
+    static MeshBuffer& Get(VertexFormat format);
+
+    MeshAllocation Allocate(const void* vertices, size_t vertexCount,
+        const unsigned int* indices, size_t indexCount);
+    void Free(const MeshAllocation& allocation);
+
+    // Copies vertices into the streaming ring and returns the first one's
+    //   index, to draw with glDrawArrays until the ring comes around.
+    //   vertexCount can't be more than GetStreamCapacity()
+    size_t Stream(const void* vertices, size_t vertexCount);
+    size_t GetStreamCapacity() const { return streamCapacity; }
+
+    GLuint GetVertexArray() const { return vao; }
+    size_t GetVertexCapacity() const { return vertexRanges.capacity; }
+    size_t GetIndexCapacity() const { return indexRanges.capacity; }
+};
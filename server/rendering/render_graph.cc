@@ -0,0 +1,187 @@
+#include "render_graph.h"
+#include "logging.h"
+
+size_t BytesPerTexel(GLenum format) {
+    switch (format) {
+        case GL_RGBA16F: return 8;
+        case GL_RGBA32F: return 16;
+        default: return 4;
+    }
+}
+
+RenderTargetPool::~RenderTargetPool() {
+    for (auto& target : targets) {
+        Destroy(*target);
+    }
+}
+
+void RenderTargetPool::Create(RenderTarget& target) {
+    bool isFloat = target.format == GL_RGBA16F || target.format == GL_RGBA32F;
+    glGenTextures(1, &target.texture);
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, target.format, target.width, target.height, 0,
+        GL_RGBA, isFloat ? GL_FLOAT : GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+    if (target.depth) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depth, 0);
+    }
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR("Could not setup render target! Status: " << status);
+    }
+}
+
+void RenderTargetPool::Destroy(RenderTarget& target) {
+    if (target.fbo) {
+        glDeleteFramebuffers(1, &target.fbo);
+        target.fbo = 0;
+    }
+    if (target.texture) {
+        glDeleteTextures(1, &target.texture);
+        target.texture = 0;
+    }
+}
+
+RenderTarget* RenderTargetPool::Acquire(int width, int height, GLenum format, GLuint depth) {
+    for (auto& target : targets) {
+        if (!target->inUse && target->width == width && target->height == height &&
+                target->format == format && target->depth == depth) {
+            target->inUse = true;
+            target->idleFrames = 0;
+            return target.get();
+        }
+    }
+
+    auto target = std::make_unique<RenderTarget>();
+    target->width = width;
+    target->height = height;
+    target->format = format;
+    target->depth = depth;
+    target->inUse = true;
+    Create(*target);
+    targets.push_back(std::move(target));
+    return targets.back().get();
+}
+
+void RenderTargetPool::Release(RenderTarget* target) {
+    target->inUse = false;
+}
+
+void RenderTargetPool::EndFrame() {
+    for (size_t i = 0; i < targets.size();) {
+        RenderTarget& target = *targets[i];
+        if (!target.inUse && ++target.idleFrames > MaxIdleFrames) {
+            Destroy(target);
+            targets.erase(targets.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void RenderGraph::Reset() {
+    if (exported) {
+        pool.Release(exported);
+        exported = nullptr;
+    }
+    resources.clear();
+    passes.clear();
+    output = None;
+}
+
+RenderGraph::Resource RenderGraph::Import(const char* name, GLuint texture,
+        int width, int height, GLenum format) {
+    resources.push_back({ name, width, height, format, 0, texture, nullptr, -1 });
+    return resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::Create(const char* name, int width, int height,
+        GLenum format, GLuint depth) {
+    resources.push_back({ name, width, height, format, depth, 0, nullptr, -1 });
+    return resources.size() - 1;
+}
+
+void RenderGraph::AddPass(const char* name, std::initializer_list<Resource> reads,
+        Resource write, bool keepContents, Execute execute) {
+    if (reads.size() > MaxReads) {
+        LOG_ERROR("Render pass " << name << " reads more than " << MaxReads << " resources");
+        throw std::runtime_error("Render pass reads too many resources");
+    }
+
+    int index = passes.size();
+    Pass pass { name, {}, 0, write, keepContents, std::move(execute) };
+    for (Resource read : reads) {
+        resources[read].lastUse = index;
+        pass.reads[pass.readCount++] = read;
+    }
+    if (write != None) {
+        resources[write].lastUse = index;
+    }
+    passes.push_back(std::move(pass));
+}
+
+void RenderGraph::Run(GPUProfiler& profiler) {
+    bytes = 0;
+    for (size_t i = 0; i < passes.size(); i++) {
+        Pass& pass = passes[i];
+        profiler.Begin(pass.name);
+
+        for (int r = 0; r < pass.readCount; r++) {
+            const ResourceInfo& info = resources[pass.reads[r]];
+            if (!info.importedTexture && !info.target) {
+                LOG_ERROR("Render pass " << pass.name << " reads " << info.name << " before it is written");
+                throw std::runtime_error("Render graph resource read before it is written");
+            }
+            bytes += info.width * info.height * BytesPerTexel(info.format);
+        }
+
+        if (pass.write != None) {
+            ResourceInfo& info = resources[pass.write];
+            if (!info.target) {
+                info.target = pool.Acquire(info.width, info.height, info.format, info.depth);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, info.target->fbo);
+            glViewport(0, 0, info.width, info.height);
+            size_t targetBytes = info.width * info.height * BytesPerTexel(info.format);
+            // Blending reads the destination back
+            bytes += pass.keepContents ? targetBytes * 2 : targetBytes;
+        }
+
+        glDisable(GL_DEPTH_TEST);
+        pass.execute(*this);
+
+        // Hand back every transient this was the last pass to touch
+        for (size_t r = 0; r < resources.size(); r++) {
+            ResourceInfo& info = resources[r];
+            if (info.target && info.lastUse == (int) i && (Resource) r != output) {
+                pool.Release(info.target);
+                info.target = nullptr;
+            }
+        }
+    }
+
+    if (output != None) {
+        exported = resources[output].target;
+    }
+    profiler.End();
+}
+
+GLuint RenderGraph::GetTexture(Resource resource) const {
+    const ResourceInfo& info = resources[resource];
+    if (info.importedTexture) return info.importedTexture;
+    return info.target ? info.target->texture : 0;
+}
+
+GLuint RenderGraph::GetOutputTexture() const {
+    return exported ? exported->texture : 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "opengl.h"
+#include "gpu_profiler.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Color target handed out by RenderTargetPool
+struct RenderTarget {
+    GLuint fbo = 0;
+    GLuint texture = 0;
+    int width = 0;
+    int height = 0;
+    GLenum format = 0;
+    // Depth attachment borrowed from elsewhere (the gBuffer), never owned
+    GLuint depth = 0;
+
+    bool inUse = false;
+    int idleFrames = 0;
+};
+
+// Reuses targets of the same size, format and depth attachment between
+//   passes and frames, targets left idle for a few frames are freed
+class RenderTargetPool {
+    std::vector<std::unique_ptr<RenderTarget>> targets;
+
+    static void Create(RenderTarget& target);
+    static void Destroy(RenderTarget& target);
+
+public:
+    static constexpr int MaxIdleFrames = 3;
+
+    RenderTargetPool() {}
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+    ~RenderTargetPool();
+
+    RenderTarget* Acquire(int width, int height, GLenum format, GLuint depth = 0);
+    void Release(RenderTarget* target);
+
+    void EndFrame();
+
+    size_t GetTargetCount() const { return targets.size(); }
+};
+
+// Bytes per texel of the color formats the renderer uses
+size_t BytesPerTexel(GLenum format);
+
+// Full screen passes that declare what they read and write. Transient
+//   resources get a pooled target from their first use to their last read,
+//   so a chain of passes ping-pongs between a couple of targets instead of
+//   copying. Rebuilt every frame.
+class RenderGraph {
+public:
+    using Resource = int;
+    static constexpr Resource None = -1;
+    using Execute = std::function<void(RenderGraph& graph)>;
+
+private:
+    struct ResourceInfo {
+        const char* name;
+        int width;
+        int height;
+        GLenum format;
+        GLuint depth;
+        // Set for textures owned outside the graph
+        GLuint importedTexture;
+        RenderTarget* target;
+        int lastUse;
+    };
+
+    static constexpr int MaxReads = 4;
+
+    struct Pass {
+        const char* name;
+        Resource reads[MaxReads];
+        int readCount;
+        Resource write;
+        // Draws on top of what write already holds (blending)
+        bool keepContents;
+        Execute execute;
+    };
+
+    RenderTargetPool& pool;
+    std::vector<ResourceInfo> resources;
+    std::vector<Pass> passes;
+    Resource output = None;
+    // Output target stays alive until the next frame so it can be displayed
+    RenderTarget* exported = nullptr;
+
+    size_t bytes = 0;
+
+public:
+    RenderGraph(RenderTargetPool& pool) : pool(pool) {}
+
+    // Drops last frame's passes and resources
+    void Reset();
+
+    Resource Import(const char* name, GLuint texture, int width, int height, GLenum format);
+    Resource Create(const char* name, int width, int height, GLenum format, GLuint depth = 0);
+
+    // write may be None for passes that draw into targets they own
+    void AddPass(const char* name, std::initializer_list<Resource> reads, Resource write,
+        bool keepContents, Execute execute);
+    void SetOutput(Resource resource) { output = resource; }
+
+    // Runs every pass in order, each timed as its own profiler pass
+    void Run(GPUProfiler& profiler);
+
+    // Only valid for transient resources while a pass using them runs
+    GLuint GetTexture(Resource resource) const;
+    GLuint GetOutputTexture() const;
+
+    size_t GetPassCount() const { return passes.size(); }
+    // Estimated color traffic of the last Run, every read and write counted
+    //   once per texel
+    size_t GetBytes() const { return bytes; }
+};
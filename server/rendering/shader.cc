@@ -181,10 +181,16 @@ GLint ShaderProgram::GetUniformLocation(const std::string& uniName) {
     return result;
 }
 
-void DeferredShadingGeometryShaderProgram::Draw(const Matrix4& model, Mesh* mesh) {
-    // Set Model Transform
-    glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
+void ShaderProgram::BindUniformBlock(const std::string& blockName, GLuint bindingPoint) {
+    GLuint index = glGetUniformBlockIndex(program, blockName.c_str());
+    if (index == GL_INVALID_INDEX) {
+        LOG_ERROR("Could not find uniform block " << blockName);
+        return;
+    }
+    glUniformBlockBinding(program, index, bindingPoint);
+}
 
+void DeferredShadingGeometryShaderProgram::BindMesh(Mesh* mesh) {
     Material* meshMat = overrideMaterial ? overrideMaterial : mesh->material;
     // Set Mesh Material
     if (meshMat != lastMaterial) {
@@ -199,50 +205,81 @@ void DeferredShadingGeometryShaderProgram::Draw(const Matrix4& model, Mesh* mesh
         glUniform1i (uniformMaterial[6], material->illum);
 
         // Texture Booleans
-        glUniform1i (uniformMaterial[7],  material->map_Ka != nullptr);
-        glUniform1i (uniformMaterial[8],  material->map_Kd != nullptr);
-        glUniform1i (uniformMaterial[9],  material->map_Ks != nullptr);
-        glUniform1i (uniformMaterial[10], material->map_Ns != nullptr);
-        glUniform1i (uniformMaterial[11], material->map_d != nullptr);
-        glUniform1i (uniformMaterial[12], material->map_bump != nullptr);
-        glUniform1i (uniformMaterial[13], material->map_refl != nullptr);
+        glUniform1i (uniformMaterial[7],  IsTextureLoaded(material->map_Ka));
+        glUniform1i (uniformMaterial[8],  IsTextureLoaded(material->map_Kd));
+        glUniform1i (uniformMaterial[9],  IsTextureLoaded(material->map_Ks));
+        glUniform1i (uniformMaterial[10], IsTextureLoaded(material->map_Ns));
+        glUniform1i (uniformMaterial[11], IsTextureLoaded(material->map_d));
+        glUniform1i (uniformMaterial[12], IsTextureLoaded(material->map_bump));
+        glUniform1i (uniformMaterial[13], IsTextureLoaded(material->map_refl));
 
         // Actual Textures, the units are previously mapped
-        if (material->map_Ka) {
+        if (IsTextureLoaded(material->map_Ka)) {
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, material->map_Ka->textureBuffer);
         }
-        if (material->map_Kd) {
+        if (IsTextureLoaded(material->map_Kd)) {
             glActiveTexture(GL_TEXTURE1);
             glBindTexture(GL_TEXTURE_2D, material->map_Kd->textureBuffer);
         }
-        if (material->map_Ks) {
+        if (IsTextureLoaded(material->map_Ks)) {
             glActiveTexture(GL_TEXTURE2);
             glBindTexture(GL_TEXTURE_2D, material->map_Ks->textureBuffer);
         }
-        if (material->map_Ns) {
+        if (IsTextureLoaded(material->map_Ns)) {
             glActiveTexture(GL_TEXTURE3);
             glBindTexture(GL_TEXTURE_2D, material->map_Ns->textureBuffer);
         }
-        if (material->map_d) {
+        if (IsTextureLoaded(material->map_d)) {
             glActiveTexture(GL_TEXTURE4);
             glBindTexture(GL_TEXTURE_2D, material->map_d->textureBuffer);
         }
-        if (material->map_bump) {
+        if (IsTextureLoaded(material->map_bump)) {
             glActiveTexture(GL_TEXTURE5);
             glBindTexture(GL_TEXTURE_2D, material->map_bump->textureBuffer);
         }
-        if (material->map_refl) {
+        if (IsTextureLoaded(material->map_refl)) {
             glActiveTexture(GL_TEXTURE6);
             glBindTexture(GL_TEXTURE_2D, material->map_refl->textureBuffer);
         }
     }
-    if (mesh != lastMesh) {
-        lastMesh = mesh;
-        glBindVertexArray(mesh->renderInfo.vao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->renderInfo.ibo);
+    GLuint vertexArray = mesh->renderInfo.GetVertexArray();
+    if (vertexArray != lastVertexArray) {
+        lastVertexArray = vertexArray;
+        glBindVertexArray(vertexArray);
     }
-    glDrawElements(GL_TRIANGLES, mesh->renderInfo.iboCount, GL_UNSIGNED_INT, nullptr);
+}
+
+void DeferredShadingGeometryShaderProgram::Draw(const Matrix4& model, Mesh* mesh) {
+    // Set Model Transform
+    glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
+    glUniform1i(uniformInstanced, GL_FALSE);
+    glUniform1i(uniformSkinned, GL_FALSE);
+    BindMesh(mesh);
+    glDrawElements(GL_TRIANGLES, mesh->renderInfo.GetIndexCount(), GL_UNSIGNED_INT,
+        mesh->renderInfo.GetIndexOffset());
+}
+
+void DeferredShadingGeometryShaderProgram::DrawSkinned(const Matrix4& model, Mesh* mesh,
+        BoneBuffer& bones, size_t palette) {
+    glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
+    glUniform1i(uniformInstanced, GL_FALSE);
+    glUniform1i(uniformSkinned, GL_TRUE);
+    BindMesh(mesh);
+    bones.Bind(palette);
+    glDrawElements(GL_TRIANGLES, mesh->renderInfo.GetIndexCount(), GL_UNSIGNED_INT,
+        mesh->renderInfo.GetIndexOffset());
+}
+
+void DeferredShadingGeometryShaderProgram::DrawInstanced(Mesh* mesh,
+        InstanceBuffer& instances, size_t offset, size_t count) {
+    glUniform1i(uniformInstanced, GL_TRUE);
+    glUniform1i(uniformSkinned, GL_FALSE);
+    BindMesh(mesh);
+    instances.Bind(offset);
+    glDrawElementsInstanced(GL_TRIANGLES, mesh->renderInfo.GetIndexCount(), GL_UNSIGNED_INT,
+        mesh->renderInfo.GetIndexOffset(), count);
+    instances.Unbind();
 }
 
 void DeferredShadingGeometryShaderProgram::PreDraw(const Vector3& viewPos,
@@ -251,6 +288,10 @@ void DeferredShadingGeometryShaderProgram::PreDraw(const Vector3& viewPos,
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
+    // Other passes rebind textures and vertex arrays in between frames
+    lastMaterial = nullptr;
+    lastVertexArray = 0;
+
     glUniform3fv(uniformViewerPosition, 1, glm::value_ptr(viewPos));
     glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
     glUniformMatrix4fv(uniformProj, 1, GL_FALSE, glm::value_ptr(proj));
@@ -262,22 +303,62 @@ void ShadowMapShaderProgram::PreDraw(const Vector3& viewPos,
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
+    lastVertexArray = 0;
+
     glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
     glUniformMatrix4fv(uniformProj, 1, GL_FALSE, glm::value_ptr(proj));
 }
 
+void ShadowMapShaderProgram::BindMesh(Mesh* mesh) {
+    GLuint vertexArray = mesh->renderInfo.GetVertexArray();
+    if (vertexArray != lastVertexArray) {
+        lastVertexArray = vertexArray;
+        glBindVertexArray(vertexArray);
+    }
+}
+
 void ShadowMapShaderProgram::Draw(const Matrix4& model, Mesh* mesh) {
     glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-    glBindVertexArray(mesh->renderInfo.vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->renderInfo.ibo);
-    glDrawElements(GL_TRIANGLES, mesh->renderInfo.iboCount, GL_UNSIGNED_INT, nullptr);
+    glUniform1i(uniformInstanced, GL_FALSE);
+    glUniform1i(uniformSkinned, GL_FALSE);
+    BindMesh(mesh);
+    glDrawElements(GL_TRIANGLES, mesh->renderInfo.GetIndexCount(), GL_UNSIGNED_INT,
+        mesh->renderInfo.GetIndexOffset());
+}
+
+void ShadowMapShaderProgram::DrawSkinned(const Matrix4& model, Mesh* mesh,
+        BoneBuffer& bones, size_t palette) {
+    glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
+    glUniform1i(uniformInstanced, GL_FALSE);
+    glUniform1i(uniformSkinned, GL_TRUE);
+    BindMesh(mesh);
+    bones.Bind(palette);
+    glDrawElements(GL_TRIANGLES, mesh->renderInfo.GetIndexCount(), GL_UNSIGNED_INT,
+        mesh->renderInfo.GetIndexOffset());
+}
+
+void ShadowMapShaderProgram::DrawInstanced(Mesh* mesh,
+        InstanceBuffer& instances, size_t offset, size_t count) {
+    glUniform1i(uniformInstanced, GL_TRUE);
+    glUniform1i(uniformSkinned, GL_FALSE);
+    BindMesh(mesh);
+    instances.Bind(offset);
+    glDrawElementsInstanced(GL_TRIANGLES, mesh->renderInfo.GetIndexCount(), GL_UNSIGNED_INT,
+        mesh->renderInfo.GetIndexOffset(), count);
+    instances.Unbind();
 }
 
 void DebugShaderProgram::Draw(const Matrix4& model, Mesh* mesh) {
     glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-    glBindVertexArray(mesh->renderInfo.vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->renderInfo.ibo);
-    glDrawElements(GL_LINES, mesh->renderInfo.iboCount, GL_UNSIGNED_INT, nullptr);
+    glBindVertexArray(mesh->renderInfo.GetVertexArray());
+    glDrawElements(GL_LINES, mesh->renderInfo.GetIndexCount(), GL_UNSIGNED_INT,
+        mesh->renderInfo.GetIndexOffset());
+}
+
+void DebugShaderProgram::DrawStreamedLines(size_t first, size_t count) {
+    glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(Matrix4(1.0f)));
+    glBindVertexArray(MeshBuffer::Get(VertexFormat::Position).GetVertexArray());
+    glDrawArrays(GL_LINES, first, count);
 }
 
 void DebugShaderProgram::PreDraw(const Vector3& viewPos,
@@ -296,6 +377,29 @@ void DeferredShadingLightingShaderProgram::PreDraw(const Vector3& viewPos,
     glUniformMatrix4fv(uniformProj, 1, GL_FALSE, glm::value_ptr(proj));
 }
 
+void ClusteredLightingShaderProgram::PreDraw(const Vector3& viewPos,
+                const Matrix4& view,
+                const Matrix4& proj) {
+    glUniform3fv(uniformViewerPosition, 1, glm::value_ptr(viewPos));
+    glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
+}
+
+void ClusteredLightingShaderProgram::RenderLighting(LightClusters& clusters) {
+    glUniform1f(uniformClusterNear, clusters.clusterNear);
+    glUniform1f(uniformClusterScale, clusters.sliceScale);
+    clusters.BindTextures(ClusterTextureUnit);
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glDisable(GL_CULL_FACE);
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+
+    clusters.UnbindTextures(ClusterTextureUnit);
+}
+
 void DeferredShadingLightingShaderProgram::RenderLighting(TransformedLight& transformed, AssetManager& assetManager) {
     // Set all the uniforms
     LightNode* light = dynamic_cast<LightNode*>(transformed.node);
@@ -349,9 +453,9 @@ void DeferredShadingLightingShaderProgram::RenderLighting(TransformedLight& tran
     }
 
     if (mesh) {
-        glBindVertexArray(mesh->renderInfo.vao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->renderInfo.ibo);
-        glDrawElements(GL_TRIANGLES, mesh->renderInfo.iboCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(mesh->renderInfo.GetVertexArray());
+        glDrawElements(GL_TRIANGLES, mesh->renderInfo.GetIndexCount(), GL_UNSIGNED_INT,
+            mesh->renderInfo.GetIndexOffset());
     }
 
     glEnable(GL_DEPTH_TEST);
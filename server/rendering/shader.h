@@ -7,6 +7,8 @@
 #include "vector.h"
 #include "object.h"
 #include "scene.h"
+#include "buffers.h"
+#include "light_clusters.h"
 
 class ClientGL;
 class Mesh;
@@ -28,6 +30,7 @@ public:
     void Use();
 
     GLint GetUniformLocation(const std::string& uniName);
+    void BindUniformBlock(const std::string& blockName, GLuint bindingPoint);
     GLint GetAttributeLocation(const std::string& attrName);
 
     virtual void PreDraw(const Vector3& viewPos,
@@ -44,6 +47,8 @@ class DeferredShadingGeometryShaderProgram : public ShaderProgram {
     GLint uniformModel;
     GLint uniformViewerPosition;
     GLint uniformRenderShadows;
+    GLint uniformInstanced;
+    GLint uniformSkinned;
 
     GLint uniformOutlineSize;
     GLint uniformOutlineColor;
@@ -53,9 +58,12 @@ class DeferredShadingGeometryShaderProgram : public ShaderProgram {
     Material* overrideMaterial = nullptr;
 
     Material* lastMaterial = nullptr;
-    Mesh* lastMesh = nullptr;
+    // Meshes of one vertex format share a VAO, most draws don't rebind it
+    GLuint lastVertexArray = 0;
     float lastDrawOutline = 0.0f;
 
+    void BindMesh(Mesh* mesh);
+
 public:
     DeferredShadingGeometryShaderProgram() {
         AddShader(LoadURL("shaders/Mesh.vs"), GL_VERTEX_SHADER);
@@ -68,6 +76,9 @@ public:
         uniformModel = GetUniformLocation("u_Model");
         uniformViewerPosition = GetUniformLocation("u_ViewerPos");
         uniformRenderShadows = GetUniformLocation("u_RenderShadows");
+        uniformInstanced = GetUniformLocation("u_Instanced");
+        uniformSkinned = GetUniformLocation("u_Skinned");
+        BindUniformBlock("Bones", BoneBuffer::BindingPoint);
 
         uniformMaterial.push_back(GetUniformLocation("u_Material.Ka"));
         uniformMaterial.push_back(GetUniformLocation("u_Material.Kd"));
@@ -119,6 +130,10 @@ public:
                  const Matrix4& proj) override;
     void Draw(const Matrix4& model, Mesh* mesh) override;
 
+    // Draws count instances of mesh with transforms from offset in instances
+    void DrawInstanced(Mesh* mesh, InstanceBuffer& instances, size_t offset, size_t count);
+    // Draws a skinned mesh posed by the given palette of bones
+    void DrawSkinned(const Matrix4& model, Mesh* mesh, BoneBuffer& bones, size_t palette);
 };
 
 class DeferredShadingLightingShaderProgram : public ShaderProgram {
@@ -244,6 +259,82 @@ public:
     void RenderLighting(TransformedLight& light, AssetManager& assetManager);
 };
 
+// Resolves every light binned in LightClusters in a single full screen pass
+class ClusteredLightingShaderProgram : public ShaderProgram {
+    // Uniforms
+    GLint uniformView;
+    GLint uniformViewerPosition;
+    GLint uniformViewportSize;
+    GLint uniformClusterNear;
+    GLint uniformClusterScale;
+
+    GLuint quadVAO;
+    GLuint quadVBO;
+
+public:
+    // Light data, cluster and index textures are bound from this unit onwards
+    static constexpr GLenum ClusterTextureUnit = GL_TEXTURE5;
+
+    ClusteredLightingShaderProgram() {
+        AddShader(LoadURL("shaders/MeshLighting.vs"), GL_VERTEX_SHADER);
+        AddShader(LoadURL("shaders/MeshLightingClustered.fs"), GL_FRAGMENT_SHADER);
+        LinkProgram();
+        Use();
+
+        float texCoords[] = {
+            0.0,  0.0,
+            1.0,  0.0,
+            0.0,  1.0,
+            0.0,  1.0,
+            1.0,  0.0,
+            1.0,  1.0
+        };
+        glGenVertexArrays(1, &quadVAO);
+        glBindVertexArray(quadVAO);
+
+        glGenBuffers(1, &quadVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(float), texCoords, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, false, 0, 0);
+
+        uniformViewerPosition = GetUniformLocation("u_ViewerPos");
+        uniformView = GetUniformLocation("u_View");
+        uniformViewportSize = GetUniformLocation("u_ViewportSize");
+        uniformClusterNear = GetUniformLocation("u_ClusterNear");
+        uniformClusterScale = GetUniformLocation("u_ClusterScale");
+
+        // Always a full screen quad
+        Matrix4 standardRemapMatrix = glm::translate(Vector3(-1, -1, -1)) * glm::scale(Vector3(2, 2, 2));
+        glUniformMatrix4fv(GetUniformLocation("u_Model"), 1, GL_FALSE, glm::value_ptr(standardRemapMatrix));
+        glUniform1i(GetUniformLocation("u_UseProjectionAndView"), GL_FALSE);
+
+        glUniform3i(GetUniformLocation("u_ClusterCount"),
+            LightClusters::TilesX, LightClusters::TilesY, LightClusters::Slices);
+        glUniform1i(GetUniformLocation("u_IndexTextureWidth"), LightClusters::IndexTextureWidth);
+
+        glUniform1i(GetUniformLocation("gbuf_position"), 0);
+        glUniform1i(GetUniformLocation("gbuf_normal"), 1);
+        glUniform1i(GetUniformLocation("gbuf_diffuse"), 2);
+        glUniform1i(GetUniformLocation("gbuf_specular"), 3);
+
+        glUniform1i(GetUniformLocation("u_LightData"), ClusterTextureUnit - GL_TEXTURE0);
+        glUniform1i(GetUniformLocation("u_ClusterData"), ClusterTextureUnit - GL_TEXTURE0 + 1);
+        glUniform1i(GetUniformLocation("u_LightIndices"), ClusterTextureUnit - GL_TEXTURE0 + 2);
+    }
+
+    void SetViewportSize(int width, int height) {
+        glUniform2f(uniformViewportSize, (float)width, (float)height);
+    }
+
+    void PreDraw(const Vector3& viewPos,
+                 const Matrix4& view,
+                 const Matrix4& proj) override;
+    void Draw(const Matrix4& model, Mesh* mesh) override {}
+
+    void RenderLighting(LightClusters& clusters);
+};
+
 class DebugShaderProgram : public ShaderProgram {
     // Uniforms
     GLint uniformProj;
@@ -268,6 +359,8 @@ public:
                  const Matrix4& view,
                  const Matrix4& proj) override;
     void Draw(const Matrix4& model, Mesh* mesh) override;
+    // Lines from count streamed vertices of the position MeshBuffer, in world space
+    void DrawStreamedLines(size_t first, size_t count);
 
     void SetColor(Vector3 color) {
         glUniform3f(uniformColor, color.r, color.g, color.b);
@@ -280,6 +373,11 @@ class ShadowMapShaderProgram : public ShaderProgram {
     GLint uniformProj;
     GLint uniformView;
     GLint uniformModel;
+    GLint uniformInstanced;
+    GLint uniformSkinned;
+
+    GLuint lastVertexArray = 0;
+    void BindMesh(Mesh* mesh);
 public:
     ShadowMapShaderProgram() {
         AddShader(LoadURL("shaders/ShadowMap.vs"), GL_VERTEX_SHADER);
@@ -290,12 +388,17 @@ public:
         uniformProj = GetUniformLocation("u_Projection");
         uniformView = GetUniformLocation("u_View");
         uniformModel = GetUniformLocation("u_Model");
+        uniformInstanced = GetUniformLocation("u_Instanced");
+        uniformSkinned = GetUniformLocation("u_Skinned");
+        BindUniformBlock("Bones", BoneBuffer::BindingPoint);
     }
 
     void PreDraw(const Vector3& viewPos,
                  const Matrix4& view,
                  const Matrix4& proj) override;
     void Draw(const Matrix4& model, Mesh* mesh) override;
+    void DrawInstanced(Mesh* mesh, InstanceBuffer& instances, size_t offset, size_t count);
+    void DrawSkinned(const Matrix4& model, Mesh* mesh, BoneBuffer& bones, size_t palette);
 };
 
 class QuadShaderProgram : public ShaderProgram {
@@ -0,0 +1,97 @@
+#include "texture_streamer.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <fstream>
+
+size_t TextureStreamer::UploadLevel(Stream& stream, int level) {
+    const CompressedMip& mip = stream.file.mips[level];
+    std::ifstream file(stream.path, std::ios::binary);
+    file.seekg(mip.offset);
+    levelData.resize(mip.size);
+    file.read(reinterpret_cast<char*>(levelData.data()), mip.size);
+    if (!file) {
+        LOG_ERROR("Could not read level " << level << " of " << stream.path);
+        throw std::runtime_error("Could not read compressed texture level");
+    }
+
+    CompressedFormat format = stream.file.header.format;
+    glBindTexture(GL_TEXTURE_2D, stream.texture->textureBuffer);
+    size_t bytes;
+    if (compressionSupported) {
+        GLenum internalFormat = format == CompressedFormat::BC1 ?
+            GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat,
+            mip.width, mip.height, 0, mip.size, levelData.data());
+        bytes = mip.size;
+    }
+    else {
+        decoded.resize(mip.width * mip.height * 4);
+        DecompressImage(format, levelData.data(), mip.width, mip.height, decoded.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, mip.width, mip.height, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        bytes = decoded.size();
+    }
+    // Every level from here down is resident, sample from it
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    residentBytes += bytes;
+    return bytes;
+}
+
+bool TextureStreamer::Load(Texture* texture, const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    Stream stream;
+    stream.texture = texture;
+    stream.path = path;
+    ReadCompressedTexture(file, stream.file);
+    file.close();
+
+    auto& header = stream.file.header;
+    texture->width = header.width;
+    texture->height = header.height;
+
+    glGenTextures(1, &texture->textureBuffer);
+    glBindTexture(GL_TEXTURE_2D, texture->textureBuffer);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.mipCount - 1);
+
+    stream.nextLevel = header.mipCount - 1;
+    while (stream.nextLevel >= 0) {
+        auto& mip = stream.file.mips[stream.nextLevel];
+        if (stream.nextLevel != (int) header.mipCount - 1 &&
+                std::max(mip.width, mip.height) > InitialSize) {
+            break;
+        }
+        UploadLevel(stream, stream.nextLevel);
+        stream.nextLevel--;
+    }
+
+    if (stream.nextLevel >= 0) {
+        streams.push_back(std::move(stream));
+    }
+    return true;
+}
+
+void TextureStreamer::Update() {
+    size_t uploaded = 0;
+    while (uploaded < bytesPerFrame && !streams.empty()) {
+        // Smallest pending level first so every texture sharpens evenly
+        auto next = std::min_element(streams.begin(), streams.end(),
+            [](const Stream& a, const Stream& b) {
+                return a.file.mips[a.nextLevel].size < b.file.mips[b.nextLevel].size;
+            });
+        uploaded += UploadLevel(*next, next->nextLevel);
+        next->nextLevel--;
+        if (next->nextLevel < 0) {
+            std::swap(*next, streams.back());
+            streams.pop_back();
+        }
+    }
+}
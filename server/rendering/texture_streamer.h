@@ -0,0 +1,61 @@
+#pragma once
+
+#include "opengl.h"
+#include "mesh.h"
+#include "compressed-texture.h"
+
+#include <string>
+#include <vector>
+
+// From EXT_texture_compression_s3tc / WEBGL_compressed_texture_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Loads packed .ctex textures. The low mips are uploaded straight away so a
+//   texture is usable on the frame it's loaded, the larger levels follow a
+//   few per frame by lowering GL_TEXTURE_BASE_LEVEL as each one arrives.
+//   Without S3TC support the blocks are decoded to RGBA8 on upload.
+class TextureStreamer {
+    struct Stream {
+        Texture* texture;
+        std::string path;
+        CompressedTexture file;
+        // Next level to upload, counts down to 0
+        int nextLevel;
+    };
+    std::vector<Stream> streams;
+
+    std::vector<uint8_t> levelData;
+    std::vector<uint8_t> decoded;
+
+    size_t residentBytes = 0;
+
+    // Returns the bytes uploaded
+    size_t UploadLevel(Stream& stream, int level);
+
+public:
+    // Set once the context exists
+    inline static bool compressionSupported = false;
+
+    // Levels this size or smaller are uploaded on load
+    static constexpr uint32_t InitialSize = 64;
+    // Upload budget per Update, at least one level always goes through
+    size_t bytesPerFrame = 2 * 1024 * 1024;
+
+    TextureStreamer() {}
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Creates the texture from a .ctex file, false if there is none
+    bool Load(Texture* texture, const std::string& path);
+
+    // Call once per frame
+    void Update();
+
+    size_t GetPendingCount() const { return streams.size(); }
+    size_t GetResidentBytes() const { return residentBytes; }
+};
@@ -4,6 +4,8 @@
 #include "objects.h"
 #include "logging.h"
 #include "global.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include <thread>
 #include <mutex>
@@ -14,7 +16,33 @@
 
 static bool gameRunning = true;
 
+static Histogram& TickTime = GetMetrics().AddHistogram("game_tick_microseconds", "Time spent in Game::Tick");
+static Histogram& TickStartInterval = GetMetrics().AddHistogram("game_tick_interval_microseconds",
+    "Time between the starts of consecutive ticks");
+static Counter& BytesReceived = GetMetrics().AddCounter("game_received_bytes_total",
+    "Bytes of messages received from players, after decompression");
+static Counter& MessagesReceived = GetMetrics().AddCounter("game_received_messages_total", "Messages received from players");
+
+// Ticks slower than this many microseconds write the trace out, 0 for never
+static Time traceOverrun = 0;
+// Writing a trace is slow, at most one is written this often (ms)
+static const Time TraceDumpInterval = 10000;
+
+static void DumpTraceOnOverrun(Time tickTime) {
+    static Time lastDump = 0;
+    Time now = Timer::Now();
+    if (lastDump && now - lastDump < TraceDumpInterval) return;
+    lastDump = now;
+    LOG_WARN("Tick took " << tickTime << "us, writing the trace");
+    // Copied now while the slow tick is still in the buffers, written off
+    //   the tick thread
+    std::thread([snapshot = Trace::TakeSnapshot(), now]() {
+        Trace::WriteChromeJSON(snapshot, "trace-overrun-" + std::to_string(now) + ".json");
+    }).detach();
+}
+
 void GameLoop(Timer& gameTimer) {
+    Trace::SetThreadName("Game Loop");
     LOG_DEBUG("Tick Interval: " << TickInterval);
     while (gameRunning) {
         gameTimer.Tick();
@@ -34,6 +62,9 @@ void Usage(char* arg0) {
     std::cout << "        --client-ignore-server    : client-only" << std::endl;
     std::cout << "        --client-draw-shadow-maps : draw shadow maps on client" << std::endl;
     std::cout << "        --client-no-shadows       : ignore shadows" << std::endl;
+    std::cout << "        --log-level LEVEL         : debug, info, warn, error or none" << std::endl;
+    std::cout << "        --trace                   : record a trace, served on /trace" << std::endl;
+    std::cout << "        --trace-overrun MS        : trace, and write it out when a tick takes longer" << std::endl;
     std::cout << "        --help                    : shows this message" << std::endl;
 }
 
@@ -66,6 +97,21 @@ int main(int argc, char** argv) {
             else if (arg == "--client-no-shadows") {
                 GlobalSettings.Client_NoShadows = true;
             }
+            else if (arg == "--log-level" && i + 1 < argc) {
+                LogLevel level;
+                if (!Log::ParseLevel(argv[++i], level)) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                Log::SetLevel(level);
+            }
+            else if (arg == "--trace") {
+                Trace::SetEnabled(true);
+            }
+            else if (arg == "--trace-overrun" && i + 1 < argc) {
+                Trace::SetEnabled(true);
+                traceOverrun = std::stoul(argv[++i]) * 1000;
+            }
             else if (arg == "--help") {
                 Usage(argv[0]);
                 exit(1);
@@ -84,13 +130,23 @@ int main(int argc, char** argv) {
         Timer gameTimer;
 
         Game game;
-        ScheduledCall* gameTick = gameTimer.ScheduleInterval(
-            std::bind(&Game::Tick, &game, std::placeholders::_1),
-            TickInterval
-        );
+        Time lastTickStart = 0;
+        ScheduledCall* gameTick = gameTimer.ScheduleInterval([&game, &lastTickStart](Time time) {
+            Time start = Timer::NowMicro();
+            game.Tick(time);
+            Time elapsed = Timer::NowMicro() - start;
+            TickTime.Record(elapsed);
+            if (traceOverrun && elapsed > traceOverrun && Trace::IsEnabled()) {
+                DumpTraceOnOverrun(elapsed);
+            }
+            if (lastTickStart) {
+                TickStartInterval.Record(start - lastTickStart);
+            }
+            lastTickStart = start;
+        }, TickInterval);
 
         gameTimer.ScheduleInterval([gameTick, &game](Time time) {
-            LOG_INFO("Tick Runtime (Interval Time) (Per Object): " <<
+            LOG_INFO("Tick Runtime us (Interval Time ms) (Per Object us): " <<
                 gameTick->callRuntime.GetAverage() << " (" <<
                 gameTick->intervalTime.GetAverage() << ") (" <<
                 game.averageObjectTickTime.GetAverage() << ")");
@@ -104,10 +160,31 @@ int main(int argc, char** argv) {
     #endif
 
         std::thread s { GameLoop, std::ref(gameTimer) };
+        Trace::SetThreadName("Sockets");
 
-        uWS::App().get("/status", [](auto *res, auto */*req*/) {
+        uWS::App app;
+        app.get("/status", [](auto *res, auto */*req*/) {
             res->end("ok");
-        }).ws<PlayerSocketData>("/connect", {
+        }).get("/metrics", [](auto *res, auto */*req*/) {
+            res->writeHeader("Content-Type", "text/plain; version=0.0.4");
+            res->end(GetMetrics().Expose());
+        });
+        // Unauthenticated, so only outside production. Starting and stopping
+        //   change state, which GETs must not
+        if (!GlobalSettings.IsProduction) {
+            app.get("/trace", [](auto *res, auto */*req*/) {
+                // Save it and open in Perfetto or chrome://tracing
+                res->writeHeader("Content-Type", "application/json");
+                res->end(Trace::ToChromeJSON(Trace::TakeSnapshot()));
+            }).post("/trace/start", [](auto *res, auto */*req*/) {
+                Trace::SetEnabled(true);
+                res->end("tracing");
+            }).post("/trace/stop", [](auto *res, auto */*req*/) {
+                Trace::SetEnabled(false);
+                res->end("stopped");
+            });
+        }
+        app.ws<PlayerSocketData>("/connect", {
             .compression = uWS::DEDICATED_COMPRESSOR_4KB,
             .maxPayloadLength = 16 * 1024,
             .idleTimeout = 30,
@@ -130,8 +207,10 @@ int main(int argc, char** argv) {
 
                 game.AddPlayer(data, playerObject);
             },
-            .message = [](auto *ws, std::string_view message, uWS::OpCode opCode) {
+            .message = [&game](auto *ws, std::string_view message, uWS::OpCode opCode) {
                 PlayerSocketData* data = static_cast<PlayerSocketData*>(ws->getUserData());
+                BytesReceived.Add(message.size());
+                MessagesReceived.Add();
                 if (!data->playerObject) {
                     // Next tick hasn't been scheduled yet
                     return;
@@ -148,6 +227,9 @@ int main(int argc, char** argv) {
                 else if (obj["event"] == "hb") {
                     ws->send(message, uWS::OpCode::TEXT);
                 }
+                else if (obj["event"] == "resync") {
+                    game.QueueRelationshipResync(data);
+                }
                 else if (obj["event"] == "globalSettings") {
                     LOG_DEBUG("Sending Global Settings");
                     rapidjson::StringBuffer buffer;
@@ -48,5 +48,16 @@ struct AABB {
         return AABB(glm::min(a.ptMin, b.ptMin), glm::max(a.ptMax, b.ptMax));
     }
 
+    // Box containing this one after an affine transform
+    AABB Transformed(const Matrix4& transform) const {
+        Vector3 center = Vector3(transform * Vector4((ptMin + ptMax) * 0.5f, 1));
+        Vector3 halfExtent = (ptMax - ptMin) * 0.5f;
+        Vector3 extent;
+        for (int i = 0; i < 3; i++) {
+            extent += glm::abs(Vector3(transform[i])) * halfExtent[i];
+        }
+        return AABB(center - extent, center + extent);
+    }
+
     bool CollidesWith(RayCastRequest& ray, RayCastResult& result);
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "timer.h"
 #include "util.h"
 #include "scene.h"
+#include "trace.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wsign-compare"
@@ -17,9 +18,6 @@
     #define STB_IMAGE_IMPLEMENTATION
     #include "external/stb_image.h"
 
-    #define DR_WAV_IMPLEMENTATION
-    #include "external/dr_wav.h"
-
 #endif
 
 #include <filesystem>
@@ -79,6 +77,9 @@ AssetManager::~AssetManager() {
     for (auto& model : models) {
         delete model;
     }
+    for (auto& group : animationGroups) {
+        delete group.second;
+    }
     #ifdef BUILD_CLIENT
     for (auto& texture : textures) {
         delete texture.second;
@@ -99,10 +100,16 @@ ModelID AssetManager::LoadModel(const std::string& name, const std::string& path
     ModelID id = models.size();
     model->id = id;
     model->name = name;
+    model->path = path;
     models.push_back(model);
 
     modelMap[name] = model;
 
+    auto animations = modelAnimations.find(name);
+    if (animations != modelAnimations.end()) {
+        model->animations = animations->second;
+    }
+
     for (auto& loadedMesh : loader.LoadedMeshes) {
         std::string name = ToLower(loadedMesh.MeshName);
         Mesh* mesh = new Mesh;
@@ -156,6 +163,10 @@ ModelID AssetManager::LoadModel(const std::string& name, const std::string& path
             mesh->vertices[i].tangent = Average(tangents[i]);
         }
 
+        if (model->animations) {
+            ComputeSkinWeights(model->animations->skeleton, *mesh);
+        }
+
         // Use Default Shader
     #ifdef BUILD_CLIENT
         DefaultMaterial* material = new DefaultMaterial;
@@ -188,33 +199,76 @@ ModelID AssetManager::LoadModel(const std::string& name, const std::string& path
     return id;
 }
 
+SkeletalAnimationGroup* AssetManager::LoadAnimationGroup(const std::string& name, const std::string& path) {
+    SkeletalAnimationGroup* group = new SkeletalAnimationGroup;
+    std::vector<std::string> skinnedModels;
+    try {
+        LoadSkeletalAnimationGroup(path, *group, skinnedModels);
+    }
+    catch (...) {
+        delete group;
+        throw;
+    }
+    animationGroups[name] = group;
+    for (const std::string& model : skinnedModels) {
+        modelAnimations[model] = group;
+    }
+    LOG_INFO("Loaded " << name << " with " << group->skeleton.GetBoneCount() << " bones and "
+        << group->clips.size() << " clips");
+    return group;
+}
+
 #ifdef BUILD_CLIENT
+bool AssetManager::LoadTextureFile(Texture* tex, const std::string& path) {
+    // Prefer the output of the texture packer, it's already mipmapped
+    if (textureStreamer.Load(tex, CompressedTexturePath(path))) {
+        return true;
+    }
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+
+    int width, height, nrChannels;
+    stbi_set_flip_vertically_on_load(true);
+    int channels = (tex->format == Texture::Format::RGB) ? 3 : 4;
+    unsigned char *data = stbi_load((path).c_str(), &width, &height, &nrChannels, channels);
+    if (!data) {
+        LOG_ERROR("Could not load texture " << path);
+        throw std::runtime_error("Could not load texture");
+    }
+    tex->data = data;
+    tex->width = width;
+    tex->height = height;
+    // LOG_DEBUG("Loaded texture " << path);
+    // LOG_DEBUG("Sample: " << (int) data[0] << " " << (int) data[1] << " " << (int) data[2] << " "
+    //                      << (int) data[3] << " " << (int) data[4] << " " << (int) data[5]);
+    tex->InitializeTexture();
+
+    stbi_image_free(tex->data);
+    tex->data = nullptr;
+    return true;
+}
+
 Texture* AssetManager::LoadTexture(const std::string& name, Texture::Format format) {
     if (name.empty()) return nullptr;
     std::string path = RESOURCE_PATH(name);
     if (textures.find(path) == textures.end()) {
         Time start = Timer::Now();
-        int width, height, nrChannels;
-        stbi_set_flip_vertically_on_load(true);
-        int channels = (format == Texture::Format::RGB) ? 3 : 4;
-        unsigned char *data = stbi_load((path).c_str(), &width, &height, &nrChannels, channels);
-        if (!data) {
-            throw std::runtime_error("Could not load texture");
-        }
         Texture* tex = new Texture;
-        tex->data = data;
-        tex->width = width;
-        tex->height = height;
         tex->format = format;
-        // LOG_DEBUG("Loaded texture " << path);
-        // LOG_DEBUG("Sample: " << (int) data[0] << " " << (int) data[1] << " " << (int) data[2] << " "
-        //                      << (int) data[3] << " " << (int) data[4] << " " << (int) data[5]);
-        tex->InitializeTexture();
-
-        stbi_image_free(tex->data);
-        tex->data = nullptr;
-
         textures[path] = tex;
+        if (!LoadTextureFile(tex, path)) {
+            tex->InitializePlaceholder();
+        #ifdef BUILD_EDITOR
+            // Everything is on disk, a missing file is a broken asset
+            LOG_ERROR("Texture " << path << " not found, using a placeholder");
+        #else
+            // Most likely in a bundle that hasn't arrived yet
+            pendingTextures[path] = tex;
+            LOG_WARN("Texture " << path << " not available yet, using a placeholder");
+        #endif
+            return tex;
+        }
         Time end = Timer::Now();
         LOG_INFO("Loaded " << path << " in " << TimeToString(end - start));
         return tex;
@@ -222,33 +276,56 @@ Texture* AssetManager::LoadTexture(const std::string& name, Texture::Format form
     return textures[path];
 }
 
+size_t AssetManager::LoadPendingTextures() {
+    size_t loaded = 0;
+    for (auto it = pendingTextures.begin(); it != pendingTextures.end();) {
+        Texture* tex = it->second;
+        GLuint placeholder = tex->textureBuffer;
+        if (LoadTextureFile(tex, it->first)) {
+            glDeleteTextures(1, &placeholder);
+            tex->loaded = true;
+            it = pendingTextures.erase(it);
+            loaded++;
+        }
+        else {
+            ++it;
+        }
+    }
+    return loaded;
+}
+
 Audio* AssetManager::LoadAudio(const std::string& name, const std::string& path) {
     if (path.empty()) return nullptr;
     if (sounds.find(name) == sounds.end()) {
         Time start = Timer::Now();
-        unsigned int channels;
-        unsigned int sampleRate;
-        drwav_uint64 totalPCMFrameCount;
-        drwav_int16* pSampleData = drwav_open_file_and_read_pcm_frames_s16(path.c_str(),
-            &channels, &sampleRate, &totalPCMFrameCount, NULL);
-        if (!pSampleData) {
+        AudioDecoder decoder;
+        if (!decoder.Open(path)) {
             LOG_ERROR("Could not load audio " << path);
             throw std::runtime_error("Could not load audio");
         }
 
         Audio* sound = new Audio;
-        sound->data = pSampleData;
-        sound->channels = channels;
-        sound->sampleRate = sampleRate;
-        sound->frames = totalPCMFrameCount;
-
-        sound->InitializeAudio();
-        drwav_free(pSampleData, NULL);
-        sound->data = nullptr;
+        sound->channels = decoder.GetChannels();
+        sound->sampleRate = decoder.GetSampleRate();
+        sound->frames = decoder.GetFrames();
+        sound->path = path;
+
+        // Long clips only pay for their header now
+        if (decoder.GetDuration() > StreamedAudioSeconds) {
+            sound->streamed = true;
+        }
+        else {
+            std::vector<int16_t> samples = decoder.ReadAll();
+            sound->data = samples.data();
+            sound->frames = samples.size() / sound->channels;
+            sound->InitializeAudio();
+            sound->data = nullptr;
+        }
 
         sounds[name] = sound;
         Time end = Timer::Now();
-        LOG_INFO("Loaded " << path << " in " << TimeToString(end - start));
+        LOG_INFO("Loaded " << path << (sound->streamed ? " (streamed)" : "") << " in "
+            << TimeToString(end - start));
         return sound;
     }
     return sounds[name];
@@ -271,6 +348,15 @@ std::set<fs::path> SortedDirectory(const fs::path& path) {
 }
 
 void AssetManager::LoadDataFromDirectory() {
+    TRACE_SCOPE("AssetManager::LoadDataFromDirectory");
+    // Animation sets, the models they skin are weighted as they load
+    for (auto& p: SortedDirectory(RESOURCE_PATH("animations/"))) {
+        if (p.extension() != ".json") {
+            continue;
+        }
+        LoadAnimationGroup(p.stem().string(), p.string());
+    }
+
     // Models
     for (auto& p: SortedDirectory(RESOURCE_PATH("models/"))) {
         if (modelExtensions.find(p.extension().string()) == modelExtensions.end()) {
@@ -284,6 +370,7 @@ void AssetManager::LoadDataFromDirectory() {
             LOG_ERROR("Could not load model " << modelPath);
             throw std::system_error(errno, std::system_category(), "failed to open " + modelPath);
         }
+        TraceScope trace(Trace::IsEnabled() ? Trace::Intern("Load " + modelName) : nullptr);
         LoadModel(modelName, modelPath, modelStream);
     }
 
@@ -6,20 +6,35 @@
 
 #include "model.h"
 #include "mesh.h"
+#include "skeletal-animation-loader.h"
 #include "logging.h"
 #include "audio.h"
+#include "audio-decoder.h"
 #include "script-manager.h"
 
+#ifdef BUILD_CLIENT
+#include "texture_streamer.h"
+#endif
+
 class AssetManager {
     std::unordered_map<std::string, Model*> modelMap;
+    // Models skinned to an animation set, by file name
+    std::unordered_map<std::string, SkeletalAnimationGroup*> modelAnimations;
 
 public:
     #ifdef BUILD_CLIENT
         std::unordered_map<std::string, Texture*> textures;
         std::unordered_map<std::string, Audio*> sounds;
+
+        // Packed textures stream their mips in through here
+        TextureStreamer textureStreamer;
+
+        // Textures requested before their file exists, drawn untextured
+        std::unordered_map<std::string, Texture*> pendingTextures;
     #endif
 
     std::vector<Model*> models;
+    std::unordered_map<std::string, SkeletalAnimationGroup*> animationGroups;
 
     ~AssetManager();
     Model* GetModel(ModelID id) {
@@ -39,9 +54,17 @@ public:
     }
 
     ModelID LoadModel(const std::string& name, const std::string& path, std::istream& stream);
+    // Has to come before the models it lists are loaded
+    SkeletalAnimationGroup* LoadAnimationGroup(const std::string& name, const std::string& path);
 
 #ifdef BUILD_CLIENT
+    // False if neither the packed texture nor the source image exists
+    bool LoadTextureFile(Texture* texture, const std::string& path);
+    // Textures that aren't on disk yet get a placeholder, see LoadPendingTextures.
+    //   The editor has no bundles to wait on, it logs the missing file as an error
     Texture* LoadTexture(const std::string& path, Texture::Format format);
+    // Retries every placeholder texture, returns how many were loaded
+    size_t LoadPendingTextures();
     Audio* LoadAudio(const std::string& name, const std::string& path);
 
     Audio* GetAudio(const std::string& name) {
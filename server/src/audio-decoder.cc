@@ -0,0 +1,44 @@
+#include "audio-decoder.h"
+#include "logging.h"
+
+#define DR_WAV_IMPLEMENTATION
+#include "external/dr_wav.h"
+
+bool AudioDecoder::Open(const std::string& path) {
+    Close();
+    if (!drwav_init_file(&wav, path.c_str(), nullptr)) {
+        LOG_ERROR("Could not decode audio " << path);
+        return false;
+    }
+    if (wav.channels != 1 && wav.channels != 2) {
+        LOG_ERROR("Audio " << path << " has " << wav.channels << " channels");
+        drwav_uninit(&wav);
+        return false;
+    }
+    isOpen = true;
+    position = 0;
+    return true;
+}
+
+void AudioDecoder::Close() {
+    if (isOpen) {
+        drwav_uninit(&wav);
+        isOpen = false;
+    }
+}
+
+uint64_t AudioDecoder::Read(int16_t* out, uint64_t frames) {
+    if (!isOpen) return 0;
+    uint64_t read = drwav_read_pcm_frames_s16(&wav, frames, out);
+    position += read;
+    return read;
+}
+
+std::vector<int16_t> AudioDecoder::ReadAll() {
+    std::vector<int16_t> samples;
+    if (!isOpen) return samples;
+    uint64_t remaining = wav.totalPCMFrameCount - position;
+    samples.resize(remaining * wav.channels);
+    samples.resize(Read(samples.data(), remaining) * wav.channels);
+    return samples;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "external/dr_wav.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Clips longer than this are streamed while they play instead of being
+//   decoded when they load
+static const float StreamedAudioSeconds = 5.0f;
+// Streams decode this many frames at a time, with a few chunks queued ahead
+static const uint64_t StreamChunkFrames = 8192;
+static const size_t StreamChunkCount = 4;
+
+// Reads a WAV file (PCM or IMA ADPCM) as 16 bit samples, in one go or a
+//   chunk at a time
+class AudioDecoder {
+    drwav wav;
+    bool isOpen = false;
+    // Frames read so far
+    uint64_t position = 0;
+
+public:
+    AudioDecoder() {}
+    ~AudioDecoder() { Close(); }
+    AudioDecoder(const AudioDecoder&) = delete;
+    AudioDecoder& operator=(const AudioDecoder&) = delete;
+
+    // Only reads the header, false if the file can't be decoded
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return isOpen; }
+
+    unsigned int GetChannels() const { return wav.channels; }
+    unsigned int GetSampleRate() const { return wav.sampleRate; }
+    uint64_t GetFrames() const { return wav.totalPCMFrameCount; }
+    float GetDuration() const {
+        return wav.sampleRate ? (float) wav.totalPCMFrameCount / wav.sampleRate : 0.0f;
+    }
+
+    // Interleaved into out, returns fewer than frames at the end of the file
+    uint64_t Read(int16_t* out, uint64_t frames);
+    // The rest of the file
+    std::vector<int16_t> ReadAll();
+};
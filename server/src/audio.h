@@ -3,6 +3,7 @@
 #ifdef BUILD_CLIENT
 
 #include <cstdint>
+#include <string>
 #include <AL/al.h>
 #include <AL/alc.h>
 
@@ -12,25 +13,28 @@ struct Audio {
     unsigned int sampleRate;
     uint64_t frames;
 
-    ALuint audioBuffer;
+    // Unset for streamed clips, which are decoded from path as they play
+    ALuint audioBuffer = 0;
+    bool streamed = false;
+    std::string path;
 
-    void InitializeAudio() {
-        alGenBuffers(1, &audioBuffer);
-
-        ALenum format;
+    ALenum GetFormat() const {
         if (channels == 1) {
-            format = AL_FORMAT_MONO16;
+            return AL_FORMAT_MONO16;
         }
         else if (channels == 2) {
-            format = AL_FORMAT_STEREO16;
-        }
-        else {
-            LOG_ERROR("ERROR: unrecognised wave format: "
-                << channels << " channels");
-            throw "Unrecognized audio format";
+            return AL_FORMAT_STEREO16;
         }
+        LOG_ERROR("ERROR: unrecognised wave format: "
+            << channels << " channels");
+        throw "Unrecognized audio format";
+    }
+
+    void InitializeAudio() {
+        alGenBuffers(1, &audioBuffer);
+
         size_t bytes = frames * sizeof(signed short) * channels;
-        alBufferData(audioBuffer, format, data, bytes, sampleRate);
+        alBufferData(audioBuffer, GetFormat(), data, bytes, sampleRate);
     }
 };
 
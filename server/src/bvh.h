@@ -3,6 +3,7 @@
 #include "vector.h"
 #include "aabb.h"
 #include <vector>
+#include <iostream>
 
 // BVH Implementation From Mesh
 // Interface of a BVH Node
@@ -95,3 +96,24 @@ struct BVHTriangle : public BVHNode {
         return AABB::FromPoints(a, b, c);
     }
 };
+
+
+// Triangles of a model in model space (with scale applied) and the BVH over
+//   them. Built once per model and scale and shared by every
+//   StaticMeshCollider that uses it, queries are brought into this space by the collider.
+struct CollisionMesh {
+    AABB bounds;
+    BVHTree<BVHTriangle>* bvhTree = nullptr;
+
+    CollisionMesh() {}
+    CollisionMesh(const std::vector<Vertex*>& vertices, const Matrix4& transform);
+    ~CollisionMesh() {
+        delete bvhTree;
+    }
+
+    size_t GetTriangleCount() const;
+
+    // Binary form for the cache files GetCollisionMesh keeps beside models
+    void Serialize(std::ostream& out) const;
+    static CollisionMesh* Deserialize(std::istream& in);
+};
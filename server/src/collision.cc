@@ -2,6 +2,11 @@
 #include "object.h"
 #include "util.h"
 
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
 Vector3 Collider::GetPosition() {
     if (owner) {
         return position + owner->GetPosition();
@@ -20,20 +25,38 @@ Quaternion Collider::GetRotation() {
     }
 }
 
-Matrix4 Collider::GetWorldTransform() {
-    return GetWorldTransformForLocalPoint(position);
+uint32_t Collider::GetOwnerVersion() {
+    // Without an owner the collider never moves
+    return owner ? owner->GetRigidTransformVersion() : 1;
+}
+
+const Matrix4& Collider::GetWorldTransform() {
+    uint32_t version = GetOwnerVersion();
+    if (worldTransformVersion != version) {
+        worldTransform = GetWorldTransformForLocalPoint(position);
+        worldTransformVersion = version;
+    }
+    return worldTransform;
 }
 
 Matrix4 Collider::GetWorldTransformForLocalPoint(const Vector3& point) {
     Matrix4 model = glm::translate(point) * glm::toMat4(rotation);
     if (owner) {
         // Transform to owner space
-        model = glm::translate(owner->GetPosition()) *
-            glm::transpose(glm::toMat4(owner->GetRotation())) * model;
+        model = owner->GetRigidTransform() * model;
     }
     return model;
 }
 
+AABB Collider::GetBroadAABB() {
+    uint32_t version = GetOwnerVersion();
+    if (broadVersion != version) {
+        broad = ComputeBroadAABB();
+        broadVersion = version;
+    }
+    return broad;
+}
+
 void GenerateOBBCollidersFromModel(Object* obj) {
     // Each Mesh Becomes a Collider
     // LOG_DEBUG("Generating Map Colliders");
@@ -55,22 +78,107 @@ void GenerateOBBCollidersFromModel(Object* obj) {
     }
 }
 
+#ifndef __EMSCRIPTEN__
+namespace fs = std::filesystem;
+
+// Built meshes are kept beside the model file, one per scale, named by the
+//   scale's bits so nearby scales never share a file
+static std::string CollisionMeshCachePath(const Model* model, const Vector3& scale) {
+    std::ostringstream path;
+    path << model->path << std::hex;
+    for (int axis = 0; axis < 3; axis++) {
+        uint32_t bits;
+        std::memcpy(&bits, &scale[axis], sizeof(bits));
+        path << (axis == 0 ? '.' : 'x') << bits;
+    }
+    path << ".cmsh";
+    return path.str();
+}
+
+// Only trusted while newer than the model it was built from
+static CollisionMesh* ReadCachedCollisionMesh(const Model* model, const std::string& cachePath) {
+    std::error_code error;
+    fs::file_time_type cacheTime = fs::last_write_time(cachePath, error);
+    if (error) return nullptr;
+    fs::file_time_type modelTime = fs::last_write_time(model->path, error);
+    if (error || cacheTime < modelTime) return nullptr;
+
+    std::ifstream in(cachePath, std::ios::binary);
+    if (!in.is_open()) return nullptr;
+    return CollisionMesh::Deserialize(in);
+}
+
+static void WriteCachedCollisionMesh(const CollisionMesh* mesh, const std::string& cachePath) {
+    // Written aside and renamed so a reader never sees half a file
+    std::string partialPath = cachePath + ".partial";
+    {
+        std::ofstream out(partialPath, std::ios::binary);
+        if (out.is_open()) {
+            mesh->Serialize(out);
+        }
+        if (!out) {
+            LOG_WARN("Could not write collision mesh cache " << cachePath);
+            return;
+        }
+    }
+    std::error_code error;
+    fs::rename(partialPath, cachePath, error);
+    if (error) {
+        LOG_WARN("Could not write collision mesh cache " << cachePath << ": " << error.message());
+        fs::remove(partialPath, error);
+    }
+}
+#endif
+
+CollisionMesh* GetCollisionMesh(Model* model, const Vector3& scale) {
+    for (auto& pair : model->collisionMeshes) {
+        if (pair.first == scale) {
+            return pair.second;
+        }
+    }
+
+    // The web build's files are a preloaded package, nothing to reuse there
+    #ifndef __EMSCRIPTEN__
+    std::string cachePath;
+    if (!model->path.empty()) {
+        cachePath = CollisionMeshCachePath(model, scale);
+        if (CollisionMesh* cached = ReadCachedCollisionMesh(model, cachePath)) {
+            model->collisionMeshes.emplace_back(scale, cached);
+            return cached;
+        }
+    }
+    #endif
+
+    std::vector<Vertex*> allVerts;
+    for (Mesh* mesh : model->meshes) {
+        std::string lower = ToLower(mesh->name);
+        if (!mesh->vertices.empty() && !Contains(lower, "nocollide")) {
+            for (size_t i = 0; i < mesh->indices.size(); i += 3) {
+                allVerts.push_back(&mesh->vertices[mesh->indices[i]]);
+                allVerts.push_back(&mesh->vertices[mesh->indices[i + 1]]);
+                allVerts.push_back(&mesh->vertices[mesh->indices[i + 2]]);
+            }
+        }
+    }
+    CollisionMesh* collisionMesh = new CollisionMesh(allVerts, glm::scale(scale));
+    model->collisionMeshes.emplace_back(scale, collisionMesh);
+
+    #ifndef __EMSCRIPTEN__
+    if (!cachePath.empty()) {
+        WriteCachedCollisionMesh(collisionMesh, cachePath);
+    }
+    #endif
+    return collisionMesh;
+}
+
 void GenerateStaticMeshCollidersFromModel(Object* obj) {
     obj->ClearColliders();
     Model* model = obj->GetModel();
     if (model) {
-        std::vector<Vertex*> allVerts;
-        for (Mesh* mesh : model->meshes) {
-            std::string lower = ToLower(mesh->name);
-            if (!mesh->vertices.empty() && !Contains(lower, "nocollide")) {
-                for (size_t i = 0; i < mesh->indices.size(); i += 3) {
-                    allVerts.push_back(&mesh->vertices[mesh->indices[i]]);
-                    allVerts.push_back(&mesh->vertices[mesh->indices[i + 1]]);
-                    allVerts.push_back(&mesh->vertices[mesh->indices[i + 2]]);
-                }
-            }
-        }
-        obj->AddCollider(new StaticMeshCollider(obj, allVerts, obj->GetTransform()));
+        // Scale is baked into the shared mesh, position and rotation
+        //   are taken from the owner on every query
+        obj->AddCollider(new StaticMeshCollider(obj,
+            GetCollisionMesh(model, obj->GetScale())));
     }
 }
 
@@ -9,6 +9,7 @@
 #include "bvh.h"
 
 class Object;
+class Model;
 
 struct CollisionResult {
     bool isColliding = false;
@@ -17,6 +18,15 @@ struct CollisionResult {
 };
 std::ostream& operator<<(std::ostream& out, const CollisionResult& result);
 
+// First contact of a sphere moved along a line, time is the fraction of the
+//   movement made before it
+struct SweepResult {
+    bool isHit = false;
+    float time = 1;
+    Vector3 hitNormal;
+    Object* hitObject = nullptr;
+};
+
 enum class ColliderType : int {
     OBB,
     SPHERE,
@@ -31,6 +41,19 @@ struct Collider {
     Vector3 position;
     Quaternion rotation;
 
+    // World space, kept until the owner moves. Shapes don't change after
+    //   construction so the owner's transform version is the only key, 0 is
+    //   never computed.
+    Matrix4 worldTransform;
+    AABB broad;
+    uint32_t worldTransformVersion = 0;
+    uint32_t broadVersion = 0;
+
+    uint32_t GetOwnerVersion();
+
+    // Broad phase bounds from scratch, GetBroadAABB caches them
+    virtual AABB ComputeBroadAABB() = 0;
+
 public:
     Collider(Object* owner, Vector3 position, Quaternion rotation) :
         owner(owner), position(position), rotation(rotation) { }
@@ -38,7 +61,11 @@ public:
     virtual ~Collider() { }
     virtual ColliderType GetType() = 0;
 
-    virtual AABB GetBroadAABB() = 0;
+    AABB GetBroadAABB();
+
+    // Half the shape's thinnest width, a shorter move can't take its centre
+    //   across a surface it wasn't touching. 0 when it has no inside
+    virtual float GetHalfThickness() = 0;
 
     // Narrow Phase Collision
     virtual CollisionResult CollidesWith(Collider* other) = 0;
@@ -61,7 +88,7 @@ public:
     Vector3 GetPosition();
     Quaternion GetRotation();
 
-    Matrix4 GetWorldTransform();
+    const Matrix4& GetWorldTransform();
     Matrix4 GetWorldTransformForLocalPoint(const Vector3&);
 
     Object* GetOwner() { return owner; }
@@ -88,7 +115,11 @@ struct OBBCollider : public Collider {
 
     virtual ColliderType GetType() override { return ColliderType::OBB; }
 
-    virtual AABB GetBroadAABB() override;
+    virtual AABB ComputeBroadAABB() override;
+
+    virtual float GetHalfThickness() override {
+        return 0.5f * glm::min(size.x, size.y, size.z);
+    }
 
     CollisionResult CollidesWith(Collider* other) override;
     bool CollidesWith(RayCastRequest& ray, RayCastResult& result) override;
@@ -103,29 +134,29 @@ struct SphereCollider : public Collider {
         Collider(owner, position, Quaternion{}),
         radius(radius) {}
 
-    virtual AABB GetBroadAABB() override {
+    virtual AABB ComputeBroadAABB() override {
         return AABB(GetPosition() - radius, GetPosition() + radius);
     }
 
+    virtual float GetHalfThickness() override { return radius; }
+
     virtual ColliderType GetType() override { return ColliderType::SPHERE; }
     CollisionResult CollidesWith(Collider* other) override;
     bool CollidesWith(RayCastRequest& ray, RayCastResult& result) override;
 };
 
 struct StaticMeshCollider : public Collider {
-    AABB broad;
+    // Owned by the model, shared between every instance
+    CollisionMesh* mesh = nullptr;
 
-    BVHTree<BVHTriangle>* bvhTree = nullptr;
+    StaticMeshCollider(Object* owner, CollisionMesh* mesh) :
+        Collider(owner, Vector3{}, Quaternion{}), mesh(mesh) {}
 
-    StaticMeshCollider(Object* owner,
-        const std::vector<Vertex*>& vertices,
-        const Matrix4& transform);
+    ~StaticMeshCollider() {}
 
-    ~StaticMeshCollider();
+    virtual AABB ComputeBroadAABB() override;
 
-    virtual AABB GetBroadAABB() override {
-        return broad;
-    }
+    virtual float GetHalfThickness() override { return 0; }
 
     virtual ColliderType GetType() override { return ColliderType::STATIC_MESH; }
     CollisionResult CollidesWith(Collider* other) override;
@@ -142,7 +173,7 @@ struct CapsuleCollider : public Collider {
 
     ~CapsuleCollider() {}
 
-    virtual AABB GetBroadAABB() override {
+    virtual AABB ComputeBroadAABB() override {
         Vector3 pt1 = Vector3(GetWorldTransform() * Vector4(0, 0, 0, 1));
         Vector3 pt2 = Vector3(GetWorldTransformForLocalPoint(position2) * Vector4(0, 0, 0, 1));
 
@@ -150,6 +181,8 @@ struct CapsuleCollider : public Collider {
                 glm::max(pt1 + radius, pt2 + radius));
     }
 
+    virtual float GetHalfThickness() override { return radius; }
+
     virtual ColliderType GetType() override { return ColliderType::CAPSULE; }
     CollisionResult CollidesWith(Collider* other) override;
     bool CollidesWith(RayCastRequest& ray, RayCastResult& result) override;
@@ -206,6 +239,16 @@ struct TwoPhaseCollider {
         children.push_back(collider);
     }
 
+    // The thinnest child's, 0 if any has no inside
+    float GetHalfThickness() const {
+        if (children.empty()) return 0;
+        float thickness = children[0]->GetHalfThickness();
+        for (size_t i = 1; i < children.size(); i++) {
+            thickness = glm::min(thickness, children[i]->GetHalfThickness());
+        }
+        return thickness;
+    }
+
     AABB GetBroadAABB() const {
         if (children.empty()) return AABB{};
         AABB broad = children[0]->GetBroadAABB();;
@@ -218,9 +261,21 @@ struct TwoPhaseCollider {
 
 void GenerateOBBCollidersFromModel(Object* obj);
 void GenerateStaticMeshCollidersFromModel(Object* obj);
+CollisionMesh* GetCollisionMesh(Model* model, const Vector3& scale);
 bool AABBAndAABBCollide(const AABB& a, const AABB& b);
 
+// Adds the counts since the last clear to the collisions_total metric
 void ClearCollisionStatistics();
 void PrintCollisionStatistics();
 
-Vector3 ClosestPointOnAABB(const AABB& aabb, const Vector3& vec);
\ No newline at end of file
+Vector3 ClosestPointOnAABB(const AABB& aabb, const Vector3& vec);
+
+// Swept sphere queries, the sphere's centre moves from start by delta. A
+//   sphere that starts touching a shape is stopped at time 0 if it moves
+//   any closer, and passes it when sliding along or moving away. Each keeps
+//   result if it is already closer.
+bool SphereSweepMesh(const Vector3& start, const Vector3& delta, float radius,
+    StaticMeshCollider* collider, SweepResult& result);
+// Against the box grown by radius, which can only report contact early
+bool SphereSweepAABB(const Vector3& start, const Vector3& delta, float radius,
+    const AABB& aabb, SweepResult& result);
\ No newline at end of file
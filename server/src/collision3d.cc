@@ -2,7 +2,8 @@
 #include "object.h"
 #include "sat.h"
 #include "bvh.h"
-#include <queue>
+#include "metrics.h"
+#include <vector>
 
 size_t AABBAndAABBCollideCount;
 size_t OBBAndOBBCollideCount;
@@ -11,9 +12,42 @@ size_t AABBAndSphereCollideCount;
 size_t OBBAndSphereCollideCount;
 size_t SphereAndMeshCollideCount;
 size_t OBBAndMeshCollideCount;
-
+size_t SphereSweepMeshCount;
+size_t SphereSweepAABBCount;
+
+static const char* CollisionsHelp = "Collision tests run, by the shapes tested";
+static Counter& AABBAndAABBCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"aabb_aabb\"");
+static Counter& OBBAndOBBCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"obb_obb\"");
+static Counter& SphereAndSphereCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"sphere_sphere\"");
+static Counter& AABBAndSphereCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"aabb_sphere\"");
+static Counter& OBBAndSphereCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"obb_sphere\"");
+static Counter& SphereAndMeshCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"sphere_mesh\"");
+static Counter& OBBAndMeshCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"obb_mesh\"");
+static Counter& SphereSweepMeshCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"sphere_sweep_mesh\"");
+static Counter& SphereSweepAABBCollisions = GetMetrics().AddCounter("collisions_total", CollisionsHelp, "type=\"sphere_sweep_aabb\"");
+
+// Nodes left to visit in a BVH traversal. Every moving object runs these
+//   each collision pass, so the stack is kept per thread and reused.
+//   None of the traversals start another while they run
+static std::vector<BVHTree<BVHTriangle>*>& GetBVHStack() {
+    thread_local std::vector<BVHTree<BVHTriangle>*> stack;
+    stack.clear();
+    return stack;
+}
 
 void ClearCollisionStatistics() {
+    // The counts stay plain globals for the collision tests to bump, they
+    //   go to the metrics in one go here
+    AABBAndAABBCollisions.Add(AABBAndAABBCollideCount);
+    OBBAndOBBCollisions.Add(OBBAndOBBCollideCount);
+    SphereAndSphereCollisions.Add(SphereAndSphereCollideCount);
+    AABBAndSphereCollisions.Add(AABBAndSphereCollideCount);
+    OBBAndSphereCollisions.Add(OBBAndSphereCollideCount);
+    SphereAndMeshCollisions.Add(SphereAndMeshCollideCount);
+    OBBAndMeshCollisions.Add(OBBAndMeshCollideCount);
+    SphereSweepMeshCollisions.Add(SphereSweepMeshCount);
+    SphereSweepAABBCollisions.Add(SphereSweepAABBCount);
+
     AABBAndAABBCollideCount = 0;
     OBBAndOBBCollideCount = 0;
     SphereAndSphereCollideCount = 0;
@@ -21,6 +55,8 @@ void ClearCollisionStatistics() {
     OBBAndSphereCollideCount = 0;
     SphereAndMeshCollideCount = 0;
     OBBAndMeshCollideCount = 0;
+    SphereSweepMeshCount = 0;
+    SphereSweepAABBCount = 0;
 }
 
 void PrintCollisionStatistics() {
@@ -32,6 +68,8 @@ void PrintCollisionStatistics() {
     LOG_DEBUG("OBBAndSphereCollideCount: " << OBBAndSphereCollideCount);
     LOG_DEBUG("SphereAndMeshCollideCount: " << SphereAndMeshCollideCount);
     LOG_DEBUG("OBBAndMeshCollideCount: " << OBBAndMeshCollideCount);
+    LOG_DEBUG("SphereSweepMeshCount: " << SphereSweepMeshCount);
+    LOG_DEBUG("SphereSweepAABBCount: " << SphereSweepAABBCount);
 }
 
 std::ostream& operator<<(std::ostream& out, const CollisionResult& result) {
@@ -143,6 +181,14 @@ bool AABBAndAABBCollide(const AABB& a, const AABB& b) {
     return (leftCollide && rightCollide) && (topCollide && bottomCollide) && (frontCollide && backCollide);
 }
 
+inline Vector3 TransformPoint(const Vector3& point, const Matrix4& transform) {
+    return Vector3(transform * Vector4(point, 1));
+}
+
+inline Vector3 TransformNormal(const Vector3& normal, const Matrix4& transform) {
+    return Vector3(transform * Vector4(normal, 0));
+}
+
 void GenerateAABBRotatedCorners(Matrix4 transform, Vector3 size, Vector3* corners) {
     float x = size.x;
     float y = size.y;
@@ -157,7 +203,7 @@ void GenerateAABBRotatedCorners(Matrix4 transform, Vector3 size, Vector3* corner
     corners[7] = Vector3(transform * Vector4(x, y, z, 1));
 }
 
-AABB OBBCollider::GetBroadAABB() {
+AABB OBBCollider::ComputeBroadAABB() {
     Vector3 arr[8];
     GenerateAABBRotatedCorners(GetWorldTransform(), size, arr);
     return AABB {arr, 8};
@@ -382,29 +428,32 @@ inline Vector3 ClosestPointOnTriangle(BVHTriangle* t, const Vector3& point, Vect
 
 CollisionResult SphereAndMeshCollide(SphereCollider* sphere, StaticMeshCollider* collider) {
     SphereAndMeshCollideCount++;
-    if (!collider->bvhTree) {
+    if (!collider->mesh || !collider->mesh->bvhTree) {
         return CollisionResult{};
     }
-    Vector3 spherePosition = sphere->GetPosition();
+    // Bring the sphere into mesh space
+    Matrix4 transform = collider->GetWorldTransform();
+    Matrix4 inverse = glm::affineInverse(transform);
+    Vector3 spherePosition = TransformPoint(sphere->GetPosition(), inverse);
 
-    AABB broadRect = sphere->GetBroadAABB();
+    AABB broadRect(spherePosition - sphere->radius, spherePosition + sphere->radius);
     // BVH Find Triangles to Test
-    std::queue<BVHTree<BVHTriangle>*> checkQueue;
-    checkQueue.emplace(collider->bvhTree);
+    std::vector<BVHTree<BVHTriangle>*>& checkStack = GetBVHStack();
+    checkStack.push_back(collider->mesh->bvhTree);
 
     float minOverlap = INFINITY;
     // Vector3 reverseVelocity = -collider->owner->GetVelocity();
 
     CollisionResult result;
 
-    while (!checkQueue.empty()) {
-        BVHTree<BVHTriangle>* currNode = checkQueue.front();
-        checkQueue.pop();
+    while (!checkStack.empty()) {
+        BVHTree<BVHTriangle>* currNode = checkStack.back();
+        checkStack.pop_back();
         if (currNode->tris.empty()) {
             // Internal Node
             if (AABBAndAABBCollide(broadRect, currNode->collider)) {
                 for (const auto& p : currNode->children) {
-                    checkQueue.push(p);
+                    checkStack.push_back(p);
                 }
             }
         }
@@ -412,7 +461,7 @@ CollisionResult SphereAndMeshCollide(SphereCollider* sphere, StaticMeshCollider*
             for (const auto& tri : currNode->tris) {
                 Vector3 planePoint;
                 Vector3 point = ClosestPointOnTriangle(tri, spherePosition, planePoint);
-                float dist = glm::distance(point, sphere->GetPosition());
+                float dist = glm::distance(point, spherePosition);
                 if (dist < sphere->radius) {
                     // To move it out we move it from planePoint since that will allow
                     //   us to move it away from the triangle
@@ -426,6 +475,9 @@ CollisionResult SphereAndMeshCollide(SphereCollider* sphere, StaticMeshCollider*
             }
         }
     }
+    if (result.isColliding) {
+        result.collisionDifference = TransformNormal(result.collisionDifference, transform);
+    }
     return result;
 }
 
@@ -514,33 +566,37 @@ bool DoesLineSegmentPenetrateTriangle(BVHTriangle* tri, const Vector3& pt1,
 }
 
 CollisionResult CapsuleAndMeshCollide(CapsuleCollider* capsule, StaticMeshCollider* collider) {
-    if (!collider->bvhTree) {
+    if (!collider->mesh || !collider->mesh->bvhTree) {
         return CollisionResult{};
     }
     // Vector3 velocity = capsule->GetOwner()->GetVelocity();
-    AABB broadRect = capsule->GetBroadAABB();
+    Matrix4 transform = collider->GetWorldTransform();
+    Matrix4 inverse = glm::affineInverse(transform);
 
-    // Get World Position of Two Points of the Capsule Segment
-    Vector3 pt1 = capsule->GetWorldPoint1();
-    Vector3 pt2 = capsule->GetWorldPoint2();
+    // Get Mesh Space Position of Two Points of the Capsule Segment
+    Vector3 pt1 = TransformPoint(capsule->GetWorldPoint1(), inverse);
+    Vector3 pt2 = TransformPoint(capsule->GetWorldPoint2(), inverse);
     // LOG_DEBUG(capsule->GetOwner()->GetPosition() << " " << pt1 << " " << pt2);
 
-    std::queue<BVHTree<BVHTriangle>*> checkQueue;
-    checkQueue.emplace(collider->bvhTree);
+    AABB broadRect(glm::min(pt1, pt2) - capsule->radius,
+        glm::max(pt1, pt2) + capsule->radius);
+
+    std::vector<BVHTree<BVHTriangle>*>& checkStack = GetBVHStack();
+    checkStack.push_back(collider->mesh->bvhTree);
 
     float minOverlap = INFINITY;
     // Vector3 reverseVelocity = -collider->owner->GetVelocity();
 
     CollisionResult result;
 
-    while (!checkQueue.empty()) {
-        BVHTree<BVHTriangle>* currNode = checkQueue.front();
-        checkQueue.pop();
+    while (!checkStack.empty()) {
+        BVHTree<BVHTriangle>* currNode = checkStack.back();
+        checkStack.pop_back();
         if (currNode->tris.empty()) {
             // Internal Node
             if (AABBAndAABBCollide(broadRect, currNode->collider)) {
                 for (const auto& p : currNode->children) {
-                    checkQueue.push(p);
+                    checkStack.push_back(p);
                 }
             }
         }
@@ -624,6 +680,9 @@ CollisionResult CapsuleAndMeshCollide(CapsuleCollider* capsule, StaticMeshCollid
     // if (result.isColliding) {
     //     LOG_DEBUG("========");
     // }
+    if (result.isColliding) {
+        result.collisionDifference = TransformNormal(result.collisionDifference, transform);
+    }
     return result;
 }
 
@@ -632,24 +691,27 @@ CollisionResult OBBAndMeshCollide(OBBCollider* rect, StaticMeshCollider* collide
     // #ifdef BUILD_SERVER
     //     LOG_DEBUG("Start AABB & Mesh Collide " << collider->mesh.name);
     // #endif
-    if (!collider->bvhTree) {
+    if (!collider->mesh || !collider->mesh->bvhTree) {
         return CollisionResult{};
     }
     // Use BVH Tree to tell us which triangles to test
 
-    AABB broadRect = rect->GetBroadAABB();
+    Matrix4 transform = collider->GetWorldTransform();
+    Matrix4 inverse = glm::affineInverse(transform);
     Quaternion r1Rotation = rect->GetRotation();
     // LOG_DEBUG("AABB Mesh Collide");
 
+    // Box corners and axes in mesh space
     Vector3 r1Corners[8];
-    GenerateAABBRotatedCorners(rect->GetWorldTransform(), rect->size, r1Corners);
+    GenerateAABBRotatedCorners(inverse * rect->GetWorldTransform(), rect->size, r1Corners);
+    AABB broadRect { r1Corners, 8 };
 
-    Vector3 rax1 = r1Rotation * Vector::Up;
-    Vector3 rax2 = r1Rotation * Vector::Left;
-    Vector3 rax3 = r1Rotation * Vector::Forward;
+    Vector3 rax1 = TransformNormal(r1Rotation * Vector::Up, inverse);
+    Vector3 rax2 = TransformNormal(r1Rotation * Vector::Left, inverse);
+    Vector3 rax3 = TransformNormal(r1Rotation * Vector::Forward, inverse);
 
-    std::queue<BVHTree<BVHTriangle>*> checkQueue;
-    checkQueue.emplace(collider->bvhTree);
+    std::vector<BVHTree<BVHTriangle>*>& checkStack = GetBVHStack();
+    checkStack.push_back(collider->mesh->bvhTree);
 
     float minOverlap = INFINITY;
     Vector3 minOverlapNormal;
@@ -657,14 +719,14 @@ CollisionResult OBBAndMeshCollide(OBBCollider* rect, StaticMeshCollider* collide
 
     CollisionResult result;
 
-    while (!checkQueue.empty()) {
-        BVHTree<BVHTriangle>* currNode = checkQueue.front();
-        checkQueue.pop();
+    while (!checkStack.empty()) {
+        BVHTree<BVHTriangle>* currNode = checkStack.back();
+        checkStack.pop_back();
         if (currNode->tris.empty()) {
             // Internal Node
             if (AABBAndAABBCollide(broadRect, currNode->collider)) {
                 for (const auto& p : currNode->children) {
-                    checkQueue.push(p);
+                    checkStack.push_back(p);
                 }
             }
         }
@@ -760,6 +822,9 @@ CollisionResult OBBAndMeshCollide(OBBCollider* rect, StaticMeshCollider* collide
     //         result.collisionDifference.z = 0;
     //     }
     // }
+    if (result.isColliding) {
+        result.collisionDifference = TransformNormal(result.collisionDifference, transform);
+    }
     return result;
 }
 
@@ -797,31 +862,47 @@ CollisionResult StaticMeshCollider::CollidesWith(Collider* other) {
 }
 
 bool StaticMeshCollider::CollidesWith(RayCastRequest& ray, RayCastResult& result) {
+    if (!mesh || !mesh->bvhTree) {
+        return false;
+    }
     bool bresult = false;
 
-    std::queue<BVHTree<BVHTriangle>*> checkQueue;
-    checkQueue.emplace(bvhTree);
-
-    while (!checkQueue.empty()) {
-        BVHTree<BVHTriangle>* currNode = checkQueue.front();
-        checkQueue.pop();
+    // Bring Ray into Mesh Space, the transform is rigid so zDepth is unchanged
+    Matrix4 transform = GetWorldTransform();
+    Matrix4 inverse = glm::affineInverse(transform);
+    RayCastRequest localRay { ray };
+    localRay.startPoint = TransformPoint(ray.startPoint, inverse);
+    localRay.direction = TransformNormal(ray.direction, inverse);
+    RayCastResult localResult { result };
+
+    std::vector<BVHTree<BVHTriangle>*>& checkStack = GetBVHStack();
+    checkStack.push_back(mesh->bvhTree);
+
+    while (!checkStack.empty()) {
+        BVHTree<BVHTriangle>* currNode = checkStack.back();
+        checkStack.pop_back();
         if (currNode->tris.empty()) {
             // Internal Node
             RayCastResult fake;
-            if (currNode->collider.CollidesWith(ray, fake)) {
+            if (currNode->collider.CollidesWith(localRay, fake)) {
                 for (const auto& p : currNode->children) {
-                    checkQueue.push(p);
+                    checkStack.push_back(p);
                 }
             }
         }
         else {
             for (size_t i = 0; i < currNode->tris.size(); i++) {
-                bresult |= RayIntersectTriangle(ray, currNode->tris[i]->c,
-                    currNode->tris[i]->b, currNode->tris[i]->a, currNode->tris[i]->norm, result);
+                bresult |= RayIntersectTriangle(localRay, currNode->tris[i]->c,
+                    currNode->tris[i]->b, currNode->tris[i]->a, currNode->tris[i]->norm, localResult);
             }
         }
     }
 
+    if (bresult) {
+        result = localResult;
+        result.hitLocation = TransformPoint(localResult.hitLocation, transform);
+        result.hitNormal = TransformNormal(localResult.hitNormal, transform);
+    }
     return bresult;
 }
 
@@ -908,6 +989,194 @@ bool SphereAndRayCollide(const Vector3& sphereCenter, float radius, RayCastReque
 }
 
 
+// Earliest time before time that a point moving from start by delta comes
+//   within radius of center
+static bool PointSweepSphere(const Vector3& start, const Vector3& delta,
+        const Vector3& center, float radius, float& time) {
+    Vector3 m = start - center;
+    float a = glm::dot(delta, delta);
+    float b = glm::dot(m, delta);
+    float c = glm::dot(m, m) - radius * radius;
+    // Inside already or moving away
+    if (c <= 0 || b >= 0 || IsZero(a)) return false;
+    float discriminant = b * b - a * c;
+    if (discriminant < 0) return false;
+    float t = (-b - glm::sqrt(discriminant)) / a;
+    if (t >= time) return false;
+    time = t;
+    return true;
+}
+
+// Same for the side of the cylinder around the segment p1 p2, the ends are
+//   left to PointSweepSphere
+static bool PointSweepCylinder(const Vector3& start, const Vector3& delta,
+        const Vector3& p1, const Vector3& p2, float radius, float& time) {
+    Vector3 d = p2 - p1;
+    Vector3 m = start - p1;
+    float dd = glm::dot(d, d);
+    float md = glm::dot(m, d);
+    float nd = glm::dot(delta, d);
+    float a = dd * glm::dot(delta, delta) - nd * nd;
+    float b = dd * glm::dot(m, delta) - nd * md;
+    float c = dd * (glm::dot(m, m) - radius * radius) - md * md;
+    // Barely moving across the segment, inside already or moving away
+    if (IsZero(a / dd) || c <= 0 || b >= 0) return false;
+    float discriminant = b * b - a * c;
+    if (discriminant < 0) return false;
+    float t = (-b - glm::sqrt(discriminant)) / a;
+    float along = md + t * nd;
+    if (t >= time || along < 0 || along > dd) return false;
+    time = t;
+    return true;
+}
+
+// A sweep stops with the sphere exactly at its contact, the next one has to
+//   see it touching even though rounding may leave it a little short
+static const float SweepContactSlop = 1e-3f;
+
+static bool SphereSweepTriangle(BVHTriangle* tri, const Vector3& start,
+        const Vector3& delta, float radius, float& time) {
+    Vector3 norm = glm::normalize(tri->norm);
+    float from = glm::dot(norm, start - tri->a);
+
+    Vector3 planePoint;
+    Vector3 closest = ClosestPointOnTriangle(tri, start, planePoint);
+    if (glm::distance(closest, start) < radius + SweepContactSlop) {
+        // Touching already, moving any closer stops it where it is. How deep
+        //   the colliders are is only known to the narrow phase
+        if (time <= 0 || glm::dot(delta, closest - start) <= 0) return false;
+        time = 0;
+        return true;
+    }
+
+    // Face first, from whichever side the sphere is on. When it is touched
+    //   nothing else of the triangle can be touched sooner
+    float side = from < 0 ? -1.f : 1.f;
+    float approach = -side * glm::dot(norm, delta);
+    if (approach > 0) {
+        float t = (side * from - radius) / approach;
+        if (t >= 0 && t < time &&
+                IsPointInTriangle(start + delta * t - norm * (side * radius), tri->a, tri->b, tri->c)) {
+            time = t;
+            return true;
+        }
+    }
+
+    bool hit = false;
+    hit |= PointSweepCylinder(start, delta, tri->a, tri->b, radius, time);
+    hit |= PointSweepCylinder(start, delta, tri->b, tri->c, radius, time);
+    hit |= PointSweepCylinder(start, delta, tri->c, tri->a, radius, time);
+    hit |= PointSweepSphere(start, delta, tri->a, radius, time);
+    hit |= PointSweepSphere(start, delta, tri->b, radius, time);
+    hit |= PointSweepSphere(start, delta, tri->c, radius, time);
+    return hit;
+}
+
+bool SphereSweepMesh(const Vector3& start, const Vector3& delta, float radius,
+        StaticMeshCollider* collider, SweepResult& result) {
+    SphereSweepMeshCount++;
+    if (!collider->mesh || !collider->mesh->bvhTree) {
+        return false;
+    }
+    // Bring the sweep into mesh space, the transform is rigid so the radius
+    //   and times are unchanged
+    Matrix4 transform = collider->GetWorldTransform();
+    Matrix4 inverse = glm::affineInverse(transform);
+    Vector3 localStart = TransformPoint(start, inverse);
+    Vector3 localDelta = TransformNormal(delta, inverse);
+    Vector3 localEnd = localStart + localDelta;
+    AABB broadRect(glm::min(localStart, localEnd) - radius, glm::max(localStart, localEnd) + radius);
+
+    float time = result.time;
+    BVHTriangle* hitTriangle = nullptr;
+
+    std::vector<BVHTree<BVHTriangle>*>& checkStack = GetBVHStack();
+    checkStack.push_back(collider->mesh->bvhTree);
+    while (!checkStack.empty()) {
+        BVHTree<BVHTriangle>* currNode = checkStack.back();
+        checkStack.pop_back();
+        if (!AABBAndAABBCollide(broadRect, currNode->collider)) {
+            continue;
+        }
+        if (currNode->tris.empty()) {
+            // Internal Node
+            for (const auto& p : currNode->children) {
+                checkStack.push_back(p);
+            }
+        }
+        else {
+            for (const auto& tri : currNode->tris) {
+                if (SphereSweepTriangle(tri, localStart, localDelta, radius, time)) {
+                    hitTriangle = tri;
+                }
+            }
+        }
+    }
+    if (!hitTriangle) {
+        return false;
+    }
+
+    // Away from the closest point at contact, or the face when the centre
+    //   is on it
+    Vector3 center = localStart + localDelta * time;
+    Vector3 planePoint;
+    Vector3 normal = center - ClosestPointOnTriangle(hitTriangle, center, planePoint);
+    if (IsZero(normal)) {
+        normal = glm::dot(hitTriangle->norm, localDelta) > 0 ? -hitTriangle->norm : hitTriangle->norm;
+    }
+    result.isHit = true;
+    result.time = time;
+    result.hitNormal = glm::normalize(TransformNormal(normal, transform));
+    result.hitObject = collider->GetOwner();
+    return true;
+}
+
+bool SphereSweepAABB(const Vector3& start, const Vector3& delta, float radius,
+        const AABB& aabb, SweepResult& result) {
+    SphereSweepAABBCount++;
+    // Touching already, moving any closer stops it where it is
+    AABB box(aabb.ptMin - radius, aabb.ptMax + radius);
+    AABB touching(box.ptMin - SweepContactSlop, box.ptMax + SweepContactSlop);
+    if (IsPointInAABB(touching.ptMin, touching.ptMax - touching.ptMin, start)) {
+        Vector3 closest = ClosestPointOnAABB(aabb, start);
+        if (result.time <= 0 || glm::dot(delta, closest - start) <= 0) {
+            return false;
+        }
+        result.isHit = true;
+        result.time = 0;
+        result.hitNormal = glm::normalize(start - closest);
+        return true;
+    }
+
+    // Slabs, entering the last one is entering the box
+    float enter = 0;
+    float exit = result.time;
+    int axis = -1;
+    for (int i = 0; i < 3; i++) {
+        if (IsZero(delta[i])) {
+            if (start[i] < box.ptMin[i] || start[i] > box.ptMax[i]) return false;
+            continue;
+        }
+        float t1 = (box.ptMin[i] - start[i]) / delta[i];
+        float t2 = (box.ptMax[i] - start[i]) / delta[i];
+        if (t1 > t2) std::swap(t1, t2);
+        if (t1 >= enter) {
+            enter = t1;
+            axis = i;
+        }
+        exit = glm::min(exit, t2);
+        if (enter > exit) return false;
+    }
+    if (axis < 0 || enter >= result.time) {
+        return false;
+    }
+    result.isHit = true;
+    result.time = enter;
+    result.hitNormal = Vector3();
+    result.hitNormal[axis] = delta[axis] > 0 ? -1.f : 1.f;
+    return true;
+}
+
 Vector3 ProjectPointToPlane(const Vector3& point, const Vector3& planePoint, const Vector3& planeNorm) {
     float t = (glm::dot(planeNorm, planePoint) - glm::dot(planeNorm, point)) / glm::length2(planeNorm);
     return point + t * planeNorm;
@@ -996,18 +1265,17 @@ CollisionResult CapsuleAndOBBCollide(CapsuleCollider* capsule, OBBCollider* obb)
     return result;
 }
 
-inline Vector3 TransformPoint(const Vector3& point, const Matrix4& transform) {
-    return Vector3(transform * Vector4(point, 1));
-}
-
-inline Vector3 TransformNormal(const Vector3& normal, const Matrix4& transform) {
-    return Vector3(transform * Vector4(normal, 0));
+AABB StaticMeshCollider::ComputeBroadAABB() {
+    if (!mesh) {
+        return AABB{};
+    }
+    Vector3 corners[8];
+    GenerateAABBRotatedCorners(GetWorldTransform() * glm::translate(mesh->bounds.ptMin),
+        mesh->bounds.ptMax - mesh->bounds.ptMin, corners);
+    return AABB { corners, 8 };
 }
 
-StaticMeshCollider::StaticMeshCollider(Object* owner, const std::vector<Vertex*>& vertices,
-    const Matrix4& transform) :
-    Collider(owner, Vector3{}, Quaternion{}) {
-
+CollisionMesh::CollisionMesh(const std::vector<Vertex*>& vertices, const Matrix4& transform) {
     Matrix4 normalMatrix = glm::transpose(glm::inverse(transform));
 
     if (!vertices.empty()) {
@@ -1017,12 +1285,12 @@ StaticMeshCollider::StaticMeshCollider(Object* owner, const std::vector<Vertex*>
             min = glm::min(min, TransformPoint(vertices[i]->position, transform));
             max = glm::max(max, TransformPoint(vertices[i]->position, transform));
         }
-        glm::vec3 bounds = max - min;
-        broad = AABB(min, max);
+        glm::vec3 extent = max - min;
+        bounds = AABB(min, max);
 
         int axis = 0;
-        if (bounds.y > bounds.x && bounds.y > bounds.z) axis = 1;
-        if (bounds.z > bounds.x && bounds.z > bounds.y) axis = 2;
+        if (extent.y > extent.x && extent.y > extent.z) axis = 1;
+        if (extent.z > extent.x && extent.z > extent.y) axis = 2;
 
         std::vector<BVHTriangle*> triangles;
 
@@ -1038,33 +1306,124 @@ StaticMeshCollider::StaticMeshCollider(Object* owner, const std::vector<Vertex*>
             triangles.push_back(new BVHTriangle(a, b, c, normal));
         }
         bvhTree = BVHTree<BVHTriangle>::Create(triangles, axis, 0);
-        // for (auto& tri : triangles) {
-        //     BVHTriangle* triangle = dynamic_cast<BVHTriangle*>(tri);
-        //     // if (!triangle->parentVolume) {
-        //     //     LOG_ERROR("Triangle " << triangle->a << " " << triangle->b <<
-        //     //         " " << triangle->c << " was not placed in a BVH volume!");
-        //     // }
-        //     // else {
-        //     //     AABB& col = triangle->parentVolume->collider;
-        //     //     if (!IsPointInAABB(col.position, col.size, triangle->a)) {
-        //     //         LOG_ERROR("A not in bound " << triangle->a);
-        //     //         LOG_ERROR(col.position << " " << col.size);
-        //     //     }
-        //     //     if (!IsPointInAABB(col.position, col.size, triangle->b)) {
-        //     //         LOG_ERROR("B not in bound " << triangle->b);
-        //     //         LOG_ERROR(col.position << " " << col.size);
-        //     //     }
-        //     //     if (!IsPointInAABB(col.position, col.size, triangle->c)) {
-        //     //         LOG_ERROR("C not in bound " << triangle->c);
-        //     //         LOG_ERROR(col.position << " " << col.size);
-        //     //     }
-        //     // }
-        // }
     }
 }
 
-StaticMeshCollider::~StaticMeshCollider() {
-    delete bvhTree;
+size_t CollisionMesh::GetTriangleCount() const {
+    size_t count = 0;
+    if (!bvhTree) return count;
+    std::vector<BVHTree<BVHTriangle>*>& checkStack = GetBVHStack();
+    checkStack.push_back(bvhTree);
+    while (!checkStack.empty()) {
+        BVHTree<BVHTriangle>* currNode = checkStack.back();
+        checkStack.pop_back();
+        count += currNode->tris.size();
+        for (const auto& p : currNode->children) {
+            checkStack.push_back(p);
+        }
+    }
+    return count;
+}
+
+// Collision Mesh Binary Format
+//   header: magic, version, bounds, hasTree
+//   node: bounds, childCount, triCount, tris (a, b, c, norm), children...
+static const uint32_t CollisionMeshMagic = 0x48534D43; // "CMSH"
+static const uint32_t CollisionMeshVersion = 1;
+
+template<typename T>
+static void WriteBinary(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool ReadBinary(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return in.good();
+}
+
+static void WriteBVHNode(std::ostream& out, const BVHTree<BVHTriangle>* node) {
+    WriteBinary(out, node->collider.ptMin);
+    WriteBinary(out, node->collider.ptMax);
+    WriteBinary(out, (uint32_t) node->children.size());
+    WriteBinary(out, (uint32_t) node->tris.size());
+    for (const auto& tri : node->tris) {
+        WriteBinary(out, tri->a);
+        WriteBinary(out, tri->b);
+        WriteBinary(out, tri->c);
+        WriteBinary(out, tri->norm);
+    }
+    for (const auto& child : node->children) {
+        WriteBVHNode(out, child);
+    }
+}
+
+static BVHTree<BVHTriangle>* ReadBVHNode(std::istream& in) {
+    BVHTree<BVHTriangle>* node = new BVHTree<BVHTriangle>;
+    uint32_t childCount, triCount;
+    if (!ReadBinary(in, node->collider.ptMin) ||
+        !ReadBinary(in, node->collider.ptMax) ||
+        !ReadBinary(in, childCount) ||
+        !ReadBinary(in, triCount)) {
+        delete node;
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < triCount; i++) {
+        Vector3 a, b, c, norm;
+        if (!ReadBinary(in, a) || !ReadBinary(in, b) ||
+            !ReadBinary(in, c) || !ReadBinary(in, norm)) {
+            delete node;
+            return nullptr;
+        }
+        node->tris.push_back(new BVHTriangle(a, b, c, norm));
+    }
+    for (uint32_t i = 0; i < childCount; i++) {
+        BVHTree<BVHTriangle>* child = ReadBVHNode(in);
+        if (!child) {
+            delete node;
+            return nullptr;
+        }
+        node->children.push_back(child);
+    }
+    return node;
+}
+
+void CollisionMesh::Serialize(std::ostream& out) const {
+    WriteBinary(out, CollisionMeshMagic);
+    WriteBinary(out, CollisionMeshVersion);
+    WriteBinary(out, bounds.ptMin);
+    WriteBinary(out, bounds.ptMax);
+    WriteBinary(out, (uint8_t) (bvhTree != nullptr));
+    if (bvhTree) {
+        WriteBVHNode(out, bvhTree);
+    }
+}
+
+CollisionMesh* CollisionMesh::Deserialize(std::istream& in) {
+    uint32_t magic, version;
+    uint8_t hasTree;
+    if (!ReadBinary(in, magic) || magic != CollisionMeshMagic ||
+        !ReadBinary(in, version) || version != CollisionMeshVersion) {
+        LOG_WARN("Collision mesh cache has wrong format, ignoring");
+        return nullptr;
+    }
+    CollisionMesh* mesh = new CollisionMesh;
+    if (!ReadBinary(in, mesh->bounds.ptMin) ||
+        !ReadBinary(in, mesh->bounds.ptMax) ||
+        !ReadBinary(in, hasTree)) {
+        LOG_WARN("Collision mesh cache is truncated, ignoring");
+        delete mesh;
+        return nullptr;
+    }
+    if (hasTree) {
+        mesh->bvhTree = ReadBVHNode(in);
+        if (!mesh->bvhTree) {
+            LOG_WARN("Collision mesh cache is truncated, ignoring");
+            delete mesh;
+            return nullptr;
+        }
+    }
+    return mesh;
 }
 
 
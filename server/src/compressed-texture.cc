@@ -0,0 +1,380 @@
+#include "compressed-texture.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+std::string CompressedTexturePath(const std::string& imagePath) {
+    size_t dot = imagePath.find_last_of('.');
+    size_t slash = imagePath.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return imagePath + ".ctex";
+    }
+    return imagePath.substr(0, dot) + ".ctex";
+}
+
+size_t CompressedBlockSize(CompressedFormat format) {
+    return format == CompressedFormat::BC1 ? 8 : 16;
+}
+
+size_t CompressedLevelSize(CompressedFormat format, uint32_t width, uint32_t height) {
+    size_t blocksX = (width + 3) / 4;
+    size_t blocksY = (height + 3) / 4;
+    return blocksX * blocksY * CompressedBlockSize(format);
+}
+
+static uint16_t To565(const float* color) {
+    int r = (int) std::round(std::clamp(color[0], 0.f, 255.f) * 31.f / 255.f);
+    int g = (int) std::round(std::clamp(color[1], 0.f, 255.f) * 63.f / 255.f);
+    int b = (int) std::round(std::clamp(color[2], 0.f, 255.f) * 31.f / 255.f);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void From565(uint16_t value, int* color) {
+    int r = (value >> 11) & 31;
+    int g = (value >> 5) & 63;
+    int b = value & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+static void ColorPalette(uint16_t c0, uint16_t c1, int palette[4][3], bool forceFourColor) {
+    From565(c0, palette[0]);
+    From565(c1, palette[1]);
+    for (int i = 0; i < 3; i++) {
+        if (c0 > c1 || forceFourColor) {
+            palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+            palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+        }
+        else {
+            palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+            palette[3][i] = 0;
+        }
+    }
+}
+
+// Endpoints on the principal axis of the block's colors, then every pixel
+//   takes the closest of the four palette entries
+static void EncodeColorBlock(const uint8_t* block, uint8_t* out) {
+    float mean[3] = { 0, 0, 0 };
+    for (int p = 0; p < 16; p++) {
+        for (int i = 0; i < 3; i++) mean[i] += block[p * 4 + i];
+    }
+    for (int i = 0; i < 3; i++) mean[i] /= 16.f;
+
+    float cov[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int p = 0; p < 16; p++) {
+        float r = block[p * 4 + 0] - mean[0];
+        float g = block[p * 4 + 1] - mean[1];
+        float b = block[p * 4 + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    float axis[3] = { 1, 1, 1 };
+    for (int iter = 0; iter < 4; iter++) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max({ std::abs(x), std::abs(y), std::abs(z) });
+        if (length < 1e-6f) break;
+        axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+    }
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (int i = 0; i < 3; i++) axis[i] /= axisLength;
+
+    float tMin = 1e9f, tMax = -1e9f;
+    for (int p = 0; p < 16; p++) {
+        float t = 0;
+        for (int i = 0; i < 3; i++) t += (block[p * 4 + i] - mean[i]) * axis[i];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    // Inset so the interpolated entries land inside the range
+    float inset = (tMax - tMin) / 16.f;
+    tMin += inset;
+    tMax -= inset;
+
+    float maxColor[3], minColor[3];
+    for (int i = 0; i < 3; i++) {
+        maxColor[i] = mean[i] + axis[i] * tMax;
+        minColor[i] = mean[i] + axis[i] * tMin;
+    }
+    uint16_t c0 = To565(maxColor);
+    uint16_t c1 = To565(minColor);
+    if (c0 < c1) std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int palette[4][3];
+        ColorPalette(c0, c1, palette, false);
+        for (int p = 0; p < 16; p++) {
+            int best = 0, bestDistance = 1 << 30;
+            for (int e = 0; e < 4; e++) {
+                int distance = 0;
+                for (int i = 0; i < 3; i++) {
+                    int d = block[p * 4 + i] - palette[e][i];
+                    distance += d * d;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = e;
+                }
+            }
+            indices |= (uint32_t) best << (p * 2);
+        }
+    }
+
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++) out[4 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+static void DecodeColorBlock(const uint8_t* in, uint8_t* block, bool forceFourColor) {
+    uint16_t c0 = in[0] | (in[1] << 8);
+    uint16_t c1 = in[2] | (in[3] << 8);
+    uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t) in[7] << 24);
+    int palette[4][3];
+    ColorPalette(c0, c1, palette, forceFourColor);
+    bool transparentBlack = !forceFourColor && c0 <= c1;
+    for (int p = 0; p < 16; p++) {
+        int index = (indices >> (p * 2)) & 3;
+        for (int i = 0; i < 3; i++) block[p * 4 + i] = palette[index][i];
+        block[p * 4 + 3] = (transparentBlack && index == 3) ? 0 : 255;
+    }
+}
+
+static void AlphaPalette(uint8_t a0, uint8_t a1, int palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    }
+    else {
+        for (int i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static void EncodeAlphaBlock(const uint8_t* block, uint8_t* out) {
+    uint8_t a0 = 0, a1 = 255;
+    for (int p = 0; p < 16; p++) {
+        a0 = std::max(a0, block[p * 4 + 3]);
+        a1 = std::min(a1, block[p * 4 + 3]);
+    }
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        int palette[8];
+        AlphaPalette(a0, a1, palette);
+        for (int p = 0; p < 16; p++) {
+            int best = 0, bestDistance = 1 << 30;
+            for (int e = 0; e < 8; e++) {
+                int distance = std::abs(block[p * 4 + 3] - palette[e]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = e;
+                }
+            }
+            indices |= (uint64_t) best << (p * 3);
+        }
+    }
+    out[0] = a0;
+    out[1] = a1;
+    for (int i = 0; i < 6; i++) out[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+static void DecodeAlphaBlock(const uint8_t* in, uint8_t* block) {
+    int palette[8];
+    AlphaPalette(in[0], in[1], palette);
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) indices |= (uint64_t) in[2 + i] << (i * 8);
+    for (int p = 0; p < 16; p++) {
+        block[p * 4 + 3] = palette[(indices >> (p * 3)) & 7];
+    }
+}
+
+void CompressImage(CompressedFormat format, const uint8_t* rgba,
+        uint32_t width, uint32_t height, std::vector<uint8_t>& out) {
+    out.resize(CompressedLevelSize(format, width, height));
+    size_t blockSize = CompressedBlockSize(format);
+    uint8_t* dest = out.data();
+    uint8_t block[16 * 4];
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            for (uint32_t y = 0; y < 4; y++) {
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t sx = std::min(bx + x, width - 1);
+                    uint32_t sy = std::min(by + y, height - 1);
+                    const uint8_t* src = rgba + (sy * width + sx) * 4;
+                    std::copy(src, src + 4, block + (y * 4 + x) * 4);
+                }
+            }
+            if (format == CompressedFormat::BC3) {
+                EncodeAlphaBlock(block, dest);
+                EncodeColorBlock(block, dest + 8);
+            }
+            else {
+                EncodeColorBlock(block, dest);
+            }
+            dest += blockSize;
+        }
+    }
+}
+
+void DecompressImage(CompressedFormat format, const uint8_t* blocks,
+        uint32_t width, uint32_t height, uint8_t* rgba) {
+    size_t blockSize = CompressedBlockSize(format);
+    uint8_t block[16 * 4];
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            if (format == CompressedFormat::BC3) {
+                DecodeColorBlock(blocks + 8, block, true);
+                DecodeAlphaBlock(blocks, block);
+            }
+            else {
+                DecodeColorBlock(blocks, block, false);
+            }
+            blocks += blockSize;
+
+            for (uint32_t y = 0; y < 4 && by + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && bx + x < width; x++) {
+                    const uint8_t* src = block + (y * 4 + x) * 4;
+                    std::copy(src, src + 4, rgba + ((by + y) * width + bx + x) * 4);
+                }
+            }
+        }
+    }
+}
+
+void DownsampleImage(const uint8_t* rgba, uint32_t width, uint32_t height,
+        std::vector<uint8_t>& out) {
+    uint32_t outWidth = std::max(1u, width / 2);
+    uint32_t outHeight = std::max(1u, height / 2);
+    out.resize(outWidth * outHeight * 4);
+    for (uint32_t y = 0; y < outHeight; y++) {
+        uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (uint32_t x = 0; x < outWidth; x++) {
+            uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (int i = 0; i < 4; i++) {
+                int sum = rgba[(y0 * width + x0) * 4 + i] + rgba[(y0 * width + x1) * 4 + i] +
+                          rgba[(y1 * width + x0) * 4 + i] + rgba[(y1 * width + x1) * 4 + i];
+                out[(y * outWidth + x) * 4 + i] = (sum + 2) / 4;
+            }
+        }
+    }
+}
+
+static void WriteU32(std::ostream& stream, uint32_t value) {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static uint32_t ReadU32(std::istream& stream) {
+    uint32_t value = 0;
+    stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+static bool IsPowerOfTwo(uint32_t value) {
+    return value && !(value & (value - 1));
+}
+
+void WriteCompressedTexture(std::ostream& stream, CompressedFormat format,
+        const uint8_t* rgba, uint32_t width, uint32_t height) {
+    if (!IsPowerOfTwo(width) || !IsPowerOfTwo(height)) {
+        LOG_ERROR("Compressed texture size must be a power of two, got " << width << "x" << height);
+        throw std::runtime_error("Compressed texture size must be a power of two");
+    }
+
+    std::vector<std::vector<uint8_t>> levels;
+    std::vector<CompressedMip> mips;
+    std::vector<uint8_t> image(rgba, rgba + width * height * 4);
+    std::vector<uint8_t> next;
+    uint32_t w = width, h = height;
+    while (true) {
+        levels.emplace_back();
+        CompressImage(format, image.data(), w, h, levels.back());
+        CompressedMip mip;
+        mip.width = w;
+        mip.height = h;
+        mip.size = levels.back().size();
+        mips.push_back(mip);
+        if (w == 1 && h == 1) break;
+
+        DownsampleImage(image.data(), w, h, next);
+        image.swap(next);
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+    }
+
+    CompressedTextureHeader header;
+    header.format = format;
+    header.width = width;
+    header.height = height;
+    header.mipCount = mips.size();
+
+    // Smallest level first
+    uint32_t offset = sizeof(uint32_t) * (6 + 4 * mips.size());
+    for (size_t i = mips.size(); i-- > 0;) {
+        mips[i].offset = offset;
+        offset += mips[i].size;
+    }
+
+    WriteU32(stream, header.magic);
+    WriteU32(stream, header.version);
+    WriteU32(stream, (uint32_t) header.format);
+    WriteU32(stream, header.width);
+    WriteU32(stream, header.height);
+    WriteU32(stream, header.mipCount);
+    for (auto& mip : mips) {
+        WriteU32(stream, mip.width);
+        WriteU32(stream, mip.height);
+        WriteU32(stream, mip.offset);
+        WriteU32(stream, mip.size);
+    }
+    for (size_t i = levels.size(); i-- > 0;) {
+        stream.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+    }
+
+    if (!stream) {
+        LOG_ERROR("Could not write compressed texture");
+        throw std::runtime_error("Could not write compressed texture");
+    }
+}
+
+void ReadCompressedTexture(std::istream& stream, CompressedTexture& texture) {
+    auto& header = texture.header;
+    header.magic = ReadU32(stream);
+    header.version = ReadU32(stream);
+    header.format = (CompressedFormat) ReadU32(stream);
+    header.width = ReadU32(stream);
+    header.height = ReadU32(stream);
+    header.mipCount = ReadU32(stream);
+    if (!stream || header.magic != CompressedTextureHeader::Magic ||
+            header.version != CompressedTextureHeader::Version) {
+        LOG_ERROR("Invalid compressed texture header");
+        throw std::runtime_error("Invalid compressed texture header");
+    }
+    if (header.format != CompressedFormat::BC1 && header.format != CompressedFormat::BC3) {
+        LOG_ERROR("Unknown compressed texture format " << (uint32_t) header.format);
+        throw std::runtime_error("Unknown compressed texture format");
+    }
+    if (header.mipCount == 0 || header.mipCount > 32) {
+        LOG_ERROR("Invalid compressed texture mip count " << header.mipCount);
+        throw std::runtime_error("Invalid compressed texture mip count");
+    }
+
+    texture.mips.resize(header.mipCount);
+    for (auto& mip : texture.mips) {
+        mip.width = ReadU32(stream);
+        mip.height = ReadU32(stream);
+        mip.offset = ReadU32(stream);
+        mip.size = ReadU32(stream);
+    }
+    if (!stream) {
+        LOG_ERROR("Truncated compressed texture mip table");
+        throw std::runtime_error("Truncated compressed texture mip table");
+    }
+}
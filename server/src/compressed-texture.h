@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Block compressed texture container (.ctex) written by the texture packer
+//   Mip 0 is the full resolution level, the data of every level is stored
+//   smallest first so a reader streaming the file gets the low mips first
+
+enum class CompressedFormat : uint32_t {
+    // RGB, 8 bytes per 4x4 block (DXT1)
+    BC1 = 0,
+    // RGBA, 16 bytes per 4x4 block (DXT5)
+    BC3 = 1,
+};
+
+struct CompressedMip {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // From the start of the file
+    uint32_t offset = 0;
+    uint32_t size = 0;
+};
+
+struct CompressedTextureHeader {
+    static constexpr uint32_t Magic = 0x58455443; // "CTEX"
+    static constexpr uint32_t Version = 1;
+
+    uint32_t magic = Magic;
+    uint32_t version = Version;
+    CompressedFormat format = CompressedFormat::BC1;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 0;
+};
+
+struct CompressedTexture {
+    CompressedTextureHeader header;
+    std::vector<CompressedMip> mips;
+};
+
+// textures/Foo.jpg -> textures/Foo.ctex
+std::string CompressedTexturePath(const std::string& imagePath);
+
+size_t CompressedBlockSize(CompressedFormat format);
+size_t CompressedLevelSize(CompressedFormat format, uint32_t width, uint32_t height);
+
+// Images are tightly packed RGBA8, rows are padded out to whole blocks by
+//   repeating the edge pixels
+void CompressImage(CompressedFormat format, const uint8_t* rgba,
+    uint32_t width, uint32_t height, std::vector<uint8_t>& out);
+// For GPUs without S3TC, writes width * height * 4 bytes
+void DecompressImage(CompressedFormat format, const uint8_t* blocks,
+    uint32_t width, uint32_t height, uint8_t* rgba);
+
+// 2x2 box filter, each dimension halves down to 1
+void DownsampleImage(const uint8_t* rgba, uint32_t width, uint32_t height,
+    std::vector<uint8_t>& out);
+
+// Builds and writes the full mip chain, sizes must be powers of two
+void WriteCompressedTexture(std::ostream& stream, CompressedFormat format,
+    const uint8_t* rgba, uint32_t width, uint32_t height);
+// Reads the header and mip table, level data is left in the stream
+void ReadCompressedTexture(std::istream& stream, CompressedTexture& texture);
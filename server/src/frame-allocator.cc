@@ -0,0 +1,50 @@
+#include "frame-allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(size_t blockSize) {
+    blocks.push_back(Block{ std::make_unique<char[]>(blockSize), blockSize });
+}
+
+void FrameArena::NextBlock(size_t size) {
+    size = std::max(size, blocks.back().size * 2);
+    blocks.push_back(Block{ std::make_unique<char[]>(size), size });
+    offset = 0;
+}
+
+static size_t AlignedOffset(const char* base, size_t offset, size_t alignment) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(base) + offset;
+    return offset + ((alignment - address % alignment) % alignment);
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment) {
+    size_t start = AlignedOffset(blocks.back().data.get(), offset, alignment);
+    if (start + size > blocks.back().size) {
+        // Room for it at any alignment
+        NextBlock(size + alignment);
+        start = AlignedOffset(blocks.back().data.get(), 0, alignment);
+    }
+    used += start - offset + size;
+    offset = start + size;
+    return blocks.back().data.get() + start;
+}
+
+void FrameArena::Reset() {
+    if (blocks.size() > 1) {
+        // The frame outgrew the first block, next time it all fits in one
+        size_t total = GetCapacity();
+        blocks.clear();
+        blocks.push_back(Block{ std::make_unique<char[]>(total), total });
+    }
+    offset = 0;
+    used = 0;
+}
+
+size_t FrameArena::GetCapacity() const {
+    size_t total = 0;
+    for (auto& block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
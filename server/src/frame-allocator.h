@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bump allocator for data that only lives until the next Reset, usually
+//   one tick. Nothing is freed on its own, Reset frees everything at once.
+//   Blocks are kept between resets and merged into one when a frame
+//   needed more than one, so a steady tick doesn't touch the heap.
+class FrameArena {
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    // Allocations come from the last block, earlier ones are full
+    std::vector<Block> blocks;
+    size_t offset = 0;
+    // Everything handed out since the last Reset, including padding
+    size_t used = 0;
+
+    void NextBlock(size_t size);
+
+public:
+    static const size_t DefaultBlockSize = 64 * 1024;
+
+    FrameArena(size_t blockSize = DefaultBlockSize);
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment);
+    void Reset();
+
+    size_t GetUsed() const { return used; }
+    size_t GetCapacity() const;
+};
+
+// Lets standard containers take their memory from a FrameArena, a
+//   container must not outlive the arena's next Reset
+template <typename T>
+struct FrameAllocator {
+    using value_type = T;
+
+    FrameArena* arena;
+
+    FrameAllocator(FrameArena& arena) : arena(&arena) {}
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(arena->Allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const FrameAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
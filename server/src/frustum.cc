@@ -0,0 +1,112 @@
+#include "frustum.h"
+#include "simd.h"
+
+Frustum::Frustum(const Matrix4& viewProj) {
+    // Gribb-Hartmann, glm is column major so rows are m[0][i]...m[3][i]
+    Vector4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+    Vector4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+    Vector4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+    Vector4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+    planes[Left] = row3 + row0;
+    planes[Right] = row3 - row0;
+    planes[Bottom] = row3 + row1;
+    planes[Top] = row3 - row1;
+    planes[Near] = row3 + row2;
+    planes[Far] = row3 - row2;
+
+    for (auto& plane : planes) {
+        plane /= glm::length(Vector3(plane));
+    }
+}
+
+bool Frustum::Intersects(const AABB& box) const {
+    for (const auto& plane : planes) {
+        // Corner furthest along the plane normal
+        Vector3 positive(
+            plane.x >= 0 ? box.ptMax.x : box.ptMin.x,
+            plane.y >= 0 ? box.ptMax.y : box.ptMin.y,
+            plane.z >= 0 ? box.ptMax.z : box.ptMin.z);
+        if (glm::dot(Vector3(plane), positive) + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::Contains(const AABB& box) const {
+    for (const auto& plane : planes) {
+        // Corner furthest against the plane normal
+        Vector3 negative(
+            plane.x >= 0 ? box.ptMin.x : box.ptMax.x,
+            plane.y >= 0 ? box.ptMin.y : box.ptMax.y,
+            plane.z >= 0 ? box.ptMin.z : box.ptMax.z);
+        if (glm::dot(Vector3(plane), negative) + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CullingList::Clear() {
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+    visible.clear();
+}
+
+void CullingList::Add(const AABB& box) {
+    minX.push_back(box.ptMin.x);
+    minY.push_back(box.ptMin.y);
+    minZ.push_back(box.ptMin.z);
+    maxX.push_back(box.ptMax.x);
+    maxY.push_back(box.ptMax.y);
+    maxZ.push_back(box.ptMax.z);
+}
+
+void CullingList::Cull(const Frustum& frustum) {
+    size_t count = Size();
+    visible.assign(count, 1);
+    uint8_t* out = visible.data();
+
+    // Four boxes against all six planes at a time, a lane's mask stays all
+    //   ones while its box is inside every plane so far
+    size_t vectorCount = count & ~(size_t) 3;
+    float4 planeX[6], planeY[6], planeZ[6], planeW[6];
+    bool positiveX[6], positiveY[6], positiveZ[6];
+    for (int p = 0; p < 6; p++) {
+        const Vector4& plane = frustum.planes[p];
+        planeX[p] = Splat4(plane.x);
+        planeY[p] = Splat4(plane.y);
+        planeZ[p] = Splat4(plane.z);
+        planeW[p] = Splat4(plane.w);
+        positiveX[p] = plane.x >= 0;
+        positiveY[p] = plane.y >= 0;
+        positiveZ[p] = plane.z >= 0;
+    }
+    for (size_t i = 0; i < vectorCount; i += 4) {
+        float4 boxMinX = Load4(&minX[i]), boxMinY = Load4(&minY[i]), boxMinZ = Load4(&minZ[i]);
+        float4 boxMaxX = Load4(&maxX[i]), boxMaxY = Load4(&maxY[i]), boxMaxZ = Load4(&maxZ[i]);
+        int4 inside = { -1, -1, -1, -1 };
+        for (int p = 0; p < 6; p++) {
+            float4 distance = planeX[p] * (positiveX[p] ? boxMaxX : boxMinX) +
+                planeY[p] * (positiveY[p] ? boxMaxY : boxMinY) +
+                planeZ[p] * (positiveZ[p] ? boxMaxZ : boxMinZ) + planeW[p];
+            inside &= distance >= Splat4(0.0f);
+        }
+        for (int lane = 0; lane < 4; lane++) {
+            out[i + lane] = inside[lane] != 0;
+        }
+    }
+
+    // The last few one at a time
+    for (const auto& plane : frustum.planes) {
+        // Pick the positive vertex per axis once for the whole plane
+        const float* px = plane.x >= 0 ? maxX.data() : minX.data();
+        const float* py = plane.y >= 0 ? maxY.data() : minY.data();
+        const float* pz = plane.z >= 0 ? maxZ.data() : minZ.data();
+        float nx = plane.x, ny = plane.y, nz = plane.z, d = plane.w;
+        for (size_t i = vectorCount; i < count; i++) {
+            out[i] &= (nx * px[i] + ny * py[i] + nz * pz[i] + d) >= 0;
+        }
+    }
+}
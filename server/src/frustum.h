@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vector.h"
+#include "aabb.h"
+
+#include <vector>
+
+// View frustum as six inward facing planes (xyz normal, w distance)
+//   extracted from a projection * view matrix
+struct Frustum {
+    enum Plane { Left = 0, Right, Bottom, Top, Near, Far };
+    Vector4 planes[6];
+
+    Frustum() {}
+    Frustum(const Matrix4& viewProj);
+
+    // Conservative, boxes straddling a corner of the frustum can pass
+    bool Intersects(const AABB& box) const;
+    // Box is entirely inside every plane
+    bool Contains(const AABB& box) const;
+};
+
+// Boxes stored as separate component arrays so culling many boxes against
+//   one frustum tests four at a time, see simd.h
+struct CullingList {
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+    std::vector<uint8_t> visible;
+
+    void Clear();
+    void Add(const AABB& box);
+    size_t Size() const { return minX.size(); }
+
+    // Fills visible[i] for every box added since the last Clear
+    void Cull(const Frustum& frustum);
+};
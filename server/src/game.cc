@@ -15,7 +15,10 @@
 #include "static-mesh.h"
 #include "objects/spectator-box.h"
 #include "scene.h"
+#include "metrics.h"
+#include "trace.h"
 
+#include <algorithm>
 #include <fstream>
 #include <exception>
 #include <thread>
@@ -31,6 +34,20 @@ const int TickInterval = 16;
 #endif
 const int ReplicateInterval = 100;
 
+#ifdef BUILD_SERVER
+static Gauge& ObjectsAlive = GetMetrics().AddGauge("game_objects", "Objects in the game after the last tick");
+static Gauge& PlayersConnected = GetMetrics().AddGauge("game_players", "Connected players");
+static Counter& BytesSent = GetMetrics().AddCounter("game_sent_bytes_total",
+    "Bytes of messages sent to players, before compression");
+static Counter& MessagesSent = GetMetrics().AddCounter("game_sent_messages_total", "Messages sent to players");
+static const char* PhysicsObjectsHelp = "Objects that aren't static after the last tick, by whether they simulate";
+static Gauge& ObjectsActive = GetMetrics().AddGauge("game_physics_objects", PhysicsObjectsHelp, "state=\"active\"");
+static Gauge& ObjectsSleeping = GetMetrics().AddGauge("game_physics_objects", PhysicsObjectsHelp, "state=\"sleeping\"");
+#endif
+
+// How close a sleeping object has to be to another for it to be touching
+static const float ContactMargin = 0.05f;
+
 Vector3 liveBoxStart(-1000, -100, -1000);
 Vector3 liveBoxSize(2000, 2000, 2000);
 
@@ -124,6 +141,7 @@ void Game::CreateMapBaseObject() {
 }
 
 void Game::LoadMap(std::string mapPath) {
+    TRACE_SCOPE("Game::LoadMap");
     LOG_INFO("Loading Map " << mapPath);
 
     scene.assetManager.LoadDataFromDirectory(scriptManager);
@@ -188,17 +206,26 @@ bool Game::IsOnTickThread() {
 }
 
 void Game::FlushNewObjects() {
+    if (flushDepth == newObjectsFlushing.size()) {
+        newObjectsFlushing.emplace_back();
+    }
+    auto& flushing = newObjectsFlushing[flushDepth];
     newObjectsMutex.lock();
-    std::unordered_map<ObjectID, Object*> newObjectsCopy = newObjects;
-    newObjects.clear();
+    std::swap(newObjects, flushing);
     newObjectsMutex.unlock();
 
-    for (auto& newObject : newObjectsCopy) {
-        LOG_DEBUG("Flush New Object (" << (void*)newObject.second << ") " << newObject.second);
+    flushDepth++;
+    for (auto& newObject : flushing) {
+        LOG_LIMITED(Debug, 20, "Flush New Object (" << (void*)newObject.second << ") " << newObject.second);
         gameObjects[newObject.first] = newObject.second;
-        gameObjects[newObject.first]->OnCreate();
+        // In the hierarchy before OnCreate, so what it spawns and parents
+        //   lands after it
+        relationshipManager.OnObjectAdded(newObject.second);
+        newObject.second->OnCreate();
         RequestReplication(newObject.first);
     }
+    flushing.clear();
+    flushDepth--;
 }
 
 #endif
@@ -206,6 +233,25 @@ void Game::FlushNewObjects() {
 void Game::Tick(Time time) {
     gameTime = time;
 
+    TRACE_SCOPE("Game::Tick");
+    frameArena.Reset();
+    // The same phase boundaries feed profileTick and the trace
+    bool tracing = Trace::IsEnabled();
+    bool timing = profileTick || tracing;
+    uint64_t tickStart = 0;
+    uint64_t phaseStart = 0;
+    if (timing) {
+        tickPhases = TickPhaseTimes{};
+        tickStart = phaseStart = Trace::Now();
+    }
+    auto endPhase = [timing, tracing, &phaseStart](Time& phase, const char* name) {
+        if (!timing) return;
+        uint64_t now = Trace::Now();
+        phase = (now - phaseStart) / 1000;
+        if (tracing) Trace::Record(name, phaseStart, now);
+        phaseStart = now;
+    };
+
 #ifdef BUILD_SERVER
 
     tickThreadId = std::this_thread::get_id();
@@ -217,18 +263,26 @@ void Game::Tick(Time time) {
     }
     queuedCalls.clear();
     queuedCallsMutex.unlock();
+    endPhase(tickPhases.queuedCalls, "Queued Calls");
 
     // New objects get queued in from HandleReplication and EnsureObjectExists
     //   on the client, not through this set.
     FlushNewObjects();
+    endPhase(tickPhases.flushNewObjects, "Flush New Objects");
 #endif
 
     relationshipManager.Tick(time);
+    endPhase(tickPhases.relationshipTick, "Relationship Tick");
 
     // if (time % 1024 == 0) LOG_DEBUG("Average Object Tick Time: " << averageObjectTickTime.GetAverage());
 
 #ifdef BUILD_SERVER
+    size_t active = 0;
+    size_t sleeping = 0;
     for (auto& object : gameObjects) {
+        if (!object.second->IsStatic()) {
+            (object.second->IsSleeping() ? sleeping : active)++;
+        }
         // if (!IsZero(GetVelocity() - lastFrameVelocity)) {
         //     if (IsTagged(Tag::WEAPON)) {
         //         LOG_DEBUG(GetId() << ": Velocity " << GetVelocity() << " " << lastFrameVelocity);
@@ -246,32 +300,42 @@ void Game::Tick(Time time) {
             DestroyObject(object.second->GetId());
         }
     }
+    ObjectsActive.Set(active);
+    ObjectsSleeping.Set(sleeping);
+    endPhase(tickPhases.killPlane, "Kill Plane");
 #endif
 
     // OnDeath could potentially add more stuff to DeadObjects
-    std::vector<ObjectID> deadObjectsThisTick;
-    deadObjectsThisTick.insert(deadObjectsThisTick.begin(),
-        deadObjects.begin(), deadObjects.end());
-    deadObjects.clear();
-    for (auto& objectId : deadObjectsThisTick) {
+    std::swap(deadObjects, deadObjectsDestroying);
+    for (auto& objectId : deadObjectsDestroying) {
         if (gameObjects.find(objectId) != gameObjects.end()) {
             Object* object = gameObjects[objectId];
-            LOG_DEBUG("Destroy Object (" << (void*)object << ") (" << objectId << ") " << object->GetClass());
+            LOG_LIMITED(Debug, 20, "Destroy Object (" << (void*)object << ") (" << objectId << ") " << object->GetClass());
 
             // Move an object into root before destroying
             DetachParent(object);
             object->OnDeath();
+            relationshipManager.OnObjectRemoved(object);
             gameObjects.erase(objectId);
+            // Whatever rested on it has to fall
+            WakeTouching(object);
         #ifdef BUILD_SERVER
             deadSinceLastReplicate.insert(objectId);
         #endif
             delete object;
         }
     }
+    deadObjectsDestroying.clear();
+    endPhase(tickPhases.deadObjects, "Dead Objects");
 #ifdef BUILD_SERVER
     Replicate(time);
     ReplicateAnimations(time);
+    endPhase(tickPhases.replicate, "Replicate");
+    ObjectsAlive.Set(gameObjects.size());
 #endif
+    if (timing) {
+        tickPhases.total = (Trace::Now() - tickStart) / 1000;
+    }
 }
 
 #ifdef BUILD_SERVER
@@ -281,6 +345,9 @@ void Game::Tick(Time time) {
         objs: [ list of replicated objects ],
         time: client timestamp of last input.
         ticks: ticks server has processed sicne that last input
+        game: the game replicable, its relationships ("rm") as a delta
+            numbered "rs" with the changes in "rd", or the full list in "r"
+            on initial replication and after a client asks to "resync"
     }
   A Animation packet:
     {
@@ -289,6 +356,8 @@ void Game::Tick(Time time) {
     }
 */
 void Game::SendData(PlayerSocketData* player, std::string message) {
+    BytesSent.Add(message.size());
+    MessagesSent.Add();
     player->eventLoop->defer([player, message] () {
         // LOG_DEBUG(message);
         if (!player->ws->send(message, uWS::OpCode::TEXT)) {
@@ -299,6 +368,7 @@ void Game::SendData(PlayerSocketData* player, std::string message) {
 
 void Game::ReplicateAnimations(Time time) {
     if (animationPackets.empty()) return;
+    TRACE_SCOPE("Game::ReplicateAnimations");
 
     rapidjson::StringBuffer output;
     rapidjson::Writer<rapidjson::StringBuffer> writer(output);
@@ -368,6 +438,7 @@ void Game::RequestReplication(ObjectID objectId) {
 }
 
 void Game::QueueAllForReplication(Time time) {
+    TRACE_SCOPE("Game::QueueAllForReplication");
     for (auto& object : gameObjects) {
         if (object.second->IsDirty()) {
             RequestReplication(object.first);
@@ -377,6 +448,7 @@ void Game::QueueAllForReplication(Time time) {
 
 void Game::Replicate(Time time) {
     if (replicateNextTick.empty()) return;
+    TRACE_SCOPE("Game::Replicate");
 
     // LOG_DEBUG("Replicate (" << time << ") " << replicateNextTick.size() << " objects");
 
@@ -413,10 +485,14 @@ void Game::Replicate(Time time) {
     rapidjson::StringBuffer gameBuffer;
     rapidjson::Writer<rapidjson::StringBuffer> gameWriter(gameBuffer);
     {
+        relationshipManager.SetSerializeDelta(true);
         gameWriter.StartObject();
         Serialize(gameWriter);
         gameWriter.EndObject();
+        relationshipManager.SetSerializeDelta(false);
     }
+    // Only made if a player needs it
+    rapidjson::StringBuffer fullGameBuffer;
 
     // std::scoped_lock<std::mutex> lock(playersSetMutex);
     for (auto& player : players) {
@@ -430,6 +506,18 @@ void Game::Replicate(Time time) {
             InitialReplication(player);
         }
         else {
+            rapidjson::StringBuffer* gameData = &gameBuffer;
+            if (player->relationshipResync) {
+                player->relationshipResync = false;
+                if (fullGameBuffer.GetSize() == 0) {
+                    rapidjson::Writer<rapidjson::StringBuffer> fullWriter(fullGameBuffer);
+                    fullWriter.StartObject();
+                    Serialize(fullWriter);
+                    fullWriter.EndObject();
+                }
+                gameData = &fullGameBuffer;
+            }
+
             rapidjson::StringBuffer output;
             rapidjson::Writer<rapidjson::StringBuffer> writer2(output);
             writer2.StartObject();
@@ -443,7 +531,7 @@ void Game::Replicate(Time time) {
             writer2.Key("objs");
             writer2.RawValue(buffer.GetString(), buffer.GetSize(), rapidjson::kArrayType);
             writer2.Key("game");
-            writer2.RawValue(gameBuffer.GetString(), gameBuffer.GetSize(), rapidjson::kObjectType);
+            writer2.RawValue(gameData->GetString(), gameData->GetSize(), rapidjson::kObjectType);
 
             writer2.EndObject();
             SendData(player, output.GetString());
@@ -482,6 +570,7 @@ void Game::EnsureObjectExists(json& object) {
     if (object.HasMember("dead")) {
         // Kill
         if (gameObjects.find(id) != gameObjects.end()) {
+            relationshipManager.OnObjectRemoved(gameObjects[id]);
             delete gameObjects[id];
             gameObjects.erase(id);
             return;
@@ -494,7 +583,7 @@ void Game::EnsureObjectExists(json& object) {
     }
     std::string objectType (object["t"].GetString(), object["t"].GetStringLength());
     if (gameObjects.find(id) == gameObjects.end()) {
-        LOG_DEBUG("Got new object (" << id << ") " << objectType);
+        LOG_LIMITED(Debug, 20, "Got new object (" << id << ") " << objectType);
         auto& ClassLookup = GetClassLookup();
         if (ClassLookup.find(objectType) == ClassLookup.end()) {
             LOG_ERROR("Class " << objectType << " is not registered!");
@@ -504,6 +593,7 @@ void Game::EnsureObjectExists(json& object) {
         obj->SetId(id);
         obj->createdThisFrameOnClient = true;
         gameObjects[id] = obj;
+        relationshipManager.OnObjectAdded(obj);
     }
 }
 
@@ -545,6 +635,170 @@ RayCastResult Game::RayCastInWorld(RayCastRequest request) {
     return result;
 }
 
+SweepResult Game::SweepInWorld(Object* obj, const Vector3& start, const Vector3& delta, float radius,
+        Object* ignore) {
+    TRACE_SCOPE("Game::SweepInWorld");
+    SweepResult result;
+    Vector3 end = start + delta;
+    AABB swept(glm::min(start, end) - radius, glm::max(start, end) + radius);
+    for (auto& object : gameObjects) {
+        if (obj == object.second || ignore == object.second) continue;
+        if (object.second->IsDestroyQueued()) continue;
+
+        bool shouldExclude = obj->IsCollisionExcluded(object.second->GetTags()) ||
+            object.second->IsCollisionExcluded(obj->GetTags());
+        if (shouldExclude && !obj->ShouldReportCollision(object.second->GetTags()) &&
+                !object.second->ShouldReportCollision(obj->GetTags())) {
+            continue;
+        }
+
+        for (Collider* child : object.second->GetCollider().children) {
+            AABB broad = child->GetBroadAABB();
+            if (!AABBAndAABBCollide(swept, broad)) continue;
+            bool hit = child->GetType() == ColliderType::STATIC_MESH ?
+                SphereSweepMesh(start, delta, radius, static_cast<StaticMeshCollider*>(child), result) :
+                SphereSweepAABB(start, delta, radius, broad, result);
+            if (hit) {
+                result.hitObject = object.second;
+            }
+        }
+    }
+    return result;
+}
+
+// Side of a sleeper grid cell, about the size of a crate so most movers
+//   and sleepers cover a handful
+static const float SleeperCellSize = 4.0f;
+// Sleepers covering more cells than this (the ground, long walls) are kept
+//   in a list every wake looks through
+static const int64_t MaxSleeperCells = 64;
+
+// False if the bounds are too far out or not finite to be given cells
+static bool GetSleeperCells(const AABB& bounds, glm::ivec3& min, glm::ivec3& max) {
+    // 21 bits a cell coordinate, see SleeperCellKey
+    const float limit = SleeperCellSize * (1 << 20);
+    if (!glm::all(glm::lessThan(glm::abs(bounds.ptMin), Vector3(limit))) ||
+            !glm::all(glm::lessThan(glm::abs(bounds.ptMax), Vector3(limit)))) {
+        return false;
+    }
+    min = glm::ivec3(glm::floor(bounds.ptMin / SleeperCellSize));
+    max = glm::ivec3(glm::floor(bounds.ptMax / SleeperCellSize));
+    return true;
+}
+
+static int64_t CountSleeperCells(const glm::ivec3& min, const glm::ivec3& max) {
+    return (int64_t) (max.x - min.x + 1) * (max.y - min.y + 1) * (max.z - min.z + 1);
+}
+
+static uint64_t SleeperCellKey(int x, int y, int z) {
+    return (uint64_t) (x & 0x1FFFFF) | (uint64_t) (y & 0x1FFFFF) << 21 | (uint64_t) (z & 0x1FFFFF) << 42;
+}
+
+void Game::WakeTouching(Object* obj, const AABB* previous) {
+    // Setters call this for every pose change, most ticks nothing sleeps
+    if (sleepers.empty() || obj->GetColliderCount() == 0) return;
+    // A child is re-posed after its parent every tick. Only look around when
+    //   its pose changed since the last check, a lid swinging open has to
+    //   drop what rests on it even though its parent never moved
+    uint32_t version = obj->GetRigidTransformVersion();
+    if (relationshipManager.HasParent(obj->GetId()) && version == obj->GetWakeCheckVersion()) return;
+    obj->SetWakeCheckVersion(version);
+    AABB broad = obj->GetCollider().GetBroadAABB();
+    // Swept over the move, so what it passed into wakes as well as what it left
+    if (previous) {
+        broad = AABB::FromTwo(broad, *previous);
+    }
+    AABB reach(broad.ptMin - ContactMargin, broad.ptMax + ContactMargin);
+
+    // Gathered first, waking one takes it out of the grid and can wake
+    //   more through here
+    FrameVector<Object*> candidates { FrameAllocator<Object*>(frameArena) };
+    glm::ivec3 min, max;
+    if (GetSleeperCells(reach, min, max) && CountSleeperCells(min, max) <= (int64_t) sleepers.size()) {
+        for (int x = min.x; x <= max.x; x++) {
+            for (int y = min.y; y <= max.y; y++) {
+                for (int z = min.z; z <= max.z; z++) {
+                    auto cell = sleeperGrid.find(SleeperCellKey(x, y, z));
+                    if (cell == sleeperGrid.end()) continue;
+                    candidates.insert(candidates.end(), cell->second.begin(), cell->second.end());
+                }
+            }
+        }
+        candidates.insert(candidates.end(), oversizedSleepers.begin(), oversizedSleepers.end());
+    }
+    else {
+        // Reaches over more cells than there are sleepers
+        candidates.assign(sleepers.begin(), sleepers.end());
+    }
+
+    for (Object* sleeper : candidates) {
+        // In more than one cell, or already woken through another
+        if (sleeper == obj || !sleeper->IsSleeping() || sleeper->GetColliderCount() == 0) continue;
+        // Never pushed by it
+        if (obj->IsCollisionExcluded(sleeper->GetTags()) || sleeper->IsCollisionExcluded(obj->GetTags())) continue;
+        if (AABBAndAABBCollide(reach, sleeper->GetCollider().GetBroadAABB())) {
+            sleeper->Wake();
+        }
+    }
+}
+
+void Game::AddSleeper(Object* obj) {
+    obj->SetSleeperIndex(sleepers.size());
+    sleepers.push_back(obj);
+    SleeperCells& cells = sleeperCells.emplace_back();
+    if (obj->GetColliderCount() == 0) return;
+
+    cells.placed = true;
+    AABB broad = obj->GetCollider().GetBroadAABB();
+    if (!GetSleeperCells(broad, cells.min, cells.max) ||
+            CountSleeperCells(cells.min, cells.max) > MaxSleeperCells) {
+        cells.oversized = true;
+        oversizedSleepers.push_back(obj);
+        return;
+    }
+    for (int x = cells.min.x; x <= cells.max.x; x++) {
+        for (int y = cells.min.y; y <= cells.max.y; y++) {
+            for (int z = cells.min.z; z <= cells.max.z; z++) {
+                sleeperGrid[SleeperCellKey(x, y, z)].push_back(obj);
+            }
+        }
+    }
+}
+
+// Swaps obj with the last of list and drops it
+static void RemoveSleeperFrom(std::vector<Object*>& list, Object* obj) {
+    auto it = std::find(list.begin(), list.end(), obj);
+    if (it == list.end()) return;
+    *it = list.back();
+    list.pop_back();
+}
+
+void Game::RemoveSleeper(Object* obj) {
+    uint32_t index = obj->GetSleeperIndex();
+    if (index >= sleepers.size() || sleepers[index] != obj) return;
+
+    const SleeperCells& cells = sleeperCells[index];
+    if (cells.oversized) {
+        RemoveSleeperFrom(oversizedSleepers, obj);
+    }
+    else if (cells.placed) {
+        for (int x = cells.min.x; x <= cells.max.x; x++) {
+            for (int y = cells.min.y; y <= cells.max.y; y++) {
+                for (int z = cells.min.z; z <= cells.max.z; z++) {
+                    RemoveSleeperFrom(sleeperGrid[SleeperCellKey(x, y, z)], obj);
+                }
+            }
+        }
+    }
+
+    sleepers[index] = sleepers.back();
+    sleeperCells[index] = sleeperCells.back();
+    sleepers[index]->SetSleeperIndex(index);
+    sleepers.pop_back();
+    sleeperCells.pop_back();
+    obj->SetSleeperIndex(-1);
+}
+
 void CollideBetween(Object* primary, Object* secondary, bool isGround,
         bool shouldExclude, bool shouldReportPrimary, bool shouldReportSecondary) {
     if (!isGround && shouldExclude && !shouldReportPrimary && !shouldReportSecondary) return;
@@ -553,6 +807,11 @@ void CollideBetween(Object* primary, Object* secondary, bool isGround,
         r.collidedWith = secondary;
         if (!shouldExclude) {
             primary->ResolveCollision(r.collisionDifference);
+            // Pushed by something moving, a resting neighbour leaves it be
+            //   or the two would keep each other awake
+            if (!primary->IsResting()) {
+                secondary->Wake();
+            }
         }
         if (shouldReportPrimary) {
             primary->OnCollide(r);
@@ -564,10 +823,11 @@ void CollideBetween(Object* primary, Object* secondary, bool isGround,
 }
 
 void Game::HandleCollisions(Object* obj) {
-    if (deadObjects.find(obj->GetId()) != deadObjects.end()) return;
+    TRACE_SCOPE("Game::HandleCollisions");
+    if (obj->IsDestroyQueued()) return;
     for (auto& object : gameObjects) {
         if (obj == object.second) continue;
-        if (deadObjects.find(object.first) != deadObjects.end()) return;
+        if (object.second->IsDestroyQueued()) continue;
 
         bool isGround = object.second->IsTagged(Tag::GROUND);
         if (!isGround && glm::distance(obj->GetPosition(), object.second->GetPosition()) > 10) {
@@ -604,7 +864,7 @@ void Game::AddObject(Object* obj) {
     ObjectID newId = RequestId();
     obj->SetId(newId);
     newObjectsMutex.lock();
-    newObjects[newId] = obj;
+    newObjects.emplace_back(newId, obj);
     newObjectsMutex.unlock();
     // Immediately queue into main object system
     if (IsOnTickThread()) {
@@ -620,12 +880,15 @@ void Game::DestroyObject(ObjectID objectId) {
         LOG_ERROR("Tried to destroy object ID 0!");
         throw std::runtime_error("Invalid destroy of ID 0, probably a memory leak!");
     }
-    if (gameObjects.find(objectId) == gameObjects.end()) {
+    auto it = gameObjects.find(objectId);
+    if (it == gameObjects.end()) {
         LOG_ERROR("Tried to queue destruction for object not exist " << objectId);
         return;
     }
-    LOG_DEBUG("Queued for Destruction " << objectId);
-    deadObjects.insert(objectId);
+    if (it->second->IsDestroyQueued()) return;
+    LOG_LIMITED(Debug, 20, "Queued for Destruction " << objectId);
+    it->second->SetDestroyQueued();
+    deadObjects.push_back(objectId);
 }
 
 
@@ -672,6 +935,7 @@ ObjectID Game::RequestId() {
 void Game::AddPlayer(PlayerSocketData* data, PlayerObject* playerObject) {
     std::scoped_lock<std::mutex> lock(playersSetMutex);
     players.insert(data);
+    PlayersConnected.Set(players.size());
 
     QueueNextTick([playerObject](Game& game) {
         game.AddObject(playerObject);
@@ -681,6 +945,7 @@ void Game::AddPlayer(PlayerSocketData* data, PlayerObject* playerObject) {
 void Game::RemovePlayer(PlayerSocketData* data) {
     std::scoped_lock<std::mutex> lock(playersSetMutex);
     players.erase(data);
+    PlayersConnected.Set(players.size());
 
     PlayerObject* playerObject = data->playerObject;
     LOG_INFO("Removing player " << playerObject);
@@ -688,6 +953,16 @@ void Game::RemovePlayer(PlayerSocketData* data) {
         game.DestroyObject(playerObject->GetId());
     });
 }
+
+void Game::QueueRelationshipResync(PlayerSocketData* data) {
+    // The socket may close before the next tick
+    QueueNextTick([data](Game& game) {
+        std::scoped_lock<std::mutex> lock(game.playersSetMutex);
+        if (game.players.count(data)) {
+            data->relationshipResync = true;
+        }
+    });
+}
 #endif
 
 void Game::GetUnitsInRange(const Vector3& position, float range,
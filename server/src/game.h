@@ -9,6 +9,7 @@
 #include "animation.h"
 #include "ray-cast.h"
 #include "script-manager.h"
+#include "frame-allocator.h"
 
 #ifdef BUILD_SERVER
 #include "uWebSocket/App.h"
@@ -16,6 +17,7 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <deque>
 #include <mutex>
 #include <atomic>
 #include <thread>
@@ -25,12 +27,28 @@ class PlayerObject;
 extern const int TickInterval;
 extern const int ReplicateInterval;
 
+// Microseconds spent in each part of one Game::Tick
+struct TickPhaseTimes {
+    Time queuedCalls = 0;
+    Time flushNewObjects = 0;
+    Time relationshipTick = 0;
+    // Spent inside relationshipTick, every object's collision handling summed
+    Time collisions = 0;
+    Time killPlane = 0;
+    Time deadObjects = 0;
+    Time replicate = 0;
+    Time total = 0;
+};
+
 struct PlayerSocketData {
 #ifdef BUILD_SERVER
     uWS::WebSocket<false, true>* ws;
     bool hasInitialReplication = false;
     bool playerObjectDirty = true;
     bool isReady = false;
+    // Missed a relationship delta, the next replication carries the full
+    //   list. Only touched on the tick thread
+    bool relationshipResync = false;
     std::string nextRespawnCharacter;
 
     uWS::Loop* eventLoop;
@@ -48,10 +66,35 @@ class Game : public Replicable {
 
     std::unordered_map<ObjectID, Object*> gameObjects;
 
+    // Transient data of one tick, reset when the next starts
+    FrameArena frameArena;
+
     std::unordered_set<PlayerSocketData*> players;
     std::mutex playersSetMutex;
 
-    std::unordered_set<ObjectID> deadObjects;
+    // Queued by DestroyObject, swapped with the other at the end of a tick
+    //   so OnDeath can queue more for the next. Both keep their capacity
+    std::vector<ObjectID> deadObjects;
+    std::vector<ObjectID> deadObjectsDestroying;
+
+    // Every sleeping object, each knows its slot so it leaves in O(1).
+    //   WakeTouching only looks through these
+    std::vector<Object*> sleepers;
+    // Sleepers don't move, so they're bucketed once into the grid cells
+    //   their bounds cover and a mover only looks at the cells it reaches.
+    //   Cell vectors are kept when they empty so refilling doesn't allocate
+    struct SleeperCells {
+        glm::ivec3 min;
+        glm::ivec3 max;
+        // Covers too many cells, kept in oversizedSleepers instead
+        bool oversized = false;
+        // Without colliders it can't be touched, it's in neither
+        bool placed = false;
+    };
+    // By sleeper slot, moved along with the sleepers
+    std::vector<SleeperCells> sleeperCells;
+    std::unordered_map<uint64_t, std::vector<Object*>> sleeperGrid;
+    std::vector<Object*> oversizedSleepers;
 
 #ifdef BUILD_SERVER
     // Notifies client of any animations
@@ -60,7 +103,12 @@ class Game : public Replicable {
     std::unordered_set<ObjectID> deadSinceLastReplicate;
 
     std::mutex newObjectsMutex;
-    std::unordered_map<ObjectID, Object*> newObjects;
+    std::vector<std::pair<ObjectID, Object*>> newObjects;
+    // Swapped with newObjects to be flushed. OnCreate can add and flush
+    //   objects again, each nesting level has its own buffer so none is
+    //   changed while it's iterated
+    std::deque<std::vector<std::pair<ObjectID, Object*>>> newObjectsFlushing;
+    size_t flushDepth = 0;
 
     std::unordered_set<ObjectID> replicateNextTick;
 
@@ -91,6 +139,8 @@ public:
         float volume;
         Vector3 location;
         ObjectID boundObject = -1;
+        // Higher wins a voice when too many sounds play at once
+        int priority = 0;
         AudioRequest(Audio* audio, float volume,
             const Vector3& location) : audio(audio), volume(volume), location(location) {}
         AudioRequest(Audio* audio, float volume,
@@ -102,6 +152,19 @@ public:
 
     PerformanceBuffer<Time> averageObjectTickTime { 100 };
 
+    // Each phase of a tick costs a clock read, so they are only timed when
+    //   asked for or while tracing, tickPhases then holds the last Tick's
+    bool profileTick = false;
+    TickPhaseTimes tickPhases;
+
+    // Containers on it must not outlive the tick, or on the client the
+    //   frames drawn before the next tick
+    FrameArena& GetFrameArena() { return frameArena; }
+
+    // Objects that ask for continuous collision are swept to their contacts,
+    //   off moves them in collider sized steps like everything else
+    bool continuousCollision = true;
+
     ~Game();
 
     // Load Map from JSON File, data-path
@@ -155,6 +218,17 @@ public:
 #endif
 
     void HandleCollisions(Object* obj);
+    // First contact of a sphere moved with obj, against everything obj
+    //   would resolve or report a collision with except ignore
+    SweepResult SweepInWorld(Object* obj, const Vector3& start, const Vector3& delta, float radius,
+        Object* ignore = nullptr);
+    // Wakes sleeping objects within reach of obj's colliders, or of the
+    //   bound of those and previous when obj just moved from there
+    void WakeTouching(Object* obj, const AABB* previous = nullptr);
+    // Called by objects as they fall asleep and wake up
+    void AddSleeper(Object* obj);
+    void RemoveSleeper(Object* obj);
+    size_t GetSleepingCount() const { return sleepers.size(); }
 
     RayCastResult RayCastInWorld(RayCastRequest request);
 
@@ -213,6 +287,9 @@ public:
 #ifdef BUILD_SERVER
     void AddPlayer(PlayerSocketData* data, PlayerObject* playerObject);
     void RemovePlayer(PlayerSocketData* data);
+    // From the socket thread, marks the player for the full list of
+    //   relationships on the tick thread
+    void QueueRelationshipResync(PlayerSocketData* data);
     void OnPlayerDead(PlayerObject* playerObject);
 #endif
 
@@ -7,6 +7,8 @@ struct _GlobalSettings : Replicable {
     ALWAYS_REPLICATED_D(std::string, MapPath, "MapPath", "maps/map1.json");
     ALWAYS_REPLICATED_D(bool, IsProduction, "IsProduction", false);
     ALWAYS_REPLICATED_D(bool, RunTests, "RunTests", false);
+    // Loot placement is random unless seeded, stays on the server
+    unsigned int LootSeed = 0;
 
     // Client Settings
     ALWAYS_REPLICATED_D(bool, Client_DrawColliders, "Client_DrawColliders", false);
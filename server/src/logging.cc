@@ -0,0 +1,347 @@
+#include "logging.h"
+
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define LOG_TIME_FORMAT "[%H:%M:%S"
+
+namespace Log {
+
+static const char* Prefixes[] = {
+    "\033[36m[DEBUG]\033[0m ",
+    "\033[34m[INFO]\033[0m ",
+    "\033[33m[WARN]\033[0m ",
+    "\033[31m[ERROR]\033[0m ",
+};
+
+// Records are taken from a pool of this many (64K), made up front. Once
+//   they're all queued new messages are dropped, so output that can't keep
+//   up doesn't grow the queue without bound
+static const uint32_t PoolSize = 1 << 16;
+// A record keeps its text's capacity for the next message, unless one long
+//   message grew it past this
+static const size_t MaxKeptText = 4096;
+
+struct Record {
+    std::atomic<Record*> next { nullptr };
+    // Next free record's slot in the pool while this one is free
+    std::atomic<uint32_t> nextFree { 0 };
+    // Not from the pool, see Message
+    bool pooled = true;
+    LogLevel level = LogLevel::Debug;
+    std::chrono::system_clock::time_point time;
+    std::string text;
+    uint64_t suppressed = 0;
+};
+
+// Vyukov's multi producer single consumer queue: a producer swaps its record
+//   in as the head with one exchange and then links it from the previous
+//   head, the consumer follows the links from the tail. The last record
+//   taken stays behind as the tail.
+//   Free records are a lock free stack of pool slots. The top is tagged
+//   with a count of pops so a slot popped and pushed back in between can't
+//   be mistaken for the one that was read.
+//   The writer sleeps once it finds the queue empty. The producer that
+//   links a record while it's asleep wakes it, every other send only reads
+//   a flag.
+class Writer {
+    Record stub;
+    std::atomic<Record*> head { &stub };
+    Record* tail = &stub;
+    std::atomic<uint64_t> dropped { 0 };
+
+    static const uint32_t NoneFree = (uint32_t) -1;
+    Record* pool;
+    // Tag in the high half, slot in the low half
+    std::atomic<uint64_t> freeTop;
+    uint64_t droppedReported = 0;
+
+    // Held by whoever is consuming, the writer thread or an error
+    std::mutex consumeMutex;
+    FILE* output = stdout;
+    std::string buffer;
+    // Formatting the time is the slow part, it's redone once a second
+    std::time_t lastSecond = 0;
+    char secondText[32] = "";
+
+    std::atomic<bool> running { false };
+    // Set while the writer waits for a record, cleared by whoever wakes it
+    std::atomic<bool> sleeping { false };
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread thread;
+
+    void Format(LogLevel level, std::chrono::system_clock::time_point time,
+            const std::string& text, uint64_t suppressed) {
+        using namespace std::chrono;
+        std::time_t second = system_clock::to_time_t(time);
+        if (second != lastSecond) {
+            std::tm local;
+            localtime_r(&second, &local);
+            std::strftime(secondText, sizeof(secondText), LOG_TIME_FORMAT, &local);
+            lastSecond = second;
+        }
+        char milliseconds[8];
+        std::snprintf(milliseconds, sizeof(milliseconds), ".%03d] ",
+            (int) (duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000));
+        buffer += secondText;
+        buffer += milliseconds;
+        buffer += Prefixes[(int) level];
+        buffer += text;
+        if (suppressed) {
+            buffer += " (" + std::to_string(suppressed) + " more suppressed)";
+        }
+        buffer += '\n';
+    }
+
+    // Takes consumeMutex
+    void DrainLocked() {
+        while (Record* next = tail->next.load(std::memory_order_acquire)) {
+            Format(next->level, next->time, next->text, next->suppressed);
+            if (tail != &stub) {
+                Release(tail);
+            }
+            tail = next;
+        }
+        uint64_t droppedNow = dropped.load(std::memory_order_relaxed);
+        if (droppedNow != droppedReported) {
+            Format(LogLevel::Warning, std::chrono::system_clock::now(),
+                std::to_string(droppedNow - droppedReported) + " log messages dropped, the writer fell behind", 0);
+            droppedReported = droppedNow;
+        }
+        Write();
+    }
+
+    void Write() {
+        if (buffer.empty()) return;
+        std::fwrite(buffer.data(), 1, buffer.size(), output);
+        std::fflush(output);
+        buffer.clear();
+    }
+
+    bool HasQueued() {
+        std::scoped_lock<std::mutex> lock(consumeMutex);
+        return tail->next.load(std::memory_order_seq_cst) != nullptr;
+    }
+
+    void Run() {
+        while (running.load(std::memory_order_relaxed)) {
+            Drain();
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            // Set before looking at the queue, so a producer linking a
+            //   record either sees it set or has its record seen here
+            sleeping.store(true, std::memory_order_seq_cst);
+            if (!HasQueued()) {
+                wake.wait(lock, [this] { return !sleeping.load(std::memory_order_relaxed); });
+            }
+            sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void WakeWriter() {
+        {
+            std::scoped_lock<std::mutex> lock(wakeMutex);
+            sleeping.store(false, std::memory_order_relaxed);
+        }
+        wake.notify_one();
+    }
+
+public:
+    Writer() {
+        pool = new Record[PoolSize];
+        for (uint32_t i = 0; i < PoolSize; i++) {
+            pool[i].nextFree.store(i + 1 < PoolSize ? i + 1 : NoneFree, std::memory_order_relaxed);
+        }
+        freeTop.store(0, std::memory_order_relaxed);
+#ifndef __EMSCRIPTEN__
+        running = true;
+        thread = std::thread(&Writer::Run, this);
+#endif
+    }
+
+    void Stop() {
+        if (running.exchange(false)) {
+            WakeWriter();
+            thread.join();
+        }
+        Drain();
+    }
+
+    void Drain() {
+        std::scoped_lock<std::mutex> lock(consumeMutex);
+        DrainLocked();
+    }
+
+    // A free record from the pool, or null once every one is in use
+    Record* Acquire() {
+        uint64_t top = freeTop.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t slot = (uint32_t) top;
+            if (slot == NoneFree) return nullptr;
+            uint32_t next = pool[slot].nextFree.load(std::memory_order_relaxed);
+            uint64_t popped = ((top >> 32) + 1) << 32 | next;
+            if (freeTop.compare_exchange_weak(top, popped, std::memory_order_acquire)) {
+                Record* record = &pool[slot];
+                record->next.store(nullptr, std::memory_order_relaxed);
+                return record;
+            }
+        }
+    }
+
+    void Release(Record* record) {
+        if (!record->pooled) return;
+        if (record->text.capacity() > MaxKeptText) {
+            std::string().swap(record->text);
+        }
+        record->text.clear();
+        uint32_t slot = (uint32_t) (record - pool);
+        uint64_t top = freeTop.load(std::memory_order_relaxed);
+        do {
+            record->nextFree.store((uint32_t) top, std::memory_order_relaxed);
+        } while (!freeTop.compare_exchange_weak(top, (top & ~(uint64_t) NoneFree) | slot,
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // The record goes back to the pool once it's written
+    void Send(Record* record) {
+        // Without a writer thread (the browser, or after exit started) and
+        //   for errors everything is written now
+        if (record->level >= LogLevel::Error || !running.load(std::memory_order_relaxed)) {
+            std::scoped_lock<std::mutex> lock(consumeMutex);
+            DrainLocked();
+            Format(record->level, record->time, record->text, record->suppressed);
+            Write();
+            Release(record);
+            return;
+        }
+        // The pool ran out while it was formatted
+        if (!record->pooled) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record* previous = head.exchange(record, std::memory_order_acq_rel);
+        previous->next.store(record, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst)) {
+            WakeWriter();
+        }
+    }
+
+    void SetOutput(FILE* file) {
+        std::scoped_lock<std::mutex> lock(consumeMutex);
+        DrainLocked();
+        output = file;
+    }
+
+    uint64_t GetDropped() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+// Never destroyed, so logging from other static destructors still works,
+//   the thread is stopped and the queue written out at exit instead
+static Writer& GetWriter() {
+    static Writer* writer = [] {
+        Writer* created = new Writer();
+        std::atexit([] { GetWriter().Stop(); });
+        return created;
+    }();
+    return *writer;
+}
+
+// Appends whatever is streamed to the current record's text
+class RecordBuffer : public std::streambuf {
+public:
+    std::string* text = nullptr;
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) {
+            text->push_back((char) c);
+        }
+        return c;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize count) override {
+        text->append(s, count);
+        return count;
+    }
+};
+
+struct ThreadStream {
+    RecordBuffer buffer;
+    std::ostream stream { &buffer };
+    // Formatted into when the pool is empty, only written if it's an error
+    //   or there's no writer thread, otherwise it's counted as dropped. A
+    //   message nested in one formatted here clears its text
+    Record overflow;
+
+    ThreadStream() {
+        overflow.pooled = false;
+    }
+};
+
+static ThreadStream& GetThreadStream() {
+    thread_local ThreadStream threadStream;
+    return threadStream;
+}
+
+Message::Message(LogLevel level) :
+    record(GetWriter().Acquire()),
+    stream(GetThreadStream().stream) {
+    if (!record) {
+        record = &GetThreadStream().overflow;
+        record->text.clear();
+    }
+    record->level = level;
+    record->time = std::chrono::system_clock::now();
+    record->text.reserve(120);
+
+    ThreadStream& threadStream = GetThreadStream();
+    outerText = threadStream.buffer.text;
+    outerFlags = threadStream.stream.flags();
+    outerPrecision = threadStream.stream.precision();
+    outerFill = threadStream.stream.fill();
+    threadStream.buffer.text = &record->text;
+    threadStream.stream.clear();
+    // Manipulators from the last message on this thread don't carry over
+    threadStream.stream.flags(std::ios_base::dec | std::ios_base::skipws);
+    threadStream.stream.precision(6);
+    threadStream.stream.fill(' ');
+}
+
+void Message::Send(uint64_t suppressed) {
+    record->suppressed = suppressed;
+    GetWriter().Send(record);
+
+    ThreadStream& threadStream = GetThreadStream();
+    threadStream.buffer.text = outerText;
+    threadStream.stream.flags(outerFlags);
+    threadStream.stream.precision(outerPrecision);
+    threadStream.stream.fill(outerFill);
+}
+
+bool ParseLevel(const std::string& name, LogLevel& level) {
+    static const char* Names[] = { "debug", "info", "warn", "error", "none" };
+    for (int i = 0; i <= (int) LogLevel::None; i++) {
+        if (name == Names[i]) {
+            level = (LogLevel) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Flush() {
+    GetWriter().Drain();
+}
+
+void SetOutput(FILE* file) {
+    GetWriter().SetOutput(file);
+}
+
+uint64_t GetDroppedCount() {
+    return GetWriter().GetDropped();
+}
+
+}
@@ -1,57 +1,116 @@
 #ifndef LOGGING_H
 #define LOGGING_H
 
-#define LOG_TIME_FORMAT "[%OH:%OM:%OS] "
-
 #include <iostream>
 #include <ctime>
 #include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 
 #include "glm.h"
 
-static std::time_t time_now = std::time(nullptr);
+enum class LogLevel { Debug = 0, Info, Warning, Error, None };
 
-class _Log {
-    std::ostream* stream = &std::cout;
-public:
-    template <class T>
-    _Log &operator<<(const T &msg) {
-        *stream << msg;
-        return *this;
-    }
-    _Log const &operator<<(std::ostream &(*F)(std::ostream &)) const {
-        F(*stream);
-        return *this;
-    }
+// Levels below this are compiled out, building with -DLOG_COMPILED_LEVEL=1
+//   drops every LOG_DEBUG
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL 0
+#endif
+
+// Messages are formatted on the calling thread and queued to a writer
+//   thread which timestamps, prefixes and writes them in batches, so a
+//   LOG_* never waits on the console. Errors are written before the call
+//   returns, along with everything queued ahead of them, since a throw
+//   usually follows. The wasm client has no threads and writes directly.
+namespace Log {
+    inline std::atomic<LogLevel> MinimumLevel { LogLevel::Debug };
+
+    // Below the minimum a message is skipped before it's formatted
+    inline void SetLevel(LogLevel level) { MinimumLevel.store(level, std::memory_order_relaxed); }
+    inline bool IsEnabled(LogLevel level) { return level >= MinimumLevel.load(std::memory_order_relaxed); }
+    // debug, info, warn, error or none, false if it's none of those
+    bool ParseLevel(const std::string& name, LogLevel& level);
+
+    struct Record;
+
+    // One message being formatted, straight into the pooled record that's
+    //   queued, the stream is reused per thread
+    class Message {
+        Record* record;
+        // Something streamed into a message can log one of its own, the
+        //   outer message gets its text and formatting back once it's sent
+        std::string* outerText;
+        std::ios_base::fmtflags outerFlags;
+        std::streamsize outerPrecision;
+        char outerFill;
+    public:
+        std::ostream& stream;
+        Message(LogLevel level);
+        // suppressed is how many messages from this site were rate limited
+        //   since the last one sent
+        void Send(uint64_t suppressed = 0);
+    };
+
+    // Writes out everything queued so far
+    void Flush();
+    // Where messages are written, stdout unless set, not owned
+    void SetOutput(FILE* file);
+    // Messages dropped because the writer fell too far behind
+    uint64_t GetDroppedCount();
 };
 
-// Wraps the prefix
-class LogWithPrefix {
-    const char* prefix;
-    _Log underlying;
+// Lets through a number of messages per second from one call site and
+//   counts the rest
+class LogRateLimiter {
+    uint64_t perSecond;
+    std::atomic<uint64_t> second { 0 };
+    std::atomic<uint64_t> sent { 0 };
+    std::atomic<uint64_t> suppressed { 0 };
 public:
-    LogWithPrefix(const char* prefix) : prefix(prefix) {
+    LogRateLimiter(uint64_t perSecond) : perSecond(perSecond) {}
 
-    }
-    template <class T>
-    _Log &operator<<(const T &msg) {
-        auto time = std::put_time(std::localtime(&time_now), LOG_TIME_FORMAT);
-        underlying << time << prefix << msg;
-        return underlying;
+    bool Allow(uint64_t& suppressedBefore) {
+        using namespace std::chrono;
+        uint64_t now = duration_cast<seconds>(steady_clock::now().time_since_epoch()).count();
+        uint64_t current = second.load(std::memory_order_relaxed);
+        suppressedBefore = 0;
+        if (now != current && second.compare_exchange_strong(current, now, std::memory_order_relaxed)) {
+            sent.store(0, std::memory_order_relaxed);
+            suppressedBefore = suppressed.exchange(0, std::memory_order_relaxed);
+        }
+        if (sent.fetch_add(1, std::memory_order_relaxed) < perSecond) return true;
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
     }
 };
 
-namespace Log {
-    static LogWithPrefix Debug  ("\033[36m[DEBUG]\033[0m ");
-    static LogWithPrefix Info   ("\033[34m[INFO]\033[0m ");
-    static LogWithPrefix Warning("\033[33m[WARN]\033[0m ");
-    static LogWithPrefix Error  ("\033[31m[ERROR]\033[0m ");
-};
+#define LOG_AT(LEVEL, ...) do { \
+        if ((int) LogLevel::LEVEL >= LOG_COMPILED_LEVEL && Log::IsEnabled(LogLevel::LEVEL)) { \
+            Log::Message _logMessage(LogLevel::LEVEL); \
+            _logMessage.stream << __VA_ARGS__; \
+            _logMessage.Send(); \
+        } \
+    } while (0)
+
+// For sites that can fire for every object every tick, at most PER_SECOND
+//   of their messages are written each second
+#define LOG_LIMITED(LEVEL, PER_SECOND, ...) do { \
+        if ((int) LogLevel::LEVEL >= LOG_COMPILED_LEVEL && Log::IsEnabled(LogLevel::LEVEL)) { \
+            static LogRateLimiter _logLimiter(PER_SECOND); \
+            uint64_t _logSuppressed; \
+            if (_logLimiter.Allow(_logSuppressed)) { \
+                Log::Message _logMessage(LogLevel::LEVEL); \
+                _logMessage.stream << __VA_ARGS__; \
+                _logMessage.Send(_logSuppressed); \
+            } \
+        } \
+    } while (0)
 
-#define LOG_INFO(...) Log::Info << __VA_ARGS__ << std::endl
-#define LOG_DEBUG(...) Log::Debug << __VA_ARGS__ << std::endl
-#define LOG_WARN(...) Log::Warning << __VA_ARGS__ << std::endl
-#define LOG_ERROR(...) Log::Error << __VA_ARGS__ << std::endl
+#define LOG_INFO(...) LOG_AT(Info, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(Debug, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(Error, __VA_ARGS__)
 
-#define LOG_BREADCRUMB() Log::Debug << __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__ << std::endl
-#endif
\ No newline at end of file
+#define LOG_BREADCRUMB() LOG_AT(Debug, __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__)
+#endif
@@ -3,12 +3,16 @@
 #include <random>
 #include "game.h"
 #include "object.h"
+#include "global.h"
 
 struct LootSpawnZone {
     AABB spawnZone;
     std::unordered_set<ObjectID> objects;
 };
 
+// Class names of the loot spawned in zones and how often each is picked
+extern std::unordered_map<std::string, size_t> LootTable;
+
 // Manages the map, model and looting zones
 class MapObject : public Object {
 
@@ -25,7 +29,7 @@ public:
     CLASS_CREATE(MapObject)
 
     MapObject(Game& game) :
-        Object(game), gen(rd()) {
+        Object(game), gen(GlobalSettings.LootSeed ? GlobalSettings.LootSeed : rd()) {
         SetTag(Tag::NO_GRAVITY);
         SetIsStatic(true);
 
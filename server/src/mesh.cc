@@ -3,42 +3,21 @@
 
 void Mesh::InitializeMesh() {
 #ifdef BUILD_CLIENT
-    glGenVertexArrays(1, &renderInfo.vao);
-    glBindVertexArray(renderInfo.vao);
-
-    glGenBuffers(1, &renderInfo.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, renderInfo.vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-        vertices.size() * sizeof(Vertex),
-        vertices.data(), GL_STATIC_DRAW
-    );
-
-    glVertexAttribPointer(0,
-        3, GL_FLOAT, false, sizeof(Vertex), (const void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1,
-        3, GL_FLOAT, false, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2,
-        2, GL_FLOAT, false, sizeof(Vertex), (const void*)offsetof(Vertex, texCoords));
-    glEnableVertexAttribArray(2);
-
-    glVertexAttribPointer(3,
-        3, GL_FLOAT, false, sizeof(Vertex), (const void*)offsetof(Vertex, tangent));
-    glEnableVertexAttribArray(3);
-
-    glVertexAttribPointer(4,
-        3, GL_FLOAT, false, sizeof(Vertex), (const void*)offsetof(Vertex, smoothedNormal));
-    glEnableVertexAttribArray(4);
-
-    glGenBuffers(1, &renderInfo.ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderInfo.ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-        indices.size() * sizeof(unsigned int),
-        indices.data(), GL_STATIC_DRAW);
-    renderInfo.iboCount = indices.size();
+    if (skin.empty()) {
+        renderInfo.buffer = &MeshBuffer::Get(VertexFormat::Standard);
+        renderInfo.allocation = renderInfo.buffer->Allocate(
+            vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+    else {
+        std::vector<SkinnedVertex> skinnedVertices(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            skinnedVertices[i].vertex = vertices[i];
+            skinnedVertices[i].skin = skin[i];
+        }
+        renderInfo.buffer = &MeshBuffer::Get(VertexFormat::Skinned);
+        renderInfo.allocation = renderInfo.buffer->Allocate(
+            skinnedVertices.data(), skinnedVertices.size(), indices.data(), indices.size());
+    }
 #endif
     for (size_t i = 0; i < vertices.size(); i++) {
         center += vertices[i].position;
@@ -63,6 +42,16 @@ void Texture::InitializeTexture() {
     glGenerateMipmap(GL_TEXTURE_2D);
 }
 
+void Texture::InitializePlaceholder() {
+    static const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &textureBuffer);
+    glBindTexture(GL_TEXTURE_2D, textureBuffer);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    loaded = false;
+}
+
 void Light::InitializeLight() {
     if (shadowMapSize == 0) return;
     // We use SHADOW_WIDTH * 2 due to cascading shadow map and SHADOW_HEIGHT * 2
@@ -10,6 +10,10 @@
 #include "light.h"
 #include "opengl.h"
 
+#ifdef BUILD_CLIENT
+#include "mesh_buffer.h"
+#endif
+
 // Handles Meshes and Vertex Data for Rendering
 // These structs can be replicable but we want to keep them POD
 //   so we specify specializations
@@ -28,6 +32,18 @@ struct Vertex {
             normal(nx, ny, nz) {}
 };
 
+// Up to 4 bones per vertex, the weights are 0-255 and sum to 255
+struct VertexSkin {
+    uint8_t bones[4];
+    uint8_t weights[4];
+};
+
+// What skinned meshes store in their MeshBuffer
+struct SkinnedVertex {
+    Vertex vertex;
+    VertexSkin skin;
+};
+
 #ifdef BUILD_CLIENT
 
 template<>
@@ -68,11 +84,24 @@ struct Texture {
     } format = Format::RGB;
 
     GLuint textureBuffer;
+    // False while the file is still downloading and a placeholder is bound
+    bool loaded = true;
 
     void InitializeTexture();
+    // 1x1 grey, kept until AssetManager::LoadPendingTextures replaces it
+    void InitializePlaceholder();
 };
 
+// Placeholders are drawn as if the material had no texture there
+inline bool IsTextureLoaded(const Texture* texture) {
+    return texture && texture->loaded;
+}
+
 struct Material {
+    // Groups draws by material in render sort keys
+    inline static uint32_t nextSortId = 0;
+    uint32_t sortId = nextSortId++;
+
     virtual ~Material() {}
     virtual int GetShaderProgram() = 0;
     virtual bool IsTransparent() = 0;
@@ -122,10 +151,16 @@ struct DefaultMaterial : public Material {
 
 #ifdef BUILD_CLIENT
 struct MeshRenderInfo {
-    GLuint vao;
-    GLuint vbo;
-    GLuint ibo;
-    size_t iboCount;
+    // Shared with every other mesh of the same vertex format
+    MeshBuffer* buffer = nullptr;
+    MeshAllocation allocation;
+
+    GLuint GetVertexArray() const { return buffer->GetVertexArray(); }
+    GLsizei GetIndexCount() const { return allocation.indexCount; }
+    // Byte offset of the first index, for glDrawElements
+    const void* GetIndexOffset() const {
+        return (const void*)(allocation.firstIndex * sizeof(unsigned int));
+    }
 };
 #endif
 class Mesh {
@@ -133,17 +168,31 @@ public:
 	std::string name;
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
+    // Empty unless the model is animated, one per vertex otherwise
+    std::vector<VertexSkin> skin;
 
     Vector3 center;
 
 #ifdef BUILD_CLIENT
     Material* material = nullptr;
     MeshRenderInfo renderInfo;
+
+    // Groups draws by mesh in render sort keys
+    inline static uint32_t nextSortId = 0;
+    uint32_t sortId = nextSortId++;
 #endif
 
+    Mesh() {}
+    // Owns its material and buffer range
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
     ~Mesh() {
         #ifdef BUILD_CLIENT
             delete material;
+            if (renderInfo.buffer) {
+                renderInfo.buffer->Free(renderInfo.allocation);
+            }
         #endif
     }
     void InitializeMesh();
@@ -0,0 +1,149 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <sstream>
+
+size_t GetMetricShard() {
+    static std::atomic<size_t> nextShard { 0 };
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % MetricShards;
+    return shard;
+}
+
+uint64_t Counter::Get() const {
+    uint64_t total = 0;
+    for (auto& shard : shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t HistogramSnapshot::Percentile(double fraction) const {
+    if (count == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t) (fraction * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(Histogram::BucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+size_t Histogram::BucketIndex(uint64_t value) {
+    int magnitude = 63 - __builtin_clzll(value | 1);
+    int shift = std::max(magnitude - SubBucketBits, 0);
+    return (size_t) shift * SubBuckets + (value >> shift);
+}
+
+uint64_t Histogram::BucketUpperBound(size_t index) {
+    if (index < 2 * SubBuckets) return index;
+    uint64_t shift = index / SubBuckets - 1;
+    uint64_t subBucket = index % SubBuckets + SubBuckets;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void Histogram::Record(uint64_t value) {
+    Shard& shard = shards[GetMetricShard()];
+    shard.counts[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+}
+
+HistogramSnapshot Histogram::Snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.counts.assign(BucketCount, 0);
+    for (auto& shard : shards) {
+        for (size_t i = 0; i < BucketCount; i++) {
+            snapshot.counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+        }
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+    }
+    // Summed from the buckets so percentiles stay consistent with count
+    //   while other threads are recording
+    for (uint64_t bucketCount : snapshot.counts) {
+        snapshot.count += bucketCount;
+    }
+    return snapshot;
+}
+
+Counter& MetricsRegistry::AddCounter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::scoped_lock<std::mutex> lock(entriesMutex);
+    Counter& counter = counters.emplace_back();
+    entries.push_back(Entry{ name, labels, help, &counter, nullptr, nullptr });
+    return counter;
+}
+
+Gauge& MetricsRegistry::AddGauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::scoped_lock<std::mutex> lock(entriesMutex);
+    Gauge& gauge = gauges.emplace_back();
+    entries.push_back(Entry{ name, labels, help, nullptr, &gauge, nullptr });
+    return gauge;
+}
+
+Histogram& MetricsRegistry::AddHistogram(const std::string& name, const std::string& help, const std::string& labels) {
+    std::scoped_lock<std::mutex> lock(entriesMutex);
+    Histogram& histogram = histograms.emplace_back();
+    entries.push_back(Entry{ name, labels, help, nullptr, nullptr, &histogram });
+    return histogram;
+}
+
+std::string MetricsRegistry::Expose() {
+    std::scoped_lock<std::mutex> lock(entriesMutex);
+    // Series of one name have to be written together
+    std::vector<const Entry*> sorted;
+    for (auto& entry : entries) {
+        sorted.push_back(&entry);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) {
+        return a->name < b->name;
+    });
+
+    std::ostringstream output;
+    auto series = [&output](const std::string& name, const std::string& labels, const std::string& extra) {
+        output << name;
+        if (!labels.empty() || !extra.empty()) {
+            output << "{" << labels << (!labels.empty() && !extra.empty() ? "," : "") << extra << "}";
+        }
+        output << " ";
+    };
+    const std::string* lastName = nullptr;
+    for (const Entry* entry : sorted) {
+        if (!lastName || *lastName != entry->name) {
+            const char* type = entry->counter ? "counter" : entry->gauge ? "gauge" : "summary";
+            output << "# HELP " << entry->name << " " << entry->help << "\n";
+            output << "# TYPE " << entry->name << " " << type << "\n";
+            lastName = &entry->name;
+        }
+        if (entry->counter) {
+            series(entry->name, entry->labels, "");
+            output << entry->counter->Get() << "\n";
+        }
+        else if (entry->gauge) {
+            series(entry->name, entry->labels, "");
+            output << entry->gauge->Get() << "\n";
+        }
+        else {
+            HistogramSnapshot snapshot = entry->histogram->Snapshot();
+            for (const char* quantile : { "0.5", "0.9", "0.99", "0.999" }) {
+                series(entry->name, entry->labels, std::string("quantile=\"") + quantile + "\"");
+                output << snapshot.Percentile(std::stod(quantile)) << "\n";
+            }
+            series(entry->name, entry->labels, "quantile=\"1\"");
+            output << snapshot.max << "\n";
+            series(entry->name + "_sum", entry->labels, "");
+            output << snapshot.sum << "\n";
+            series(entry->name + "_count", entry->labels, "");
+            output << snapshot.count << "\n";
+        }
+    }
+    return output.str();
+}
+
+MetricsRegistry& GetMetrics() {
+    static MetricsRegistry metrics;
+    return metrics;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Threads write to their own shard of a metric so updates from the tick
+//   thread and the socket thread don't contend on one cache line, reads
+//   sum the shards
+static const size_t MetricShards = 4;
+
+// The shard the calling thread writes to, handed out round robin
+size_t GetMetricShard();
+
+// Only goes up
+class Counter {
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value { 0 };
+    };
+    std::array<Shard, MetricShards> shards;
+
+public:
+    void Add(uint64_t amount = 1) {
+        shards[GetMetricShard()].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+    uint64_t Get() const;
+};
+
+// Set to the current value, the last write wins
+class Gauge {
+    std::atomic<int64_t> value { 0 };
+
+public:
+    void Set(int64_t newValue) { value.store(newValue, std::memory_order_relaxed); }
+    void Add(int64_t amount) { value.fetch_add(amount, std::memory_order_relaxed); }
+    int64_t Get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// A histogram's shards merged at one point in time
+struct HistogramSnapshot {
+    std::vector<uint64_t> counts;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    // Upper bound of the bucket the value at that fraction falls in
+    uint64_t Percentile(double fraction) const;
+    double Mean() const { return count ? (double) sum / count : 0; }
+};
+
+// Log-linear buckets like HdrHistogram, values below 2 * SubBuckets are
+//   kept exactly and every power of two above is split into SubBuckets
+//   linear buckets. Any value up to 2^64 is recorded to within 1/SubBuckets
+//   of itself in a fixed number of buckets, in whatever unit the caller
+//   records, microseconds for durations.
+class Histogram {
+public:
+    static const int SubBucketBits = 5;
+    static const uint64_t SubBuckets = 1 << SubBucketBits;
+    static const size_t BucketCount = (64 - SubBucketBits + 1) * SubBuckets;
+
+    static size_t BucketIndex(uint64_t value);
+    static uint64_t BucketUpperBound(size_t index);
+
+    void Record(uint64_t value);
+    HistogramSnapshot Snapshot() const;
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BucketCount> counts {};
+        std::atomic<uint64_t> count { 0 };
+        std::atomic<uint64_t> sum { 0 };
+        std::atomic<uint64_t> max { 0 };
+    };
+    std::array<Shard, MetricShards> shards;
+};
+
+// Every metric the process exposes. Metrics are registered once, usually
+//   at static initialization, and updated without locking after
+class MetricsRegistry {
+    struct Entry {
+        std::string name;
+        // Inside of the braces, like type="obb_mesh", empty for none
+        std::string labels;
+        std::string help;
+        Counter* counter = nullptr;
+        Gauge* gauge = nullptr;
+        Histogram* histogram = nullptr;
+    };
+
+    std::mutex entriesMutex;
+    std::vector<Entry> entries;
+    // Deques so registered metrics never move
+    std::deque<Counter> counters;
+    std::deque<Gauge> gauges;
+    std::deque<Histogram> histograms;
+
+public:
+    Counter& AddCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& AddGauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& AddHistogram(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    // Prometheus text exposition format. Histograms are written as summaries
+    //   of their p50/p90/p99/p999 and max since startup, rates and windows
+    //   come from the scraper's _sum and _count
+    std::string Expose();
+};
+
+MetricsRegistry& GetMetrics();
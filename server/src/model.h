@@ -1,6 +1,8 @@
 #pragma once
 
 #include "mesh.h"
+#include "skeletal-animation.h"
+#include "bvh.h"
 #include "logging.h"
 #include "replicable.h"
 
@@ -14,6 +16,8 @@ class Model {
 public:
     std::string name;
     ModelID id;
+    // File the model was loaded from, empty for models built in code
+    std::string path;
 
     // Meshes to be rendered
     std::vector<Mesh*> meshes;
@@ -21,6 +25,16 @@ public:
     // Meshes marked otherwise
     std::vector<Mesh*> otherMeshes;
 
+    // Shared static mesh collision data, one per instance scale
+    std::vector<std::pair<Vector3, CollisionMesh*>> collisionMeshes;
+
+    // Set when the meshes are skinned, owned by the AssetManager
+    const SkeletalAnimationGroup* animations = nullptr;
+
+    // Model space bounds of the rendered meshes, computed on first use
+    AABB bounds;
+    bool hasBounds = false;
+
     ~Model() {
         for (Mesh* mesh : meshes) {
             delete mesh;
@@ -28,19 +42,30 @@ public:
         for (Mesh* mesh : otherMeshes) {
             delete mesh;
         }
+        for (auto& pair : collisionMeshes) {
+            delete pair.second;
+        }
     }
 
     Model() {}
-    Model(Model& other) {
-        name = other.name;
-        id = other.id;
-        for (Mesh* mesh : other.meshes) {
-            meshes.push_back(new Mesh(*mesh));
-        }
-        for (Mesh* mesh : other.otherMeshes) {
-            otherMeshes.push_back(new Mesh(*mesh));
+    // Meshes live in shared GPU buffers, draw with a material override
+    //   instead of copying a model
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    ModelID GetId() { return id; }
+
+    const AABB& GetBounds() {
+        if (!hasBounds) {
+            hasBounds = true;
+            bool first = true;
+            for (Mesh* mesh : meshes) {
+                if (mesh->vertices.empty()) continue;
+                AABB meshBounds = AABB::FromMesh(*mesh);
+                bounds = first ? meshBounds : AABB::FromTwo(bounds, meshBounds);
+                first = false;
+            }
         }
+        return bounds;
     }
-    ModelID GetId() { return id; }
 };
 
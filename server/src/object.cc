@@ -7,6 +7,16 @@
 
 static const double GRAVITY = 30;
 static const double EPSILON = 10e-10;
+// Contacts a swept object stops at in one tick before it takes the rest of
+//   its move in steps
+static const int MaxSweeps = 4;
+// A stop that gets less of the move done than this made no progress
+static const float MinSweepTime = 1e-4f;
+// Ticks an object stays put for before it sleeps, and how far it may move
+//   and how fast it may be going in each of them
+static const size_t SleepAfterTicks = 30;
+static const float SleepDistance = 0.001f;
+static const float SleepSpeed = 0.05f;
 
 std::unordered_map<std::string, ObjectConstructor>& GetClassLookup() {
     static std::unordered_map<std::string, ObjectConstructor> ClassLookup;
@@ -44,9 +54,19 @@ Object::Object(Game& game) :
     airFriction(0.95, 0.95, 0.95)
 {}
 
-Object::~Object() {}
+Object::~Object() {
+    if (isSleeping) {
+        game.RemoveSleeper(this);
+    }
+}
 
 void Object::HandleAllCollisions() {
+    if (game.profileTick) {
+        Time start = Timer::NowMicro();
+        game.HandleCollisions(this);
+        game.tickPhases.collisions += Timer::NowMicro() - start;
+        return;
+    }
     game.HandleCollisions(this);
     // Vector3 lastPosition = position;
     // for (size_t i = 0; i < 1; i++) {
@@ -67,8 +87,11 @@ void Object::Tick(Time time) {
         float timeFactor = delta / 1000.0;
 
         Vector3 positionDelta = GetVelocity() * timeFactor;
-        isGrounded = false;
-        if (!isStatic) {
+        // Sleeping, it still stands on whatever it rests on
+        if (!isSleeping) {
+            isGrounded = false;
+        }
+        if (!isStatic && !isSleeping) {
             AABB aabbBroad;
             if (!collider.children.empty()) {
                 aabbBroad = collider.children[0]->GetBroadAABB();
@@ -93,35 +116,12 @@ void Object::Tick(Time time) {
             //     HandleAllCollisions();
             // #endif
 
-            // #ifdef BUILD_SERVER
-                // Minimize Tunnelling by Creating Divisions
-                Vector3 size = glm::abs(aabbBroad.ptMax - aabbBroad.ptMin);
-
-                int divX = size.x < EPSILON ? 1 : glm::ceil(glm::abs(positionDelta.x) / size.x);
-                int divY = size.y < EPSILON ? 1 : glm::ceil(glm::abs(positionDelta.y) / size.y);
-                int divZ = size.z < EPSILON ? 1 : glm::ceil(glm::abs(positionDelta.z) / size.z);
-
-                int divisions = glm::max(divX, divY, divZ);
-                // if (IsTagged(Tag::PLAYER)) {
-                //     LOG_DEBUG(position.y << ": " << divisions << " " << positionDelta << " " << size);
-                // }
-
-                Vector3 subStepDelta = positionDelta;
-                for (int i = 0; i < divisions; i++) {
-                    position += subStepDelta / (float)divisions;
-                    HandleAllCollisions();
-                    if (IsStatic()) {
-                        break;
-                    }
-                    subStepDelta = GetVelocity() * timeFactor;
-                }
-
-                if (divisions == 0) {
-                    // We did not call HandleCollisions so reporting won't be triggered
-                    //   above, so we additionally handle collisions here.
-                    HandleAllCollisions();
-                }
-            // #endif
+            if (continuousCollision && game.continuousCollision && GetColliderCount() > 0) {
+                MoveSwept(aabbBroad, timeFactor);
+            }
+            else {
+                MoveSubstepped(aabbBroad, positionDelta, timeFactor);
+            }
 
             if (glm::abs(velocity.x) < EPSILON) {
                 velocity.x = 0;
@@ -132,6 +132,26 @@ void Object::Tick(Time time) {
             if (glm::abs(velocity.z) < EPSILON) {
                 velocity.z = 0;
             }
+
+            // Resting contacts put it back where it was each tick. Gravity
+            //   adds a tick of speed that the contact only takes back on
+            //   the next one, which doesn't count as moving
+            float sleepSpeed = SleepSpeed;
+            if (GetColliderCount() > 0 && !IsTagged(Tag::NO_GRAVITY)) {
+                sleepSpeed += GRAVITY * timeFactor;
+            }
+            if (canSleep && glm::distance(position, lastFramePosition) < SleepDistance &&
+                    glm::length(velocity) < sleepSpeed) {
+                if (++restingTicks >= SleepAfterTicks) {
+                    isSleeping = true;
+                    game.AddSleeper(this);
+                    velocity = Vector3();
+                    SetDirty(true);
+                }
+            }
+            else {
+                restingTicks = 0;
+            }
         }
 
         if (!IsZero(lastFramePosition - position)) {
@@ -154,6 +174,85 @@ void Object::Tick(Time time) {
     }
 }
 
+// The sphere around the broad AABB is swept, it holds the colliders however
+//   they turn about its centre so it reaches a wall before they can. The
+//   narrow phase at each stop finds what they actually touch. Once the sphere
+//   is held against something the colliders may be anywhere short of it, the
+//   rest of the move is taken in steps no longer than their half thickness
+//   so none can be carried past a surface it wasn't already touching
+void Object::MoveSwept(const AABB& aabbBroad, float timeFactor) {
+    Vector3 size = aabbBroad.ptMax - aabbBroad.ptMin;
+    float radius = 0.5f * glm::length(size);
+    Vector3 centerOffset = (aabbBroad.ptMin + aabbBroad.ptMax) * 0.5f - position;
+
+    float remaining = 1;
+    // Something it only reports touching, passed through from here on
+    Object* passing = nullptr;
+    for (int i = 0; i < MaxSweeps; i++) {
+        Vector3 delta = GetVelocity() * timeFactor * remaining;
+        Time start = game.profileTick ? Timer::NowMicro() : 0;
+        SweepResult hit = game.SweepInWorld(this, position + centerOffset, delta, radius, passing);
+        if (game.profileTick) {
+            game.tickPhases.collisions += Timer::NowMicro() - start;
+        }
+
+        position += delta * hit.time;
+        HandleAllCollisions();
+        if (!hit.isHit || IsStatic()) {
+            return;
+        }
+        remaining *= 1 - hit.time;
+        if (IsCollisionExcluded(hit.hitObject->GetTags()) ||
+                hit.hitObject->IsCollisionExcluded(GetTags())) {
+            passing = hit.hitObject;
+        }
+        else if (hit.time < MinSweepTime) {
+            // Held against something that blocks it, sweeping again would
+            //   stop at the same place
+            break;
+        }
+    }
+    // Held against something or still finding contacts
+    MoveSubstepped(aabbBroad, GetVelocity() * timeFactor * remaining, timeFactor * remaining,
+        collider.GetHalfThickness());
+}
+
+void Object::MoveSubstepped(const AABB& aabbBroad, const Vector3& positionDelta, float timeFactor,
+        float maxStep) {
+// #ifdef BUILD_SERVER
+    // Minimize Tunnelling by Creating Divisions
+    Vector3 size = glm::abs(aabbBroad.ptMax - aabbBroad.ptMin);
+
+    int divX = size.x < EPSILON ? 1 : glm::ceil(glm::abs(positionDelta.x) / size.x);
+    int divY = size.y < EPSILON ? 1 : glm::ceil(glm::abs(positionDelta.y) / size.y);
+    int divZ = size.z < EPSILON ? 1 : glm::ceil(glm::abs(positionDelta.z) / size.z);
+
+    int divisions = glm::max(divX, divY, divZ);
+    if (maxStep > EPSILON) {
+        divisions = glm::max(divisions, (int) glm::ceil(glm::length(positionDelta) / maxStep));
+    }
+    // if (IsTagged(Tag::PLAYER)) {
+    //     LOG_DEBUG(position.y << ": " << divisions << " " << positionDelta << " " << size);
+    // }
+
+    Vector3 subStepDelta = positionDelta;
+    for (int i = 0; i < divisions; i++) {
+        position += subStepDelta / (float)divisions;
+        HandleAllCollisions();
+        if (IsStatic()) {
+            break;
+        }
+        subStepDelta = GetVelocity() * timeFactor;
+    }
+
+    if (divisions == 0) {
+        // We did not call HandleCollisions so reporting won't be triggered
+        //   above, so we additionally handle collisions here.
+        HandleAllCollisions();
+    }
+// #endif
+}
+
 void Object::ResolveCollision(Vector3 difference) {
     // if (isStatic) return;
     // TODO: this collision difference really should be negated
@@ -224,10 +323,28 @@ bool Object::CollidesWith(const Vector3& p1, const Vector3& p2) {
 }
 
 void Object::SetIsStatic(bool isStatic) {
+    // Grounded weapons set it every tick, which shouldn't replicate them
+    if (this->isStatic == isStatic) return;
+    Wake();
     this->isStatic = isStatic;
     SetDirty(true);
 }
 
+void Object::SetCanSleep(bool enabled) {
+    canSleep = enabled;
+    if (!enabled) {
+        Wake();
+    }
+}
+
+void Object::Wake() {
+    restingTicks = 0;
+    if (!isSleeping) return;
+    isSleeping = false;
+    game.RemoveSleeper(this);
+    game.WakeTouching(this);
+}
+
 void Object::Serialize(JSONWriter& obj) {
     Replicable::Serialize(obj);
 
@@ -245,6 +362,7 @@ void Object::Serialize(JSONWriter& obj) {
 
 void Object::ProcessReplication(json& object) {
     Replicable::ProcessReplication(object);
+    Wake();
 
     if (object.HasMember("m")) {
         model = game.GetModel(object["m"].GetInt());
@@ -264,6 +382,7 @@ void Object::OnClientCreate() {
         clientPosition = position;
         clientRotation = rotation;
         clientScale = scale;
+        clientPoseVersion++;
         lastClientDrawTime = Timer::Now();
     #endif
 }
@@ -272,12 +391,27 @@ void Object::OnClientCreate() {
     void Object::PreDraw(Time now) {
         // Target Time + position and rotation is the desired position
         // Interpolate from lastClientDrawTime through now to nextTickTargetTime
+        // A settled pose is left alone, so whatever is keyed on the pose
+        //   version doesn't redo work for objects that aren't moving
+        if (clientPosition == position && clientRotation == rotation && clientScale == scale) {
+            lastClientDrawTime = now;
+            return;
+        }
         float lerpRatio = GetClientInterpolationRatio(now);
         // LOG_DEBUG("LastDraw " << lastClientDrawTime << " Now " << now << " NextTick " << nextTickTargetTime << " Ratio " << lerpRatio);
 
         clientPosition = glm::lerp(clientPosition, position, lerpRatio);
         clientRotation = glm::slerp(clientRotation, rotation, lerpRatio);
         clientScale = glm::lerp(clientScale, scale, lerpRatio);
+        // The lerp alone may never land exactly on the target
+        if (glm::distance2(clientPosition, position) < 1e-8f &&
+            glm::distance2(clientScale, scale) < 1e-8f &&
+            glm::abs(glm::dot(clientRotation, rotation)) > 1.0f - 1e-6f) {
+            clientPosition = position;
+            clientRotation = rotation;
+            clientScale = scale;
+        }
+        clientPoseVersion++;
 
         // clientPosition = position;
         // clientRotation = rotation;
@@ -314,35 +448,51 @@ void Object::OnClientCreate() {
         return clientRotation;
     }
 
-    bool Object::IsVisibleInFrustrum(const Vector3& camPos, const Vector3& camDir) {
-        if (GetColliderCount() == 0) {
-            // We don't know the bounds of this object, so assume visible
-            return true;
-        }
-        AABB b = GetCollider().GetBroadAABB();
-        if (!IsPointABehindPointB(Vector3(b.ptMin.x, b.ptMin.y, b.ptMin.z), camPos, camDir) ||
-            !IsPointABehindPointB(Vector3(b.ptMin.x, b.ptMin.y, b.ptMax.z), camPos, camDir) ||
-            !IsPointABehindPointB(Vector3(b.ptMin.x, b.ptMax.y, b.ptMin.z), camPos, camDir) ||
-            !IsPointABehindPointB(Vector3(b.ptMin.x, b.ptMax.y, b.ptMax.z), camPos, camDir) ||
-            !IsPointABehindPointB(Vector3(b.ptMax.x, b.ptMin.y, b.ptMin.z), camPos, camDir) ||
-            !IsPointABehindPointB(Vector3(b.ptMax.x, b.ptMin.y, b.ptMax.z), camPos, camDir) ||
-            !IsPointABehindPointB(Vector3(b.ptMax.x, b.ptMax.y, b.ptMin.z), camPos, camDir) ||
-            !IsPointABehindPointB(Vector3(b.ptMax.x, b.ptMax.y, b.ptMax.z), camPos, camDir)
-        ) {
-            return true;
+    const AABB& Object::GetRenderBounds(const Matrix4& transform) {
+        if (!renderBoundsValid || transform != renderBoundsTransform) {
+            if (model) {
+                renderBounds = model->GetBounds().Transformed(transform);
+            }
+            else {
+                renderBounds = AABB(Vector3(transform[3]), Vector3(transform[3]));
+            }
+            renderBoundsTransform = transform;
+            renderBoundsValid = true;
         }
-        return false;
+        return renderBounds;
     }
 #endif
 
 #ifdef BUILD_SERVER
     const Matrix4 Object::GetTransform() {
-        return glm::translate(position) *
-            glm::inverse(glm::toMat4(rotation)) *
-            glm::scale(scale);
+        return GetRigidTransform() * glm::scale(scale);
     }
 #endif
 
+void Object::UpdateRigidTransform() {
+    if (rigidTransformVersion && position == rigidTransformPosition && rotation == rigidTransformRotation) {
+        return;
+    }
+    // Unit rotations, the transpose is the inverse
+    rigidTransform = glm::translate(position) * glm::transpose(glm::toMat4(rotation));
+    rigidTransformPosition = position;
+    rigidTransformRotation = rotation;
+    // 0 is left for never computed
+    if (++rigidTransformVersion == 0) {
+        rigidTransformVersion = 1;
+    }
+}
+
+const Matrix4& Object::GetRigidTransform() {
+    UpdateRigidTransform();
+    return rigidTransform;
+}
+
+uint32_t Object::GetRigidTransformVersion() {
+    UpdateRigidTransform();
+    return rigidTransformVersion;
+}
+
 Model* Object::GetModel() {
     return model;
 }
@@ -358,24 +508,64 @@ void Object::ClearColliders() {
 void Object::SetModel(Model* newModel) {
     model = newModel;
     isDirty = true;
+#ifdef BUILD_CLIENT
+    renderBoundsValid = false;
+#endif
+}
+
+AABB Object::GetBoundsBeforeMove() {
+    // Only used to wake sleepers, don't bring the colliders up to date for nothing
+    if (game.GetSleepingCount() == 0) return AABB{};
+    return collider.GetBroadAABB();
+}
+
+void Object::WakeForMove(const AABB& previous) {
+    restingTicks = 0;
+    if (isSleeping) {
+        isSleeping = false;
+        game.RemoveSleeper(this);
+    }
+    game.WakeTouching(this, &previous);
 }
 
 void Object::SetPosition(const Vector3& in) {
-    position = in;
+    if (in != position) {
+        AABB previous = GetBoundsBeforeMove();
+        position = in;
+        WakeForMove(previous);
+    }
+    else {
+        Wake();
+    }
     SetDirty(true);
 }
 
 void Object::SetRotation(const Quaternion& in) {
-    rotation = in;
+    if (in != rotation) {
+        AABB previous = GetBoundsBeforeMove();
+        rotation = in;
+        WakeForMove(previous);
+    }
+    else {
+        Wake();
+    }
     SetDirty(true);
 }
 
 void Object::SetScale(const Vector3& in) {
-    scale = in;
+    if (in != scale) {
+        AABB previous = GetBoundsBeforeMove();
+        scale = in;
+        WakeForMove(previous);
+    }
+    else {
+        Wake();
+    }
     SetDirty(true);
 }
 
 void Object::SetVelocity(const Vector3& in) {
+    Wake();
     velocity = in;
     SetDirty(true);
 }
@@ -108,6 +108,44 @@ protected:
 
     Model* model = nullptr;
 
+    // Swept to each contact instead of moved in steps the size of its
+    //   colliders, for small fast objects that would need many steps
+    bool continuousCollision = false;
+    void MoveSwept(const AABB& aabbBroad, float timeFactor);
+    // Steps no longer than the broad AABB or maxStep when given, the first
+    //   one is positionDelta
+    void MoveSubstepped(const AABB& aabbBroad, const Vector3& positionDelta, float timeFactor,
+        float maxStep = 0);
+
+    // Resting objects skip their physics until something touches or moves
+    //   them, restingTicks counts the ticks they have stayed put
+    // Called by the setters after the pose changes with the bounds from
+    //   before, it wakes whatever touches the object where it was or where
+    //   it moved to, even if the object itself was awake
+    AABB GetBoundsBeforeMove();
+    void WakeForMove(const AABB& previous);
+    bool canSleep = true;
+    bool isSleeping = false;
+    size_t restingTicks = 0;
+
+    // Set by Game::DestroyObject, the object is gone at the end of the tick
+    bool isDestroyQueued = false;
+    // Slot in the RelationshipManager's flattened hierarchy
+    uint32_t hierarchyIndex = (uint32_t) -1;
+    // Slot in Game's sleepers while asleep
+    uint32_t sleeperIndex = (uint32_t) -1;
+    // Rigid transform version Game::WakeTouching last looked around from
+    uint32_t wakeCheckVersion = 0;
+
+    // Position and rotation as a matrix, the space colliders sit in, redone
+    //   only when either changes. The version counts the changes so
+    //   colliders can key their own caches on it.
+    Matrix4 rigidTransform;
+    Vector3 rigidTransformPosition;
+    Quaternion rigidTransformRotation;
+    uint32_t rigidTransformVersion = 0;
+    void UpdateRigidTransform();
+
 public:
 
 #ifdef BUILD_CLIENT
@@ -120,12 +158,20 @@ public:
     Vector3 clientPosition;
     Quaternion clientRotation;
     Vector3 clientScale;
+    // Bumped whenever the client pose changes, which stops once it lands on
+    //   the replicated one
+    uint32_t clientPoseVersion = 0;
 
     // Replication Smoothing
     Vector3 clientMeshPositionOffset;
     Time clientSmoothingTargetTime = 0;
 
-    bool IsVisibleInFrustrum(const Vector3& camPos, const Vector3& camDir);
+    // World space bounds of the model for culling, cached until the
+    //   transform changes
+    AABB renderBounds;
+    Matrix4 renderBoundsTransform;
+    bool renderBoundsValid = false;
+    const AABB& GetRenderBounds(const Matrix4& transform);
 #endif
 
     REPLICATED(Vector3, airFriction, "af");
@@ -139,6 +185,11 @@ public:
     float GetClientInterpolationRatio(Time now);
     virtual void PreDraw(Time time);
     bool createdThisFrameOnClient = false;
+
+    // Drawn with this instead of each mesh's own material when set
+    virtual Material* GetMaterialOverride() { return nullptr; }
+    // Poses the skinned meshes of the model, null draws them in bind pose
+    virtual const SkeletonPose* GetPose() { return nullptr; }
 #endif
 
     Object(Game& game);
@@ -157,6 +208,14 @@ public:
 
     void HandleAllCollisions();
     void ResolveCollision(Vector3 difference);
+    void SetContinuousCollision(bool enabled) { continuousCollision = enabled; }
+
+    // Off for objects driven every tick, like players
+    void SetCanSleep(bool enabled);
+    bool IsSleeping() const { return isSleeping; }
+    bool IsResting() const { return restingTicks > 0; }
+    // Also wakes whatever sleeps against it, so a pile wakes together
+    void Wake();
 
     size_t GetColliderCount() const { return collider.children.size(); }
     const TwoPhaseCollider& GetCollider() const { return collider; }
@@ -176,6 +235,15 @@ public:
     bool IsDirty() const { return isDirty; }
     void SetDirty(bool dirty) { isDirty = dirty; }
 
+    bool IsDestroyQueued() const { return isDestroyQueued; }
+    void SetDestroyQueued() { isDestroyQueued = true; }
+    uint32_t GetHierarchyIndex() const { return hierarchyIndex; }
+    void SetHierarchyIndex(uint32_t index) { hierarchyIndex = index; }
+    uint32_t GetSleeperIndex() const { return sleeperIndex; }
+    void SetSleeperIndex(uint32_t index) { sleeperIndex = index; }
+    uint32_t GetWakeCheckVersion() const { return wakeCheckVersion; }
+    void SetWakeCheckVersion(uint32_t version) { wakeCheckVersion = version; }
+
     virtual const char* GetClass() const = 0;
 
     virtual void Serialize(JSONWriter& obj) override;
@@ -225,6 +293,9 @@ public:
 #endif
 
     Model* GetModel();
+
+    const Matrix4& GetRigidTransform();
+    uint32_t GetRigidTransformVersion();
 };
 
 // Non abstract Object
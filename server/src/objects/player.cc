@@ -63,6 +63,8 @@ PlayerObject::PlayerObject(Game& game) : PlayerObject(game, Vector3()) {
 PlayerObject::PlayerObject(Game& game, Vector3 position) : ScriptableObject(game),
     inventoryManager(game, this) {
     SetTag(Tag::PLAYER);
+    // Input moves it without going through the setters
+    SetCanSleep(false);
 
     // SetTag(Tag::NO_GRAVITY);
 
@@ -399,8 +401,29 @@ void PlayerObject::PreDraw(Time now) {
     clientRotationYaw = AngleLerpDegrees(clientRotationYaw, rotationYaw, lerpRatio);
     clientRotationPitch = AngleLerpDegrees(clientRotationPitch, rotationPitch, lerpRatio);
 
+    Model* model = GetModel();
+    if (model && model->animations) {
+        if (animation.group != model->animations) {
+            animation = SkeletalAnimationState();
+            animation.group = model->animations;
+            lastAnimationTime = now;
+        }
+        animation.TickState(now > lastAnimationTime ? now - lastAnimationTime : 0);
+        lastAnimationTime = now;
+        poseDirty = true;
+    }
+
     ScriptableObject::PreDraw(now);
 }
+
+const SkeletonPose* PlayerObject::GetPose() {
+    if (!animation.group) return nullptr;
+    if (poseDirty) {
+        poseDirty = false;
+        animation.Evaluate(pose, fadePose);
+    }
+    return &pose;
+}
 #endif
 void PlayerObject::Serialize(JSONWriter& obj) {
     // LOG_DEBUG("Player Object Serialize - Start");
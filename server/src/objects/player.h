@@ -32,6 +32,13 @@ protected:
     #ifdef BUILD_CLIENT
         float clientRotationYaw = 0.0f;
         float clientRotationPitch = 0.0f;
+
+        // Advanced in PreDraw, only evaluated when the player is drawn
+        SkeletalAnimationState animation;
+        SkeletonPose pose;
+        SkeletonPose fadePose;
+        Time lastAnimationTime = 0;
+        bool poseDirty = true;
     #endif
 
     REPLICATED(Vector3, inputVelocity, "iv");
@@ -87,6 +94,7 @@ public:
     virtual void ProcessReplication(json& obj) override;
 #ifdef BUILD_CLIENT
     virtual void PreDraw(Time time) override;
+    virtual const SkeletonPose* GetPose() override;
     Quaternion GetClientRotationWithPitch() const {
         Matrix4 matrix;
         matrix = glm::rotate(matrix, glm::radians(clientRotationYaw), Vector::Up);
@@ -36,6 +36,6 @@ public:
 
     double GetAverage() const {
         // LOG_DEBUG("Get Average " << fullSum << " " << size);
-        return fullSum / size;
+        return (double) fullSum / size;
     }
 };
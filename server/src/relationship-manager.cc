@@ -1,27 +1,293 @@
 #include "relationship-manager.h"
 #include "game.h"
+#include "metrics.h"
+#include "trace.h"
 
-#include <queue>
+#include <algorithm>
+
+static Histogram& ObjectTickTime = GetMetrics().AddHistogram("object_tick_microseconds",
+    "Time spent on one object in a pass over the hierarchy, Tick or PreDraw");
 
 RelationshipManager::RelationshipManager(Game& game) : game(game) {}
 
 void RelationshipManager::RemoveParent(ObjectID child) {
-    parentChildren[childParent[child]].erase(child);
-    childParent.erase(child);
-    isDirty = true;
+    if (childParent.erase(child)) {
+        isDirty = true;
+        LogChange(child, 0);
+        MarkUnplaced(child);
+        PlaceUnplaced();
+    }
 }
 
 void RelationshipManager::SetParent(ObjectID child, ObjectID parent) {
     if (parent == child) {
         return;
     }
-    if (childParent.find(child) != childParent.end()) {
-        // Already have a parent
-        RemoveParent(child);
+    auto it = childParent.find(child);
+    if (it != childParent.end() && it->second == parent) {
+        return;
     }
     childParent[child] = parent;
-    parentChildren[parent].insert(child);
     isDirty = true;
+    LogChange(child, parent);
+    MarkUnplaced(child);
+    PlaceUnplaced();
+}
+
+void RelationshipManager::LogChange(ObjectID child, ObjectID parent) {
+#ifdef BUILD_SERVER
+    changes.emplace_back(child, parent);
+#endif
+}
+
+void RelationshipManager::MarkUnplaced(ObjectID child) {
+    if (std::find(unplaced.begin(), unplaced.end(), child) == unplaced.end()) {
+        unplaced.push_back(child);
+    }
+}
+
+void RelationshipManager::PlaceUnplaced() {
+    // Moving slots under Execute would skip or repeat objects
+    if (executing) {
+        return;
+    }
+    for (size_t i = 0; i < unplaced.size();) {
+        if (Place(unplaced[i])) {
+            unplaced[i] = unplaced.back();
+            unplaced.pop_back();
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+bool RelationshipManager::Place(ObjectID child) {
+    Object* childObj = game.GetObject(child);
+    auto it = childParent.find(child);
+    if (!childObj || childObj->GetHierarchyIndex() == NoSlot) {
+        // Unlinked it just becomes a root whenever it does arrive
+        return it == childParent.end();
+    }
+    uint32_t slot = childObj->GetHierarchyIndex();
+
+    int32_t parent = NoParent;
+    if (it != childParent.end()) {
+        Object* parentObj = game.GetObject(it->second);
+        if (!parentObj || parentObj->GetHierarchyIndex() == NoSlot) {
+            // Waits as a root for the parent to arrive
+            if (parentIndex[slot] != NoParent) {
+                MoveSubtree(slot, NoParent);
+            }
+            return false;
+        }
+        uint32_t parentSlot = parentObj->GetHierarchyIndex();
+        if (parentSlot >= slot && parentSlot < subtreeEnd[slot]) {
+            LOG_WARN("Object " << it->second << " can't be the parent of its ancestor " << child);
+            return true;
+        }
+        parent = parentSlot;
+    }
+    if (parentIndex[slot] != parent) {
+        MoveSubtree(slot, parent);
+    }
+    return true;
+}
+
+void RelationshipManager::MoveSubtree(uint32_t slot, int32_t newParent) {
+    TRACE_SCOPE("RelationshipManager::MoveSubtree");
+    uint32_t begin = slot;
+    uint32_t end = subtreeEnd[slot];
+    uint32_t size = end - begin;
+    uint32_t target = newParent == NoParent ? order.size() : subtreeEnd[newParent];
+    // Only the slots in [lo, hi) move
+    uint32_t lo = std::min(begin, target);
+    uint32_t hi = std::max(end, target);
+
+    // Where a slot ends up once [begin, end) is moved to target, the slots
+    //   in between shift over by its size
+    auto moved = [&](uint32_t position) -> uint32_t {
+        if (target > end) {
+            if (position >= begin && position < end) return position + (target - end);
+            if (position >= end && position < target) return position - size;
+        }
+        else if (target < begin) {
+            if (position >= begin && position < end) return position - (begin - target);
+            if (position >= target && position < begin) return position + size;
+        }
+        return position;
+    };
+    int32_t parentSlot = newParent == NoParent ? NoParent : (int32_t) moved(newParent);
+
+    // Past hi only the children of the range's slots whose subtree reaches
+    //   past it point into it, and those slots are all ancestors of hi - 1
+    uint32_t from = hi;
+    for (int32_t ancestor = hi - 1; ancestor != NoParent && (uint32_t) ancestor >= lo; ancestor = parentIndex[ancestor]) {
+        for (uint32_t i = from; i < subtreeEnd[ancestor]; i = subtreeEnd[i]) {
+            if (parentIndex[i] == ancestor) {
+                parentIndex[i] = moved(ancestor);
+            }
+        }
+        from = std::max(from, subtreeEnd[ancestor]);
+    }
+    for (uint32_t i = lo; i < hi; i++) {
+        if (parentIndex[i] != NoParent) {
+            parentIndex[i] = moved(parentIndex[i]);
+        }
+    }
+
+    // The subtree keeps its shape and whatever it jumps over shifts, except
+    //   for the ancestors it leaves or joins
+    if (target >= end) {
+        for (uint32_t i = begin; i < end; i++) {
+            subtreeEnd[i] += target - end;
+        }
+        for (uint32_t i = end; i < target; i++) {
+            // The new parent and its ancestors in here take it in
+            bool holdsParent = newParent != NoParent && i <= (uint32_t) newParent && subtreeEnd[i] >= target;
+            if (!holdsParent) {
+                subtreeEnd[i] -= size;
+            }
+        }
+        // Up to the first one that holds the new parent too
+        for (int32_t ancestor = parentIndex[begin]; ancestor != NoParent; ancestor = parentIndex[ancestor]) {
+            if (newParent != NoParent && ancestor <= newParent && (uint32_t) newParent < subtreeEnd[ancestor]) {
+                break;
+            }
+            subtreeEnd[ancestor] -= size;
+        }
+    }
+    else {
+        for (uint32_t i = begin; i < end; i++) {
+            subtreeEnd[i] -= begin - target;
+        }
+        for (uint32_t i = target; i < begin; i++) {
+            // The ancestors it leaves in here keep it
+            if (subtreeEnd[i] <= begin) {
+                subtreeEnd[i] += size;
+            }
+        }
+        // Up to the first one that held it already
+        for (int32_t ancestor = newParent; ancestor != NoParent && subtreeEnd[ancestor] <= begin; ancestor = parentIndex[ancestor]) {
+            subtreeEnd[ancestor] += size;
+        }
+    }
+
+    // Right before or after the new parent's subtree it only changes parent
+    if (target > end) {
+        std::rotate(order.begin() + begin, order.begin() + end, order.begin() + target);
+        std::rotate(parentIndex.begin() + begin, parentIndex.begin() + end, parentIndex.begin() + target);
+        std::rotate(subtreeEnd.begin() + begin, subtreeEnd.begin() + end, subtreeEnd.begin() + target);
+    }
+    else if (target < begin) {
+        std::rotate(order.begin() + target, order.begin() + begin, order.begin() + end);
+        std::rotate(parentIndex.begin() + target, parentIndex.begin() + begin, parentIndex.begin() + end);
+        std::rotate(subtreeEnd.begin() + target, subtreeEnd.begin() + begin, subtreeEnd.begin() + end);
+    }
+    parentIndex[moved(begin)] = parentSlot;
+    for (uint32_t i = lo; i < hi; i++) {
+        if (order[i]) {
+            order[i]->SetHierarchyIndex(i);
+        }
+    }
+}
+
+void RelationshipManager::RebuildSubtreeEnds() {
+    // Children come after their parent, so walking back every subtree is
+    //   complete before it extends its parent's
+    for (uint32_t i = 0; i < subtreeEnd.size(); i++) {
+        subtreeEnd[i] = i + 1;
+    }
+    for (uint32_t i = subtreeEnd.size(); i-- > 0;) {
+        if (parentIndex[i] != NoParent) {
+            subtreeEnd[parentIndex[i]] = std::max(subtreeEnd[parentIndex[i]], subtreeEnd[i]);
+        }
+    }
+}
+
+void RelationshipManager::Compact() {
+    TRACE_SCOPE("RelationshipManager::Compact");
+    remap.resize(order.size());
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < order.size(); i++) {
+        remap[i] = order[i] ? count++ : NoSlot;
+    }
+    // Slots only move down and parents come first, so nothing is read after
+    //   it's overwritten
+    for (uint32_t i = 0; i < order.size(); i++) {
+        if (!order[i]) continue;
+        uint32_t slot = remap[i];
+        order[slot] = order[i];
+        int32_t parent = parentIndex[i];
+        parentIndex[slot] = parent == NoParent || remap[parent] == NoSlot ? NoParent : (int32_t) remap[parent];
+        order[slot]->SetHierarchyIndex(slot);
+    }
+    order.resize(count);
+    parentIndex.resize(count);
+    subtreeEnd.resize(count);
+    RebuildSubtreeEnds();
+    emptySlots = 0;
+}
+
+void RelationshipManager::OnObjectAdded(Object* object) {
+    uint32_t slot = order.size();
+    order.push_back(object);
+    parentIndex.push_back(NoParent);
+    subtreeEnd.push_back(slot + 1);
+    object->SetHierarchyIndex(slot);
+
+    if (childParent.count(object->GetId())) {
+        MarkUnplaced(object->GetId());
+    }
+    // Its children may have been waiting for it too
+    if (!unplaced.empty()) {
+        PlaceUnplaced();
+    }
+}
+
+void RelationshipManager::OnObjectRemoved(Object* object) {
+    ObjectID id = object->GetId();
+    if (childParent.erase(id)) {
+        isDirty = true;
+        LogChange(id, 0);
+    }
+    auto waiting = std::find(unplaced.begin(), unplaced.end(), id);
+    if (waiting != unplaced.end()) {
+        unplaced.erase(waiting);
+    }
+    for (ObjectID child : unplaced) {
+        auto it = childParent.find(child);
+        if (it != childParent.end() && it->second == id) {
+            LogChange(child, 0);
+            childParent.erase(it);
+            isDirty = true;
+        }
+    }
+
+    uint32_t slot = object->GetHierarchyIndex();
+    if (slot == NoSlot) {
+        return;
+    }
+    for (uint32_t i = slot + 1; i < subtreeEnd[slot]; i = subtreeEnd[i]) {
+        if (!order[i]) continue;
+        ObjectID child = order[i]->GetId();
+        auto it = childParent.find(child);
+        if (it != childParent.end() && it->second == id) {
+            LogChange(child, 0);
+            childParent.erase(it);
+            isDirty = true;
+        }
+        MarkUnplaced(child);
+    }
+    order[slot] = nullptr;
+    object->SetHierarchyIndex(NoSlot);
+    emptySlots++;
+
+    // The children become roots
+    PlaceUnplaced();
+    if (!executing && emptySlots >= 64 && emptySlots * 2 > order.size()) {
+        Compact();
+    }
 }
 
 Object* RelationshipManager::GetParent(ObjectID child) {
@@ -36,20 +302,34 @@ Object* RelationshipManager::GetParent(ObjectID child) {
     return parent;
 }
 
-std::unordered_set<Object*> RelationshipManager::GetChildren(ObjectID parent) {
-    if (parentChildren.find(parent) == parentChildren.end()) {
-        return {};
+FrameVector<Object*> RelationshipManager::GetChildren(ObjectID parent) {
+    FrameVector<Object*> children { FrameAllocator<Object*>(game.GetFrameArena()) };
+    uint32_t slot = NoSlot;
+    Object* parentObj = game.GetObject(parent);
+    if (parentObj) {
+        slot = parentObj->GetHierarchyIndex();
     }
-    std::unordered_set<Object*> children;
-    for (ObjectID child : parentChildren[parent]) {
-        Object* childObj = game.GetObject(child);
-        if (!childObj) {
-            RemoveParent(child);
-        }
-        else {
-            children.insert(childObj);
+    if (slot != NoSlot) {
+        for (uint32_t i = slot + 1; i < subtreeEnd[slot]; i = subtreeEnd[i]) {
+            if (!order[i]) continue;
+            // Unplaced links are the only ones the slots may have wrong
+            if (!unplaced.empty()) {
+                auto it = childParent.find(order[i]->GetId());
+                if (it == childParent.end() || it->second != parent) continue;
+            }
+            children.push_back(order[i]);
         }
     }
+    for (ObjectID child : unplaced) {
+        auto it = childParent.find(child);
+        if (it == childParent.end() || it->second != parent) continue;
+        Object* childObj = game.GetObject(child);
+        if (!childObj) continue;
+        // Already found in the slots
+        uint32_t childSlot = childObj->GetHierarchyIndex();
+        if (slot != NoSlot && childSlot != NoSlot && parentIndex[childSlot] == (int32_t) slot) continue;
+        children.push_back(childObj);
+    }
     return children;
 }
 
@@ -67,51 +347,62 @@ void RelationshipManager::Tick(Time time) {
     }, time);
 }
 
-void RelationshipManager::Execute(std::function<void(Object*, Time)> func, Time time) {
-    std::queue<ObjectID> queue;
-
-    for (auto& object : game.GetGameObjects()) {
-        if (GetParent(object.first)) continue;
-        queue.push(object.first);
-    }
-
-    while (!queue.empty()) {
-        ObjectID object = queue.front();
-        queue.pop();
+void RelationshipManager::Execute(const std::function<void(Object*, Time)>& func, Time time) {
+    TRACE_SCOPE("RelationshipManager::Execute");
+    // Objects added during the pass wait for the next one, and so do the
+    //   moves of links changed during it
+    executing = true;
+    size_t count = order.size();
+    for (size_t next = 0; next < count; next++) {
+        Object* obj = order[next];
+        if (!obj) continue;
 
         Time start = Timer::NowMicro();
-        if (Object* obj = game.GetObject(object)) {
+        {
+            TRACE_SCOPE(obj->GetClass());
             func(obj, time);
         }
-        else {
-            LOG_ERROR("Object " << object << " got added to queue but did not find it in GameObjects!");
-        }
 
         Time end = Timer::NowMicro();
         game.averageObjectTickTime.InsertValue(end - start);
-
-        for (auto& child : parentChildren[object]) {
-            if (!game.GetObject(child)) {
-                RemoveParent(child);
-                continue;
-            }
-            queue.push(child);
-        }
+        ObjectTickTime.Record(end - start);
     }
-    auto it = parentChildren.begin();
-    while (it != parentChildren.end()) {
-        if (it->second.empty()) {
-            it = parentChildren.erase(it);
-            isDirty = true;
-        }
-        else {
-            it++;
-        }
+    executing = false;
+    if (!unplaced.empty()) {
+        PlaceUnplaced();
+    }
+    if (emptySlots >= 64 && emptySlots * 2 > order.size()) {
+        Compact();
     }
 }
 
 void RelationshipManager::Serialize(JSONWriter& obj) {
     Replicable::Serialize(obj);
+#ifdef BUILD_SERVER
+    if (serializeDelta) {
+        if (!changes.empty()) {
+            sequence++;
+        }
+        obj.Key("rs");
+        obj.Uint(sequence);
+        if (changes.empty()) {
+            return;
+        }
+        obj.Key("rd");
+        obj.StartArray();
+        for (auto& change : changes) {
+            obj.Uint64(change.first);
+            obj.Uint64(change.second);
+        }
+        obj.EndArray();
+        changes.clear();
+        return;
+    }
+#endif
+    // Changes not sent yet are in here too, and replay harmlessly over it
+    //   when their delta arrives
+    obj.Key("rs");
+    obj.Uint(sequence);
     obj.Key("r");
     obj.StartArray();
     for (auto& pair : childParent) {
@@ -124,20 +415,72 @@ void RelationshipManager::Serialize(JSONWriter& obj) {
 
 void RelationshipManager::ProcessReplication(json& obj) {
     Replicable::ProcessReplication(obj);
-    childParent.clear();
-    parentChildren.clear();
+    uint32_t incoming = obj.HasMember("rs") ? obj["rs"].GetUint() : 0;
+
+    if (obj.HasMember("r")) {
+        // Whatever the full list leaves out becomes a root. Every link is
+        //   marked once and placed in one go, not one SetParent at a time
+        for (auto& pair : childParent) {
+            unplaced.push_back(pair.first);
+        }
+        childParent.clear();
+
+        ObjectID child = 0;
+        for (auto& entry : obj["r"].GetArray()) {
+            if (child == 0) {
+                child = entry.GetUint64();
+            }
+            else {
+                ObjectID parent = entry.GetUint64();
+                if (parent != child) {
+                    childParent[child] = parent;
+                    unplaced.push_back(child);
+                }
+                child = 0;
+            }
+        }
+        std::sort(unplaced.begin(), unplaced.end());
+        unplaced.erase(std::unique(unplaced.begin(), unplaced.end()), unplaced.end());
+        isDirty = true;
+        PlaceUnplaced();
+        sequence = incoming;
+        outOfSync = false;
+        resyncRequested = false;
+        // PrintDebug();
+        return;
+    }
+
+    if (incoming == sequence) {
+        return;
+    }
+    if (outOfSync || incoming != sequence + 1 || !obj.HasMember("rd")) {
+        if (!outOfSync) {
+            LOG_WARN("Relationships at " << sequence << " got delta " << incoming << ", waiting for a resync");
+        }
+        outOfSync = true;
+        return;
+    }
 
-    ObjectID child = 0;
-    for (auto& entry : obj["r"].GetArray()) {
-        if (child == 0) {
-            child = entry.GetUint64();
+    auto& delta = obj["rd"];
+    for (rapidjson::SizeType i = 0; i + 1 < delta.Size(); i += 2) {
+        ObjectID child = delta[i].GetUint64();
+        ObjectID parent = delta[i + 1].GetUint64();
+        if (parent == 0) {
+            RemoveParent(child);
         }
         else {
-            SetParent(child, entry.GetUint64());
-            child = 0;
+            SetParent(child, parent);
         }
     }
-    // PrintDebug();
+    sequence = incoming;
+}
+
+bool RelationshipManager::TakeResyncRequest() {
+    if (!outOfSync || resyncRequested) {
+        return false;
+    }
+    resyncRequested = true;
+    return true;
 }
 
 bool RelationshipManager::IsDirty() const {
@@ -2,6 +2,7 @@
 
 #include "object.h"
 #include "replicable.h"
+#include "frame-allocator.h"
 #include <unordered_set>
 
 // Handles relationships between two objects
@@ -11,24 +12,74 @@ class RelationshipManager : public Replicable {
     // Each object can only have one parent
     std::unordered_map<ObjectID, ObjectID> childParent;
 
-    // For speed sake, we also store children
-    std::unordered_map<ObjectID, std::unordered_set<ObjectID>> parentChildren;
+    // Every object flattened depth first so a parent always comes before its
+    //   children and a subtree is the contiguous range [i, subtreeEnd[i]).
+    //   Objects keep their slot in their hierarchy index. New objects are
+    //   appended as roots, a new link moves just the child's subtree, and a
+    //   removed object leaves a null slot until enough pile up to compact.
+    std::vector<Object*> order;
+    // Slot of the parent, NoParent for roots
+    std::vector<int32_t> parentIndex;
+    std::vector<uint32_t> subtreeEnd;
+    size_t emptySlots = 0;
+    // Children whose link isn't reflected by the slots yet, because one end
+    //   isn't in the game or the link changed during a pass
+    std::vector<ObjectID> unplaced;
+    // Scratch for compacting, kept so its memory is reused
+    std::vector<uint32_t> remap;
+    bool executing = false;
 
     bool isDirty = false;
 
+    // Links replicate as a log of changes, numbered by the Serialize that
+    //   sent them. The full list only goes to a new player or a client that
+    //   missed a delta.
+    uint32_t sequence = 0;
+#ifdef BUILD_SERVER
+    // (child, parent) since the last delta, object ids start at 1 so a
+    //   parent of 0 removes the link
+    std::vector<std::pair<ObjectID, ObjectID>> changes;
+    bool serializeDelta = false;
+#endif
+    // A delta came out of sequence, nothing is applied until the full list
+    bool outOfSync = false;
+    bool resyncRequested = false;
+
+    static constexpr int32_t NoParent = -1;
+    static constexpr uint32_t NoSlot = (uint32_t) -1;
+
+    void LogChange(ObjectID child, ObjectID parent);
+
+    // Brings the slots in line with the child's link, false while one end of
+    //   a link is missing
+    bool Place(ObjectID child);
+    void PlaceUnplaced();
+    void MarkUnplaced(ObjectID child);
+    // Makes the subtree at slot the last child of newParent, or the last root
+    void MoveSubtree(uint32_t slot, int32_t newParent);
+    void RebuildSubtreeEnds();
+    void Compact();
     void PrintDebug();
 public:
     RelationshipManager(Game& game);
 
     // Tries to obtain parent, parent doesn't exist anymore, we prune
     Object* GetParent(ObjectID child);
+    // Whether the child is linked at all, without looking the parent up
+    bool HasParent(ObjectID child) const { return childParent.count(child); }
 
-    std::unordered_set<Object*> GetChildren(ObjectID parent);
+    // On the game's frame arena, only good until the next tick
+    FrameVector<Object*> GetChildren(ObjectID parent);
 
     void SetParent(ObjectID child, ObjectID parent);
 
     void RemoveParent(ObjectID child);
 
+    // Called by the game whenever an object joins or leaves GameObjects
+    void OnObjectAdded(Object* object);
+    // Also unlinks the children of the object, they become roots
+    void OnObjectRemoved(Object* object);
+
 #ifdef BUILD_CLIENT
     // Delegates PreDraw to all the objects
     void PreDraw(Time time);
@@ -37,11 +88,19 @@ public:
     // Actually delegates the tick to all the objects
     void Tick(Time time);
 
-    void Execute(std::function<void(Object*, Time)> func, Time time);
+    void Execute(const std::function<void(Object*, Time)>& func, Time time);
 
     // Serialization Methods
     bool IsDirty() const;
     void ResetDirty();
+#ifdef BUILD_SERVER
+    // Serialize writes the changes since the last delta and forgets them
+    //   instead of the full list, for the packets every player shares
+    void SetSerializeDelta(bool delta) { serializeDelta = delta; }
+#endif
+    // True once after a delta is missed, the server should then be asked
+    //   for the full list
+    bool TakeResyncRequest();
     void Serialize(JSONWriter& obj) override;
     void ProcessReplication(json& obj) override;
 };
@@ -174,50 +174,46 @@ void Scene::FlattenHierarchy(std::vector<TransformedNode>& output, Node* root) {
 }
 
 #ifdef BUILD_CLIENT
-void TransformedLight::InitializeLight() {
-    static int setShadowMapSize = 0;
-    LightNode* lightNode = dynamic_cast<LightNode*>(node);
-    if (setShadowMapSize == lightNode->shadowMapSize) {
-        return;
+// Atlas of 2x2 cascades, color is only kept for debug views
+static void CreateShadowTarget(int shadowMapSize, GLuint& frameBuffer,
+        GLuint& depthMap, GLuint& colorMap) {
+    if (frameBuffer) {
+        glDeleteFramebuffers(1, &frameBuffer);
+        frameBuffer = 0;
     }
-    setShadowMapSize = lightNode->shadowMapSize;
-    if (shadowFrameBuffer) {
-        glDeleteFramebuffers(1, &shadowFrameBuffer);
-        shadowFrameBuffer = 0;
+    if (depthMap) {
+        glDeleteTextures(1, &depthMap);
+        depthMap = 0;
     }
-    if (shadowDepthMap) {
-        glDeleteTextures(1, &shadowDepthMap);
-        shadowDepthMap = 0;
-    }
-    if (shadowColorMap) {
-        glDeleteTextures(1, &shadowColorMap);
-        shadowColorMap = 0;
+    if (colorMap) {
+        glDeleteTextures(1, &colorMap);
+        colorMap = 0;
     }
 
     // We use SHADOW_WIDTH * 2 due to cascading shadow map and SHADOW_HEIGHT * 2
-    glGenTextures(1, &shadowColorMap);
-    glBindTexture(GL_TEXTURE_2D, shadowColorMap);
+    glGenTextures(1, &colorMap);
+    glBindTexture(GL_TEXTURE_2D, colorMap);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                lightNode->shadowMapSize * 2, lightNode->shadowMapSize * 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                shadowMapSize * 2, shadowMapSize * 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glGenTextures(1, &shadowDepthMap);
-    glBindTexture(GL_TEXTURE_2D, shadowDepthMap);
+    glGenTextures(1, &depthMap);
+    glBindTexture(GL_TEXTURE_2D, depthMap);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
-                lightNode->shadowMapSize * 2, lightNode->shadowMapSize * 2, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+                shadowMapSize * 2, shadowMapSize * 2, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glGenFramebuffers(1, &shadowFrameBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowFrameBuffer);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowColorMap, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowDepthMap, 0);
+    glGenFramebuffers(1, &frameBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorMap, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
 
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 
@@ -225,4 +221,21 @@ void TransformedLight::InitializeLight() {
         LOG_ERROR("FB error, status: " << status);
     }
 }
+
+void TransformedLight::InitializeLight() {
+    LightNode* lightNode = dynamic_cast<LightNode*>(node);
+    if (initializedShadowMapSize == lightNode->shadowMapSize) {
+        return;
+    }
+    initializedShadowMapSize = lightNode->shadowMapSize;
+
+    CreateShadowTarget(lightNode->shadowMapSize,
+        shadowFrameBuffer, shadowDepthMap, shadowColorMap);
+    CreateShadowTarget(lightNode->shadowMapSize,
+        shadowCacheFrameBuffer, shadowCacheDepthMap, shadowCacheColorMap);
+    for (auto& cached : isCascadeCached) {
+        cached = false;
+    }
+    shadowFrame = 0;
+}
 #endif
\ No newline at end of file
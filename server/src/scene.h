@@ -205,6 +205,21 @@ struct TransformedLight : public TransformedNode {
         GLuint shadowDepthMap = 0;
         GLuint shadowColorMap = 0;
 
+        // Same layout as the shadow map but only static casters, copied in
+        //   before dynamic casters are drawn on top
+        GLuint shadowCacheFrameBuffer = 0;
+        GLuint shadowCacheDepthMap = 0;
+        GLuint shadowCacheColorMap = 0;
+
+        // Per cascade (near, mid, far), what the cached static casters were drawn with
+        Matrix4 cachedCascadeViewProj[3];
+        size_t cachedStaticSignature[3] = {};
+        bool isCascadeCached[3] = {};
+
+        // Counts shadow map updates, for updating the far cascade less often
+        size_t shadowFrame = 0;
+        int initializedShadowMapSize = 0;
+
         Matrix4 depthBiasMVPNear;
         Matrix4 depthBiasMVPMid;
         Matrix4 depthBiasMVPFar;
@@ -226,6 +241,18 @@ struct TransformedLight : public TransformedNode {
                 glDeleteTextures(1, &shadowColorMap);
                 shadowColorMap = 0;
             }
+            if (shadowCacheFrameBuffer) {
+                glDeleteFramebuffers(1, &shadowCacheFrameBuffer);
+                shadowCacheFrameBuffer = 0;
+            }
+            if (shadowCacheDepthMap) {
+                glDeleteTextures(1, &shadowCacheDepthMap);
+                shadowCacheDepthMap = 0;
+            }
+            if (shadowCacheColorMap) {
+                glDeleteTextures(1, &shadowCacheColorMap);
+                shadowCacheColorMap = 0;
+            }
         #endif
     }
     void Update(const TransformedNode& node) {
@@ -5,6 +5,7 @@
 #include "player.h"
 #include "weapons/weapon.h"
 #include "util.h"
+#include "trace.h"
 
 std::string ScriptManager::GetBaseTypeFromScriptingType(const std::string& type) {
     // Make a WendyCall to retrieve BaseType
@@ -120,12 +121,14 @@ ScriptManager::~ScriptManager() {
 }
 
 void ScriptManager::AddScript(const std::string& path) {
+    TRACE_SCOPE("ScriptManager::AddScript");
     Script* script = new Script;
     script->LoadAndCompile(path);
     scripts.push_back(script);
 }
 
 void ScriptManager::InitializeVM() {
+    TRACE_SCOPE("ScriptManager::InitializeVM");
     push_frame(vm->memory, "main", 0, 0);
     // Create Global Variables needed for scripting
 
@@ -5,6 +5,7 @@
 #include "weapons/weapon.h"
 #include "scripting-interface.h"
 #include "script-manager.h"
+#include "trace.h"
 
 #include <fstream>
 
@@ -90,6 +91,8 @@ void ScriptInstance::InitializeInstance(const std::string& className, ObjectID i
 
 void WendyCallMemberFunction(struct data structInstance,
     const std::string& member, const std::vector<struct data> arguments) {
+    // Named after the script function, only interned while tracing
+    TraceScope trace(Trace::IsEnabled() ? Trace::Intern(member) : nullptr);
     // Setup a member function call
     struct data* fn = struct_get_field(ScriptManager::vm, structInstance, member.c_str());
     if (!fn) {
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+// Four lanes in one register through the GCC/clang vector extensions, so the
+//   same code is SSE natively and wasm simd128 when built with -msimd128.
+//   The arithmetic and comparison operators work lane by lane.
+typedef float float4 __attribute__((vector_size(16)));
+typedef int int4 __attribute__((vector_size(16)));
+
+// Unaligned, std::vector storage is only guaranteed 8 byte alignment
+inline float4 Load4(const float* data) {
+    float4 value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline void Store4(float* data, float4 value) {
+    std::memcpy(data, &value, sizeof(value));
+}
+
+inline float4 Splat4(float value) {
+    return float4{ value, value, value, value };
+}
+
+// Negates the lanes where mask is set, mask comes from a comparison
+inline float4 NegateWhere4(float4 value, int4 mask) {
+    return (float4) ((int4) value ^ (mask & (int4) Splat4(-0.0f)));
+}
+
+inline float4 InverseSqrt4(float4 value) {
+    float4 result;
+    for (int i = 0; i < 4; i++) {
+        result[i] = 1.0f / std::sqrt(value[i]);
+    }
+    return result;
+}
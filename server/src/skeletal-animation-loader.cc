@@ -0,0 +1,415 @@
+#include "skeletal-animation-loader.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+// Raw BVH data before it's split into clips
+struct BVHMotion {
+    enum class Channel { XPosition, YPosition, ZPosition, XRotation, YRotation, ZRotation };
+    // Per bone, in file order
+    std::vector<std::vector<Channel>> channels;
+    size_t channelCount = 0;
+    size_t frameCount = 0;
+    float frameTime = 0;
+    std::vector<float> values;
+};
+
+static void ExpectToken(std::istream& stream, const std::string& expected) {
+    std::string token;
+    if (!(stream >> token) || token != expected) {
+        LOG_ERROR("BVH expected " << expected << " but found " << token);
+        throw std::runtime_error("BVH expected " + expected);
+    }
+}
+
+static Vector3 ReadVector(std::istream& stream) {
+    Vector3 vector;
+    if (!(stream >> vector.x >> vector.y >> vector.z)) {
+        LOG_ERROR("BVH has a malformed OFFSET");
+        throw std::runtime_error("BVH has a malformed OFFSET");
+    }
+    return vector;
+}
+
+// Reads a ROOT or JOINT block, name has already been read
+static void ReadJoint(std::istream& stream, const std::string& name, int parent,
+        Skeleton& skeleton, BVHMotion& motion, std::vector<Vector3>& endSites) {
+    int bone = skeleton.GetBoneCount();
+    if (bone >= (int) MaxBones) {
+        LOG_ERROR("BVH has more than " << MaxBones << " bones");
+        throw std::runtime_error("BVH has too many bones");
+    }
+    skeleton.names.push_back(name);
+    skeleton.parents.push_back(parent);
+    skeleton.bindTranslations.emplace_back();
+    skeleton.rotates.push_back(false);
+    motion.channels.emplace_back();
+    endSites.emplace_back(NAN);
+
+    ExpectToken(stream, "{");
+    std::string token;
+    while (stream >> token) {
+        if (token == "OFFSET") {
+            skeleton.bindTranslations[bone] = ReadVector(stream);
+        }
+        else if (token == "CHANNELS") {
+            size_t count;
+            stream >> count;
+            for (size_t i = 0; i < count; i++) {
+                stream >> token;
+                static const char* names[] = {
+                    "Xposition", "Yposition", "Zposition", "Xrotation", "Yrotation", "Zrotation" };
+                auto found = std::find(std::begin(names), std::end(names), token);
+                if (found == std::end(names)) {
+                    LOG_ERROR("BVH has an unknown channel " << token);
+                    throw std::runtime_error("BVH has an unknown channel " + token);
+                }
+                auto channel = (BVHMotion::Channel) (found - std::begin(names));
+                motion.channels[bone].push_back(channel);
+                if (channel >= BVHMotion::Channel::XRotation) {
+                    skeleton.rotates[bone] = true;
+                }
+            }
+            motion.channelCount += count;
+        }
+        else if (token == "JOINT") {
+            std::string childName;
+            stream >> childName;
+            ReadJoint(stream, childName, bone, skeleton, motion, endSites);
+        }
+        else if (token == "End") {
+            ExpectToken(stream, "Site");
+            ExpectToken(stream, "{");
+            ExpectToken(stream, "OFFSET");
+            endSites[bone] = ReadVector(stream);
+            ExpectToken(stream, "}");
+        }
+        else if (token == "}") {
+            return;
+        }
+        else {
+            LOG_ERROR("BVH has an unexpected " << token);
+            throw std::runtime_error("BVH has an unexpected " + token);
+        }
+    }
+    LOG_ERROR("BVH ends inside joint " << name);
+    throw std::runtime_error("BVH ends inside a joint");
+}
+
+static void ReadBVH(std::istream& stream, Skeleton& skeleton, BVHMotion& motion,
+        std::vector<Vector3>& endSites) {
+    ExpectToken(stream, "HIERARCHY");
+    ExpectToken(stream, "ROOT");
+    std::string name;
+    stream >> name;
+    ReadJoint(stream, name, -1, skeleton, motion, endSites);
+
+    ExpectToken(stream, "MOTION");
+    ExpectToken(stream, "Frames:");
+    stream >> motion.frameCount;
+    ExpectToken(stream, "Frame");
+    ExpectToken(stream, "Time:");
+    stream >> motion.frameTime;
+
+    motion.values.resize(motion.frameCount * motion.channelCount);
+    for (float& value : motion.values) {
+        if (!(stream >> value)) {
+            LOG_ERROR("BVH motion is shorter than " << motion.frameCount << " frames");
+            throw std::runtime_error("BVH motion is truncated");
+        }
+    }
+    if (motion.frameCount == 0) {
+        LOG_ERROR("BVH has no frames");
+        throw std::runtime_error("BVH has no frames");
+    }
+}
+
+// BVH exported Z up, we're Y up
+static Vector3 FromZUp(const Vector3& v) {
+    return Vector3(v.x, v.z, -v.y);
+}
+
+static Vector3 ToZUp(const Vector3& v) {
+    return Vector3(v.x, -v.z, v.y);
+}
+
+// Local transform of every bone at a frame, rotations apply in channel order
+static void ReadFrame(const Skeleton& skeleton, const BVHMotion& motion, size_t frame, bool zUp,
+        std::vector<Vector3>& translations, std::vector<Quaternion>& rotations) {
+    const float* values = &motion.values[frame * motion.channelCount];
+    for (size_t bone = 0; bone < skeleton.GetBoneCount(); bone++) {
+        // Bind translations are already converted, channels are in file space
+        Vector3 translation = zUp ? ToZUp(skeleton.bindTranslations[bone]) : skeleton.bindTranslations[bone];
+        Quaternion rotation;
+        for (auto channel : motion.channels[bone]) {
+            float value = *values++;
+            switch (channel) {
+                case BVHMotion::Channel::XPosition: translation.x = value; break;
+                case BVHMotion::Channel::YPosition: translation.y = value; break;
+                case BVHMotion::Channel::ZPosition: translation.z = value; break;
+                case BVHMotion::Channel::XRotation:
+                    rotation = rotation * glm::angleAxis(glm::radians(value), Vector3(1, 0, 0));
+                    break;
+                case BVHMotion::Channel::YRotation:
+                    rotation = rotation * glm::angleAxis(glm::radians(value), Vector3(0, 1, 0));
+                    break;
+                case BVHMotion::Channel::ZRotation:
+                    rotation = rotation * glm::angleAxis(glm::radians(value), Vector3(0, 0, 1));
+                    break;
+            }
+        }
+        if (zUp) {
+            translation = FromZUp(translation);
+            Vector3 axis = FromZUp(Vector3(rotation.x, rotation.y, rotation.z));
+            rotation = Quaternion(rotation.w, axis.x, axis.y, axis.z);
+        }
+        translations[bone] = translation;
+        rotations[bone] = rotation;
+    }
+}
+
+static SkeletalAnimationClip BuildClip(const Skeleton& skeleton, const BVHMotion& motion,
+        bool zUp, size_t start, size_t end) {
+    SkeletalAnimationClip clip;
+    clip.frameCount = end - start + 1;
+    clip.frameTime = motion.frameTime;
+
+    size_t boneCount = skeleton.GetBoneCount();
+    size_t padded = skeleton.GetPaddedBoneCount();
+    for (auto& component : clip.translations) {
+        component.assign(clip.frameCount * padded, 0.0f);
+    }
+    for (auto& component : clip.rotations) {
+        component.assign(clip.frameCount * padded, 0.0f);
+    }
+    clip.rotations[3].assign(clip.frameCount * padded, 1.0f);
+
+    bool translationsMove = false;
+    bool rotationsMove = false;
+    std::vector<Vector3> translations(boneCount);
+    std::vector<Quaternion> rotations(boneCount);
+    for (size_t frame = 0; frame < clip.frameCount; frame++) {
+        ReadFrame(skeleton, motion, start + frame, zUp, translations, rotations);
+        for (size_t bone = 0; bone < boneCount; bone++) {
+            size_t index = frame * padded + bone;
+            for (int c = 0; c < 3; c++) {
+                clip.translations[c][index] = translations[bone][c];
+                translationsMove |= glm::abs(translations[bone][c] - clip.translations[c][bone]) > 1e-5f;
+            }
+            for (int c = 0; c < 4; c++) {
+                clip.rotations[c][index] = rotations[bone][c];
+                rotationsMove |= glm::abs(rotations[bone][c] - clip.rotations[c][bone]) > 1e-5f;
+            }
+        }
+    }
+
+    // Channels that never change keep their first frame only
+    clip.translationFrames = translationsMove ? clip.frameCount : 1;
+    clip.rotationFrames = rotationsMove ? clip.frameCount : 1;
+    for (auto& component : clip.translations) {
+        component.resize(clip.translationFrames * padded);
+        component.shrink_to_fit();
+    }
+    for (auto& component : clip.rotations) {
+        component.resize(clip.rotationFrames * padded);
+        component.shrink_to_fit();
+    }
+    return clip;
+}
+
+void LoadSkeletalAnimationGroup(const std::string& path, SkeletalAnimationGroup& group,
+        std::vector<std::string>& models) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        LOG_ERROR("Could not open " << path);
+        throw std::runtime_error("Could not open " + path);
+    }
+    rapidjson::IStreamWrapper wrapper(file);
+    JSONDocument description;
+    description.ParseStream(wrapper);
+    if (description.HasParseError() || !description.IsObject() ||
+        !description.HasMember("skeleton")) {
+        LOG_ERROR("Animation set " << path << " needs a skeleton");
+        throw std::runtime_error("Animation set " + path + " needs a skeleton");
+    }
+    bool zUp = description.HasMember("zUp") && description["zUp"].GetBool();
+
+    std::filesystem::path bvhPath = std::filesystem::path(path).parent_path() /
+        description["skeleton"].GetString();
+    std::ifstream bvhFile(bvhPath);
+    if (!bvhFile.is_open()) {
+        LOG_ERROR("Could not open " << bvhPath.string());
+        throw std::runtime_error("Could not open " + bvhPath.string());
+    }
+
+    Skeleton& skeleton = group.skeleton;
+    BVHMotion motion;
+    std::vector<Vector3> endSites;
+    ReadBVH(bvhFile, skeleton, motion, endSites);
+
+    // The BVH rest pose has no rotations, the mesh was modelled in it
+    size_t boneCount = skeleton.GetBoneCount();
+    skeleton.bindRotations.assign(boneCount, Quaternion());
+    skeleton.jointPositions.resize(boneCount);
+    skeleton.inverseBindMatrices.resize(boneCount);
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        if (zUp) {
+            skeleton.bindTranslations[bone] = FromZUp(skeleton.bindTranslations[bone]);
+            endSites[bone] = FromZUp(endSites[bone]);
+        }
+        int parent = skeleton.parents[bone];
+        skeleton.jointPositions[bone] = skeleton.bindTranslations[bone] +
+            (parent >= 0 ? skeleton.jointPositions[parent] : Vector3(0));
+        skeleton.inverseBindMatrices[bone] = glm::translate(-skeleton.jointPositions[bone]);
+    }
+
+    // A bone ends at its end site, or in the middle of its children
+    skeleton.tipPositions = skeleton.jointPositions;
+    std::vector<int> childCount(boneCount, 0);
+    std::vector<Vector3> childSum(boneCount, Vector3(0));
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        if (skeleton.parents[bone] >= 0) {
+            childCount[skeleton.parents[bone]]++;
+            childSum[skeleton.parents[bone]] += skeleton.jointPositions[bone];
+        }
+    }
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        if (!glm::isnan(endSites[bone].x)) {
+            skeleton.tipPositions[bone] = skeleton.jointPositions[bone] + endSites[bone];
+        }
+        else if (childCount[bone] > 0) {
+            skeleton.tipPositions[bone] = childSum[bone] / (float) childCount[bone];
+        }
+    }
+
+    if (description.HasMember("clips")) {
+        for (auto& clipDescription : description["clips"].GetArray()) {
+            size_t start = clipDescription["start"].GetUint();
+            size_t end = clipDescription["end"].GetUint();
+            if (start > end || end >= motion.frameCount) {
+                LOG_ERROR("Clip frames " << start << "-" << end << " are outside of "
+                    << motion.frameCount << " frames in " << path);
+                throw std::runtime_error("Clip frames out of range in " + path);
+            }
+            SkeletalAnimationClip& clip = group.clips.emplace_back(
+                BuildClip(skeleton, motion, zUp, start, end));
+            clip.name = clipDescription["name"].GetString();
+            clip.loop = !clipDescription.HasMember("loop") || clipDescription["loop"].GetBool();
+        }
+    }
+    else {
+        SkeletalAnimationClip& clip = group.clips.emplace_back(
+            BuildClip(skeleton, motion, zUp, 0, motion.frameCount - 1));
+        clip.name = std::filesystem::path(path).stem().string();
+    }
+
+    // Clips without a next one hold their last frame
+    for (size_t i = 0; i < group.clips.size(); i++) {
+        SkeletalAnimationTransition& transition = group.transitions.emplace_back();
+        transition.transitionTo = i;
+        transition.transitionTime = 0;
+        if (!description.HasMember("clips")) continue;
+        auto& clipDescription = description["clips"][i];
+        if (clipDescription.HasMember("next")) {
+            transition.transitionTo = group.FindClip(clipDescription["next"].GetString());
+            if (transition.transitionTo == group.clips.size()) {
+                LOG_ERROR("Clip " << group.clips[i].name << " goes to unknown clip "
+                    << clipDescription["next"].GetString());
+                throw std::runtime_error("Unknown next clip in " + path);
+            }
+        }
+        if (clipDescription.HasMember("transitionTime")) {
+            transition.transitionTime = clipDescription["transitionTime"].GetUint();
+        }
+    }
+
+    if (description.HasMember("models")) {
+        for (auto& model : description["models"].GetArray()) {
+            models.push_back(model.GetString());
+        }
+    }
+}
+
+static float DistanceToSegment(const Vector3& point, const Vector3& a, const Vector3& b) {
+    Vector3 ab = b - a;
+    float lengthSquared = glm::dot(ab, ab);
+    float t = lengthSquared > 0 ? glm::clamp(glm::dot(point - a, ab) / lengthSquared, 0.0f, 1.0f) : 0;
+    return glm::distance(point, a + ab * t);
+}
+
+void ComputeSkinWeights(const Skeleton& skeleton, Mesh& mesh) {
+    size_t boneCount = skeleton.GetBoneCount();
+    size_t vertexCount = mesh.vertices.size();
+    std::vector<float> distances(vertexCount * boneCount);
+    std::vector<float> totals(boneCount, 0.0f);
+    for (size_t v = 0; v < vertexCount; v++) {
+        for (size_t bone = 0; bone < boneCount; bone++) {
+            float distance = DistanceToSegment(mesh.vertices[v].position,
+                skeleton.jointPositions[bone], skeleton.tipPositions[bone]);
+            distances[v * boneCount + bone] = distance;
+            totals[bone] += distance;
+        }
+    }
+
+    // The bone the mesh as a whole is closest to. Meshes are usually one
+    //   body part, so it only bends along that bone's limb: up and down the
+    //   chain until it branches. A torso doesn't follow the arms next to it.
+    int closest = -1;
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        if (!skeleton.rotates[bone]) continue;
+        if (closest < 0 || totals[bone] < totals[closest]) closest = bone;
+    }
+    if (closest < 0) {
+        LOG_ERROR("Skeleton has no bones to skin " << mesh.name << " to");
+        throw std::runtime_error("Skeleton has no bones to skin to");
+    }
+    std::vector<int> childCount(boneCount, 0);
+    std::vector<int> lastChild(boneCount, -1);
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        if (skeleton.parents[bone] >= 0) {
+            childCount[skeleton.parents[bone]]++;
+            lastChild[skeleton.parents[bone]] = bone;
+        }
+    }
+    std::vector<bool> isInLimb(boneCount, false);
+    isInLimb[closest] = true;
+    for (int bone = closest; skeleton.parents[bone] >= 0;) {
+        int parent = skeleton.parents[bone];
+        if (childCount[parent] != 1 || !skeleton.rotates[parent]) break;
+        isInLimb[parent] = true;
+        bone = parent;
+    }
+    for (int bone = closest; childCount[bone] == 1;) {
+        bone = lastChild[bone];
+        if (!skeleton.rotates[bone]) break;
+        isInLimb[bone] = true;
+    }
+
+    // Up to 4 of the limb's bones by inverse distance, the closest dominates
+    mesh.skin.resize(vertexCount);
+    std::vector<std::pair<float, uint8_t>> weights;
+    for (size_t v = 0; v < vertexCount; v++) {
+        weights.clear();
+        for (size_t bone = 0; bone < boneCount; bone++) {
+            if (!isInLimb[bone]) continue;
+            float distance = distances[v * boneCount + bone] + 0.01f;
+            weights.emplace_back(1.0f / (distance * distance * distance * distance), bone);
+        }
+        std::sort(weights.begin(), weights.end(), std::greater<>());
+        weights.resize(std::min<size_t>(weights.size(), 4));
+
+        float total = 0;
+        for (auto& weight : weights) total += weight.first;
+        VertexSkin& skin = mesh.skin[v];
+        int remaining = 255;
+        for (size_t i = 0; i < 4; i++) {
+            skin.bones[i] = i < weights.size() ? weights[i].second : 0;
+            skin.weights[i] = i < weights.size() ? (uint8_t) (255 * weights[i].first / total) : 0;
+            remaining -= skin.weights[i];
+        }
+        // Rounding goes to the closest bone, the weights sum to exactly one
+        skin.weights[0] += remaining;
+    }
+}
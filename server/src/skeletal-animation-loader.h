@@ -0,0 +1,29 @@
+#pragma once
+
+#include "skeletal-animation.h"
+#include "mesh.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+// Animation sets are described by a json file in data/animations
+//   {
+//     "skeleton": "Player.bvh",
+//     "zUp": true,
+//     "models": [ "NewPlayer2.obj" ],
+//     "clips": [
+//       { "name": "Idle", "start": 0, "end": 249, "loop": true },
+//       { "name": "Wave", "start": 250, "end": 300, "loop": false,
+//         "next": "Idle", "transitionTime": 200 }
+//     ]
+//   }
+//   The BVH gives the skeleton, the clips are frame ranges of its motion
+//   (all of it as one looping clip when there are none). The listed models
+//   are skinned to the skeleton when they load.
+void LoadSkeletalAnimationGroup(const std::string& path, SkeletalAnimationGroup& group,
+    std::vector<std::string>& models);
+
+// Weights each vertex to the bones of the limb the mesh is closest to in the
+//   bind pose, OBJ files carry no weights of their own
+void ComputeSkinWeights(const Skeleton& skeleton, Mesh& mesh);
@@ -1,22 +1,209 @@
 #include "skeletal-animation.h"
+#include "simd.h"
 
-void SkeletalAnimationState::TickState(Time dt) {
+void SkeletonPose::Resize(const Skeleton& skeleton) {
+    boneCount = skeleton.GetBoneCount();
+    paddedBoneCount = skeleton.GetPaddedBoneCount();
+    for (auto& component : translations) {
+        component.assign(paddedBoneCount, 0.0f);
+    }
+    for (auto& component : rotations) {
+        component.assign(paddedBoneCount, 0.0f);
+    }
+    // Padding lanes stay identity so normalizing them is harmless
+    rotations[3].assign(paddedBoneCount, 1.0f);
+    modelMatrices.resize(boneCount);
+    skinningMatrices.resize(boneCount);
+}
+
+// out = a + (b - a) * t for count floats of each component
+static void LerpTranslations(const float* const a[3], const float* const b[3], float t,
+        float* const out[3], size_t count) {
+    float4 t4 = Splat4(t);
+    for (size_t i = 0; i < count; i += 4) {
+        for (int c = 0; c < 3; c++) {
+            float4 from = Load4(a[c] + i);
+            Store4(out[c] + i, from + (Load4(b[c] + i) - from) * t4);
+        }
+    }
+}
+
+// Normalized lerp along the shorter arc, out may be a
+static void NlerpRotations(const float* const a[4], const float* const b[4], float t,
+        float* const out[4], size_t count) {
+    float4 t4 = Splat4(t);
+    for (size_t i = 0; i < count; i += 4) {
+        float4 ax = Load4(a[0] + i), ay = Load4(a[1] + i), az = Load4(a[2] + i), aw = Load4(a[3] + i);
+        float4 bx = Load4(b[0] + i), by = Load4(b[1] + i), bz = Load4(b[2] + i), bw = Load4(b[3] + i);
+
+        int4 opposite = (ax * bx + ay * by + az * bz + aw * bw) < Splat4(0.0f);
+        bx = NegateWhere4(bx, opposite);
+        by = NegateWhere4(by, opposite);
+        bz = NegateWhere4(bz, opposite);
+        bw = NegateWhere4(bw, opposite);
+
+        float4 x = ax + (bx - ax) * t4;
+        float4 y = ay + (by - ay) * t4;
+        float4 z = az + (bz - az) * t4;
+        float4 w = aw + (bw - aw) * t4;
+        float4 scale = InverseSqrt4(x * x + y * y + z * z + w * w);
+        Store4(out[0] + i, x * scale);
+        Store4(out[1] + i, y * scale);
+        Store4(out[2] + i, z * scale);
+        Store4(out[3] + i, w * scale);
+    }
+}
+
+void SampleClip(const SkeletalAnimationClip& clip, float time, SkeletonPose& pose) {
+    size_t padded = pose.paddedBoneCount;
+
+    // Frames either side of time and how far between them it is
+    float frame = clip.frameTime > 0 ? time / clip.frameTime : 0;
+    float lastFrame = clip.frameCount - 1;
+    if (clip.loop && lastFrame > 0) {
+        frame = std::fmod(frame, lastFrame);
+        if (frame < 0) frame += lastFrame;
+    }
+    frame = glm::clamp(frame, 0.0f, lastFrame);
+    size_t frameA = (size_t) frame;
+    size_t frameB = std::min(frameA + 1, clip.frameCount - 1);
+    float t = frame - frameA;
+
+    float* translationsOut[3] = {
+        pose.translations[0].data(), pose.translations[1].data(), pose.translations[2].data() };
+    size_t translationA = clip.translationFrames == 1 ? 0 : frameA * padded;
+    size_t translationB = clip.translationFrames == 1 ? 0 : frameB * padded;
+    const float* translationsA[3];
+    const float* translationsB[3];
+    for (int c = 0; c < 3; c++) {
+        translationsA[c] = clip.translations[c].data() + translationA;
+        translationsB[c] = clip.translations[c].data() + translationB;
+    }
+    LerpTranslations(translationsA, translationsB, t, translationsOut, padded);
+
+    float* rotationsOut[4] = { pose.rotations[0].data(), pose.rotations[1].data(),
+        pose.rotations[2].data(), pose.rotations[3].data() };
+    size_t rotationA = clip.rotationFrames == 1 ? 0 : frameA * padded;
+    size_t rotationB = clip.rotationFrames == 1 ? 0 : frameB * padded;
+    const float* rotationsA[4];
+    const float* rotationsB[4];
+    for (int c = 0; c < 4; c++) {
+        rotationsA[c] = clip.rotations[c].data() + rotationA;
+        rotationsB[c] = clip.rotations[c].data() + rotationB;
+    }
+    NlerpRotations(rotationsA, rotationsB, t, rotationsOut, padded);
+}
+
+void BlendPoses(SkeletonPose& a, const SkeletonPose& b, float weight) {
+    float* translationsA[3] = {
+        a.translations[0].data(), a.translations[1].data(), a.translations[2].data() };
+    const float* translationsB[3] = {
+        b.translations[0].data(), b.translations[1].data(), b.translations[2].data() };
+    LerpTranslations(translationsA, translationsB, weight, translationsA, a.paddedBoneCount);
+
+    float* rotationsA[4] = {
+        a.rotations[0].data(), a.rotations[1].data(), a.rotations[2].data(), a.rotations[3].data() };
+    const float* rotationsB[4] = {
+        b.rotations[0].data(), b.rotations[1].data(), b.rotations[2].data(), b.rotations[3].data() };
+    NlerpRotations(rotationsA, rotationsB, weight, rotationsA, a.paddedBoneCount);
+}
+
+// out = a * b, out may alias either
+static void MultiplyMatrices(const Matrix4& a, const Matrix4& b, Matrix4& out) {
+    float4 a0 = Load4(&a[0][0]), a1 = Load4(&a[1][0]), a2 = Load4(&a[2][0]), a3 = Load4(&a[3][0]);
+    float4 columns[4];
+    for (int j = 0; j < 4; j++) {
+        columns[j] = a0 * b[j][0] + a1 * b[j][1] + a2 * b[j][2] + a3 * b[j][3];
+    }
+    for (int j = 0; j < 4; j++) {
+        Store4(&out[j][0], columns[j]);
+    }
+}
+
+void ComputeSkinningMatrices(const Skeleton& skeleton, SkeletonPose& pose) {
+    // Local matrices 4 bones at a time, written over the model matrices
+    float4 one = Splat4(1.0f), two = Splat4(2.0f);
+    for (size_t i = 0; i < pose.paddedBoneCount; i += 4) {
+        float4 x = Load4(&pose.rotations[0][i]), y = Load4(&pose.rotations[1][i]);
+        float4 z = Load4(&pose.rotations[2][i]), w = Load4(&pose.rotations[3][i]);
+        float4 xx = x * x, yy = y * y, zz = z * z;
+        float4 xy = x * y, xz = x * z, yz = y * z;
+        float4 wx = w * x, wy = w * y, wz = w * z;
+
+        float4 m00 = one - two * (yy + zz), m01 = two * (xy + wz), m02 = two * (xz - wy);
+        float4 m10 = two * (xy - wz), m11 = one - two * (xx + zz), m12 = two * (yz + wx);
+        float4 m20 = two * (xz + wy), m21 = two * (yz - wx), m22 = one - two * (xx + yy);
+        float4 tx = Load4(&pose.translations[0][i]);
+        float4 ty = Load4(&pose.translations[1][i]);
+        float4 tz = Load4(&pose.translations[2][i]);
+
+        for (size_t lane = 0; lane < 4 && i + lane < pose.boneCount; lane++) {
+            Matrix4& local = pose.modelMatrices[i + lane];
+            local[0] = Vector4(m00[lane], m01[lane], m02[lane], 0);
+            local[1] = Vector4(m10[lane], m11[lane], m12[lane], 0);
+            local[2] = Vector4(m20[lane], m21[lane], m22[lane], 0);
+            local[3] = Vector4(tx[lane], ty[lane], tz[lane], 1);
+        }
+    }
+
+    // Parents come first, so theirs are already in model space
+    for (size_t i = 0; i < pose.boneCount; i++) {
+        int parent = skeleton.parents[i];
+        if (parent >= 0) {
+            MultiplyMatrices(pose.modelMatrices[parent], pose.modelMatrices[i], pose.modelMatrices[i]);
+        }
+        MultiplyMatrices(pose.modelMatrices[i], skeleton.inverseBindMatrices[i], pose.skinningMatrices[i]);
+    }
+}
+
+void SkeletalAnimationState::Play(size_t newClip, Time fade) {
+    if (!group || newClip >= group->clips.size() || newClip == clip) return;
+    previousClip = clip;
+    previousClipTime = clipTime;
+    clip = newClip;
+    clipTime = 0;
+    fadeTime = 0;
+    fadeDuration = fade / 1000.0f;
+}
+
+void SkeletalAnimationState::TickState(Time deltaTime) {
+    if (!group) return;
+    float dt = deltaTime / 1000.0f;
     clipTime += dt;
-    // Next-keyframe
-    auto nextKeyframe = group.clips[clip].keyFrames[keyFrame + 1];
-    if (clipTime < nextKeyframe.time) {
-        return;
+    if (fadeDuration > 0) {
+        previousClipTime += dt;
+        fadeTime += dt;
+        if (fadeTime >= fadeDuration) {
+            fadeDuration = 0;
+        }
     }
-    keyFrame += 1;
-    if (keyFrame < group.clips[clip].keyFrames.size() - 1) {
+
+    const SkeletalAnimationClip& current = group->clips[clip];
+    float duration = current.GetDuration();
+    if (current.loop) {
+        // Keeps the float precise on long running clips
+        if (duration > 0) clipTime = std::fmod(clipTime, duration);
         return;
     }
-    if (group.clips[clip].loop) {
-        keyFrame = 0;
-        return;
+    if (clipTime >= duration) {
+        const SkeletalAnimationTransition& transition = group->transitions[clip];
+        Play(transition.transitionTo, transition.transitionTime);
     }
+}
 
-    auto transition = group.transitions[clip];
-    // TODO(felix): implement transition time
-    clip = transition.transitionTo;
+void SkeletalAnimationState::Evaluate(SkeletonPose& pose, SkeletonPose& scratch) const {
+    const Skeleton& skeleton = group->skeleton;
+    if (pose.boneCount != skeleton.GetBoneCount()) {
+        pose.Resize(skeleton);
+    }
+    SampleClip(group->clips[clip], clipTime, pose);
+    if (fadeDuration > 0) {
+        if (scratch.boneCount != skeleton.GetBoneCount()) {
+            scratch.Resize(skeleton);
+        }
+        // The old clip fades out as the new one comes in
+        SampleClip(group->clips[previousClip], previousClipTime, scratch);
+        BlendPoses(pose, scratch, 1.0f - fadeTime / fadeDuration);
+    }
+    ComputeSkinningMatrices(skeleton, pose);
 }
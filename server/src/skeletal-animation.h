@@ -4,21 +4,25 @@
 #include "timer.h"
 #include "replicable.h"
 
-struct SkeletalAnimationKeyFrame {
-    Vector3 position;
-    Quaternion rotation;
+#include <string>
 
-    // Maybe needs interpolation parameters
-};
+// Keys are sampled at a fixed rate and stored frame major, split by
+//   component: translations[0][frame * paddedBones + bone] is an x. A
+//   channel that doesn't change over the clip keeps a single frame.
+struct SkeletalAnimationClip {
+    std::string name;
+    size_t frameCount = 0;
+    // Seconds between frames
+    float frameTime = 0;
+    bool loop = true;
 
-struct SkeletalAnimationKeyFrameWithTime {
-    Time time;
-    SkeletalAnimationKeyFrame keyFrame;
-};
+    // 1 or frameCount
+    size_t translationFrames = 0;
+    size_t rotationFrames = 0;
+    std::vector<float> translations[3];
+    std::vector<float> rotations[4];
 
-struct SkeletalAnimationClip {
-    std::vector<SkeletalAnimationKeyFrameWithTime> keyFrames;
-    bool loop;
+    float GetDuration() const { return frameTime * (frameCount - 1); }
 };
 
 struct SkeletalAnimationTransition {
@@ -27,17 +31,58 @@ struct SkeletalAnimationTransition {
 };
 
 struct SkeletalAnimationGroup {
+    Skeleton skeleton;
     std::vector<SkeletalAnimationClip> clips;
+    // One per clip, followed when a clip that doesn't loop finishes
     std::vector<SkeletalAnimationTransition> transitions;
+
+    // clips.size() if there is no such clip
+    size_t FindClip(const std::string& name) const {
+        for (size_t i = 0; i < clips.size(); i++) {
+            if (clips[i].name == name) return i;
+        }
+        return clips.size();
+    }
+};
+
+// Local bone transforms in the same split layout as the clips, then the
+//   matrices built from them
+struct SkeletonPose {
+    size_t boneCount = 0;
+    size_t paddedBoneCount = 0;
+    std::vector<float> translations[3];
+    std::vector<float> rotations[4];
+
+    std::vector<Matrix4> modelMatrices;
+    // Model space matrix times the inverse bind matrix, what the shaders use
+    std::vector<Matrix4> skinningMatrices;
+
+    void Resize(const Skeleton& skeleton);
 };
 
+// Interpolates between the two frames around time, in seconds
+void SampleClip(const SkeletalAnimationClip& clip, float time, SkeletonPose& pose);
+// Blends b over a by weight, the result goes into a
+void BlendPoses(SkeletonPose& a, const SkeletonPose& b, float weight);
+// Fills modelMatrices and skinningMatrices from the local transforms
+void ComputeSkinningMatrices(const Skeleton& skeleton, SkeletonPose& pose);
+
 struct SkeletalAnimationState {
-    SkeletalAnimationGroup& group;
-    size_t clip;
+    const SkeletalAnimationGroup* group = nullptr;
+    size_t clip = 0;
+    // Seconds into the clip
+    float clipTime = 0;
 
-    // This is the *previous* keyFrame we're interpolating from
-    size_t keyFrame;
-    Time clipTime;
+    // The clip being faded out, while fadeDuration is non zero
+    size_t previousClip = 0;
+    float previousClipTime = 0;
+    float fadeTime = 0;
+    float fadeDuration = 0;
 
+    // Crossfades from the current clip over fade
+    void Play(size_t newClip, Time fade);
     void TickState(Time deltaTime);
-};
\ No newline at end of file
+
+    // Samples and blends the clips into pose, scratch holds the faded clip
+    void Evaluate(SkeletonPose& pose, SkeletonPose& scratch) const;
+};
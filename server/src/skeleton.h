@@ -1,15 +1,41 @@
 #pragma once
 
 #include "vector.h"
+#include <string>
 #include <vector>
 
-struct Bone {
-    size_t parent;
-    Vector3 position;
-    Quaternion rotation;
-    float length;
-};
+// A pose has to fit in the shaders' bone uniform block
+static const size_t MaxBones = 32;
 
+// Bones are stored parents first, so model space transforms can be built in
+//   a single pass over the arrays
 struct Skeleton {
-    std::vector<Bone> bones;
+    std::vector<std::string> names;
+    // -1 for a root
+    std::vector<int> parents;
+
+    // Rest pose relative to the parent, the bind pose the mesh was modelled in
+    std::vector<Vector3> bindTranslations;
+    std::vector<Quaternion> bindRotations;
+
+    // Takes a model space vertex into the space of the bone
+    std::vector<Matrix4> inverseBindMatrices;
+
+    // Model space start and end of each bone in the bind pose, for skin weights
+    std::vector<Vector3> jointPositions;
+    std::vector<Vector3> tipPositions;
+    // False for bones without rotation channels, nothing is skinned to them
+    std::vector<bool> rotates;
+
+    size_t GetBoneCount() const { return parents.size(); }
+    // Pose arrays are padded so they can be processed 4 bones at a time
+    size_t GetPaddedBoneCount() const { return (parents.size() + 3) & ~(size_t) 3; }
+
+    // -1 if there is no such bone
+    int FindBone(const std::string& name) const {
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == name) return i;
+        }
+        return -1;
+    }
 };
@@ -6,7 +6,8 @@
 
 class SpriteObject : public Object {
     REPLICATED(std::string, texture, "tex");
-    Model customQuad;
+    // Shared, the sprite's texture goes in through a material override
+    Model* quad = nullptr;
 
     #ifdef BUILD_CLIENT
         bool materialSetup = false;
@@ -17,11 +18,8 @@ public:
 
     SpriteObject(Game& game) : SpriteObject(game, "") { }
     SpriteObject(Game& game, const std::string& texture) : Object(game), texture(texture) {
-        // Make a Copy
-        if (auto model = game.GetAssetManager().GetModel("Quad.obj")) {
-            customQuad = Model(*model);
-        }
-        else {
+        quad = game.GetAssetManager().GetModel("Quad.obj");
+        if (!quad) {
             LOG_ERROR("Could not find quad model!");
             throw std::runtime_error("Could not find quad model!");
         }
@@ -39,18 +37,23 @@ public:
         Object::ProcessReplication(obj);
     #ifdef BUILD_CLIENT
         // Override Model
-        model = &customQuad;
+        model = quad;
         if (!materialSetup) {
             materialSetup = true;
             material = new DefaultMaterial;
-            customQuad.meshes[0]->material = material;
 
-            // Custom Model
+            // Custom Material
             material->illum = -1;
             material->map_Kd = game.GetAssetManager().LoadTexture(texture, Texture::Format::RGBA);
         }
     #endif
     }
+
+    #ifdef BUILD_CLIENT
+        Material* GetMaterialOverride() override {
+            return material;
+        }
+    #endif
 };
 
 CLASS_REGISTER(SpriteObject);
\ No newline at end of file
@@ -1,7 +1,15 @@
 #include "tests.h"
 #include "collision.h"
+#include "model.h"
 #include "object.h"
 #include "logging.h"
+#include "static-mesh.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <unordered_map>
 #include <vector>
 
 // For running tests
@@ -77,14 +85,595 @@ void Tests::RunStaticMeshCollisionTest() {
 
 }
 
+// A box asleep on a static support has to fall once the support is moved
+//   out from under it, even though the support itself never slept
+bool Tests::RunMovedSupportTest() {
+    GameObject* support = new GameObject(game, Vector3(0, 0, 0));
+    support->AddCollider(new OBBCollider(support, Vector3(-2, -0.5, -2), Vector3(4, 1, 4)));
+    support->SetIsStatic(true);
+    GameObject* box = new GameObject(game, Vector3(0, 1.5, 0));
+    box->AddCollider(new OBBCollider(box, Vector3(-0.5), Vector3(1)));
+    game.AddObject(support);
+    game.AddObject(box);
+
+    // Both are removed again whatever fails, so they can't touch or wake
+    //   anything in the tests after this one
+    Time time = 0;
+    auto finish = [&](bool passed) {
+        game.DestroyObject(support->GetId());
+        game.DestroyObject(box->GetId());
+        game.Tick(time += TickInterval);
+        return passed;
+    };
+
+    for (int i = 0; i < 120 && !box->IsSleeping(); i++) {
+        game.Tick(time += TickInterval);
+    }
+    if (!box->IsSleeping()) {
+        LOG_ERROR("Moved Support: the box never went to sleep on the support");
+        return finish(false);
+    }
+    if (game.GetSleepingCount() != 1) {
+        LOG_ERROR("Moved Support: " << game.GetSleepingCount() << " sleepers with only the box asleep");
+        return finish(false);
+    }
+
+    support->SetPosition(Vector3(0, 0, 10));
+    if (box->IsSleeping()) {
+        LOG_ERROR("Moved Support: the box slept on after its support moved away");
+        return finish(false);
+    }
+    if (game.GetSleepingCount() != 0) {
+        LOG_ERROR("Moved Support: the woken box was left in the sleepers");
+        return finish(false);
+    }
+    float restingHeight = box->GetPosition().y;
+    for (int i = 0; i < 10; i++) {
+        game.Tick(time += TickInterval);
+    }
+    if (box->GetPosition().y >= restingHeight) {
+        LOG_ERROR("Moved Support: the box stayed at " << restingHeight << " with nothing under it");
+        return finish(false);
+    }
+    LOG_INFO("Moved Support: passed");
+    return finish(true);
+}
+
+// Something set straight into a sleeping box wakes it, though the box was
+//   nowhere near where it came from
+bool Tests::RunMovedIntoSleeperTest() {
+    GameObject* support = new GameObject(game, Vector3(0, 0, 0));
+    support->AddCollider(new OBBCollider(support, Vector3(-2, -0.5, -2), Vector3(4, 1, 4)));
+    support->SetIsStatic(true);
+    GameObject* box = new GameObject(game, Vector3(0, 1.5, 0));
+    box->AddCollider(new OBBCollider(box, Vector3(-0.5), Vector3(1)));
+    GameObject* wall = new GameObject(game, Vector3(0, 1.5, 50));
+    wall->AddCollider(new OBBCollider(wall, Vector3(-0.5), Vector3(1)));
+    wall->SetIsStatic(true);
+    game.AddObject(support);
+    game.AddObject(box);
+    game.AddObject(wall);
+
+    Time time = 0;
+    auto finish = [&](bool passed) {
+        game.DestroyObject(support->GetId());
+        game.DestroyObject(box->GetId());
+        game.DestroyObject(wall->GetId());
+        game.Tick(time += TickInterval);
+        return passed;
+    };
+
+    for (int i = 0; i < 120 && !box->IsSleeping(); i++) {
+        game.Tick(time += TickInterval);
+    }
+    if (!box->IsSleeping()) {
+        LOG_ERROR("Moved Into Sleeper: the box never went to sleep on the support");
+        return finish(false);
+    }
+    wall->SetPosition(Vector3(0.6, 1.5, 0));
+    if (box->IsSleeping()) {
+        LOG_ERROR("Moved Into Sleeper: the box slept on with the wall set into it");
+        return finish(false);
+    }
+    LOG_INFO("Moved Into Sleeper: passed");
+    return finish(true);
+}
+
+// Collision meshes are shared per model, but each scale bakes its own
+//   triangles
+bool Tests::RunCollisionMeshScaleTest() {
+    Model model;
+    Mesh* mesh = new Mesh;
+    mesh->vertices.emplace_back(1, 0, 1, 0, 1, 0);
+    mesh->vertices.emplace_back(1, 0, -1, 0, 1, 0);
+    mesh->vertices.emplace_back(-1, 0, -1, 0, 1, 0);
+    mesh->indices = { 2, 1, 0 };
+    model.meshes.push_back(mesh);
+
+    CollisionMesh* unit = GetCollisionMesh(&model, Vector3(1));
+    CollisionMesh* doubled = GetCollisionMesh(&model, Vector3(2));
+    if (unit == doubled) {
+        LOG_ERROR("Collision Mesh Scale: a scaled instance got the unscaled mesh");
+        return false;
+    }
+    if (doubled->bounds.ptMax.x != 2 * unit->bounds.ptMax.x) {
+        LOG_ERROR("Collision Mesh Scale: bounds " << doubled->bounds.ptMax.x
+            << " at scale 2 for " << unit->bounds.ptMax.x << " at scale 1");
+        return false;
+    }
+    if (GetCollisionMesh(&model, Vector3(1)) != unit) {
+        LOG_ERROR("Collision Mesh Scale: the same scale built a second mesh");
+        return false;
+    }
+    LOG_INFO("Collision Mesh Scale: passed");
+    return true;
+}
+
+static bool SameBVH(const BVHTree<BVHTriangle>* a, const BVHTree<BVHTriangle>* b) {
+    if (a->collider.ptMin != b->collider.ptMin || a->collider.ptMax != b->collider.ptMax ||
+            a->children.size() != b->children.size() || a->tris.size() != b->tris.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a->tris.size(); i++) {
+        if (a->tris[i]->a != b->tris[i]->a || a->tris[i]->b != b->tris[i]->b ||
+                a->tris[i]->c != b->tris[i]->c || a->tris[i]->norm != b->tris[i]->norm) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a->children.size(); i++) {
+        if (!SameBVH(a->children[i], b->children[i])) return false;
+    }
+    return true;
+}
+
+// A collision mesh read back from its binary form has the same tree, and a
+//   cut off one is refused
+bool Tests::RunCollisionMeshSerializeTest() {
+    // Enough triangles that the tree has more than a leaf
+    Model model;
+    Mesh* mesh = new Mesh;
+    for (int x = 0; x < 4; x++) {
+        for (int z = 0; z < 4; z++) {
+            for (int corner : { 0, 2, 1, 0, 3, 2 }) {
+                mesh->indices.push_back(mesh->vertices.size());
+                mesh->vertices.emplace_back(x + (corner == 1 || corner == 2), 0.5f * x,
+                    z + (corner >= 2), 0, 1, 0);
+            }
+        }
+    }
+    model.meshes.push_back(mesh);
+    CollisionMesh* original = GetCollisionMesh(&model, Vector3(1));
+
+    std::stringstream stream;
+    original->Serialize(stream);
+    std::string bytes = stream.str();
+    CollisionMesh* copy = CollisionMesh::Deserialize(stream);
+    if (!copy) {
+        LOG_ERROR("Collision Mesh Serialize: could not read back " << bytes.size() << " bytes");
+        return false;
+    }
+    bool same = copy->bounds.ptMin == original->bounds.ptMin &&
+        copy->bounds.ptMax == original->bounds.ptMax &&
+        copy->GetTriangleCount() == original->GetTriangleCount() &&
+        SameBVH(copy->bvhTree, original->bvhTree);
+    delete copy;
+    if (!same) {
+        LOG_ERROR("Collision Mesh Serialize: the mesh read back differs");
+        return false;
+    }
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() / 2));
+    CollisionMesh* partial = CollisionMesh::Deserialize(truncated);
+    if (partial) {
+        delete partial;
+        LOG_ERROR("Collision Mesh Serialize: half of the bytes were read as a mesh");
+        return false;
+    }
+    LOG_INFO("Collision Mesh Serialize: passed");
+    return true;
+}
+
+// A model loaded from a file reuses the mesh the last load cached beside it
+bool Tests::RunCollisionMeshCacheTest() {
+    namespace fs = std::filesystem;
+    std::string path = (fs::temp_directory_path() / "collision-mesh-cache-test.obj").string();
+    std::ofstream(path) << "# stands in for a model file\n";
+
+    Model built;
+    built.path = path;
+    Mesh* mesh = new Mesh;
+    mesh->vertices.emplace_back(1, 0, 1, 0, 1, 0);
+    mesh->vertices.emplace_back(1, 0, -1, 0, 1, 0);
+    mesh->vertices.emplace_back(-1, 0, -1, 0, 1, 0);
+    mesh->indices = { 2, 1, 0 };
+    built.meshes.push_back(mesh);
+    CollisionMesh* original = GetCollisionMesh(&built, Vector3(1));
+
+    // No meshes of its own, so anything it gets came from the cache
+    Model reloaded;
+    reloaded.path = path;
+    CollisionMesh* cached = GetCollisionMesh(&reloaded, Vector3(1));
+    bool same = cached->GetTriangleCount() == original->GetTriangleCount() &&
+        SameBVH(cached->bvhTree, original->bvhTree);
+
+    for (const auto& entry : fs::directory_iterator(fs::temp_directory_path())) {
+        if (entry.path().string().rfind(path, 0) == 0) {
+            fs::remove(entry.path());
+        }
+    }
+    if (!same) {
+        LOG_ERROR("Collision Mesh Cache: got " << cached->GetTriangleCount()
+            << " triangles back for " << original->GetTriangleCount());
+        return false;
+    }
+    LOG_INFO("Collision Mesh Cache: passed");
+    return true;
+}
+
+// Stops where it lands like an ArrowObject, without its assets
+class TestArrow : public GameObject {
+public:
+    TestArrow(Game& game, const Vector3& position) : GameObject(game, position) {
+        AddCollider(new OBBCollider(this, Vector3(-0.15), Vector3(0.3)));
+        airFriction = Vector3(1);
+        SetContinuousCollision(true);
+    }
+
+    virtual void OnCollide(CollisionResult& result) override {
+        if (result.collidedWith->IsStatic()) {
+            SetIsStatic(true);
+        }
+    }
+
+    virtual void Tick(Time time) override {
+        GameObject::Tick(time);
+        if (!IsStatic() && !IsZero(GetVelocity())) {
+            SetRotation(DirectionToQuaternion(GetVelocity()));
+        }
+    }
+};
+
+// Arrows swept into a static mesh floor from any angle and at any speed
+//   have to land on it, none may end up under it
+bool Tests::RunSweptArrowTest() {
+    // Cells 4 units wide with their corners at one of four heights, so there
+    //   are slopes, ridges and creases to land on
+    const int FloorExtent = 64;
+    auto floorPoint = [](int x, int z) {
+        return Vector3(x, ((x / 4 * 7 + z / 4 * 13) & 3) * 0.75f, z);
+    };
+    Model floorModel;
+    Mesh* floorMesh = new Mesh;
+    for (int x = -FloorExtent; x < FloorExtent; x += 4) {
+        for (int z = -FloorExtent; z < FloorExtent; z += 4) {
+            Vector3 corners[4] = { floorPoint(x, z), floorPoint(x + 4, z),
+                floorPoint(x + 4, z + 4), floorPoint(x, z + 4) };
+            int triangles[2][3] = { { 0, 2, 1 }, { 0, 3, 2 } };
+            for (auto& tri : triangles) {
+                Vector3 normal = glm::normalize(glm::cross(corners[tri[1]] - corners[tri[0]],
+                    corners[tri[2]] - corners[tri[0]]));
+                for (int corner : tri) {
+                    floorMesh->indices.push_back(floorMesh->vertices.size());
+                    floorMesh->vertices.emplace_back(corners[corner].x, corners[corner].y, corners[corner].z,
+                        normal.x, normal.y, normal.z);
+                }
+            }
+        }
+    }
+    floorModel.meshes.push_back(floorMesh);
+    // Away from what the other tests leave behind
+    Vector3 origin(200, 0, 0);
+    StaticMeshObject* floor = new StaticMeshObject(game);
+    floor->SetPosition(origin);
+    floor->SetModel(&floorModel);
+    GenerateStaticMeshCollidersFromModel(floor);
+    game.AddObject(floor);
+
+    // From straight down to shallow enough to skim the floor, started at
+    //   heights down to grazing its highest corners. Each is thrown alone
+    //   so none is knocked off course by another
+    size_t thrown = 0;
+    size_t fellThrough = 0;
+    size_t flying = 0;
+    Time time = game.GetGameTime();
+    for (float speed : { 30.f, 100.f, 300.f, 1000.f, 3000.f }) {
+        for (int i = 0; i < 400; i++) {
+            Vector3 start = origin + Vector3((i % 20 - 10) * 3, 2.45f + (i % 13) * 0.7f, (i / 20 - 10) * 3);
+            TestArrow* arrow = new TestArrow(game, start);
+            float angle = i * 0.7f;
+            float spread = (i % 11) * 0.5f;
+            Vector3 direction = glm::normalize(Vector3(glm::cos(angle) * spread, -1, glm::sin(angle) * spread));
+            arrow->SetVelocity(direction * speed);
+            arrow->SetRotation(DirectionToQuaternion(direction));
+            game.AddObject(arrow);
+            ObjectID id = arrow->GetId();
+            thrown++;
+
+            for (int tick = 0; tick < 120 && !arrow->IsStatic(); tick++) {
+                game.Tick(time += TickInterval);
+                // Gone if it fell to the kill plane
+                arrow = game.GetObject<TestArrow>(id);
+                if (!arrow) break;
+            }
+            if (!arrow || arrow->GetPosition().y < origin.y) {
+                fellThrough++;
+            }
+            else if (!arrow->IsStatic()) {
+                flying++;
+            }
+            if (arrow) {
+                game.DestroyObject(id);
+            }
+        }
+    }
+    game.DestroyObject(floor->GetId());
+    game.Tick(time += TickInterval);
+
+    if (fellThrough != 0 || flying != 0) {
+        LOG_ERROR("Swept Arrows: of " << thrown << ", " << fellThrough
+            << " fell through the floor and " << flying << " never landed");
+        return false;
+    }
+    LOG_INFO("Swept Arrows: passed");
+    return true;
+}
+
+// A client that drops a relationship delta has to ask for the full list,
+//   and end up with the same links as the server once it has it
+bool Tests::RunRelationshipResyncTest() {
+    // Another game stands in for the client. It brings its own script VM, the
+    //   tests' game gets its own back once it's gone
+    struct vm* vm = ScriptManager::vm;
+    Game* scriptGame = ScriptManager::game;
+    bool passed = true;
+    {
+        Game client;
+        RelationshipManager& serverLinks = game.GetRelationshipManager();
+        RelationshipManager& clientLinks = client.GetRelationshipManager();
+
+        // Both hand out the same ids from here on
+        ObjectID first = game.RequestId();
+        while (client.RequestId() < first) {}
+        const int Count = 32;
+        std::vector<ObjectID> ids;
+        for (int i = 0; i < Count; i++) {
+            GameObject* serverObject = new GameObject(game);
+            GameObject* clientObject = new GameObject(client);
+            serverObject->SetIsStatic(true);
+            game.AddObject(serverObject);
+            client.AddObject(clientObject);
+            ids.push_back(serverObject->GetId());
+        }
+
+        auto send = [&](bool delta) {
+            rapidjson::StringBuffer buffer;
+            JSONWriter writer(buffer);
+            serverLinks.SetSerializeDelta(delta);
+            writer.StartObject();
+            serverLinks.Serialize(writer);
+            writer.EndObject();
+            serverLinks.SetSerializeDelta(false);
+            return std::string(buffer.GetString());
+        };
+        auto receive = [&](const std::string& packet) {
+            JSONDocument document;
+            document.Parse(packet.c_str());
+            clientLinks.ProcessReplication(document);
+        };
+        // Links in a different shape every round, some of them undone
+        auto relink = [&](int round) {
+            for (int i = 1; i < Count; i++) {
+                int parent = ((i * 2654435761u + round * 40503u) >> 8) % i;
+                if ((i + round) % 5 == 0) {
+                    serverLinks.RemoveParent(ids[i]);
+                }
+                else {
+                    serverLinks.SetParent(ids[i], ids[parent]);
+                }
+            }
+        };
+
+        // Whatever the earlier tests left unsent, then the joining player's
+        //   full list
+        send(true);
+        receive(send(false));
+        relink(0);
+        receive(send(true));
+        // Dropped
+        relink(1);
+        send(true);
+        relink(2);
+        receive(send(true));
+        if (!clientLinks.TakeResyncRequest() || clientLinks.TakeResyncRequest()) {
+            LOG_ERROR("Relationship Resync: the missed delta didn't ask for one resync");
+            passed = false;
+        }
+        // The tick's delta goes to the other players, this client gets the
+        //   full list instead
+        relink(3);
+        send(true);
+        receive(send(false));
+        relink(4);
+        receive(send(true));
+
+        for (ObjectID id : ids) {
+            Object* serverParent = serverLinks.GetParent(id);
+            Object* clientParent = clientLinks.GetParent(id);
+            ObjectID serverParentId = serverParent ? serverParent->GetId() : 0;
+            ObjectID clientParentId = clientParent ? clientParent->GetId() : 0;
+            std::vector<ObjectID> serverChildren;
+            std::vector<ObjectID> clientChildren;
+            for (Object* child : serverLinks.GetChildren(id)) {
+                serverChildren.push_back(child->GetId());
+            }
+            for (Object* child : clientLinks.GetChildren(id)) {
+                clientChildren.push_back(child->GetId());
+            }
+            std::sort(serverChildren.begin(), serverChildren.end());
+            std::sort(clientChildren.begin(), clientChildren.end());
+            if (serverParentId != clientParentId || serverChildren != clientChildren) {
+                LOG_ERROR("Relationship Resync: object " << id << " has parent " << clientParentId
+                    << " and " << clientChildren.size() << " children on the client, "
+                    << serverParentId << " and " << serverChildren.size() << " on the server");
+                passed = false;
+            }
+        }
+
+        for (ObjectID id : ids) {
+            game.DestroyObject(id);
+        }
+        game.Tick(game.GetGameTime() + TickInterval);
+    }
+    ScriptManager::vm = vm;
+    ScriptManager::game = scriptGame;
+
+    if (passed) {
+        LOG_INFO("Relationship Resync: passed");
+    }
+    return passed;
+}
+
+// Writes down when it ticks instead of moving
+class TickOrderObject : public GameObject {
+    std::vector<ObjectID>& ticked;
+public:
+    TickOrderObject(Game& game, std::vector<ObjectID>& ticked) : GameObject(game), ticked(ticked) {}
+
+    virtual void Tick(Time time) override {
+        ticked.push_back(GetId());
+    }
+};
+
+// Objects added, reparented, detached and destroyed at random over many
+//   ticks still have to tick once each, parents before their children
+bool Tests::RunHierarchyOrderTest() {
+    RelationshipManager& links = game.GetRelationshipManager();
+    std::mt19937 random(2024);
+    std::vector<ObjectID> ticked;
+    std::vector<ObjectID> live;
+    // Destroyed during the changes, they still tick once
+    std::vector<ObjectID> dying;
+    std::unordered_map<ObjectID, ObjectID> parents;
+    auto isAncestor = [&](ObjectID ancestor, ObjectID id) {
+        for (auto it = parents.find(id); it != parents.end(); it = parents.find(it->second)) {
+            if (it->second == ancestor) return true;
+        }
+        return false;
+    };
+
+    bool passed = true;
+    Time time = game.GetGameTime();
+    for (int tick = 0; tick < 300 && passed; tick++) {
+        dying.clear();
+        for (int change = 0; change < 8; change++) {
+            uint32_t action = random() % 10;
+            if (live.size() < 8 || action < 3) {
+                TickOrderObject* object = new TickOrderObject(game, ticked);
+                object->SetIsStatic(true);
+                game.AddObject(object);
+                live.push_back(object->GetId());
+                continue;
+            }
+            size_t index = random() % live.size();
+            ObjectID id = live[index];
+            if (action < 7) {
+                ObjectID parent = live[random() % live.size()];
+                if (parent == id || isAncestor(id, parent)) continue;
+                links.SetParent(id, parent);
+                parents[id] = parent;
+            }
+            else if (action < 8) {
+                links.RemoveParent(id);
+                parents.erase(id);
+            }
+            else {
+                game.DestroyObject(id);
+                live[index] = live.back();
+                live.pop_back();
+                dying.push_back(id);
+                parents.erase(id);
+                // Its children become roots
+                for (auto it = parents.begin(); it != parents.end();) {
+                    it = it->second == id ? parents.erase(it) : std::next(it);
+                }
+            }
+        }
+
+        ticked.clear();
+        game.Tick(time += TickInterval);
+
+        std::unordered_map<ObjectID, size_t> position;
+        for (size_t i = 0; i < ticked.size(); i++) {
+            if (!position.emplace(ticked[i], i).second) {
+                LOG_ERROR("Hierarchy Order: object " << ticked[i] << " ticked twice on tick " << tick);
+                passed = false;
+            }
+        }
+        if (position.size() != live.size() + dying.size()) {
+            LOG_ERROR("Hierarchy Order: " << position.size() << " ticked on tick " << tick
+                << " with " << live.size() + dying.size() << " in the game");
+            passed = false;
+        }
+        for (ObjectID id : live) {
+            auto child = position.find(id);
+            if (child == position.end()) {
+                LOG_ERROR("Hierarchy Order: object " << id << " didn't tick on tick " << tick);
+                passed = false;
+                continue;
+            }
+            auto link = parents.find(id);
+            if (link != parents.end() && position[link->second] > child->second) {
+                LOG_ERROR("Hierarchy Order: object " << id << " ticked before its parent "
+                    << link->second << " on tick " << tick);
+                passed = false;
+            }
+
+            std::vector<ObjectID> children;
+            for (Object* object : links.GetChildren(id)) {
+                children.push_back(object->GetId());
+            }
+            std::vector<ObjectID> expected;
+            for (auto& pair : parents) {
+                if (pair.second == id) expected.push_back(pair.first);
+            }
+            std::sort(children.begin(), children.end());
+            std::sort(expected.begin(), expected.end());
+            if (children != expected) {
+                LOG_ERROR("Hierarchy Order: object " << id << " has " << children.size()
+                    << " children instead of " << expected.size() << " on tick " << tick);
+                passed = false;
+            }
+        }
+    }
+
+    for (ObjectID id : live) {
+        game.DestroyObject(id);
+    }
+    game.Tick(time += TickInterval);
+
+    if (passed) {
+        LOG_INFO("Hierarchy Order: passed");
+    }
+    return passed;
+}
+
 int Tests::Run() {
     LOG_INFO("Testing Begin");
+    int failures = 0;
     // RunRotatedAABBCollisionTest();
     // RunStaticMeshCollisionTest();
+    failures += !RunMovedSupportTest();
+    failures += !RunMovedIntoSleeperTest();
+    failures += !RunCollisionMeshScaleTest();
+    failures += !RunCollisionMeshSerializeTest();
+    failures += !RunCollisionMeshCacheTest();
+    failures += !RunSweptArrowTest();
+    failures += !RunRelationshipResyncTest();
+    failures += !RunHierarchyOrderTest();
     Matrix4 matrix;
     matrix = glm::rotate(matrix, glm::radians(15.0f), Vector::Up);
     LOG_DEBUG(glm::quat_cast(matrix));
 
-    LOG_INFO("Tests Complete");
-    return 0;
+    LOG_INFO("Tests Complete, " << failures << " failed");
+    return failures;
 }
\ No newline at end of file
@@ -4,6 +4,14 @@
 class Tests {
     void RunRotatedAABBCollisionTest();
     void RunStaticMeshCollisionTest();
+    bool RunMovedSupportTest();
+    bool RunMovedIntoSleeperTest();
+    bool RunCollisionMeshScaleTest();
+    bool RunCollisionMeshSerializeTest();
+    bool RunCollisionMeshCacheTest();
+    bool RunSweptArrowTest();
+    bool RunRelationshipResyncTest();
+    bool RunHierarchyOrderTest();
     Game& game;
 public:
     Tests(Game& game) : game(game) {}
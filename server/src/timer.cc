@@ -30,9 +30,10 @@ void Timer::Tick() {
     for (auto it = schedule.begin(); it != schedule.end(); it++) {
         auto& event = *it;
         if (current > event->nextScheduled) {
+            Time start = NowMicro();
             event->function(event->nextScheduled);
             event->intervalTime.InsertValue(current - event->lastRealtimeTick);
-            event->callRuntime.InsertValue(Now() - current);
+            event->callRuntime.InsertValue(NowMicro() - start);
 
             event->lastRealtimeTick = current;
 
@@ -18,6 +18,7 @@ struct ScheduledCall {
     Time lastRealtimeTick;
     bool shouldRepeat;
 
+    // Microseconds, a tick usually takes well under a millisecond
     PerformanceBuffer<Time> callRuntime { 100 };
     PerformanceBuffer<Time> intervalTime { 100 };
 
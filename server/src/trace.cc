@@ -0,0 +1,173 @@
+#include "trace.h"
+#include "logging.h"
+
+#include "json/rapidjson/writer.h"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Trace {
+
+// Spans kept per thread, a busy server tick records a few thousand
+static const uint64_t RingCapacity = 1 << 16;
+
+// Written only by its thread, fields are atomic so a snapshot can read them
+//   while the thread keeps recording
+struct ThreadBuffer {
+    struct Slot {
+        std::atomic<const char*> name { nullptr };
+        std::atomic<uint64_t> start { 0 };
+        std::atomic<uint64_t> end { 0 };
+    };
+    std::unique_ptr<Slot[]> slots { new Slot[RingCapacity] };
+    std::atomic<uint64_t> written { 0 };
+    uint32_t index = 0;
+    std::string name;
+};
+
+// Buffers outlive their threads so a trace still shows what they did
+static std::mutex registryMutex;
+static std::vector<ThreadBuffer*> buffers;
+static std::unordered_set<std::string> internedNames;
+
+static ThreadBuffer& GetThreadBuffer() {
+    thread_local ThreadBuffer* buffer = [] {
+        std::scoped_lock<std::mutex> lock(registryMutex);
+        ThreadBuffer* created = new ThreadBuffer();
+        created->index = buffers.size();
+        created->name = "Thread " + std::to_string(created->index);
+        buffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+void Record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& buffer = GetThreadBuffer();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    ThreadBuffer::Slot& slot = buffer.slots[index % RingCapacity];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+const char* Intern(const std::string& name) {
+    // Most lookups hit the thread's own cache without locking
+    thread_local std::unordered_map<std::string, const char*> cache;
+    auto found = cache.find(name);
+    if (found != cache.end()) {
+        return found->second;
+    }
+    std::scoped_lock<std::mutex> lock(registryMutex);
+    const char* interned = internedNames.insert(name).first->c_str();
+    cache[name] = interned;
+    return interned;
+}
+
+void SetThreadName(const std::string& name) {
+    ThreadBuffer& buffer = GetThreadBuffer();
+    std::scoped_lock<std::mutex> lock(registryMutex);
+    buffer.name = name;
+}
+
+Snapshot TakeSnapshot() {
+    std::scoped_lock<std::mutex> lock(registryMutex);
+    Snapshot snapshot;
+    for (ThreadBuffer* buffer : buffers) {
+        snapshot.threadNames.push_back(buffer->name);
+
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t first = written > RingCapacity ? written - RingCapacity : 0;
+        size_t copiedFrom = snapshot.events.size();
+        for (uint64_t i = first; i < written; i++) {
+            ThreadBuffer::Slot& slot = buffer->slots[i % RingCapacity];
+            snapshot.events.push_back(Event{
+                slot.name.load(std::memory_order_relaxed),
+                slot.start.load(std::memory_order_relaxed),
+                slot.end.load(std::memory_order_relaxed),
+                buffer->index
+            });
+        }
+        // The thread may have lapped the oldest slots while they were read
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t writtenAfter = buffer->written.load(std::memory_order_relaxed);
+        uint64_t overwritten = writtenAfter > RingCapacity ? writtenAfter - RingCapacity : 0;
+        if (overwritten > first) {
+            size_t drop = std::min<uint64_t>(overwritten - first, written - first);
+            snapshot.events.erase(snapshot.events.begin() + copiedFrom,
+                snapshot.events.begin() + copiedFrom + drop);
+        }
+    }
+    return snapshot;
+}
+
+std::string ToChromeJSON(const Snapshot& snapshot) {
+    rapidjson::StringBuffer output;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(output);
+    // Timestamps are relative to the oldest span so they stay readable
+    uint64_t origin = UINT64_MAX;
+    for (const Event& event : snapshot.events) {
+        origin = std::min(origin, event.start);
+    }
+
+    writer.StartObject();
+    writer.Key("displayTimeUnit");
+    writer.String("ms");
+    writer.Key("traceEvents");
+    writer.StartArray();
+    for (size_t thread = 0; thread < snapshot.threadNames.size(); thread++) {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String("thread_name");
+        writer.Key("ph");
+        writer.String("M");
+        writer.Key("pid");
+        writer.Int(1);
+        writer.Key("tid");
+        writer.Uint(thread);
+        writer.Key("args");
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(snapshot.threadNames[thread].c_str());
+        writer.EndObject();
+        writer.EndObject();
+    }
+    for (const Event& event : snapshot.events) {
+        if (!event.name) continue;
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(event.name);
+        writer.Key("ph");
+        writer.String("X");
+        writer.Key("pid");
+        writer.Int(1);
+        writer.Key("tid");
+        writer.Uint(event.thread);
+        // Chrome traces are in microseconds
+        writer.Key("ts");
+        writer.Double((event.start - origin) / 1000.0);
+        writer.Key("dur");
+        writer.Double((event.end - event.start) / 1000.0);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return output.GetString();
+}
+
+bool WriteChromeJSON(const Snapshot& snapshot, const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        LOG_ERROR("Could not write trace " << path);
+        return false;
+    }
+    file << ToChromeJSON(snapshot);
+    LOG_INFO("Wrote " << snapshot.events.size() << " trace events to " << path);
+    return true;
+}
+
+}
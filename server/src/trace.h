@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Timed spans kept in per thread ring buffers and written out as Chrome
+//   trace JSON, which Perfetto (ui.perfetto.dev) and chrome://tracing open.
+//   Spans nest by time, so a scope inside another shows under it. Tracing
+//   is off unless enabled, a disabled scope costs one relaxed load.
+namespace Trace {
+    inline std::atomic<bool> Enabled { false };
+
+    inline bool IsEnabled() { return Enabled.load(std::memory_order_relaxed); }
+    inline void SetEnabled(bool enabled) { Enabled.store(enabled, std::memory_order_relaxed); }
+
+    // Nanoseconds, steady clock
+    inline uint64_t Now() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // The name is kept by pointer, it has to be a literal or from Intern
+    void Record(const char* name, uint64_t start, uint64_t end);
+    // A pointer to a copy of the name that lives as long as the process
+    const char* Intern(const std::string& name);
+    // Shown for the calling thread's track
+    void SetThreadName(const std::string& name);
+
+    struct Event {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+        uint32_t thread;
+    };
+
+    struct Snapshot {
+        std::vector<Event> events;
+        // Indexed by Event::thread
+        std::vector<std::string> threadNames;
+    };
+
+    // Copies what's in every thread's ring buffer, other threads keep
+    //   recording meanwhile
+    Snapshot TakeSnapshot();
+    std::string ToChromeJSON(const Snapshot& snapshot);
+    // False if the file couldn't be written
+    bool WriteChromeJSON(const Snapshot& snapshot, const std::string& path);
+};
+
+// Records the lifetime of the scope as one span
+class TraceScope {
+    const char* name;
+    uint64_t start = 0;
+public:
+    TraceScope(const char* name) : name(Trace::IsEnabled() ? name : nullptr) {
+        if (this->name) start = Trace::Now();
+    }
+    ~TraceScope() {
+        if (name) Trace::Record(name, start, Trace::Now());
+    }
+};
+
+#define TRACE_JOIN_INNER(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN_INNER(a, b)
+#define TRACE_SCOPE(NAME) TraceScope TRACE_JOIN(_traceScope, __LINE__)(NAME)
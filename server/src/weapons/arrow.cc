@@ -6,6 +6,7 @@ ArrowObject::ArrowObject(Game& game, ObjectID playerId) : ThrownProjectile(game,
     SetModel(game.GetModel("Arrow.obj"));
     AddCollider(new OBBCollider(this, Vector3(-0.15, -0.15, -0.15), Vector3(0.3, 0.3, 0.3)));
     airFriction = Vector3(1, 1, 1);
+    SetContinuousCollision(true);
 }
 
 void ArrowObject::OnCollide(CollisionResult& result) {
@@ -8,6 +8,7 @@ GrenadeObject::GrenadeObject(Game& game, ObjectID playerId) : ThrownProjectile(g
     GenerateOBBCollidersFromModel(this);
     game.PlayAudio("GrenadeOut.wav", 1.f, this);
     airFriction = Vector3(0.97);
+    SetContinuousCollision(true);
 }
 
 void GrenadeObject::OnCollide(CollisionResult& result) {
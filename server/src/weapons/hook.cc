@@ -13,6 +13,7 @@ HookObject::HookObject(Game& game, ObjectID playerId) : ThrownProjectile(game, p
 
     game.PlayAudio("HookThrow.wav", 1.f, this);
     airFriction = Vector3(1, 1, 1);
+    SetContinuousCollision(true);
 }
 
 void HookObject::OnCollide(CollisionResult& result) {
@@ -44,6 +44,7 @@ void WeaponObject::PreDraw(Time time) {
         clientPosition = GetAttachedTo()->GetAttachmentPoint(attachmentPoint);
         clientRotation = GetAttachedTo()->GetClientRotationWithPitch();
         clientScale = GetAttachedTo()->GetClientScale();
+        clientPoseVersion++;
      }
 }
 #endif
@@ -0,0 +1,132 @@
+#include "compressed-texture.h"
+#include "logging.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+#define STB_IMAGE_IMPLEMENTATION
+#include "external/stb_image.h"
+#pragma GCC diagnostic pop
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <unordered_set>
+
+// Packs every JPG/PNG under a directory into a block compressed .ctex next
+//   to it, the client streams these in place of decoding the source images
+
+namespace fs = std::filesystem;
+
+// Larger sources are downsampled, a 4K texture is wasted on the web client
+static const uint32_t MaxPackedSize = 2048;
+
+static uint32_t NearestPowerOfTwo(uint32_t value) {
+    uint32_t lower = 1;
+    while (lower * 2 <= value) lower *= 2;
+    return (value - lower < lower * 2 - value) ? lower : lower * 2;
+}
+
+// Bilinear, only used to bring odd sized images onto a power of two
+static void ResizeImage(const uint8_t* rgba, uint32_t width, uint32_t height,
+        uint32_t outWidth, uint32_t outHeight, std::vector<uint8_t>& out) {
+    out.resize(outWidth * outHeight * 4);
+    for (uint32_t y = 0; y < outHeight; y++) {
+        float sy = std::max(0.f, (y + 0.5f) * height / outHeight - 0.5f);
+        uint32_t y0 = std::min((uint32_t) sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+        float fy = sy - y0;
+        for (uint32_t x = 0; x < outWidth; x++) {
+            float sx = std::max(0.f, (x + 0.5f) * width / outWidth - 0.5f);
+            uint32_t x0 = std::min((uint32_t) sx, width - 1), x1 = std::min(x0 + 1, width - 1);
+            float fx = sx - x0;
+            for (int i = 0; i < 4; i++) {
+                float top = rgba[(y0 * width + x0) * 4 + i] * (1 - fx) + rgba[(y0 * width + x1) * 4 + i] * fx;
+                float bottom = rgba[(y1 * width + x0) * 4 + i] * (1 - fx) + rgba[(y1 * width + x1) * 4 + i] * fx;
+                out[(y * outWidth + x) * 4 + i] = (uint8_t) (top * (1 - fy) + bottom * fy + 0.5f);
+            }
+        }
+    }
+}
+
+static bool IsSourceImage(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg";
+}
+
+static void PackTexture(const fs::path& source, const fs::path& output) {
+    int width, height, channels;
+    // Matches AssetManager::LoadTexture
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* data = stbi_load(source.string().c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        LOG_ERROR("Could not load texture " << source);
+        throw std::runtime_error("Could not load texture");
+    }
+
+    std::vector<uint8_t> image(data, data + width * height * 4);
+    stbi_image_free(data);
+
+    // WebGL wants level 0 of S3TC textures in whole blocks
+    uint32_t packedWidth = std::max(4u, NearestPowerOfTwo(width));
+    uint32_t packedHeight = std::max(4u, NearestPowerOfTwo(height));
+    if (packedWidth != (uint32_t) width || packedHeight != (uint32_t) height) {
+        std::vector<uint8_t> resized;
+        ResizeImage(image.data(), width, height, packedWidth, packedHeight, resized);
+        image.swap(resized);
+    }
+    while (packedWidth > MaxPackedSize || packedHeight > MaxPackedSize) {
+        std::vector<uint8_t> next;
+        DownsampleImage(image.data(), packedWidth, packedHeight, next);
+        image.swap(next);
+        packedWidth = std::max(1u, packedWidth / 2);
+        packedHeight = std::max(1u, packedHeight / 2);
+    }
+
+    CompressedFormat format = CompressedFormat::BC1;
+    for (size_t i = 3; i < image.size(); i += 4) {
+        if (image[i] != 255) {
+            format = CompressedFormat::BC3;
+            break;
+        }
+    }
+
+    std::ofstream stream(output, std::ios::binary);
+    WriteCompressedTexture(stream, format, image.data(), packedWidth, packedHeight);
+    LOG_INFO("Packed " << source << " " << width << "x" << height << " -> "
+        << (format == CompressedFormat::BC1 ? "BC1 " : "BC3 ")
+        << packedWidth << "x" << packedHeight << ", " << fs::file_size(source) / 1024
+        << "KB -> " << fs::file_size(output) / 1024 << "KB");
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        LOG_ERROR("usage: " << argv[0] << " <texture_dir>");
+        return 1;
+    }
+
+    std::vector<fs::path> sources;
+    for (auto& entry : fs::recursive_directory_iterator(argv[1])) {
+        if (entry.is_regular_file() && IsSourceImage(entry.path())) {
+            sources.push_back(entry.path());
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+
+    std::unordered_set<std::string> outputs;
+    size_t packed = 0;
+    for (auto& source : sources) {
+        fs::path output = CompressedTexturePath(source.string());
+        if (!outputs.insert(output.string()).second) {
+            LOG_ERROR("Skipping " << source << ", another image already packs to " << output);
+            continue;
+        }
+        if (fs::exists(output) && fs::last_write_time(output) >= fs::last_write_time(source)) {
+            continue;
+        }
+        PackTexture(source, output);
+        packed++;
+    }
+    LOG_INFO("Packed " << packed << " of " << sources.size() << " textures");
+    return 0;
+}
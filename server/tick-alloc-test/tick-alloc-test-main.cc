@@ -0,0 +1,154 @@
+#include "game.h"
+#include "global.h"
+#include "logging.h"
+#include "collision.h"
+#include "model.h"
+#include "static-mesh.h"
+#include "weapons/arrow.h"
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Counts the heap allocations of steady ticks, once every buffer has grown
+//   to fit. It replaces the global allocator, so it is a binary of its own
+//   rather than one of the tests every server build links
+
+// Allocations made by the thread that asked for them to be counted
+static thread_local bool CountAllocations = false;
+static thread_local size_t Allocations = 0;
+
+void* operator new(size_t size) {
+    if (CountAllocations) {
+        Allocations++;
+    }
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+template<class F>
+static size_t CountDuring(F&& run) {
+    Allocations = 0;
+    CountAllocations = true;
+    run();
+    CountAllocations = false;
+    return Allocations;
+}
+
+int main() {
+    // No map, the objects below are the whole world
+    GlobalSettings.RunTests = true;
+    // Outlives the game, the ground's collider shares its collision mesh
+    Model groundModel;
+    Game game;
+
+    // Static mesh ground in 4 unit cells, big enough that its BVH has
+    //   internal nodes to walk
+    Mesh* groundMesh = new Mesh;
+    for (int x = -16; x < 112; x += 4) {
+        for (int z = -8; z < 8; z += 4) {
+            int corners[4][2] = { { x, z }, { x + 4, z }, { x + 4, z + 4 }, { x, z + 4 } };
+            for (int corner : { 0, 2, 1, 0, 3, 2 }) {
+                groundMesh->indices.push_back(groundMesh->vertices.size());
+                groundMesh->vertices.emplace_back((float) corners[corner][0], 0, (float) corners[corner][1], 0, 1, 0);
+            }
+        }
+    }
+    groundModel.meshes.push_back(groundMesh);
+    // Set up like a map's static mesh, only its model isn't a loaded asset
+    StaticMeshObject* ground = new StaticMeshObject(game);
+    ground->SetPosition(Vector3(0, -0.25f, 0));
+    ground->SetModel(&groundModel);
+    GenerateStaticMeshCollidersFromModel(ground);
+    game.AddObject(ground);
+
+    std::vector<GameObject*> objects;
+    for (int i = 0; i < 64; i++) {
+        GameObject* object = new GameObject(game, Vector3(i, 0, 0));
+        // Close enough to be collision candidates without touching, each
+        //   stands on the ground
+        object->AddCollider(new OBBCollider(object, Vector3(-0.25), Vector3(0.5)));
+        // Half keep sliding, the rest go to sleep
+        if (i % 2) {
+            object->airFriction = Vector3(1);
+            object->SetVelocity(Vector3(0.1f, 0, 0));
+        }
+        game.AddObject(object);
+        objects.push_back(object);
+    }
+    for (size_t i = 0; i + 1 < objects.size(); i += 4) {
+        game.AssignParent(objects[i + 1], objects[i]);
+    }
+
+    // Skims the ground the whole run, so every tick sweeps it against
+    //   the mesh and sets its rotation
+    ArrowObject* arrow = new ArrowObject(game, 0);
+    arrow->SetPosition(Vector3(0, 0, 4));
+    arrow->SetTag(Tag::NO_GRAVITY);
+    arrow->SetVelocity(Vector3(10, 0, 0));
+    game.AddObject(arrow);
+
+    Time time = 0;
+    for (int i = 0; i < 60; i++) {
+        game.Tick(time += TickInterval);
+    }
+
+    // The hierarchy pass runs every object's Tick and collisions, it is what
+    //   the frame arena and the reused buffers were made for
+    const int Ticks = 100;
+    size_t hierarchy = CountDuring([&] {
+        for (int i = 0; i < Ticks; i++) {
+            game.GetFrameArena().Reset();
+            game.GetRelationshipManager().Tick(time += TickInterval);
+        }
+    });
+    // Whole ticks with nothing new to send
+    size_t ticks = CountDuring([&] {
+        for (int i = 0; i < Ticks; i++) {
+            game.Tick(time += TickInterval);
+        }
+    });
+    // Replication serializes what changed into a JSON string per message,
+    //   rapidjson's buffers and the socket's copy are heap allocated. That
+    //   is per message rather than per object tick, so it is only logged
+    size_t replicating = CountDuring([&] {
+        for (int i = 0; i < Ticks; i++) {
+            if (i % 6 == 0) {
+                game.QueueAllForReplication(time);
+            }
+            game.Tick(time += TickInterval);
+        }
+    });
+    LOG_INFO(replicating << " heap allocations in " << Ticks << " ticks replicating every object every 6th");
+
+    int failures = 0;
+    if (arrow->IsStatic() || !game.ObjectExists(arrow->GetId())) {
+        LOG_ERROR("FAILED: the arrow stopped, later ticks didn't sweep it");
+        failures++;
+    }
+    if (hierarchy != 0) {
+        LOG_ERROR("FAILED: " << hierarchy << " heap allocations in " << Ticks << " hierarchy passes");
+        failures++;
+    }
+    else {
+        LOG_INFO("No heap allocations in " << Ticks << " hierarchy passes");
+    }
+    if (ticks != 0) {
+        LOG_ERROR("FAILED: " << ticks << " heap allocations in " << Ticks << " whole ticks");
+        failures++;
+    }
+    else {
+        LOG_INFO("No heap allocations in " << Ticks << " whole ticks");
+    }
+    return failures;
+}
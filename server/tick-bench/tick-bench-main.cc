@@ -0,0 +1,375 @@
+#include "game.h"
+#include "objects.h"
+#include "global.h"
+#include "logging.h"
+#include "timer.h"
+#include "map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+
+// Runs Game::Tick on a map at a fixed time step with no sockets, keeping
+//   populations of scripted players, projectiles, grenades and loot alive,
+//   and reports what each phase of the tick costs. Run from the repository
+//   root so data/ is found. Everything random is seeded, two runs of the
+//   same commit simulate the same game and their JSON can be diffed
+
+struct Population {
+    size_t players = 32;
+    size_t grenades = 16;
+    size_t arrows = 32;
+    size_t loot = 64;
+    // Fastest horizontal speed arrows are shot at
+    float arrowSpeed = 30;
+};
+
+struct BenchSettings {
+    std::vector<std::string> maps { "maps/map1.json", "maps/dust2.json", "maps/test-range.json" };
+    size_t ticks = 3000;
+    // Ticks run before measuring, so populations have spread out
+    size_t warmupTicks = 300;
+    unsigned int seed = 1;
+    Population population;
+    // Off moves projectiles in collider sized steps instead of sweeping them
+    bool continuousCollision = true;
+    std::string output = "tick-bench.json";
+};
+
+static const char* Characters[] = { "Marine", "Archer", "Bombmaker", "Hookman" };
+
+// Key codes the browser sends, see KEY_MAP in player.cc
+static const int MovementKeys[] = { 87, 65, 83, 68 };
+static const int SpaceKey = 32;
+static const int WeaponKeys[] = { 49, 50, 51, 52 };
+
+// Drives one player with the input a client would send
+struct ScriptedPlayer {
+    ObjectID id = 0;
+    int movementKey = 0;
+    Time nextMovementChange = 0;
+    bool firing = false;
+    Time nextFireChange = 0;
+};
+
+class TickBench {
+    Game& game;
+    std::mt19937 random;
+    Population population;
+
+    std::vector<ScriptedPlayer> players;
+    std::vector<ObjectID> grenades;
+    std::vector<ObjectID> arrows;
+    std::vector<ObjectID> loot;
+    // Sorted so picking from them doesn't depend on the table's order
+    std::vector<std::string> lootClasses;
+    size_t nextCharacter = 0;
+
+    float Between(float low, float high) {
+        return std::uniform_real_distribution<float>(low, high)(random);
+    }
+
+    Vector3 AroundSpawn(float spread, float low, float high) {
+        return RESPAWN_LOCATION + Vector3(Between(-spread, spread), Between(low, high), Between(-spread, spread));
+    }
+
+    // Stamped for the tick after the player's current one, which is when
+    //   a client that keeps up with the server would have it processed
+    void SendInput(PlayerObject* player, const std::string& event, const std::string& fields) {
+        Time time = player->lastClientInputTime + (player->ticksSinceLastProcessed + 1) * TickInterval;
+        JSONDocument input;
+        std::string text = "{\"event\":\"" + event + "\"," + fields + ",\"time\":" + std::to_string(time) + "}";
+        input.Parse(text.c_str());
+        player->OnInput(input);
+    }
+
+    void PlayInput(ScriptedPlayer& scripted, Time time) {
+        PlayerObject* player = game.GetObject<PlayerObject>(scripted.id);
+        auto key = [](int code) { return "\"key\":" + std::to_string(code); };
+
+        if (time >= scripted.nextMovementChange) {
+            if (scripted.movementKey) {
+                SendInput(player, "ku", key(scripted.movementKey));
+            }
+            size_t choice = random() % 5;
+            scripted.movementKey = choice < 4 ? MovementKeys[choice] : 0;
+            if (scripted.movementKey) {
+                SendInput(player, "kd", key(scripted.movementKey));
+            }
+            if (random() % 4 == 0) {
+                SendInput(player, "kd", key(SpaceKey));
+                SendInput(player, "ku", key(SpaceKey));
+            }
+            if (random() % 8 == 0) {
+                int weapon = WeaponKeys[random() % 4];
+                SendInput(player, "kd", key(weapon));
+                SendInput(player, "ku", key(weapon));
+            }
+            scripted.nextMovementChange = time + 300 + random() % 1200;
+        }
+        if (time >= scripted.nextFireChange) {
+            scripted.firing = !scripted.firing;
+            SendInput(player, scripted.firing ? "md" : "mu", "\"button\":1");
+            scripted.nextFireChange = time + (scripted.firing ? 100 + random() % 500 : 500 + random() % 2500);
+        }
+        if (random() % 10 < 7) {
+            SendInput(player, "mm", "\"x\":" + std::to_string((int) Between(-20, 20)) +
+                ",\"y\":" + std::to_string((int) Between(-5, 5)));
+        }
+    }
+
+    template <class T>
+    static void RemoveDead(Game& game, std::vector<T>& objects, ObjectID T::*id) {
+        objects.erase(std::remove_if(objects.begin(), objects.end(), [&game, id](const T& object) {
+            return !game.ObjectExists(object.*id);
+        }), objects.end());
+    }
+
+    static void RemoveDead(Game& game, std::vector<ObjectID>& objects) {
+        objects.erase(std::remove_if(objects.begin(), objects.end(), [&game](ObjectID id) {
+            return !game.ObjectExists(id);
+        }), objects.end());
+    }
+
+public:
+    TickBench(Game& game, const Population& population, unsigned int seed)
+        : game(game), random(seed), population(population) {
+        for (auto& [className, weight] : LootTable) {
+            lootClasses.push_back(className);
+        }
+        std::sort(lootClasses.begin(), lootClasses.end());
+    }
+
+    // Tops every population back up and sends this tick's input
+    void Populate(Time time) {
+        RemoveDead(game, players, &ScriptedPlayer::id);
+        RemoveDead(game, grenades);
+        RemoveDead(game, arrows);
+        RemoveDead(game, loot);
+
+        // Respawned like a client's player would be, nothing else does it
+        //   without a socket
+        while (players.size() < population.players) {
+            Object* player = game.CreateScriptedObject(Characters[nextCharacter++ % 4]);
+            player->SetPosition(AroundSpawn(10, 0, 2));
+            game.AddObject(player);
+            players.push_back(ScriptedPlayer{ player->GetId() });
+        }
+        while (grenades.size() < population.grenades) {
+            GrenadeObject* grenade = new GrenadeObject(game, 0);
+            grenade->SetPosition(AroundSpawn(20, 5, 15));
+            grenade->SetVelocity(Vector3(Between(-5, 5), Between(0, 5), Between(-5, 5)));
+            game.AddObject(grenade);
+            grenades.push_back(grenade->GetId());
+        }
+        while (arrows.size() < population.arrows) {
+            ArrowObject* arrow = new ArrowObject(game, 0);
+            arrow->SetPosition(AroundSpawn(20, 2, 10));
+            float speed = population.arrowSpeed;
+            arrow->SetVelocity(Vector3(Between(-speed, speed), Between(0, 5), Between(-speed, speed)));
+            game.AddObject(arrow);
+            arrows.push_back(arrow->GetId());
+        }
+        auto& classLookup = GetClassLookup();
+        while (loot.size() < population.loot) {
+            Object* item = classLookup[lootClasses[random() % lootClasses.size()]](game);
+            item->SetPosition(AroundSpawn(25, 2, 10));
+            game.AddObject(item);
+            loot.push_back(item->GetId());
+        }
+
+        for (ScriptedPlayer& player : players) {
+            PlayInput(player, time);
+        }
+    }
+};
+
+// Positions of everything left, a change means the simulation differs
+static double Checksum(Game& game) {
+    double sum = 0;
+    for (auto& [id, object] : game.GetGameObjects()) {
+        Vector3 position = object->GetPosition();
+        sum += id * (std::abs(position.x) + std::abs(position.y) + std::abs(position.z));
+    }
+    return sum;
+}
+
+static void WritePhase(JSONWriter& writer, const char* name, std::vector<Time> values) {
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p) {
+        return values.empty() ? 0 : values[std::min(values.size() - 1, (size_t) (p * (values.size() - 1) + 0.5))];
+    };
+    Time max = values.empty() ? 0 : values.back();
+    double mean = 0;
+    for (Time value : values) mean += value;
+    mean /= std::max<size_t>(values.size(), 1);
+
+    writer.Key(name);
+    writer.StartObject();
+    writer.Key("mean");
+    writer.Double(mean);
+    writer.Key("p50");
+    writer.Uint64(percentile(0.5));
+    writer.Key("p90");
+    writer.Uint64(percentile(0.9));
+    writer.Key("p99");
+    writer.Uint64(percentile(0.99));
+    writer.Key("max");
+    writer.Uint64(max);
+    writer.EndObject();
+
+    // Same columns as the JSON, under the header RunMap logs
+    LOG_INFO("    " << std::left << std::setw(17) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(9) << mean << std::setw(8) << percentile(0.5) << std::setw(8) << percentile(0.9)
+        << std::setw(8) << percentile(0.99) << std::setw(8) << max);
+}
+
+static void RunMap(const std::string& map, const BenchSettings& settings, JSONWriter& writer) {
+    // Loading and every tick log per object, which would swamp what's
+    //   being measured. Skipped below the level they aren't even formatted
+    LogLevel level = Log::MinimumLevel.load();
+    Log::SetLevel(std::max(level, LogLevel::Warning));
+
+    GlobalSettings.MapPath = map;
+    GlobalSettings.LootSeed = settings.seed;
+    std::vector<TickPhaseTimes> phases;
+    size_t objects = 0;
+    size_t sleeping = 0;
+    double checksum;
+    {
+        Game game;
+        TickBench bench(game, settings.population, settings.seed);
+        game.profileTick = true;
+        game.continuousCollision = settings.continuousCollision;
+        Time time = 0;
+        for (size_t tick = 0; tick < settings.warmupTicks + settings.ticks; tick++) {
+            time += TickInterval;
+            bench.Populate(time);
+            game.Tick(time);
+            if (tick >= settings.warmupTicks) {
+                phases.push_back(game.tickPhases);
+                objects += game.GetGameObjects().size();
+                for (auto& [id, object] : game.GetGameObjects()) {
+                    sleeping += object->IsSleeping();
+                }
+            }
+        }
+        checksum = Checksum(game);
+    }
+    Log::SetLevel(level);
+
+    LOG_INFO(map << ": " << settings.ticks << " ticks, " << objects / std::max<size_t>(settings.ticks, 1)
+        << " objects on average, " << sleeping / std::max<size_t>(settings.ticks, 1) << " sleeping");
+    writer.StartObject();
+    writer.Key("map");
+    writer.String(map.c_str());
+    writer.Key("averageObjects");
+    writer.Double((double) objects / std::max<size_t>(settings.ticks, 1));
+    writer.Key("averageSleeping");
+    writer.Double((double) sleeping / std::max<size_t>(settings.ticks, 1));
+    writer.Key("checksum");
+    writer.Double(checksum);
+    writer.Key("phases");
+    writer.StartObject();
+
+    LOG_INFO("    " << std::left << std::setw(17) << "phase (us)" << std::right << std::setw(9) << "mean"
+        << std::setw(8) << "p50" << std::setw(8) << "p90" << std::setw(8) << "p99" << std::setw(8) << "max");
+    auto phase = [&phases](Time TickPhaseTimes::*field) {
+        std::vector<Time> values;
+        for (auto& tick : phases) {
+            values.push_back(tick.*field);
+        }
+        return values;
+    };
+    WritePhase(writer, "queuedCalls", phase(&TickPhaseTimes::queuedCalls));
+    WritePhase(writer, "flushNewObjects", phase(&TickPhaseTimes::flushNewObjects));
+    WritePhase(writer, "relationshipTick", phase(&TickPhaseTimes::relationshipTick));
+    WritePhase(writer, "collisions", phase(&TickPhaseTimes::collisions));
+    WritePhase(writer, "killPlane", phase(&TickPhaseTimes::killPlane));
+    WritePhase(writer, "deadObjects", phase(&TickPhaseTimes::deadObjects));
+    WritePhase(writer, "replicate", phase(&TickPhaseTimes::replicate));
+    WritePhase(writer, "total", phase(&TickPhaseTimes::total));
+
+    writer.EndObject();
+    writer.EndObject();
+}
+
+static void Usage(char* arg0) {
+    std::cout << "usage: " << arg0 << " [options] [maps...]" << std::endl;
+    std::cout << "    options: " << std::endl;
+    std::cout << "        --ticks N        : measured ticks per map (3000)" << std::endl;
+    std::cout << "        --warmup N       : ticks before measuring (300)" << std::endl;
+    std::cout << "        --seed N         : seeds loot, spawns and input (1)" << std::endl;
+    std::cout << "        --players N      : scripted players kept alive (32)" << std::endl;
+    std::cout << "        --grenades N     : grenades kept in the air (16)" << std::endl;
+    std::cout << "        --arrows N       : arrows kept in the air (32)" << std::endl;
+    std::cout << "        --loot N         : loot kept on the ground besides the map's own (64)" << std::endl;
+    std::cout << "        --arrow-speed N  : fastest horizontal speed of the arrows (30)" << std::endl;
+    std::cout << "        --substeps       : move projectiles in steps instead of sweeping them" << std::endl;
+    std::cout << "        --out PATH       : JSON results (tick-bench.json)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    BenchSettings settings;
+    std::vector<std::string> maps;
+    for (int i = 1; i < argc; i++) {
+        std::string arg { argv[i] };
+        bool hasValue = i + 1 < argc;
+        if (arg == "--ticks" && hasValue) settings.ticks = std::stoul(argv[++i]);
+        else if (arg == "--warmup" && hasValue) settings.warmupTicks = std::stoul(argv[++i]);
+        else if (arg == "--seed" && hasValue) settings.seed = std::stoul(argv[++i]);
+        else if (arg == "--players" && hasValue) settings.population.players = std::stoul(argv[++i]);
+        else if (arg == "--grenades" && hasValue) settings.population.grenades = std::stoul(argv[++i]);
+        else if (arg == "--arrows" && hasValue) settings.population.arrows = std::stoul(argv[++i]);
+        else if (arg == "--loot" && hasValue) settings.population.loot = std::stoul(argv[++i]);
+        else if (arg == "--arrow-speed" && hasValue) settings.population.arrowSpeed = std::stof(argv[++i]);
+        else if (arg == "--substeps") settings.continuousCollision = false;
+        else if (arg == "--out" && hasValue) settings.output = argv[++i];
+        else if (arg.rfind("--", 0) == 0) {
+            Usage(argv[0]);
+            return 1;
+        }
+        else maps.push_back(arg);
+    }
+    if (!maps.empty()) {
+        settings.maps = maps;
+    }
+
+    rapidjson::StringBuffer buffer;
+    JSONWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("seed");
+    writer.Uint(settings.seed);
+    writer.Key("ticks");
+    writer.Uint64(settings.ticks);
+    writer.Key("tickInterval");
+    writer.Int(TickInterval);
+    writer.Key("continuousCollision");
+    writer.Bool(settings.continuousCollision);
+    writer.Key("population");
+    writer.StartObject();
+    writer.Key("players");
+    writer.Uint64(settings.population.players);
+    writer.Key("grenades");
+    writer.Uint64(settings.population.grenades);
+    writer.Key("arrows");
+    writer.Uint64(settings.population.arrows);
+    writer.Key("loot");
+    writer.Uint64(settings.population.loot);
+    writer.Key("arrowSpeed");
+    writer.Double(settings.population.arrowSpeed);
+    writer.EndObject();
+    writer.Key("maps");
+    writer.StartArray();
+    for (auto& map : settings.maps) {
+        RunMap(map, settings, writer);
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    std::ofstream output(settings.output);
+    output << buffer.GetString() << std::endl;
+    LOG_INFO("Wrote " << settings.output);
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "voice_manager.h"
+#include "logging.h"
+
+#include <AL/alc.h>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+// Runs the voice manager against a real OpenAL context without needing
+//   audio hardware, OpenAL Soft's null backend mixes into nothing
+
+static int failures = 0;
+
+static void Expect(bool condition, const std::string& what) {
+    if (!condition) {
+        LOG_ERROR("FAILED: " << what);
+        failures++;
+    }
+}
+
+static void ExpectStats(const VoiceStats& stats, size_t started, size_t coalesced, size_t culled,
+        size_t stolen, size_t dropped, size_t active, const std::string& what) {
+    Expect(stats.started == started, what + ": started " + std::to_string(stats.started));
+    Expect(stats.coalesced == coalesced, what + ": coalesced " + std::to_string(stats.coalesced));
+    Expect(stats.culled == culled, what + ": culled " + std::to_string(stats.culled));
+    Expect(stats.stolen == stolen, what + ": stolen " + std::to_string(stats.stolen));
+    Expect(stats.dropped == dropped, what + ": dropped " + std::to_string(stats.dropped));
+    Expect(stats.active == active, what + ": active " + std::to_string(stats.active));
+    Expect(alGetError() == AL_NO_ERROR, what + ": OpenAL error");
+}
+
+// Mono 16 bit PCM silence, for a clip to stream
+static void WriteSilentWav(const std::string& path, uint32_t sampleRate, uint32_t frames) {
+    std::ofstream file(path, std::ios::binary);
+    auto write32 = [&](uint32_t value) { file.write(reinterpret_cast<const char*>(&value), 4); };
+    auto write16 = [&](uint16_t value) { file.write(reinterpret_cast<const char*>(&value), 2); };
+    file.write("RIFF", 4);
+    write32(36 + frames * 2);
+    file.write("WAVEfmt ", 8);
+    write32(16);
+    write16(1);
+    write16(1);
+    write32(sampleRate);
+    write32(sampleRate * 2);
+    write16(2);
+    write16(16);
+    file.write("data", 4);
+    write32(frames * 2);
+    std::vector<char> samples(frames * 2);
+    file.write(samples.data(), samples.size());
+}
+
+static VoiceRequest At(Audio* audio, float x, float gain = 1.0f, int priority = 0) {
+    VoiceRequest request;
+    request.audio = audio;
+    request.position = Vector3(x, 0, 0);
+    request.gain = gain;
+    request.priority = priority;
+    return request;
+}
+
+int main() {
+    setenv("ALSOFT_DRIVERS", "null", 0);
+    ALCdevice* device = alcOpenDevice(nullptr);
+    if (!device) {
+        LOG_ERROR("Could not open the null audio device");
+        return 1;
+    }
+    ALCcontext* context = alcCreateContext(device, nullptr);
+    alcMakeContextCurrent(context);
+
+    // A second of silence
+    std::vector<signed short> samples(44100);
+    Audio audio { samples.data(), 1, 44100, samples.size() };
+    audio.InitializeAudio();
+    Audio other = audio;
+    other.InitializeAudio();
+
+    {
+        VoiceManager voices;
+        voices.Initialize(8);
+        Time now = 1000;
+
+        // More sounds than voices, the quietest (furthest) are dropped
+        for (int i = 0; i < 20; i++) {
+            voices.Play(At(&audio, i * 2.0f));
+        }
+        voices.Update(now, Vector3(0));
+        ExpectStats(voices.GetStats(), 8, 0, 0, 0, 12, 8, "pool");
+        float furthest = 0;
+        for (Voice& voice : voices.GetVoices()) {
+            furthest = std::max(furthest, voice.request.position.x);
+        }
+        Expect(furthest == 14.0f, "pool keeps the closest sounds");
+
+        // A closer sound takes the furthest voice, a far one gets nothing
+        voices.Play(At(&audio, 1.0f));
+        voices.Play(At(&audio, 100.0f));
+        voices.Update(now += 16, Vector3(0));
+        ExpectStats(voices.GetStats(), 1, 0, 0, 1, 1, 8, "steal");
+
+        // Priority beats loudness, low priority can't take these voices
+        for (Voice& voice : voices.GetVoices()) {
+            voice.request.priority = 1;
+        }
+        voices.Play(At(&other, 0.5f, 1.0f, 0));
+        voices.Update(now += 16, Vector3(0));
+        ExpectStats(voices.GetStats(), 0, 0, 0, 0, 1, 8, "priority");
+
+        // Every voice has played its second
+        voices.Update(now += 1000, Vector3(0));
+        ExpectStats(voices.GetStats(), 0, 0, 0, 0, 0, 0, "finish");
+
+        // A burst in one place plays once, other sounds nearby don't merge
+        for (int i = 0; i < 10; i++) {
+            voices.Play(At(&audio, 5.0f + i * 0.05f, 0.5f + i * 0.01f));
+        }
+        voices.Play(At(&other, 5.0f));
+        voices.Update(now += 16, Vector3(0));
+        ExpectStats(voices.GetStats(), 2, 9, 0, 0, 0, 2, "coalesce");
+        for (Voice& voice : voices.GetVoices()) {
+            if (voice.active && voice.request.audio == &audio) {
+                Expect(std::abs(voice.request.gain - 0.59f) < 1e-5f, "coalesced sound keeps the loudest gain");
+            }
+        }
+
+        // Out of earshot, never given a voice
+        voices.Play(At(&audio, 1000.0f, 0.5f));
+        voices.Play(At(&audio, 0.0f, 0.001f));
+        voices.Update(now += 16, Vector3(0));
+        ExpectStats(voices.GetStats(), 0, 0, 2, 0, 0, 2, "cull");
+
+        // A voice that last played a static clip has to take a stream
+        std::string streamPath = (std::filesystem::temp_directory_path() / "voice-test-stream.wav").string();
+        WriteSilentWav(streamPath, 44100, 44100);
+        Audio streamed { nullptr, 1, 44100, 44100 };
+        streamed.streamed = true;
+        streamed.path = streamPath;
+        voices.Play(At(&streamed, 0.0f));
+        voices.Update(now += 16, Vector3(0));
+        ExpectStats(voices.GetStats(), 1, 0, 0, 0, 0, 3, "static then streamed");
+        Expect(voices.GetStats().streaming == 1, "static then streamed: streaming");
+        for (Voice& voice : voices.GetVoices()) {
+            if (voice.active && voice.request.audio == &streamed) {
+                ALint queued = 0;
+                alGetSourcei(voice.source, AL_BUFFERS_QUEUED, &queued);
+                Expect(queued > 0, "static then streamed: buffers queued");
+            }
+        }
+        // And back to a static clip once the stream is taken off it
+        for (Voice& voice : voices.GetVoices()) {
+            voice.request.priority = 0;
+        }
+        for (int i = 0; i < 8; i++) {
+            voices.Play(At(&audio, 0.1f, 1.0f, 1));
+            voices.Play(At(&other, 0.1f + i * 5.0f, 1.0f, 1));
+        }
+        voices.Update(now += 16, Vector3(0));
+        ExpectStats(voices.GetStats(), 8, 7, 0, 3, 1, 8, "streamed then static");
+        Expect(voices.GetStats().streaming == 0, "streamed then static: still streaming");
+        std::filesystem::remove(streamPath);
+    }
+
+    alDeleteBuffers(1, &audio.audioBuffer);
+    alDeleteBuffers(1, &other.audioBuffer);
+    alcMakeContextCurrent(nullptr);
+    alcDestroyContext(context);
+    alcCloseDevice(device);
+
+    if (failures) {
+        LOG_ERROR(failures << " voice manager checks failed");
+        return 1;
+    }
+    LOG_INFO("Voice manager checks passed");
+    return 0;
+}